@@ -0,0 +1,105 @@
+/* trace_format.h - On-disk layout of the Preheat trace ring file
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Shared by the recorder in the daemon (daemon/trace.c) and the decoder
+ * in preheat-ctl (tools/ctl_cmd_trace.c), which does not link the daemon.
+ *
+ * LAYOUT:
+ *   [kp_trace_header_t, KP_TRACE_HEADER_SIZE bytes][data area, capacity bytes]
+ *
+ *   The data area is a ring of records. Each starts with a
+ *   kp_trace_record_t and is padded to KP_TRACE_ALIGN bytes. A record
+ *   never wraps: when the next one doesn't fit before the end, a PAD
+ *   record fills the rest and writing continues at offset 0. Records
+ *   overwritten by the head are dropped from the tail. All integers are
+ *   in host byte order.
+ *
+ * PAYLOADS:
+ *   Fields follow the record header back to back, without alignment;
+ *   strings are NUL-terminated. Read them with memcpy().
+ *
+ *   EXEC       i32 pid, i32 ppid, str exe
+ *              flags: KP_TRACE_F_USER
+ *   EXIT       i32 pid
+ *   MAPSET     u32 count, str exe, count × (u64 offset, u64 length, str path)
+ *              flags: KP_TRACE_F_TRUNCATED
+ *   CYCLE      i32 model time, i32 cycle length, i64 budget kB, i64 used kB,
+ *              u32 maps ranked, u32 maps selected,
+ *              u32 count, count × (f64 lnprob, str exe)
+ *              flags: KP_TRACE_F_URGENT, KP_TRACE_F_REWARM, KP_TRACE_F_COALESCED
+ *   READAHEAD  u32 files, u64 bytes,
+ *              u32 count, count × (u64 offset, u64 length, str path)
+ *              flags: KP_TRACE_F_REWARM, KP_TRACE_F_HOTSET, KP_TRACE_F_TRUNCATED,
+ *              KP_TRACE_F_REPEAT (count is 0: same files as the last
+ *              READAHEAD that has a list)
+ */
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+#define KP_TRACE_MAGIC          "PHTRACE1"
+#define KP_TRACE_VERSION        1
+#define KP_TRACE_HEADER_SIZE    128
+#define KP_TRACE_ALIGN          16
+#define KP_TRACE_MAX_RECORD     65536   /* Longer payloads are truncated */
+
+/**
+ * kp_trace_header_t: Start of the ring file
+ *
+ * Offsets are into the data area. written counts every byte ever
+ * appended, PAD records included, so a record's absolute position
+ * (written at the time it was appended) is still in the ring while it
+ * is >= written - used.
+ */
+typedef struct _kp_trace_header_t
+{
+    char magic[8];          /* KP_TRACE_MAGIC, no NUL */
+    uint32_t version;
+    uint32_t header_size;   /* KP_TRACE_HEADER_SIZE */
+    uint64_t capacity;      /* Size of the data area */
+    uint64_t head;          /* Where the next record goes */
+    uint64_t tail;          /* Oldest record */
+    uint64_t used;          /* Bytes from tail to head */
+    uint64_t written;       /* Bytes ever appended */
+    uint64_t records;       /* Records ever appended, PAD excluded */
+    uint64_t dropped;       /* Records lost (too long, file error) */
+    int64_t started_us;     /* File created, µs since the epoch */
+} kp_trace_header_t;
+
+/**
+ * kp_trace_record_t: Header of one record
+ */
+typedef struct _kp_trace_record_t
+{
+    uint32_t len;           /* Including this header and padding */
+    uint16_t type;          /* KP_TRACE_* */
+    uint16_t flags;         /* KP_TRACE_F_* */
+    int64_t time_us;        /* µs since the epoch */
+} kp_trace_record_t;
+
+/* Record types */
+#define KP_TRACE_PAD            0
+#define KP_TRACE_EXEC           1
+#define KP_TRACE_EXIT           2
+#define KP_TRACE_MAPSET         3
+#define KP_TRACE_CYCLE          4
+#define KP_TRACE_READAHEAD      5
+
+/* Record flags */
+#define KP_TRACE_F_USER         0x0001  /* EXEC: user-initiated launch */
+#define KP_TRACE_F_TRUNCATED    0x0002  /* List cut at KP_TRACE_MAX_RECORD */
+#define KP_TRACE_F_URGENT       0x0004  /* CYCLE: a map was due this cycle */
+#define KP_TRACE_F_REWARM       0x0008  /* Resume rewarm pass */
+#define KP_TRACE_F_COALESCED    0x0010  /* CYCLE: batch held back on battery */
+#define KP_TRACE_F_HOTSET       0x0020  /* READAHEAD: boot hot set */
+#define KP_TRACE_F_REPEAT       0x0040  /* READAHEAD: same files as before */
+
+#endif /* TRACE_FORMAT_H */
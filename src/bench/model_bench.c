@@ -0,0 +1,654 @@
+/* model_bench.c - Model hot path micro-benchmarks for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Model Benchmark
+ * =============================================================================
+ *
+ * Times the loops the daemon runs over its model every cycle, on a
+ * synthetic state of a chosen size, so a regression in any of them shows
+ * up as a number before a release rather than as CPU time on users'
+ * machines.
+ *
+ * SYNTHETIC STATE (fixed seed, so runs are comparable):
+ *   - M maps, each owned by one exe, plus shared picks skewed towards the
+ *     low map numbers (the common libraries every app maps)
+ *   - N exes of -l maps each, 60% in the priority pool, 5% running
+ *   - K Markov chains between random exe pairs, with filled-in transition
+ *     counts and times so every chain bids
+ *   - F families of 2-5 exes
+ *
+ * The model links against the simulator's proc and page cache modules
+ * (sim/sim_proc.c, sim/sim_cache.c), so prediction and readahead run
+ * their full path without touching /proc or the disk.
+ *
+ * BENCHMARKS:
+ *   map_hash           kp_map_hash() per map
+ *   map_lookup_hit     kp_state->maps lookup of an equal map, per lookup
+ *   map_lookup_miss    Lookup of a map that is not there
+ *   map_ref_unref      Register and drop a new map (kp_map_ref/unref)
+ *   markov_foreach     kp_markov_foreach(), per chain visited
+ *   exemap_foreach     kp_exemap_foreach(), per exemap visited
+ *   prophet_predict    kp_prophet_predict(), per cycle
+ *   record_preloaded   kp_prophet_record_preloaded_exes() on the top maps
+ *   state_write        kp_state_write_to_string(), per save
+ *   state_read         kp_state_load() of that output, per load
+ *
+ * OUTPUT:
+ *   One line per benchmark of space-separated key=value pairs, best of
+ *   -r rounds, preceded by a "bench=model" line describing the state.
+ *   --compare FILE reads an earlier run and exits 1 if any ns_per_op grew
+ *   by more than --tolerance percent (default 15).
+ *
+ * USAGE:
+ *   make -C src bench                       # build and run, default sizes
+ *   preheat-bench-model -e 2000 -m 80000 -k 20000 > after.txt
+ *   preheat-bench-model --compare before.txt
+ *
+ * Built on demand; not installed.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../state/state_io.h"
+#include "../predict/prophet.h"
+#include "../daemon/stats.h"
+#include "../utils/seeding.h"
+#include "../sim/sim.h"
+
+#include <time.h>
+#include <math.h>
+
+#define MODEL_TIME      500000  /* kp_state->time of the synthetic state */
+#define RECORD_MAPS     500     /* Batch size for record_preloaded */
+#define REF_UNREF_OPS   2000
+
+typedef struct _bench_params_t
+{
+    int exes;
+    int maps;
+    int markovs;
+    int families;
+    int maps_per_exe;
+    int rounds;
+} bench_params_t;
+
+typedef struct _bench_result_t
+{
+    char name[32];
+    double ns_per_op;
+} bench_result_t;
+
+static GArray *results;     /* bench_result_t */
+
+/* Deterministic xorshift64 generator */
+static guint64 rng_state = 0x9e3779b97f4a7c15ULL;
+
+static guint32
+rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (guint32)(rng_state >> 32);
+}
+
+static int
+rng_range(int lo, int hi)
+{
+    return lo + (int)(rng_next() % (guint32)(hi - lo + 1));
+}
+
+static double
+rng_unit(void)
+{
+    return rng_next() / 4294967296.0;
+}
+
+static gint64
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Print one result line and keep it for --compare
+ */
+static void
+report(const char *name, long ops, gint64 best_ns, const char *extra)
+{
+    bench_result_t r;
+
+    g_strlcpy(r.name, name, sizeof(r.name));
+    r.ns_per_op = ops > 0 ? (double)best_ns / ops : 0.0;
+    g_array_append_val(results, r);
+
+    printf("name=%s ops=%ld best_ns=%" G_GINT64_FORMAT " ns_per_op=%.1f%s%s\n",
+           name, ops, best_ns, r.ns_per_op, extra ? " " : "", extra ? extra : "");
+}
+
+/* ========================================================================
+ * SYNTHETIC STATE
+ * ======================================================================== */
+
+static kp_map_t *
+make_map(int i)
+{
+    char path[96];
+    size_t length = (size_t)(1 + (i * 2654435761U) % 512) << 12;
+
+    g_snprintf(path, sizeof(path), "/usr/lib/bench/%02d/libbench%05d.so", i % 64, i);
+    return kp_map_new(path, 0, length);
+}
+
+static void
+fill_markov(kp_markov_t *markov)
+{
+    markov->time = rng_range(0, MIN(markov->a->time, markov->b->time));
+    for (int i = 0; i < 4; i++) {
+        int left = 0;
+        for (int j = 0; j < 4; j++) {
+            markov->weight[i][j] = i == j ? 0 : rng_range(0, 40);
+            left += markov->weight[i][j];
+        }
+        markov->weight[i][i] = left;
+        markov->time_to_leave[i] = 60.0 + rng_unit() * 36000.0;
+    }
+}
+
+/**
+ * Build the synthetic model into kp_state (which must be empty)
+ *
+ * @return Number of Markov chains created
+ */
+static int
+generate_state(const bench_params_t *p)
+{
+    kp_map_t **maps = g_new(kp_map_t *, p->maps);
+    kp_exe_t **exes = g_new(kp_exe_t *, p->exes);
+    GHashTable *pairs = g_hash_table_new(g_int64_hash, g_int64_equal);
+    GArray *pair_keys = g_array_sized_new(FALSE, FALSE, sizeof(gint64), p->markovs);
+    int own = (p->maps + p->exes - 1) / p->exes;
+    int chains = 0;
+
+    kp_state->time = MODEL_TIME;
+    kp_state->last_running_timestamp = MODEL_TIME;
+    kp_state->last_accounting_timestamp = MODEL_TIME;
+    kp_state->cycle = kp_conf->model.cycle;
+
+    for (int i = 0; i < p->maps; i++)
+        maps[i] = make_map(i);
+
+    for (int e = 0; e < p->exes; e++) {
+        GSet *exemaps = g_set_new();
+        GHashTable *taken = g_hash_table_new(g_direct_hash, g_direct_equal);
+        char path[64];
+        kp_exe_t *exe;
+        int picks = 0;
+
+        /* Every map gets one owner, so all of them end up registered */
+        for (int i = e * own; i < MIN((e + 1) * own, p->maps); i++) {
+            kp_exemap_t *exemap = kp_exemap_new(maps[i]);
+            exemap->prob = 1.0;
+            g_set_add(exemaps, exemap);
+            g_hash_table_add(taken, GINT_TO_POINTER(i + 1));
+            picks++;
+        }
+
+        /* Shared libraries: quadratic skew towards the low map numbers */
+        for (int tries = 0; picks < p->maps_per_exe && tries < 4 * p->maps_per_exe; tries++) {
+            double u = rng_unit();
+            int i = (int)(u * u * p->maps);
+            kp_exemap_t *exemap;
+
+            if (g_hash_table_contains(taken, GINT_TO_POINTER(i + 1)))
+                continue;
+            g_hash_table_add(taken, GINT_TO_POINTER(i + 1));
+            exemap = kp_exemap_new(maps[i]);
+            exemap->prob = 1.0;
+            g_set_add(exemaps, exemap);
+            picks++;
+        }
+        g_hash_table_destroy(taken);
+
+        g_snprintf(path, sizeof(path), "/usr/bin/bench-app%05d", e);
+        exe = kp_exe_new(path, rng_next() % 20 == 0, exemaps);
+        exe->time = rng_range(60, MODEL_TIME / 2);
+        exe->raw_launches = (unsigned long)rng_range(1, 400);
+        exe->weighted_launches = exe->raw_launches * (0.5 + rng_unit());
+        exe->total_duration_sec = (unsigned long)exe->time;
+        exe->pool = rng_next() % 10 < 6 ? POOL_PRIORITY : POOL_OBSERVATION;
+        if (exe->running_timestamp < 0)
+            exe->update_time = exe->running_timestamp = MODEL_TIME - rng_range(1, MODEL_TIME / 4);
+        exe->change_timestamp = exe->running_timestamp - rng_range(0, 600);
+        kp_state_register_exe(exe, FALSE);
+        exes[e] = exe;
+    }
+
+    /* Chains between distinct random pairs */
+    for (int k = 0, tries = 0; k < p->markovs && p->exes > 1 && tries < 8 * p->markovs; tries++) {
+        int a = rng_range(0, p->exes - 1), b = rng_range(0, p->exes - 1);
+        gint64 key;
+        kp_markov_t *markov;
+
+        if (a == b)
+            continue;
+        key = (gint64)MIN(a, b) * p->exes + MAX(a, b);
+        if (g_hash_table_contains(pairs, &key))
+            continue;
+        g_array_append_val(pair_keys, key);
+        g_hash_table_add(pairs, &g_array_index(pair_keys, gint64, pair_keys->len - 1));
+
+        markov = kp_markov_new(exes[a], exes[b], TRUE);
+        if (markov) {
+            fill_markov(markov);
+            chains++;
+        }
+        k++;
+    }
+
+    for (int f = 0; f < p->families; f++) {
+        char id[32];
+        kp_app_family_t *family;
+        int members = rng_range(2, 5);
+
+        g_snprintf(id, sizeof(id), "bench-family%03d", f);
+        family = kp_family_new(id, f % 2 ? FAMILY_AUTO : FAMILY_CONFIG);
+        for (int m = 0; m < members; m++)
+            kp_family_add_member(family, exes[rng_range(0, p->exes - 1)]->path);
+        g_hash_table_insert(kp_state->app_families, g_strdup(id), family);
+    }
+
+    g_hash_table_destroy(pairs);
+    g_array_free(pair_keys, TRUE);
+    g_free(exes);
+    g_free(maps);
+    return chains;
+}
+
+/* Loaded maps have no layout; keep the cost model off the disk */
+static void
+mark_map_probed(gpointer key, gpointer value, gpointer user_data)
+{
+    kp_map_t *map = key;
+
+    (void)value;
+    (void)user_data;
+    if (map->extents < 0)
+        map->extents = 1;
+}
+
+static void
+count_markov(gpointer data, gpointer user_data)
+{
+    kp_markov_t *markov = data;
+    (*(long *)user_data) += markov->state;
+}
+
+static void
+count_exemap(gpointer key, gpointer value, gpointer user_data)
+{
+    kp_exemap_t *exemap = key;
+
+    (void)value;
+    (*(long *)user_data) += exemap->map->length > 0;
+}
+
+static void
+count_running(gpointer key, gpointer value, gpointer user_data)
+{
+    (void)key;
+    if (exe_is_running((kp_exe_t *)value))
+        (*(int *)user_data)++;
+}
+
+/* ========================================================================
+ * BENCHMARKS
+ * ======================================================================== */
+
+static void
+bench_maps(int rounds)
+{
+    GPtrArray *arr = kp_state->maps_arr;
+    guint n = arr->len;
+    kp_map_t **hit = g_new(kp_map_t *, n);
+    kp_map_t **miss = g_new(kp_map_t *, n);
+    gint64 best[4] = { G_MAXINT64, G_MAXINT64, G_MAXINT64, G_MAXINT64 };
+    volatile guint sink = 0;
+
+    /* Unregistered copies, so lookups compare rather than hit by pointer */
+    for (guint i = 0; i < n; i++) {
+        kp_map_t *m = g_ptr_array_index(arr, i);
+        hit[i] = kp_map_new(m->path, m->offset, m->length);
+        miss[i] = kp_map_new(m->path, m->offset + 4096, m->length);
+    }
+
+    for (int r = 0; r < rounds; r++) {
+        gint64 t0;
+
+        t0 = now_ns();
+        for (guint i = 0; i < n; i++)
+            sink += kp_map_hash(g_ptr_array_index(arr, i));
+        best[0] = MIN(best[0], now_ns() - t0);
+
+        t0 = now_ns();
+        for (guint i = 0; i < n; i++)
+            sink += g_hash_table_lookup(kp_state->maps, hit[i]) != NULL;
+        best[1] = MIN(best[1], now_ns() - t0);
+
+        t0 = now_ns();
+        for (guint i = 0; i < n; i++)
+            sink += g_hash_table_lookup(kp_state->maps, miss[i]) != NULL;
+        best[2] = MIN(best[2], now_ns() - t0);
+
+        t0 = now_ns();
+        for (int i = 0; i < REF_UNREF_OPS; i++) {
+            kp_map_t *m = kp_map_new("/usr/lib/bench/transient.so", (size_t)i << 12, 4096);
+            kp_map_ref(m);
+            kp_map_unref(m);
+        }
+        best[3] = MIN(best[3], now_ns() - t0);
+    }
+
+    report("map_hash", n, best[0], NULL);
+    report("map_lookup_hit", n, best[1], NULL);
+    report("map_lookup_miss", n, best[2], NULL);
+    report("map_ref_unref", REF_UNREF_OPS, best[3], NULL);
+
+    for (guint i = 0; i < n; i++) {
+        kp_map_free(hit[i]);
+        kp_map_free(miss[i]);
+    }
+    g_free(hit);
+    g_free(miss);
+}
+
+static void
+bench_foreach(int rounds)
+{
+    gint64 best[2] = { G_MAXINT64, G_MAXINT64 };
+    long markovs = 0, exemaps = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        long visits = 0;
+        gint64 t0;
+
+        t0 = now_ns();
+        kp_markov_foreach(count_markov, &visits);
+        best[0] = MIN(best[0], now_ns() - t0);
+
+        /* count_markov sums states; count visits separately once */
+        if (r == 0) {
+            GHashTableIter iter;
+            gpointer key, value;
+            g_hash_table_iter_init(&iter, kp_state->exes);
+            while (g_hash_table_iter_next(&iter, &key, &value))
+                markovs += g_set_size(((kp_exe_t *)value)->markovs);
+            markovs /= 2;
+        }
+
+        visits = 0;
+        t0 = now_ns();
+        kp_exemap_foreach(count_exemap, &visits);
+        best[1] = MIN(best[1], now_ns() - t0);
+        exemaps = visits;
+    }
+
+    report("markov_foreach", markovs, best[0], NULL);
+    report("exemap_foreach", exemaps, best[1], NULL);
+}
+
+static void
+bench_predict(int rounds)
+{
+    gint64 best[2] = { G_MAXINT64, G_MAXINT64 };
+    int count = MIN(RECORD_MAPS, (int)kp_state->maps_arr->len);
+    int predicted = 0;
+    char extra[64];
+
+    for (int r = 0; r < rounds; r++) {
+        gint64 t0;
+
+        t0 = now_ns();
+        kp_prophet_predict(NULL);
+        best[0] = MIN(best[0], now_ns() - t0);
+
+        /* maps_arr is now sorted by need: the head is what a batch holds */
+        t0 = now_ns();
+        kp_prophet_record_preloaded_exes((kp_map_t **)kp_state->maps_arr->pdata, count);
+        best[1] = MIN(best[1], now_ns() - t0);
+    }
+
+    for (guint i = 0; i < kp_state->maps_arr->len; i++)
+        if (((kp_map_t *)g_ptr_array_index(kp_state->maps_arr, i))->lnprob < 0)
+            predicted++;
+
+    g_snprintf(extra, sizeof(extra), "maps=%u predicted=%d",
+               kp_state->maps_arr->len, predicted);
+    report("prophet_predict", 1, best[0], extra);
+    g_snprintf(extra, sizeof(extra), "batch=%d", count);
+    report("record_preloaded", 1, best[1], extra);
+}
+
+/**
+ * Save and reload the state; leaves the reloaded state in kp_state
+ */
+static int
+bench_state_io(int rounds)
+{
+    gint64 best[2] = { G_MAXINT64, G_MAXINT64 };
+    GString *out = NULL;
+    GError *error = NULL;
+    char *path = NULL;
+    char extra[64];
+    int fd;
+    guint exes = g_hash_table_size(kp_state->exes);
+
+    for (int r = 0; r < rounds; r++) {
+        gint64 t0;
+        char *errmsg;
+
+        if (out)
+            g_string_free(out, TRUE);
+        out = g_string_sized_new(64 * 1024);
+
+        t0 = now_ns();
+        errmsg = kp_state_write_to_string(out);
+        best[0] = MIN(best[0], now_ns() - t0);
+
+        if (errmsg) {
+            fprintf(stderr, "state write failed: %s\n", errmsg);
+            g_free(errmsg);
+            g_string_free(out, TRUE);
+            return 1;
+        }
+    }
+
+    g_snprintf(extra, sizeof(extra), "bytes=%" G_GSIZE_FORMAT, out->len);
+    report("state_write", 1, best[0], extra);
+
+    fd = g_file_open_tmp("preheat-bench-model-XXXXXX.state", &path, &error);
+    if (fd < 0) {
+        fprintf(stderr, "cannot create temporary file: %s\n", error->message);
+        g_error_free(error);
+        g_string_free(out, TRUE);
+        return 1;
+    }
+    if (write(fd, out->str, out->len) != (ssize_t)out->len) {
+        fprintf(stderr, "cannot write %s: %s\n", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        g_free(path);
+        g_string_free(out, TRUE);
+        return 1;
+    }
+    close(fd);
+    g_string_free(out, TRUE);
+
+    for (int r = 0; r < rounds; r++) {
+        gint64 t0;
+
+        kp_state_free();
+        t0 = now_ns();
+        kp_state_load(path);
+        best[1] = MIN(best[1], now_ns() - t0);
+    }
+
+    g_snprintf(extra, sizeof(extra), "exes=%u reloaded=%u",
+               exes, g_hash_table_size(kp_state->exes));
+    report("state_read", 1, best[1], extra);
+
+    unlink(path);
+    g_free(path);
+    return g_hash_table_size(kp_state->exes) == exes ? 0 : 1;
+}
+
+/* ========================================================================
+ * REGRESSION CHECK
+ * ======================================================================== */
+
+/**
+ * Compare this run with an earlier output file
+ *
+ * @return Number of benchmarks slower by more than @tolerance percent
+ */
+static int
+compare(const char *baseline, double tolerance)
+{
+    FILE *in = fopen(baseline, "r");
+    char line[512];
+    int regressions = 0;
+
+    if (!in) {
+        fprintf(stderr, "cannot read %s: %s\n", baseline, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        char name[32];
+        const char *p;
+        double before;
+
+        if (sscanf(line, "name=%31s", name) != 1 || !(p = strstr(line, " ns_per_op=")) ||
+            sscanf(p, " ns_per_op=%lf", &before) != 1 || before <= 0)
+            continue;
+
+        for (guint i = 0; i < results->len; i++) {
+            bench_result_t *r = &g_array_index(results, bench_result_t, i);
+            double change;
+
+            if (strcmp(r->name, name))
+                continue;
+
+            change = (r->ns_per_op - before) * 100.0 / before;
+            printf("compare=%s before=%.1f after=%.1f change=%+.1f%%%s\n",
+                   name, before, r->ns_per_op, change,
+                   change > tolerance ? " regression=1" : "");
+            if (change > tolerance)
+                regressions++;
+        }
+    }
+
+    fclose(in);
+    return regressions;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-e EXES] [-m MAPS] [-k MARKOVS] [-f FAMILIES] [-l MAPS_PER_EXE]\n"
+            "       %*s [-r ROUNDS] [--compare FILE] [--tolerance PERCENT]\n",
+            prog, (int)strlen(prog), "");
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_params_t p = { 500, 20000, 5000, 50, 60, 5 };
+    const char *baseline = NULL;
+    double tolerance = 15.0;
+    int running = 0;
+    int chains;
+    int status;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-e") && i + 1 < argc)
+            p.exes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            p.maps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+            p.markovs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            p.families = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            p.maps_per_exe = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            p.rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+            baseline = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (p.exes < 2 || p.maps < p.exes || p.markovs < 0 || p.families < 0 ||
+        p.maps_per_exe < 1 || p.rounds < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    kp_log_level = 2;   /* Warnings and worse */
+    kp_log_init(NULL);
+
+    kp_config_load(NULL, TRUE);
+    kp_conf->system.pipeline = FALSE;   /* Readahead inline, into the model cache */
+    kp_conf->system.trace = FALSE;
+
+    kp_stats_init();
+    sim_proc_init(16L * 1024 * 1024, 4L * 1024 * 1024);
+    sim_cache_init((size_t)12 * 1024 * 1024 * 1024);
+
+    kp_state_load(NULL);
+    kp_seed_stop();     /* Empty state starts seeding from the real system */
+    chains = generate_state(&p);
+    g_hash_table_foreach(kp_state->maps, mark_map_probed, NULL);
+    g_hash_table_foreach(kp_state->exes, count_running, &running);
+
+    results = g_array_new(FALSE, FALSE, sizeof(bench_result_t));
+
+    printf("bench=model exes=%u maps=%u markovs=%d families=%u running=%d rounds=%d\n",
+           g_hash_table_size(kp_state->exes), g_hash_table_size(kp_state->maps),
+           chains, g_hash_table_size(kp_state->app_families), running, p.rounds);
+
+    bench_maps(p.rounds);
+    bench_foreach(p.rounds);
+    bench_predict(p.rounds);
+    status = bench_state_io(p.rounds);
+
+    if (baseline) {
+        int regressions = compare(baseline, tolerance);
+        if (regressions)
+            status = 1;
+    }
+
+    g_array_free(results, TRUE);
+    kp_state_free();
+    sim_cache_free();
+    return status;
+}
@@ -0,0 +1,305 @@
+/* pattern_bench.c - Path filter micro-benchmark for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Pattern Benchmark
+ * =============================================================================
+ *
+ * Measures the per-line cost of the filters every scan runs over
+ * /proc/PID/maps: mapprefix/exeprefix rules and excluded_patterns globs.
+ * Each filter is timed over the same corpus with the original linear scan
+ * (strncmp per prefix, fnmatch per glob) and with the compiled sets from
+ * utils/pattern.c, in alternating passes; the fastest pass of each is
+ * reported, so a burst of noise can't decide the comparison. Both results
+ * are compared line by line so a speedup can't hide a behaviour change.
+ *
+ * USAGE:
+ *   preheat-bench-pattern --capture maps.txt     # snapshot /proc/[pid]/maps
+ *   preheat-bench-pattern maps.txt               # benchmark a corpus
+ *   preheat-bench-pattern -n 50 -m '/usr/;!/' -x '...' -p '...' maps.txt
+ *
+ * Built on demand with "make -C src preheat-bench-pattern"; not installed.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../utils/pattern.h"
+
+#include <dirent.h>
+#include <ctype.h>
+#include <time.h>
+
+#define DEFAULT_MAPPREFIX "/usr/;/lib;/var/cache/;!/"
+#define DEFAULT_EXEPREFIX "!/usr/sbin/;!/usr/local/sbin/;!/usr/libexec/;/usr/;/snap/;!/"
+#define DEFAULT_PATTERNS  "/bin/sh;/bin/bash;/usr/bin/grep;/usr/bin/cat;/usr/bin/sed;" \
+                          "/usr/bin/awk;/usr/bin/find;/usr/bin/xargs;/sbin/*"
+
+#define PASSES     5        /* Timed passes per implementation */
+
+#define PATHLEN    512      /* Same limit as FILELEN in state.h */
+#define PATHLENSTR "511"
+
+/* Reference implementation: the pre-trie accept_file() from proc.c */
+static gboolean
+linear_accept(const char *file, char * const *prefix)
+{
+    if (prefix)
+        for (; *prefix; prefix++) {
+            const char *p = *prefix;
+            gboolean accept = TRUE;
+            if (*p == '!') {
+                p++;
+                accept = FALSE;
+            }
+            if (!strncmp(file, p, strlen(p)))
+                return accept;
+        }
+    return TRUE;
+}
+
+static gint64
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Write all readable /proc/PID/maps to a corpus file
+ */
+static int
+capture(const char *out_path)
+{
+    DIR *proc;
+    struct dirent *entry;
+    FILE *out;
+    char buffer[1024];
+    int procs = 0;
+    long lines = 0;
+
+    out = fopen(out_path, "w");
+    if (!out) {
+        fprintf(stderr, "cannot write %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+
+    proc = opendir("/proc");
+    if (!proc) {
+        fclose(out);
+        fprintf(stderr, "cannot open /proc: %s\n", strerror(errno));
+        return 1;
+    }
+
+    while ((entry = readdir(proc))) {
+        char name[64];
+        FILE *in;
+
+        if (!isdigit((unsigned char)entry->d_name[0]))
+            continue;
+
+        g_snprintf(name, sizeof(name), "/proc/%s/maps", entry->d_name);
+        in = fopen(name, "r");
+        if (!in)
+            continue;
+
+        procs++;
+        while (fgets(buffer, sizeof(buffer), in)) {
+            fputs(buffer, out);
+            lines++;
+        }
+        fclose(in);
+    }
+
+    closedir(proc);
+    fclose(out);
+
+    printf("captured %ld lines from %d processes into %s\n", lines, procs, out_path);
+    return 0;
+}
+
+/**
+ * Load the path column of a maps corpus (anonymous regions skipped)
+ */
+static GPtrArray *
+load_corpus(const char *path)
+{
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    char buffer[1024];
+    FILE *in;
+
+    in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "cannot read %s: %s\n", path, strerror(errno));
+        g_ptr_array_free(paths, TRUE);
+        return NULL;
+    }
+
+    while (fgets(buffer, sizeof(buffer), in)) {
+        char file[PATHLEN];
+
+        file[0] = '\0';
+        if (sscanf(buffer, "%*x-%*x %*15s %*x %*x:%*x %*u %"PATHLENSTR"s", file) == 1 &&
+            file[0] == '/')
+            g_ptr_array_add(paths, g_strdup(file));
+    }
+
+    fclose(in);
+    return paths;
+}
+
+static void
+report(const char *name, gint64 old_ns, gint64 new_ns, long calls, long mismatches)
+{
+    double old_per = (double)old_ns / calls;
+    double new_per = (double)new_ns / calls;
+
+    printf("%-18s linear=%8.1f ns/line  compiled=%8.1f ns/line  speedup=%5.2fx  mismatches=%ld\n",
+           name, old_per, new_per, new_per > 0 ? old_per / new_per : 0.0, mismatches);
+}
+
+/* Time a prefix rule list both ways */
+static long
+bench_prefix(const char *name, const char *rules_raw, GPtrArray *paths, int rounds)
+{
+    char **rules = g_strsplit(rules_raw, ";", -1);
+    kp_prefix_set_t *set = kp_prefix_set_new(rules);
+    volatile long sink = 0;
+    long mismatches = 0;
+    gint64 t0, t_old, t_new;
+
+    for (guint i = 0; i < paths->len; i++) {
+        const char *p = g_ptr_array_index(paths, i);
+        if (linear_accept(p, rules) != kp_prefix_set_accept(set, p))
+            mismatches++;
+    }
+
+    t_old = t_new = G_MAXINT64;
+    for (int pass = 0; pass < PASSES; pass++) {
+        t0 = now_ns();
+        for (int r = 0; r < rounds; r++)
+            for (guint i = 0; i < paths->len; i++)
+                sink += linear_accept(g_ptr_array_index(paths, i), rules);
+        t_old = MIN(t_old, now_ns() - t0);
+
+        t0 = now_ns();
+        for (int r = 0; r < rounds; r++)
+            for (guint i = 0; i < paths->len; i++)
+                sink += kp_prefix_set_accept(set, g_ptr_array_index(paths, i));
+        t_new = MIN(t_new, now_ns() - t0);
+    }
+
+    report(name, t_old, t_new, (long)rounds * paths->len, mismatches);
+
+    kp_prefix_set_free(set);
+    g_strfreev(rules);
+    return mismatches;
+}
+
+/* Time a glob list both ways */
+static long
+bench_globs(const char *name, const char *patterns_raw, GPtrArray *paths, int rounds)
+{
+    char **patterns = g_strsplit(patterns_raw, ";", -1);
+    int count = (int)g_strv_length(patterns);
+    kp_glob_set_t *set = kp_glob_set_new(patterns, count);
+    volatile long sink = 0;
+    long mismatches = 0;
+    gint64 t0, t_old, t_new;
+
+    for (guint i = 0; i < paths->len; i++) {
+        const char *p = g_ptr_array_index(paths, i);
+        if (kp_pattern_matches_any(p, patterns, count) != kp_glob_set_match(set, p))
+            mismatches++;
+    }
+
+    t_old = t_new = G_MAXINT64;
+    for (int pass = 0; pass < PASSES; pass++) {
+        t0 = now_ns();
+        for (int r = 0; r < rounds; r++)
+            for (guint i = 0; i < paths->len; i++)
+                sink += kp_pattern_matches_any(g_ptr_array_index(paths, i), patterns, count);
+        t_old = MIN(t_old, now_ns() - t0);
+
+        t0 = now_ns();
+        for (int r = 0; r < rounds; r++)
+            for (guint i = 0; i < paths->len; i++)
+                sink += kp_glob_set_match(set, g_ptr_array_index(paths, i));
+        t_new = MIN(t_new, now_ns() - t0);
+    }
+
+    report(name, t_old, t_new, (long)rounds * paths->len, mismatches);
+
+    kp_glob_set_free(set);
+    g_strfreev(patterns);
+    return mismatches;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s --capture FILE\n"
+            "       %s [-n ROUNDS] [-m MAPPREFIX] [-x EXEPREFIX] [-p PATTERNS] CORPUS\n",
+            prog, prog);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *mapprefix = DEFAULT_MAPPREFIX;
+    const char *exeprefix = DEFAULT_EXEPREFIX;
+    const char *patterns = DEFAULT_PATTERNS;
+    const char *corpus = NULL;
+    int rounds = 20;
+    GPtrArray *paths;
+    long mismatches = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--capture") && i + 1 < argc)
+            return capture(argv[i + 1]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            mapprefix = argv[++i];
+        else if (!strcmp(argv[i], "-x") && i + 1 < argc)
+            exeprefix = argv[++i];
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            patterns = argv[++i];
+        else if (argv[i][0] != '-' && !corpus)
+            corpus = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!corpus || rounds < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    paths = load_corpus(corpus);
+    if (!paths)
+        return 1;
+    if (paths->len == 0) {
+        fprintf(stderr, "no file-backed lines in %s\n", corpus);
+        g_ptr_array_free(paths, TRUE);
+        return 1;
+    }
+
+    printf("corpus=%s lines=%u rounds=%d\n", corpus, paths->len, rounds);
+    mismatches += bench_prefix("mapprefix", mapprefix, paths, rounds);
+    mismatches += bench_prefix("exeprefix", exeprefix, paths, rounds);
+    mismatches += bench_globs("excluded_patterns", patterns, paths, rounds);
+
+    g_ptr_array_free(paths, TRUE);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,449 @@
+/* proc_bench.c - Process scanner benchmark for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Proc Scanner Benchmark
+ * =============================================================================
+ *
+ * Measures what one scan cycle costs as the process count grows, without
+ * needing a machine with that many processes. A fake proc tree is written
+ * to a temporary directory and monitor/proc.c is pointed at it with
+ * kp_proc_set_root() (the daemon's procroot), so the real parsers run
+ * over it unchanged:
+ *
+ *   <root>/meminfo, vmstat, stat       memory and paging counters
+ *   <root>/PID/exe                     symlink to one of N/10 executables
+ *   <root>/PID/stat, cmdline           as the kernel writes them
+ *   <root>/PID/maps                    8-32 shared libraries of 4 mappings
+ *                                      each, plus heap, anon, stack, vvar
+ *                                      and vdso lines
+ *
+ * Contents come from a fixed-seed generator, so runs are comparable.
+ * Each size is timed for:
+ *
+ *   snapshot    kp_proc_snapshot() + exeprefix filter over every process
+ *   maps-size   kp_proc_get_maps() without a model (the running-exe path)
+ *   maps-model  kp_proc_get_maps() into kp_state->maps with exemaps, all
+ *               maps already known (the new-exe path in steady state)
+ *   ppid        kp_proc_get_ppid() for every process
+ *   memstat     kp_proc_get_memstat(), per call
+ *
+ * Reads are served from the page cache, so the numbers are parse and
+ * syscall cost, not disk or procfs generation time.
+ *
+ * USAGE:
+ *   preheat-bench-proc                     # 100, 1000 and 10000 processes
+ *   preheat-bench-proc -p 5000 -n 5        # one size, best of 5 rounds
+ *   preheat-bench-proc --generate DIR -p N # only write a tree to DIR
+ *
+ * A tree written with --generate can also be given to the daemon as
+ * procroot. Built on demand with "make -C src preheat-bench-proc"; not
+ * installed.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../monitor/proc.h"
+
+#include <ftw.h>
+#include <time.h>
+
+#define FIRST_PID       1000
+#define LIB_POOL        400     /* Distinct shared libraries */
+#define MIN_LIBS        8       /* Libraries mapped per process */
+#define MAX_LIBS        32
+#define MEMSTAT_CALLS   1000
+
+/* Deterministic xorshift64 generator */
+static guint64 rng_state;
+
+static guint32
+rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (guint32)(rng_state >> 32);
+}
+
+static int
+rng_range(int lo, int hi)
+{
+    return lo + (int)(rng_next() % (guint32)(hi - lo + 1));
+}
+
+static gint64
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static gboolean
+write_file(const char *path, const char *data, gsize len)
+{
+    FILE *f = fopen(path, "w");
+
+    if (!f) {
+        fprintf(stderr, "cannot write %s: %s\n", path, strerror(errno));
+        return FALSE;
+    }
+    fwrite(data, 1, len, f);
+    fclose(f);
+    return TRUE;
+}
+
+static void
+lib_path(char *buf, size_t size, int lib)
+{
+    static const char *dirs[] = {
+        "/usr/lib/x86_64-linux-gnu/", "/usr/lib/", "/usr/lib64/", "/opt/app/lib/"
+    };
+    g_snprintf(buf, size, "%slibbench%03d.so.%d", dirs[lib % 4], lib, 1 + lib % 7);
+}
+
+/* One maps file: executable, libraries and the usual anonymous regions */
+static long
+append_maps(GString *s, const char *exe, int inode)
+{
+    unsigned long addr = 0x55d000000000UL + ((unsigned long)rng_range(0, 0xffff) << 16);
+    int nlibs = rng_range(MIN_LIBS, MAX_LIBS);
+    long lines = 0;
+
+    g_string_truncate(s, 0);
+
+#define MAP_LINE(len, perms, off, dev, ino, path) G_STMT_START {            \
+        g_string_append_printf(s, "%012lx-%012lx %s %08lx %s %-10d %s%s\n",  \
+                               addr, addr + (len), perms,                    \
+                               (unsigned long)(off), dev, ino,               \
+                               *(path) ? "                " : "", path);     \
+        addr += (len);                                                       \
+        lines++;                                                             \
+    } G_STMT_END
+
+    MAP_LINE(0x4000, "r--p", 0, "08:01", inode, exe);
+    MAP_LINE(0x20000, "r-xp", 0x4000, "08:01", inode, exe);
+    MAP_LINE(0x8000, "r--p", 0x24000, "08:01", inode, exe);
+    MAP_LINE(0x2000, "rw-p", 0x2c000, "08:01", inode, exe);
+    MAP_LINE(0x200000, "rw-p", 0, "00:00", 0, "[heap]");
+
+    addr = 0x7f0000000000UL + ((unsigned long)rng_range(0, 0xffff) << 20);
+    for (int i = 0; i < nlibs; i++) {
+        char path[128];
+        int lib = (int)(rng_next() % LIB_POOL);
+        /* A library has the same layout in every process that maps it */
+        unsigned long text = (4 + (lib * 2654435761UL) % 509) << 12;
+
+        lib_path(path, sizeof(path), lib);
+        MAP_LINE(0x2000, "r--p", 0, "08:01", 200000 + lib, path);
+        MAP_LINE(text, "r-xp", 0x2000, "08:01", 200000 + lib, path);
+        MAP_LINE(0x4000, "r--p", 0x2000 + text, "08:01", 200000 + lib, path);
+        MAP_LINE(0x1000, "rw-p", 0x6000 + text, "08:01", 200000 + lib, path);
+        if (rng_next() % 4 == 0)
+            MAP_LINE(0x10000, "rw-p", 0, "00:00", 0, "");
+    }
+
+    MAP_LINE(0x21000, "rw-p", 0, "00:00", 0, "[stack]");
+    MAP_LINE(0x4000, "r--p", 0, "00:00", 0, "[vvar]");
+    MAP_LINE(0x2000, "r-xp", 0, "00:00", 0, "[vdso]");
+
+#undef MAP_LINE
+
+    return lines;
+}
+
+/**
+ * Write a fake proc tree with @procs processes under @root
+ *
+ * @return Total maps lines written, or -1 on error
+ */
+static long
+generate(const char *root, int procs)
+{
+    GString *buf = g_string_sized_new(16384);
+    int nexes = MAX(1, procs / 10);
+    long lines = 0;
+    char path[PATH_MAX];
+
+    rng_state = 0x9e3779b97f4a7c15ULL;
+
+    if (g_mkdir_with_parents(root, 0755) < 0) {
+        fprintf(stderr, "cannot create %s: %s\n", root, strerror(errno));
+        g_string_free(buf, TRUE);
+        return -1;
+    }
+
+    g_string_printf(buf,
+                    "MemTotal:       16302536 kB\n"
+                    "MemFree:         2093260 kB\n"
+                    "MemAvailable:    9630864 kB\n"
+                    "Buffers:          412340 kB\n"
+                    "Cached:          7049400 kB\n"
+                    "SwapCached:            0 kB\n");
+    g_snprintf(path, sizeof(path), "%s/meminfo", root);
+    if (!write_file(path, buf->str, buf->len))
+        goto fail;
+
+    g_string_printf(buf, "nr_free_pages 523315\npgpgin 48211032\npgpgout 19923384\n"
+                    "pswpin 0\npswpout 0\n");
+    g_snprintf(path, sizeof(path), "%s/vmstat", root);
+    if (!write_file(path, buf->str, buf->len))
+        goto fail;
+
+    g_string_printf(buf, "cpu  10132153 290696 3084719 46828483 16683 0 25195 0 0 0\n"
+                    "btime 1760000000\nprocesses %d\n", FIRST_PID + procs);
+    g_snprintf(path, sizeof(path), "%s/stat", root);
+    if (!write_file(path, buf->str, buf->len))
+        goto fail;
+
+    for (int i = 0; i < procs; i++) {
+        int pid = FIRST_PID + i;
+        int exe_id = (int)(rng_next() % (guint32)nexes);
+        char exe[64];
+
+        g_snprintf(exe, sizeof(exe), "/usr/bin/bench-app%04d", exe_id);
+
+        g_snprintf(path, sizeof(path), "%s/%d", root, pid);
+        if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+            goto fail;
+        }
+
+        g_snprintf(path, sizeof(path), "%s/%d/exe", root, pid);
+        unlink(path);
+        if (symlink(exe, path) < 0) {
+            fprintf(stderr, "cannot link %s: %s\n", path, strerror(errno));
+            goto fail;
+        }
+
+        g_string_printf(buf, "%s", exe);
+        g_string_append_c(buf, '\0');
+        g_string_append(buf, "--bench");
+        g_string_append_c(buf, '\0');
+        g_snprintf(path, sizeof(path), "%s/%d/cmdline", root, pid);
+        if (!write_file(path, buf->str, buf->len))
+            goto fail;
+
+        g_string_printf(buf, "%d (bench-app%04d) S %d %d %d 0 -1 4194304 "
+                        "1520 0 3 0 12 4 0 0 20 0 %d 0 %d 254193664 4210 "
+                        "18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 3 "
+                        "0 0 0 0 0\n",
+                        pid, exe_id, i ? FIRST_PID + rng_range(0, i - 1) : 1,
+                        pid, pid, rng_range(1, 24), 1000 + i);
+        g_snprintf(path, sizeof(path), "%s/%d/stat", root, pid);
+        if (!write_file(path, buf->str, buf->len))
+            goto fail;
+
+        lines += append_maps(buf, exe, 100000 + exe_id);
+        g_snprintf(path, sizeof(path), "%s/%d/maps", root, pid);
+        if (!write_file(path, buf->str, buf->len))
+            goto fail;
+    }
+
+    g_string_free(buf, TRUE);
+    return lines;
+
+fail:
+    g_string_free(buf, TRUE);
+    return -1;
+}
+
+static int
+remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static void
+count_proc(gpointer key, gpointer value, gpointer user_data)
+{
+    (void)key;
+    (void)value;
+    (*(int *)user_data)++;
+}
+
+static void
+report(const char *name, gint64 ns, long per, const char *unit, long lines)
+{
+    printf("  %-11s %10.3f ms  %9.1f ns/%s", name, ns / 1e6, (double)ns / per, unit);
+    if (lines > 0)
+        printf("  %7.1f ns/line", (double)ns / lines);
+    printf("\n");
+}
+
+/* Time the scanner over an existing tree; best of @rounds */
+static void
+bench_tree(const char *root, int procs, long lines, int rounds)
+{
+    gint64 best[5] = { G_MAXINT64, G_MAXINT64, G_MAXINT64, G_MAXINT64, G_MAXINT64 };
+    GPtrArray *warm = g_ptr_array_new();
+    volatile size_t sink = 0;
+    int seen = 0;
+
+    kp_proc_set_root(root);
+
+    /* Keep every map registered so the timed model pass finds them all */
+    for (int i = 0; i < procs; i++) {
+        GSet *exemaps = NULL;
+        if (kp_proc_get_maps(FIRST_PID + i, kp_state->maps, &exemaps) && exemaps)
+            g_ptr_array_add(warm, exemaps);
+        else if (exemaps)
+            g_set_free(exemaps);
+    }
+
+    for (int r = 0; r < rounds; r++) {
+        kp_proc_snapshot_t *snap;
+        kp_memory_t mem;
+        gint64 t0;
+
+        t0 = now_ns();
+        seen = 0;
+        snap = kp_proc_snapshot();
+        kp_proc_snapshot_foreach(snap, count_proc, &seen);
+        kp_proc_snapshot_free(snap);
+        best[0] = MIN(best[0], now_ns() - t0);
+
+        t0 = now_ns();
+        for (int i = 0; i < procs; i++)
+            sink += kp_proc_get_maps(FIRST_PID + i, NULL, NULL);
+        best[1] = MIN(best[1], now_ns() - t0);
+
+        t0 = now_ns();
+        for (int i = 0; i < procs; i++) {
+            GSet *exemaps = NULL;
+            sink += kp_proc_get_maps(FIRST_PID + i, kp_state->maps, &exemaps);
+            if (exemaps) {
+                g_set_foreach(exemaps, (GFunc)(void (*)(void))kp_exemap_free, NULL);
+                g_set_free(exemaps);
+            }
+        }
+        best[2] = MIN(best[2], now_ns() - t0);
+
+        t0 = now_ns();
+        for (int i = 0; i < procs; i++)
+            sink += (size_t)kp_proc_get_ppid(FIRST_PID + i);
+        best[3] = MIN(best[3], now_ns() - t0);
+
+        t0 = now_ns();
+        for (int i = 0; i < MEMSTAT_CALLS; i++) {
+            kp_proc_get_memstat(&mem);
+            sink += (size_t)mem.available;
+        }
+        best[4] = MIN(best[4], now_ns() - t0);
+    }
+
+    printf("procs=%d lines=%ld maps=%u accepted=%d rounds=%d\n",
+           procs, lines, g_hash_table_size(kp_state->maps), seen, rounds);
+    report("snapshot", best[0], procs, "proc", 0);
+    report("maps-size", best[1], procs, "proc", lines);
+    report("maps-model", best[2], procs, "proc", lines);
+    report("ppid", best[3], procs, "proc", 0);
+    report("memstat", best[4], MEMSTAT_CALLS, "call", 0);
+
+    for (guint i = 0; i < warm->len; i++) {
+        GSet *exemaps = g_ptr_array_index(warm, i);
+        g_set_foreach(exemaps, (GFunc)(void (*)(void))kp_exemap_free, NULL);
+        g_set_free(exemaps);
+    }
+    g_ptr_array_free(warm, TRUE);
+}
+
+/* Generate, time and remove a tree of @procs processes */
+static int
+run_size(int procs, int rounds)
+{
+    GError *error = NULL;
+    char *root = g_dir_make_tmp("preheat-bench-proc-XXXXXX", &error);
+    gint64 t0;
+    long lines;
+
+    if (!root) {
+        fprintf(stderr, "cannot create temporary directory: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    t0 = now_ns();
+    lines = generate(root, procs);
+    if (lines >= 0) {
+        printf("generated %s in %.1f ms\n", root, (now_ns() - t0) / 1e6);
+        bench_tree(root, procs, lines, rounds);
+    }
+
+    nftw(root, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+    g_free(root);
+    return lines < 0;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-p PROCS] [-n ROUNDS]\n"
+            "       %s --generate DIR [-p PROCS]\n",
+            prog, prog);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int default_sizes[] = { 100, 1000, 10000 };
+    const char *generate_dir = NULL;
+    int procs = 0;
+    int rounds = 3;
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--generate") && i + 1 < argc)
+            generate_dir = argv[++i];
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            procs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (procs < 0 || rounds < 1 || (generate_dir && procs == 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (generate_dir) {
+        long lines = generate(generate_dir, procs);
+        if (lines < 0)
+            return 1;
+        printf("wrote %d processes, %ld maps lines under %s\n", procs, lines, generate_dir);
+        return 0;
+    }
+
+    kp_log_level = 2;   /* Warnings and worse */
+    kp_log_init(NULL);
+    kp_config_load(NULL, TRUE);
+    kp_state_load(NULL);
+
+    if (procs)
+        status = run_size(procs, rounds);
+    else
+        for (guint i = 0; i < G_N_ELEMENTS(default_sizes) && !status; i++)
+            status = run_size(default_sizes[i], rounds);
+
+    kp_state_free();
+    return status;
+}
@@ -21,17 +21,27 @@
  * FILE LOCATION:
  *   /etc/preheat.d/blacklist (or SYSCONFDIR/preheat.d/blacklist)
  *
- * FILE FORMAT:
- *   - One binary name per line (NOT full paths, just the executable name)
- *   - Lines starting with # are comments
- *   - Valid characters: alphanumeric, underscore, dash, dot
+ * FILE FORMAT (one rule per line, # starts a comment):
+ *   name          Binary name, any directory (alphanumeric, _ - . only)
+ *   name-glob*    Glob on the binary name (contains * ? or [)
+ *   /path/to/bin  Exact executable path
+ *   /path/gsd-*   Glob on the full path (fnmatch, * does not cross /)
+ *   /directory/   Everything below a directory (trailing slash)
  *
  * EXAMPLE BLACKLIST:
  *   # Don't preload security tools
  *   wireshark
  *   nmap
- *   # Don't preload large IDEs
- *   eclipse
+ *   # Helpers and games
+ *   /usr/libexec/gsd-*
+ *   /opt/games/
+ *
+ * MATCHING:
+ *   Names are a hash set; name globs and path globs are compiled into
+ *   kp_glob_set_t and directories into a kp_prefix_set_t (utils/pattern.c).
+ *   Membership is resolved once per exe and cached in exe->blacklisted:
+ *   kp_exe_new() sets it, and a reload that changed the file recomputes it
+ *   for every known exe, so prediction cycles only read a flag.
  *
  * RELOAD SUPPORT:
  *   kp_blacklist_reload() can be called on SIGHUP to reload without restart.
@@ -43,9 +53,10 @@
 #include "common.h"
 #include "blacklist.h"
 #include "../utils/logging.h"
+#include "../utils/pattern.h"
+#include "../state/state.h"
 
 #include <sys/stat.h>
-#include <libgen.h>
 
 /* Default blacklist file location (set at compile time) */
 #define BLACKLIST_DIR "/etc/preheat.d"
@@ -56,17 +67,92 @@
 
 /*
  * Global blacklist state.
- * 
- * Uses a hash table for O(1) lookup performance since this is called
- * for every process discovered during /proc scanning.
+ *
+ * Plain names use a hash table; the other rule kinds are compiled sets,
+ * NULL when the file has no rule of that kind.
  */
 static struct {
     GHashTable *entries;      /* Binary name -> TRUE (hash set pattern) */
+    kp_glob_set_t *name_globs;  /* Globs on the binary name */
+    kp_glob_set_t *path_globs;  /* Exact paths and globs on the full path */
+    kp_prefix_set_t *dirs;      /* "!dir/" rules: rejected means blacklisted */
     char *filepath;           /* Path to blacklist file */
     time_t last_modified;     /* File mtime for change detection on reload */
     int count;                /* Number of entries (cached for quick access) */
 } blacklist = {0};
 
+/* Drop compiled rules */
+static void
+clear_rule_sets(void)
+{
+    kp_glob_set_free(blacklist.name_globs);
+    kp_glob_set_free(blacklist.path_globs);
+    kp_prefix_set_free(blacklist.dirs);
+    blacklist.name_globs = NULL;
+    blacklist.path_globs = NULL;
+    blacklist.dirs = NULL;
+}
+
+/* Compile a collected rule list (NULL if empty) */
+static kp_glob_set_t *
+compile_globs(GPtrArray *rules)
+{
+    if (rules->len == 0)
+        return NULL;
+    return kp_glob_set_new((char **)rules->pdata, (int)rules->len);
+}
+
+/**
+ * Check that an entry is a valid rule
+ *
+ * Plain names keep the original strict character set; rules with a
+ * slash or wildcard may use any printable character except whitespace.
+ */
+static gboolean
+valid_entry(const char *p)
+{
+    gboolean plain = !strpbrk(p, "/*?[");
+
+    if (strchr(p, '/') && p[0] != '/')
+        return FALSE;   /* Relative paths are ambiguous */
+
+    for (const char *c = p; *c; c++) {
+        if (plain) {
+            if (!g_ascii_isalnum(*c) && *c != '_' && *c != '-' && *c != '.')
+                return FALSE;
+        } else if (!g_ascii_isgraph(*c)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Recompute exe->blacklisted for every known exe
+ */
+void
+kp_blacklist_refresh_exes(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    int flagged = 0;
+
+    if (!kp_state->exes)
+        return;
+
+    g_hash_table_iter_init(&iter, kp_state->exes);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        kp_exe_t *exe = value;
+        exe->blacklisted = kp_blacklist_contains(exe->path);
+        if (exe->blacklisted)
+            flagged++;
+    }
+
+    g_debug("Blacklist matches %d of %u known executables",
+            flagged, g_hash_table_size(kp_state->exes));
+}
+
 /**
  * Parse blacklist file and populate hash table
  */
@@ -78,6 +164,7 @@ load_blacklist_file(const char *filepath)
     int loaded = 0;
     int skipped = 0;
     struct stat st;
+    GPtrArray *name_globs, *path_globs, *dirs;
 
     /* Clear existing entries */
     if (blacklist.entries) {
@@ -85,6 +172,7 @@ load_blacklist_file(const char *filepath)
     } else {
         blacklist.entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     }
+    clear_rule_sets();
     blacklist.count = 0;
 
     /* Check if file exists */
@@ -105,6 +193,10 @@ load_blacklist_file(const char *filepath)
         return;
     }
 
+    name_globs = g_ptr_array_new_with_free_func(g_free);
+    path_globs = g_ptr_array_new_with_free_func(g_free);
+    dirs = g_ptr_array_new_with_free_func(g_free);
+
     while (fgets(line, sizeof(line), fp)) {
         char *p = line;
         char *end;
@@ -126,34 +218,42 @@ load_blacklist_file(const char *filepath)
             continue;
         }
 
-        /* Validate entry: alphanumeric, underscore, dash, dot only */
-        gboolean valid = TRUE;
-        for (char *c = p; *c; c++) {
-            if (!g_ascii_isalnum(*c) && *c != '_' && *c != '-' && *c != '.') {
-                valid = FALSE;
-                break;
-            }
-        }
-
-        if (!valid) {
+        if (!valid_entry(p)) {
             g_warning("Invalid blacklist entry (bad characters), skipping: %s", p);
             skipped++;
             continue;
         }
 
-        /* Add to hash table */
-        g_hash_table_insert(blacklist.entries, g_strdup(p), GINT_TO_POINTER(1));
+        /* Sort into rule kinds */
+        if (p[0] == '/' && g_str_has_suffix(p, "/"))
+            g_ptr_array_add(dirs, g_strconcat("!", p, NULL));
+        else if (p[0] == '/')
+            g_ptr_array_add(path_globs, g_strdup(p));
+        else if (strpbrk(p, "*?["))
+            g_ptr_array_add(name_globs, g_strdup(p));
+        else
+            g_hash_table_insert(blacklist.entries, g_strdup(p), GINT_TO_POINTER(1));
         loaded++;
     }
 
     fclose(fp);
 
+    blacklist.name_globs = compile_globs(name_globs);
+    blacklist.path_globs = compile_globs(path_globs);
+    if (dirs->len > 0) {
+        g_ptr_array_add(dirs, NULL);
+        blacklist.dirs = kp_prefix_set_new((char **)dirs->pdata);
+    }
+
+    g_ptr_array_free(name_globs, TRUE);
+    g_ptr_array_free(path_globs, TRUE);
+    g_ptr_array_free(dirs, TRUE);
+
     blacklist.count = loaded;
 
     if (loaded > 0 || skipped > 0) {
-        g_message("Blacklist loaded: %d entries from %s%s",
-                  loaded, filepath,
-                  skipped > 0 ? g_strdup_printf(" (%d skipped)", skipped) : "");
+        g_message("Blacklist loaded: %d entries from %s (%d skipped)",
+                  loaded, filepath, skipped);
     }
 }
 
@@ -195,6 +295,7 @@ kp_blacklist_reload(void)
 
     g_message("Reloading blacklist from %s", blacklist.filepath);
     load_blacklist_file(blacklist.filepath);
+    kp_blacklist_refresh_exes();
 }
 
 /**
@@ -203,25 +304,25 @@ kp_blacklist_reload(void)
 gboolean
 kp_blacklist_contains(const char *binary_name)
 {
-    char *base;
-    char *path_copy;
-    gboolean result;
+    const char *base;
 
     if (!blacklist.entries || !binary_name) {
         return FALSE;
     }
 
-    /* Extract basename if full path given */
-    if (binary_name[0] == '/') {
-        path_copy = g_strdup(binary_name);
-        base = basename(path_copy);
-        result = g_hash_table_contains(blacklist.entries, base);
-        g_free(path_copy);
-    } else {
-        result = g_hash_table_contains(blacklist.entries, binary_name);
-    }
+    /* Name rules apply to the basename if a full path is given */
+    base = strrchr(binary_name, '/');
+    base = base ? base + 1 : binary_name;
+
+    if (g_hash_table_contains(blacklist.entries, base) ||
+        kp_glob_set_match(blacklist.name_globs, base))
+        return TRUE;
+
+    if (binary_name[0] != '/')
+        return FALSE;
 
-    return result;
+    return kp_glob_set_match(blacklist.path_globs, binary_name) ||
+           !kp_prefix_set_accept(blacklist.dirs, binary_name);
 }
 
 /**
@@ -243,6 +344,7 @@ kp_blacklist_free(void)
         g_hash_table_destroy(blacklist.entries);
         blacklist.entries = NULL;
     }
+    clear_rule_sets();
 
     g_free(blacklist.filepath);
     blacklist.filepath = NULL;
@@ -21,13 +21,24 @@ void kp_blacklist_init(void);
 
 /**
  * Reload blacklist from file
- * Called on SIGHUP
+ * Called on SIGHUP. If the file changed, exe->blacklisted is recomputed
+ * for every exe in kp_state.
  */
 void kp_blacklist_reload(void);
 
+/**
+ * Recompute exe->blacklisted for every exe in kp_state
+ * Called after a state load that ran concurrently with kp_blacklist_init().
+ */
+void kp_blacklist_refresh_exes(void);
+
 /**
  * Check if a binary is blacklisted
- * @param binary_name Base name of the binary (not full path)
+ *
+ * Hot paths should read exe->blacklisted instead, which caches this.
+ *
+ * @param binary_name Full path of the binary, or its base name (only
+ *                    name rules apply then)
  * @return TRUE if blacklisted, FALSE otherwise
  */
 gboolean kp_blacklist_contains(const char *binary_name);
@@ -423,6 +423,9 @@ resolve_binary_path(const char *path)
  */
 kp_conf_t kp_conf[1];
 
+/* Bumped on every (re)load, see kp_config_generation() */
+static guint conf_generation = 0;
+
 /**
  * Load manual apps from whitelist file
  * 
@@ -624,6 +627,9 @@ set_default_conf(kp_conf_t *conf)
     /* Initialize pattern list runtime fields */
     conf->system.excluded_patterns_list = NULL;
     conf->system.excluded_patterns_count = 0;
+    conf->system.excluded_patterns_set = NULL;
+    conf->system.mapprefix_set = NULL;
+    conf->system.exeprefix_set = NULL;
     conf->system.user_app_paths_list = NULL;
     conf->system.user_app_paths_count = 0;
 }
@@ -689,7 +695,8 @@ kp_config_load(const char *conffile, gboolean fail)
     dummyconf.grp.key = get_##type (STRINGIZE(grp), STRINGIZE(key), unit); \
     if (!e) \
         newconf.grp.key = dummyconf.grp.key; \
-    else if (e->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) { \
+    else if (e->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND && \
+             e->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND) { \
         g_log(G_LOG_DOMAIN, flags, "failed loading config key %s.%s: %s", \
               STRINGIZE(grp), STRINGIZE(key), e->message); \
         g_error_free(e); \
@@ -717,14 +724,20 @@ kp_config_load(const char *conffile, gboolean fail)
     g_strfreev(kp_conf->system.mapprefix);
     g_free(kp_conf->system.exeprefix_raw);
     g_strfreev(kp_conf->system.exeprefix);
+    kp_prefix_set_free(kp_conf->system.mapprefix_set);
+    kp_prefix_set_free(kp_conf->system.exeprefix_set);
     g_free(kp_conf->system.manualapps);
     g_strfreev(kp_conf->system.manual_apps_loaded);
     
     /* Free old pattern lists */
     g_free(kp_conf->system.excluded_patterns);
     g_strfreev(kp_conf->system.excluded_patterns_list);
+    kp_glob_set_free(kp_conf->system.excluded_patterns_set);
     g_free(kp_conf->system.user_app_paths);
     g_strfreev(kp_conf->system.user_app_paths_list);
+    g_free(kp_conf->system.sysfsroot);
+    g_free(kp_conf->system.procroot);
+    g_free(kp_conf->system.runroot);
 
 #ifdef ENABLE_PREHEAT_EXTENSIONS
     g_free(kp_conf->preheat.manual_apps_list);
@@ -741,6 +754,18 @@ kp_config_load(const char *conffile, gboolean fail)
         kp_conf->model.cycle = 90;
     }
 
+    if (kp_conf->model.mincycle < 2 || kp_conf->model.mincycle > kp_conf->model.cycle) {
+        g_warning("Invalid mincycle value %d (must be 2-cycle), using cycle",
+                  kp_conf->model.mincycle);
+        kp_conf->model.mincycle = kp_conf->model.cycle;
+    }
+
+    if (kp_conf->model.maxcycle < kp_conf->model.cycle || kp_conf->model.maxcycle > 3600) {
+        g_warning("Invalid maxcycle value %d (must be cycle-3600), using cycle",
+                  kp_conf->model.maxcycle);
+        kp_conf->model.maxcycle = kp_conf->model.cycle;
+    }
+
     if (kp_conf->model.memfree < 0 || kp_conf->model.memfree > 100) {
         g_warning("Invalid memfree value %d (must be 0-100%%), using default 50",
                   kp_conf->model.memfree);
@@ -759,6 +784,44 @@ kp_config_load(const char *conffile, gboolean fail)
         kp_conf->system.sortstrategy = 3;
     }
 
+    if (kp_conf->battery.memfree < 0 || kp_conf->battery.memfree > 100) {
+        g_warning("Invalid battery memfree value %d (must be 0-100%%), using default 15",
+                  kp_conf->battery.memfree);
+        kp_conf->battery.memfree = 15;
+    }
+
+    if (kp_conf->battery.maxprocs < 0 || kp_conf->battery.maxprocs > 100) {
+        g_warning("Invalid battery maxprocs value %d (must be 0-100), using default 4",
+                  kp_conf->battery.maxprocs);
+        kp_conf->battery.maxprocs = 4;
+    }
+
+    if (kp_conf->battery.mincycle < 2 || kp_conf->battery.mincycle > 3600) {
+        g_warning("Invalid battery mincycle value %d (must be 2-3600), using default 30",
+                  kp_conf->battery.mincycle);
+        kp_conf->battery.mincycle = 30;
+    }
+
+    if (kp_conf->battery.maxcycle < kp_conf->battery.mincycle ||
+        kp_conf->battery.maxcycle > 3600) {
+        g_warning("Invalid battery maxcycle value %d (must be mincycle-3600), using mincycle",
+                  kp_conf->battery.maxcycle);
+        kp_conf->battery.maxcycle = kp_conf->battery.mincycle;
+    }
+
+    if (kp_conf->battery.coalesce < 0 || kp_conf->battery.coalesce > 3600) {
+        g_warning("Invalid battery coalesce value %d (must be 0-3600), using default 120",
+                  kp_conf->battery.coalesce);
+        kp_conf->battery.coalesce = 120;
+    }
+
+    if (kp_conf->system.tracesize < 256 * 1024 ||
+        kp_conf->system.tracesize > 1024 * 1024 * 1024) {
+        g_warning("Invalid tracesize value %d (must be 256-1048576 KB), using default 16384",
+                  kp_conf->system.tracesize / 1024);
+        kp_conf->system.tracesize = 16384 * 1024;
+    }
+
     if (kp_conf->model.minsize < 0) {
         g_warning("Invalid min size value %d (must be >= 0), using default 2000000",
                   kp_conf->model.minsize);
@@ -789,6 +852,13 @@ kp_config_load(const char *conffile, gboolean fail)
         g_message("Parsed %d exe prefixes from config", count);
     }
     
+    /* Compile rule lists used on every scan */
+    kp_conf->system.mapprefix_set = kp_prefix_set_new(kp_conf->system.mapprefix);
+    kp_conf->system.exeprefix_set = kp_prefix_set_new(kp_conf->system.exeprefix);
+    kp_conf->system.excluded_patterns_set =
+        kp_glob_set_new(kp_conf->system.excluded_patterns_list,
+                        kp_conf->system.excluded_patterns_count);
+
     if (kp_conf->system.excluded_patterns_count > 0) {
         g_message("Loaded %d exclusion patterns for observation pool",
                   kp_conf->system.excluded_patterns_count);
@@ -801,6 +871,17 @@ kp_config_load(const char *conffile, gboolean fail)
     
     /* Load manual apps from file */
     load_manual_apps_file(kp_conf);
+
+    conf_generation++;
+}
+
+/**
+ * Configuration generation
+ */
+guint
+kp_config_generation(void)
+{
+    return conf_generation;
 }
 
 /**
@@ -14,6 +14,7 @@
 #define CONFIG_H
 
 #include <glib.h>
+#include "../utils/pattern.h"
 
 /* Unit definitions (for confkeys.h) */
 #define bytes			   1
@@ -36,6 +37,8 @@ typedef struct _kp_conf_t
     /* [model] section - prediction model parameters */
     struct _conf_model {
         int cycle;              /* Scan cycle time (seconds) */
+        int mincycle;           /* Adaptive cycle lower bound (seconds) */
+        int maxcycle;           /* Adaptive cycle upper bound (seconds) */
         gboolean usecorrelation; /* Use correlation in predictions */
 
         int minsize;            /* Minimum process size to track (bytes) */
@@ -45,6 +48,7 @@ typedef struct _kp_conf_t
         int memfree;            /* % of free memory */
         int memcached;          /* % of cached memory */
         
+        gboolean costmodel;     /* Rank by latency saved per I/O time */
         int hitstats_window;    /* Hit/miss detection window (seconds) */
     } model;
 
@@ -59,6 +63,8 @@ typedef struct _kp_conf_t
         char **mapprefix;       /* Parsed prefixes for mapped files */
         char *exeprefix_raw;    /* Raw semicolon-separated prefix string */
         char **exeprefix;       /* Parsed prefixes for executables */
+        kp_prefix_set_t *mapprefix_set; /* Compiled mapprefix (runtime) */
+        kp_prefix_set_t *exeprefix_set; /* Compiled exeprefix (runtime) */
 
         int maxprocs;           /* Max parallel readahead processes */
         enum {
@@ -67,6 +73,12 @@ typedef struct _kp_conf_t
             SORT_INODE = 2,     /* Sort by inode */
             SORT_BLOCK = 3      /* Sort by disk block */
         } sortstrategy;
+        gboolean deadlinesort;  /* Earliest-deadline-first readahead batches */
+        gboolean prewarm;       /* Stat files and dirs before data readahead */
+        gboolean recenthints;   /* Live hints from recently-used and history */
+        gboolean pipeline;      /* Scan and I/O worker threads */
+        gboolean trace;         /* Record a replayable trace */
+        int tracesize;          /* Trace ring file size (bytes) */
 
         char *manualapps;           /* Path to manual apps whitelist file */
         char **manual_apps_loaded;  /* Loaded app paths (runtime) */
@@ -76,12 +88,29 @@ typedef struct _kp_conf_t
         char *excluded_patterns;       /* Path patterns to exclude (semicolon-separated) */
         char **excluded_patterns_list; /* Parsed exclusion patterns (runtime) */
         int excluded_patterns_count;   /* Number of exclusion patterns */
+        kp_glob_set_t *excluded_patterns_set; /* Compiled exclusion patterns (runtime) */
         
         char *user_app_paths;          /* User app directories (semicolon-separated) */
         char **user_app_paths_list;    /* Parsed user app paths (runtime) */
         int user_app_paths_count;      /* Number of user app paths */
+
+        char *sysfsroot;               /* Root of sysfs (power supplies) */
+        char *procroot;                /* Root of procfs (startup only) */
+        char *runroot;                 /* Root of /run (startup only) */
     } system;
 
+    /* [battery] section - budget while discharging */
+    struct _conf_battery {
+        gboolean enabled;       /* Apply this budget on battery */
+        int memtotal;           /* Memory percentages, as in [model] */
+        int memfree;
+        int memcached;
+        int maxprocs;           /* Max parallel readahead processes */
+        int mincycle;           /* Adaptive cycle bounds (seconds) */
+        int maxcycle;
+        int coalesce;           /* Min gap between readahead batches (seconds) */
+    } battery;
+
 #ifdef ENABLE_PREHEAT_EXTENSIONS
     /* [preheat] section - Preheat extensions */
     struct _conf_preheat {
@@ -108,6 +137,14 @@ extern kp_conf_t kp_conf[1];
  */
 void kp_config_load(const char *conffile, gboolean fail);
 
+/**
+ * Configuration generation
+ *
+ * Incremented by every kp_config_load(), so caches derived from the
+ * configuration can tell when to rebuild.
+ */
+guint kp_config_generation(void);
+
 /**
  * Dump loaded configuration to log
  * (VERBATIM signature from upstream preload_conf_dump_log)
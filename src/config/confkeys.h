@@ -49,6 +49,12 @@
  *        Smaller = more responsive but higher CPU usage. Range: 5-300 */
 confkey(model,	integer,	cycle,		     20,	seconds)
 
+/* mincycle/maxcycle: Bounds of the adaptive cycle. The cycle drops toward
+ *        mincycle while apps launch and backs off toward maxcycle while
+ *        nothing changes. Set both to cycle for a fixed cycle. */
+confkey(model,	integer,	mincycle,	     10,	seconds)
+confkey(model,	integer,	maxcycle,	    240,	seconds)
+
 /* usecorrelation: Use Markov chain correlation between applications.
  *                 When true, predicts apps based on what was launched before. */
 confkey(model,	boolean,	usecorrelation,	   true,	-)
@@ -65,6 +71,12 @@ confkey(model,	integer,	memtotal,	    -10,	signed_integer_percent)
 confkey(model,	integer,	memfree,	     50,	signed_integer_percent)
 confkey(model,	integer,	memcached,	      0,	signed_integer_percent)
 
+/* costmodel: Rank preload candidates by expected launch latency saved per
+ *            second of readahead I/O, using a seek+bandwidth model learned
+ *            per block device from timed readaheads. When false, candidates
+ *            are ranked by probability alone. */
+confkey(model,	boolean,	costmodel,	   true,	-)
+
 /* hitstats_window: Sliding window (seconds) for hit/miss detection.
  *                  A launch is a "hit" if app was preloaded within this window.
  *                  Default: 3600 (1 hour). Range: 60-86400 */
@@ -100,6 +112,31 @@ confkey(system,	integer,	maxprocs,	     30,	processes)
  *   3 = BLOCK  - Sort by physical disk block (optimal, but needs root) */
 confkey(system,	enum,		sortstrategy,	      3,	-)
 
+/* deadlinesort: Read files in deadline classes by expected time-to-launch
+ *               (earliest first), applying sortstrategy within a class.
+ *               Ignored with sortstrategy = 0. */
+confkey(system,	boolean,	deadlinesort,	   true,	-)
+
+/* prewarm: stat() predicted files and their parent directories in one
+ *          batch before reading data, so path lookup and inode reads
+ *          don't interleave with data reads (mostly helps HDDs) */
+confkey(system,	boolean,	prewarm,	   true,	-)
+
+/* recenthints: Watch recently-used.xbel and shell history and favour
+ *              apps they name for a few minutes (see daemon/hints.c) */
+confkey(system,	boolean,	recenthints,	   true,	-)
+
+/* pipeline: Read /proc on a scan thread and issue readahead and state
+ *           writes on an I/O thread (see daemon/pipeline.c). Read once
+ *           at startup. */
+confkey(system,	boolean,	pipeline,	   true,	-)
+
+/* trace: Record exec/exit events, map sets, predictions and readahead
+ *        batches to a ring file for offline replay (see daemon/trace.c)
+ * tracesize: Size of the ring file (KB) */
+confkey(system,	boolean,	trace,		  false,	-)
+confkey(system,	integer,	tracesize,	  16384,	kilobytes)
+
 /* manualapps: Path to file containing apps to always preload */
 confkey(system,	string,		manualapps,	   NULL,	-)
 
@@ -111,6 +148,33 @@ confkey(system,	string,		excluded_patterns, "/bin/sh;/bin/bash;/usr/bin/grep;/us
  *                 Apps in these paths auto-promoted to priority pool. */
 confkey(system,	string,		user_app_paths,	   "/usr/share/applications;/usr/local/share/applications;~/.local/share/applications;/opt",	-)
 
+/* sysfsroot: Root of the sysfs tree read for power supplies.
+ *            Point it at a fake tree to test power switching. */
+confkey(system,	string,		sysfsroot,	   "/sys",	-)
+
+/* procroot: Root of the proc tree scanned for processes and memory.
+ * runroot:  Root of the runtime tree watched for login sessions (<runroot>/user).
+ *           Both are read once at startup; point them at generated trees
+ *           for benchmarks and tests. */
+confkey(system,	string,		procroot,	   "/proc",	-)
+confkey(system,	string,		runroot,	   "/run",	-)
+
+/* [battery] section - Budget while running on battery (see power.c).
+ * enabled: Use these values on battery; when false the AC values apply.
+ * memtotal/memfree/memcached/maxprocs/mincycle/maxcycle: As in
+ *          [model]/[system], but applied while discharging.
+ * coalesce: Minimum seconds between readahead batches. Predictions made
+ *          in between are merged into the next batch unless an app is
+ *          expected within the current cycle. */
+confkey(battery,	boolean,	enabled,	   true,	-)
+confkey(battery,	integer,	memtotal,	    -10,	signed_integer_percent)
+confkey(battery,	integer,	memfree,	     15,	signed_integer_percent)
+confkey(battery,	integer,	memcached,	      0,	signed_integer_percent)
+confkey(battery,	integer,	maxprocs,	      4,	processes)
+confkey(battery,	integer,	mincycle,	     30,	seconds)
+confkey(battery,	integer,	maxcycle,	    600,	seconds)
+confkey(battery,	integer,	coalesce,	    120,	seconds)
+
 /* PREHEAT EXTENSIONS (opt-in, only active if --enable-preheat-extensions) */
 
 #ifdef ENABLE_PREHEAT_EXTENSIONS
@@ -0,0 +1,356 @@
+/* events.c - Signal and timer event core for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Event Core
+ * =============================================================================
+ *
+ * Two file descriptors feed everything that is not I/O-driven into the
+ * GLib main loop:
+ *
+ *   signalfd  → control signals (HUP, USR1, USR2, TERM, INT, QUIT)
+ *   timerfd   → all daemon timers (tick, tick2, autosave, pause expiry)
+ *
+ * SIGNALS:
+ *   The old handlers set a flag and called g_timeout_add() from signal
+ *   context, which is not async-signal-safe, and the action ran whenever
+ *   the main loop next got around to a zero timeout. Reading a signalfd
+ *   is an ordinary fd event: the action runs in the same main loop
+ *   iteration the signal arrives in, and signals arriving while an action
+ *   runs are queued in the fd instead of racing a flag.
+ *
+ * TIMERS:
+ *   Each kp_event_timer_t is a one-shot deadline. The core arms a single
+ *   timerfd (CLOCK_MONOTONIC, absolute) for the earliest one. When it
+ *   fires, every timer due within its slack runs in the same wakeup, so
+ *   e.g. an autosave with a minute of slack rides along with the next
+ *   tick instead of waking the CPU on its own.
+ *
+ * FALLBACK:
+ *   Without signalfd, signals.c keeps its sigaction handlers. Without
+ *   timerfd, the earliest deadline is a plain GLib timeout.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "events.h"
+#include "../utils/logging.h"
+
+#include <time.h>
+
+#ifdef HAVE_SYS_SIGNALFD_H
+#include <sys/signalfd.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
+struct _kp_event_timer_t
+{
+    const char *name;
+    kp_event_func func;
+    gpointer data;
+    gint64 slack_us;
+    gint64 due_us;          /* Monotonic deadline, 0 = disarmed */
+};
+
+static struct
+{
+    GPtrArray *timers;      /* All timers; they live until exit */
+    gint64 armed_us;        /* Deadline the timer source is set to, 0 = none */
+    int tfd;                /* timerfd, -1 = not created, -2 = unavailable */
+    guint fallback_id;      /* GLib timeout when there is no timerfd */
+
+    int sfd;                /* signalfd, -1 if none */
+    kp_event_signal_func signal_func;
+
+    /* Counters for the stats file */
+    guint64 wakeups;        /* Timer source fired */
+    guint64 timers_run;
+    guint64 timers_early;   /* Ran early to share a wakeup */
+    guint64 signals;
+} core = { NULL, 0, -1, 0, -1, NULL, 0, 0, 0, 0 };
+
+static gint64
+now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/* ========================================================================
+ * TIMERS
+ * ======================================================================== */
+
+static void core_rearm(void);
+
+/* Timer source fired: run everything due within its slack */
+static void
+core_dispatch(void)
+{
+    gint64 now = now_us();
+
+    core.armed_us = 0;
+    core.wakeups++;
+
+    for (guint i = 0; i < core.timers->len; i++) {
+        kp_event_timer_t *t = g_ptr_array_index(core.timers, i);
+
+        if (!t->due_us || t->due_us - t->slack_us > now)
+            continue;
+
+        if (t->due_us > now)
+            core.timers_early++;
+        core.timers_run++;
+
+        g_debug("timer %s", t->name);
+        t->due_us = 0;
+        t->func(t->data);   /* May re-arm any timer */
+    }
+
+    core_rearm();
+}
+
+#ifdef HAVE_SYS_TIMERFD_H
+static gboolean
+timerfd_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    guint64 expirations;
+
+    (void)source;
+    (void)data;
+
+    if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+        g_warning("timerfd failed, falling back to GLib timeouts");
+        close(core.tfd);
+        core.tfd = -2;
+        core.armed_us = 0;
+        core_rearm();
+        return FALSE;
+    }
+
+    if (read(core.tfd, &expirations, sizeof(expirations)) < 0 && errno == EAGAIN)
+        return TRUE;    /* Re-armed since it fired */
+
+    core_dispatch();
+    return TRUE;
+}
+#endif
+
+static gboolean
+fallback_callback(gpointer data)
+{
+    (void)data;
+
+    core.fallback_id = 0;
+    core_dispatch();
+    return FALSE;
+}
+
+/* Create the timerfd on first use */
+static void
+core_init(void)
+{
+    if (core.timers)
+        return;
+
+    core.timers = g_ptr_array_new();
+
+#ifdef HAVE_SYS_TIMERFD_H
+    core.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (core.tfd >= 0) {
+        GIOChannel *channel = g_io_channel_unix_new(core.tfd);
+        g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                       timerfd_callback, NULL);
+        g_io_channel_unref(channel);
+        return;
+    }
+    g_debug("timerfd_create failed (%s), using GLib timeouts", strerror(errno));
+#endif
+    core.tfd = -2;
+}
+
+/* Point the timer source at the earliest deadline */
+static void
+core_rearm(void)
+{
+    gint64 next = 0;
+
+    for (guint i = 0; i < core.timers->len; i++) {
+        kp_event_timer_t *t = g_ptr_array_index(core.timers, i);
+        if (t->due_us && (!next || t->due_us < next))
+            next = t->due_us;
+    }
+
+    if (next == core.armed_us)
+        return;
+    core.armed_us = next;
+
+#ifdef HAVE_SYS_TIMERFD_H
+    if (core.tfd >= 0) {
+        struct itimerspec its;
+
+        memset(&its, 0, sizeof(its));
+        if (next) {
+            /* A zero it_value would disarm; a past one fires at once */
+            next = MAX(next, 1);
+            its.it_value.tv_sec = next / G_USEC_PER_SEC;
+            its.it_value.tv_nsec = (next % G_USEC_PER_SEC) * 1000;
+        }
+        if (timerfd_settime(core.tfd, TFD_TIMER_ABSTIME, &its, NULL) == 0)
+            return;
+        g_warning("timerfd_settime failed: %s", strerror(errno));
+    }
+#endif
+
+    if (core.fallback_id) {
+        g_source_remove(core.fallback_id);
+        core.fallback_id = 0;
+    }
+    if (next) {
+        gint64 delay = MAX(0, next - now_us());
+        core.fallback_id = g_timeout_add((guint)((delay + 999) / 1000),
+                                         fallback_callback, NULL);
+    }
+}
+
+/**
+ * Create a timer (disarmed)
+ */
+kp_event_timer_t *
+kp_event_timer_new(const char *name, guint slack_ms, kp_event_func func, gpointer data)
+{
+    kp_event_timer_t *t;
+
+    core_init();
+
+    t = g_new0(kp_event_timer_t, 1);
+    t->name = name;
+    t->func = func;
+    t->data = data;
+    t->slack_us = (gint64)slack_ms * 1000;
+    g_ptr_array_add(core.timers, t);
+    return t;
+}
+
+/**
+ * Arm a timer to run once, delay_ms from now
+ */
+void
+kp_event_timer_arm(kp_event_timer_t *timer, guint delay_ms)
+{
+    g_return_if_fail(timer);
+
+    timer->due_us = now_us() + (gint64)delay_ms * 1000;
+    core_rearm();
+}
+
+/**
+ * Change how early a timer may run to share a wakeup
+ */
+void
+kp_event_timer_set_slack(kp_event_timer_t *timer, guint slack_ms)
+{
+    g_return_if_fail(timer);
+
+    timer->slack_us = (gint64)slack_ms * 1000;
+}
+
+/**
+ * Disarm a timer
+ */
+void
+kp_event_timer_disarm(kp_event_timer_t *timer)
+{
+    g_return_if_fail(timer);
+
+    timer->due_us = 0;
+    core_rearm();
+}
+
+/* ========================================================================
+ * SIGNALS
+ * ======================================================================== */
+
+#ifdef HAVE_SYS_SIGNALFD_H
+static gboolean
+signalfd_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    struct signalfd_siginfo info;
+
+    (void)source;
+    (void)data;
+
+    if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+        g_critical("signalfd failed, control signals are no longer handled");
+        return FALSE;
+    }
+
+    while (read(core.sfd, &info, sizeof(info)) == sizeof(info)) {
+        core.signals++;
+        core.signal_func((int)info.ssi_signo);
+    }
+    return TRUE;
+}
+#endif
+
+/**
+ * Deliver signals in set to func from the main loop, through a signalfd
+ */
+gboolean
+kp_event_watch_signals(const sigset_t *set, kp_event_signal_func func)
+{
+#ifdef HAVE_SYS_SIGNALFD_H
+    GIOChannel *channel;
+    sigset_t old;
+
+    g_return_val_if_fail(set && func && core.sfd < 0, FALSE);
+
+    if (sigprocmask(SIG_BLOCK, set, &old) < 0)
+        return FALSE;
+
+    core.sfd = signalfd(-1, set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (core.sfd < 0) {
+        g_debug("signalfd failed (%s), using signal handlers", strerror(errno));
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        return FALSE;
+    }
+
+    core.signal_func = func;
+    channel = g_io_channel_unix_new(core.sfd);
+    /* Ahead of timers and I/O watches, so control actions never queue
+     * behind a tick */
+    g_io_add_watch_full(channel, G_PRIORITY_HIGH, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                        signalfd_callback, NULL, NULL);
+    g_io_channel_unref(channel);
+    return TRUE;
+#else
+    (void)set;
+    (void)func;
+    return FALSE;
+#endif
+}
+
+/**
+ * Write event core counters to the stats file
+ */
+void
+kp_event_dump(FILE *f)
+{
+    fprintf(f, "\n# Event Core\n");
+    fprintf(f, "event_timerfd=%d\n", core.tfd >= 0 ? 1 : 0);
+    fprintf(f, "event_signalfd=%d\n", core.sfd >= 0 ? 1 : 0);
+    fprintf(f, "event_wakeups=%" G_GUINT64_FORMAT "\n", core.wakeups);
+    fprintf(f, "event_timers_run=%" G_GUINT64_FORMAT "\n", core.timers_run);
+    fprintf(f, "event_timers_early=%" G_GUINT64_FORMAT "\n", core.timers_early);
+    fprintf(f, "event_signals=%" G_GUINT64_FORMAT "\n", core.signals);
+}
@@ -0,0 +1,70 @@
+/* events.h - Signal and timer event core for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <glib.h>
+#include <signal.h>
+#include <stdio.h>
+
+/**
+ * kp_event_timer_t: One-shot timer on the shared timer source
+ *
+ * Armed timers are kept as absolute monotonic deadlines; the core keeps a
+ * single timerfd set to the earliest one. A timer may run up to @slack
+ * before its deadline when the core wakes up for another timer anyway.
+ */
+typedef struct _kp_event_timer_t kp_event_timer_t;
+
+typedef void (*kp_event_func)(gpointer data);
+typedef void (*kp_event_signal_func)(int sig);
+
+/**
+ * Create a timer (disarmed)
+ *
+ * @param name      Static name, for debug output
+ * @param slack_ms  How early the timer may run to share a wakeup
+ */
+kp_event_timer_t *kp_event_timer_new(const char *name, guint slack_ms,
+                                     kp_event_func func, gpointer data);
+
+/**
+ * Arm a timer to run once, @delay_ms from now (replaces any earlier arming)
+ */
+void kp_event_timer_arm(kp_event_timer_t *timer, guint delay_ms);
+
+/**
+ * Change how early a timer may run to share a wakeup
+ */
+void kp_event_timer_set_slack(kp_event_timer_t *timer, guint slack_ms);
+
+/**
+ * Disarm a timer
+ */
+void kp_event_timer_disarm(kp_event_timer_t *timer);
+
+/**
+ * Deliver signals in @set to @func from the main loop, through a signalfd
+ *
+ * The signals are blocked for the process (threads created afterwards
+ * inherit the mask) so they are only ever read from the signalfd.
+ *
+ * @return  FALSE if signalfd is unavailable; nothing is changed and the
+ *          caller should install handlers
+ */
+gboolean kp_event_watch_signals(const sigset_t *set, kp_event_signal_func func);
+
+/**
+ * Write event core counters to the stats file
+ */
+void kp_event_dump(FILE *f);
+
+#endif /* EVENTS_H */
@@ -0,0 +1,683 @@
+/* hints.c - Live usage hints for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Live Usage Hints
+ * =============================================================================
+ *
+ * First-run seeding reads recently-used.xbel and shell history once. After
+ * that they are still a leading indicator: a document opened from the file
+ * manager is recorded with its handler ("recently opened with X") before
+ * X has finished starting, and a command typed in a shell says what the
+ * user is working on. This module watches those files and turns new
+ * entries into short-lived launch hints.
+ *
+ * WATCHES (one inotify fd, per watched home):
+ *   ~/.local/share    IN_MOVED_TO | IN_CLOSE_WRITE → recently-used.xbel
+ *   ~                 IN_CLOSE_WRITE | IN_MOVED_TO → .bash_history, .zsh_history
+ *
+ *   Homes watched: the daemon's own, plus every user with a session under
+ *   /run/user (session.c reports logins and logouts).
+ *
+ * INCREMENTAL PARSING:
+ *   History files are appended to. Each keeps the offset of the last whole
+ *   line parsed, and only bytes past it are read (utils/linereader.c). A
+ *   file that was replaced or truncated is skipped to its end, since its
+ *   new entries can't be told apart from old ones.
+ *
+ *   recently-used.xbel is rewritten as a whole by GLib (new file, then
+ *   rename), so there is no appended region. Instead every application
+ *   element carries a modified= timestamp; only entries newer than the
+ *   newest one already seen produce hints.
+ *
+ * FEEDING THE MODEL:
+ *   A hint is (exe, strength, time). At every prediction, rank_maps() in
+ *   prophet.c calls kp_hints_boost(), which bids for each hinted exe that
+ *   isn't running, with a probability that decays with the hint's age:
+ *
+ *     p = strength × 2^(−age / HINT_HALFLIFE)
+ *     exe.lnprob += log(1 − p)
+ *
+ *   A fresh hint also runs a prediction right away (at most once per
+ *   HINT_PREDICT_GAP), so the handler is warmed between scan cycles.
+ *   Apps without a .desktop file are ignored, like in seeding.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "hints.h"
+#include "../utils/logging.h"
+#include "../utils/desktop.h"
+#include "../utils/linereader.h"
+#include "../utils/seeding.h"
+#include "../utils/fswatch.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../state/state_closure.h"
+#include "../predict/prophet.h"
+#include "pause.h"
+
+#include <math.h>
+#include <pwd.h>
+
+#define HINT_WINDOW         600     /* Hints older than this are dropped */
+#define HINT_HALFLIFE       120.0   /* Seconds for a hint to lose half its weight */
+#define HINT_XBEL_PROB      0.8     /* Fresh "recently opened with X" */
+#define HINT_HISTORY_PROB   0.5     /* Fresh shell command */
+#define HINT_PREDICT_GAP    5       /* Seconds between hint-triggered predictions */
+
+#define XBEL_NAME "recently-used.xbel"
+
+typedef enum {
+    HINT_FILE_XBEL,
+    HINT_FILE_BASH,
+    HINT_FILE_ZSH,
+    HINT_FILES
+} hint_file_kind_t;
+
+static const char *const hint_file_names[HINT_FILES] = {
+    XBEL_NAME, ".bash_history", ".zsh_history"
+};
+
+/* One watched file */
+typedef struct {
+    char *path;
+    dev_t dev;              /* Identity when last parsed */
+    ino_t ino;
+    off_t offset;           /* History: bytes already parsed */
+    gint64 watermark;       /* XBEL: newest modified= seen (µs since epoch) */
+} hint_file_t;
+
+/* One watched home directory */
+typedef struct {
+    uid_t uid;
+    int wd_home;            /* -1 if not watched */
+    int wd_share;
+    hint_file_t files[HINT_FILES];
+} hint_home_t;
+
+/* One active hint */
+typedef struct {
+    double strength;        /* Launch probability when fresh */
+    time_t time;
+} hint_t;
+
+static struct {
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_t *watch;        /* NULL when not watching */
+#endif
+    GHashTable *homes;          /* GUINT_TO_POINTER(uid) → hint_home_t* */
+    GHashTable *hints;          /* exe path → hint_t* */
+    time_t last_predict;
+    gboolean pending;           /* inotify batch added hints */
+    unsigned long received;     /* Hints received since start */
+} hints;
+
+/* ========================================================================
+ * HINTS
+ * ======================================================================== */
+
+/**
+ * Record a hint for an executable
+ *
+ * @return TRUE if the exe is a known GUI app and the hint was recorded
+ */
+static gboolean
+hint_add(const char *exe_path, double strength, const char *source)
+{
+    hint_t *hint;
+    kp_exe_t *exe;
+
+    /* Like seeding: only apps with a .desktop file (skip CLI tools) */
+    if (!kp_desktop_has_file(exe_path))
+        return FALSE;
+
+    exe = g_hash_table_lookup(kp_state->exes, exe_path);
+    if (!exe) {
+        exe = kp_exe_new(exe_path, FALSE, NULL);
+        exe->pool = POOL_PRIORITY;  /* Launched by the user */
+        kp_state_register_exe(exe, TRUE);
+        kp_state->dirty = TRUE;
+    }
+    if (exe->blacklisted)
+        return FALSE;
+
+    hint = g_hash_table_lookup(hints.hints, exe_path);
+    if (!hint) {
+        hint = g_new0(hint_t, 1);
+        g_hash_table_insert(hints.hints, g_strdup(exe_path), hint);
+    }
+    hint->strength = MAX(hint->strength * pow(0.5, (time(NULL) - hint->time) / HINT_HALFLIFE),
+                         strength);
+    hint->time = time(NULL);
+    hints.received++;
+
+    g_debug("Hint from %s: %s", source, exe_path);
+    return TRUE;
+}
+
+/* ========================================================================
+ * PARSERS
+ * ======================================================================== */
+
+/**
+ * Replace the XML entities GLib writes in attribute values
+ */
+static void
+xml_unescape(char *s)
+{
+    static const struct { const char *entity; char c; } entities[] = {
+        { "&apos;", '\'' }, { "&quot;", '"' }, { "&amp;", '&' },
+        { "&lt;", '<' }, { "&gt;", '>' },
+    };
+    char *out = s;
+
+    while (*s) {
+        gboolean replaced = FALSE;
+
+        if (*s == '&') {
+            for (unsigned i = 0; i < G_N_ELEMENTS(entities); i++) {
+                size_t n = strlen(entities[i].entity);
+                if (strncmp(s, entities[i].entity, n) == 0) {
+                    *out++ = entities[i].c;
+                    s += n;
+                    replaced = TRUE;
+                    break;
+                }
+            }
+        }
+        if (!replaced)
+            *out++ = *s++;
+    }
+    *out = '\0';
+}
+
+/**
+ * Copy an attribute value of an XML element line
+ */
+static gboolean
+xml_attr(const char *line, size_t len, const char *name, char *out, size_t size)
+{
+    const char *end = line + len;
+    size_t name_len = strlen(name);
+
+    for (const char *p = line; p + name_len + 2 < end; p++) {
+        const char *value, *close;
+
+        if (p[0] != ' ' || strncmp(p + 1, name, name_len) != 0 ||
+            p[1 + name_len] != '=' || p[2 + name_len] != '"')
+            continue;
+
+        value = p + name_len + 3;
+        close = memchr(value, '"', (size_t)(end - value));
+        if (!close || (size_t)(close - value) >= size)
+            return FALSE;
+
+        memcpy(out, value, (size_t)(close - value));
+        out[close - value] = '\0';
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Parse an ISO 8601 UTC timestamp ("2025-01-31T10:00:00.123456Z")
+ *
+ * @return  Microseconds since the epoch, or 0 if malformed
+ */
+static gint64
+parse_iso8601(const char *s)
+{
+    struct tm tm;
+    int usec = 0;
+    const char *frac;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(s, "%4d-%2d-%2dT%2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return 0;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+
+    frac = strchr(s, '.');
+    if (frac) {
+        int digits = 0;
+        for (frac++; g_ascii_isdigit(*frac) && digits < 6; frac++, digits++)
+            usec = usec * 10 + (*frac - '0');
+        for (; digits < 6; digits++)
+            usec *= 10;
+    }
+
+    return (gint64)timegm(&tm) * G_USEC_PER_SEC + usec;
+}
+
+/**
+ * Scan recently-used.xbel for application entries newer than the watermark
+ *
+ * @return Number of hints recorded
+ */
+static int
+parse_xbel(hint_file_t *file)
+{
+    kp_linereader_t r = KP_LINEREADER_INIT;
+    const char *line;
+    size_t len;
+    gint64 newest = file->watermark;
+    int added = 0;
+
+    if (!kp_linereader_open(&r, file->path, 0))
+        return 0;
+
+    while ((line = kp_linereader_next(&r, &len, TRUE))) {
+        char exec[1024];
+        char modified[64];
+        char *exe_path, *unquoted;
+        gint64 when;
+
+        if (!g_strstr_len(line, (gssize)len, "<bookmark:application "))
+            continue;
+        if (!xml_attr(line, len, "modified", modified, sizeof(modified)) ||
+            !xml_attr(line, len, "exec", exec, sizeof(exec)))
+            continue;
+
+        when = parse_iso8601(modified);
+        if (when <= file->watermark)
+            continue;
+        newest = MAX(newest, when);
+
+        /* GLib stores the whole command line quoted: 'gedit %u' */
+        xml_unescape(exec);
+        unquoted = g_shell_unquote(exec, NULL);
+        exe_path = kp_desktop_resolve_exec(unquoted ? unquoted : exec);
+        g_free(unquoted);
+        if (exe_path && hint_add(exe_path, HINT_XBEL_PROB, "recently-used"))
+            added++;
+        g_free(exe_path);
+    }
+
+    kp_linereader_close(&r);
+    file->watermark = newest;
+    return added;
+}
+
+/**
+ * Parse lines appended to a shell history file
+ *
+ * @return Number of hints recorded
+ */
+static int
+parse_history(hint_file_t *file)
+{
+    kp_linereader_t r = KP_LINEREADER_INIT;
+    GHashTable *seen;
+    const char *line;
+    size_t len;
+    int added = 0;
+
+    if (!kp_linereader_open(&r, file->path, file->offset))
+        return 0;
+
+    seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Whole lines only: a half-written command is picked up next time */
+    while ((line = kp_linereader_next(&r, &len, FALSE))) {
+        char cmd[256];
+        char *exe_path;
+
+        if (!kp_seed_history_command(line, len, cmd, sizeof(cmd)) ||
+            g_hash_table_lookup(seen, cmd))
+            continue;
+        g_hash_table_insert(seen, g_strdup(cmd), GINT_TO_POINTER(1));
+
+        exe_path = kp_desktop_resolve_exec(cmd);
+        if (exe_path && hint_add(exe_path, HINT_HISTORY_PROB, "shell history"))
+            added++;
+        g_free(exe_path);
+    }
+
+    file->offset = kp_linereader_offset(&r);
+    kp_linereader_close(&r);
+    g_hash_table_destroy(seen);
+    return added;
+}
+
+/**
+ * Take note of a file's identity and end without producing hints
+ *
+ * Used when a watch starts and when a history file was replaced.
+ */
+static void
+file_skip_to_end(hint_file_t *file, hint_file_kind_t kind)
+{
+    struct stat st;
+
+    if (stat(file->path, &st) != 0) {
+        file->dev = 0;
+        file->ino = 0;
+        file->offset = 0;
+        return;
+    }
+
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->offset = st.st_size;
+    if (kind == HINT_FILE_XBEL)
+        file->watermark = MAX(file->watermark, (gint64)time(NULL) * G_USEC_PER_SEC);
+}
+
+/**
+ * A watched file was written or replaced
+ *
+ * @return Number of hints recorded
+ */
+static int
+file_changed(hint_file_t *file, hint_file_kind_t kind)
+{
+    struct stat st;
+
+    if (stat(file->path, &st) != 0)
+        return 0;
+
+    if (kind == HINT_FILE_XBEL)
+        return parse_xbel(file);
+
+    if (st.st_dev != file->dev || st.st_ino != file->ino || st.st_size < file->offset) {
+        /* Replaced or truncated (history rewritten): old and new entries
+         * can't be told apart, start over from its end */
+        g_debug("%s was rewritten, skipping to its end", file->path);
+        file_skip_to_end(file, kind);
+        return 0;
+    }
+
+    if (st.st_size == file->offset)
+        return 0;
+
+    return parse_history(file);
+}
+
+/* ========================================================================
+ * WATCHES
+ * ======================================================================== */
+
+/**
+ * Run a prediction now so hinted apps are read in before the next cycle
+ */
+static void
+hints_predict_now(void)
+{
+    time_t now = time(NULL);
+
+    if (!kp_conf->system.dopredict || kp_pause_is_active() || !kp_state->exes)
+        return;
+    if (now - hints.last_predict < HINT_PREDICT_GAP)
+        return;
+
+    hints.last_predict = now;
+    g_debug("Hints: predicting immediately");
+    kp_prophet_predict(NULL);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/**
+ * Find the home and file an inotify event refers to
+ */
+static hint_file_t *
+event_file(const struct inotify_event *ev, hint_file_kind_t *kind)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, hints.homes);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        hint_home_t *home = value;
+
+        if (ev->wd == home->wd_share && strcmp(ev->name, XBEL_NAME) == 0) {
+            *kind = HINT_FILE_XBEL;
+            return &home->files[HINT_FILE_XBEL];
+        }
+        if (ev->wd == home->wd_home) {
+            for (int k = HINT_FILE_BASH; k < HINT_FILES; k++)
+                if (strcmp(ev->name, hint_file_names[k]) == 0) {
+                    *kind = (hint_file_kind_t)k;
+                    return &home->files[k];
+                }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * inotify event: a watched file written or replaced
+ */
+static gboolean
+hints_inotify_event(const struct inotify_event *ev, gpointer data)
+{
+    hint_file_kind_t kind;
+    hint_file_t *file;
+
+    (void)data;
+
+    if (!ev->len || !kp_conf->system.recenthints || !kp_state->exes)
+        return TRUE;
+
+    file = event_file(ev, &kind);
+    if (file && file_changed(file, kind) > 0)
+        hints.pending = TRUE;
+    return TRUE;
+}
+
+/**
+ * End of an inotify batch: predict once for everything that came in
+ */
+static void
+hints_inotify_done(gboolean active, gpointer data)
+{
+    (void)data;
+
+    if (!active) {
+        kp_fswatch_free(hints.watch);
+        hints.watch = NULL;
+        return;
+    }
+
+    if (hints.pending)
+        hints_predict_now();
+    hints.pending = FALSE;
+}
+#endif
+
+/**
+ * Free a home entry and drop its watches
+ */
+static void
+home_free(gpointer data)
+{
+    hint_home_t *home = data;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if (hints.watch) {
+        kp_fswatch_rm(hints.watch, home->wd_home);
+        kp_fswatch_rm(hints.watch, home->wd_share);
+    }
+#endif
+
+    for (int k = 0; k < HINT_FILES; k++)
+        g_free(home->files[k].path);
+    g_free(home);
+}
+
+/**
+ * Start watching a home directory
+ */
+static void
+home_watch(uid_t uid, const char *dir)
+{
+    hint_home_t *home;
+    char *share;
+
+    if (!dir || !*dir || g_hash_table_lookup(hints.homes, GUINT_TO_POINTER(uid)))
+        return;
+
+    home = g_new0(hint_home_t, 1);
+    home->uid = uid;
+    home->wd_home = -1;
+    home->wd_share = -1;
+
+    share = g_build_filename(dir, ".local/share", NULL);
+    home->files[HINT_FILE_XBEL].path = g_build_filename(share, XBEL_NAME, NULL);
+    for (int k = HINT_FILE_BASH; k < HINT_FILES; k++)
+        home->files[k].path = g_build_filename(dir, hint_file_names[k], NULL);
+
+    /* Only what is written from now on counts */
+    for (int k = 0; k < HINT_FILES; k++)
+        file_skip_to_end(&home->files[k], (hint_file_kind_t)k);
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if (hints.watch) {
+        home->wd_home = kp_fswatch_add(hints.watch, dir,
+                                       IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+        home->wd_share = kp_fswatch_add(hints.watch, share,
+                                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    }
+#endif
+
+    g_debug("Hints: watching %s for UID %u (%s)", dir, (unsigned)uid,
+            home->wd_home >= 0 ? "active" : "no watch");
+
+    g_free(share);
+    g_hash_table_insert(hints.homes, GUINT_TO_POINTER(uid), home);
+}
+
+/**
+ * Initialize live hints
+ */
+void
+kp_hints_init(void)
+{
+    if (hints.homes)
+        return;
+
+    hints.homes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, home_free);
+    hints.hints = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+#ifdef HAVE_SYS_INOTIFY_H
+    hints.watch = kp_fswatch_new(hints_inotify_event, hints_inotify_done, NULL);
+    if (!hints.watch)
+        g_debug("inotify unavailable (%s), live hints disabled", strerror(errno));
+#endif
+
+    /* The daemon's own home, as used by first-run seeding */
+    home_watch(getuid(), g_get_home_dir());
+}
+
+/**
+ * Watch the home directory of a logged-in user
+ */
+void
+kp_hints_watch_user(uid_t uid)
+{
+    struct passwd *pw;
+
+    if (!hints.homes)
+        return;
+
+    pw = getpwuid(uid);
+    if (pw)
+        home_watch(uid, pw->pw_dir);
+}
+
+/**
+ * Stop watching the home directory of a user who logged out
+ */
+void
+kp_hints_unwatch_user(uid_t uid)
+{
+    if (!hints.homes || uid == getuid())
+        return;
+
+    g_hash_table_remove(hints.homes, GUINT_TO_POINTER(uid));
+}
+
+/**
+ * Bid for every hinted exe in the current prediction
+ */
+void
+kp_hints_boost(void)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    time_t now = time(NULL);
+    int boosted = 0;
+
+    if (!hints.hints || !kp_conf->system.recenthints)
+        return;
+
+    g_hash_table_iter_init(&iter, hints.hints);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        hint_t *hint = value;
+        double age = (double)(now - hint->time);
+        kp_exe_t *exe;
+        double p;
+
+        if (age > HINT_WINDOW) {
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+
+        exe = g_hash_table_lookup(kp_state->exes, key);
+        if (!exe || exe->blacklisted || exe_is_running(exe))
+            continue;
+
+        /* New apps have no maps yet; attach the binary and its closure */
+        if (g_set_size(exe->exemaps) == 0 && kp_closure_load_maps(exe) == 0)
+            continue;
+
+        p = hint->strength * pow(0.5, MAX(0.0, age) / HINT_HALFLIFE);
+        exe->lnprob += log(1 - MIN(p, 0.999));
+        exe->launch_rate += p / MAX(1, kp_state->cycle);
+        boosted++;
+    }
+
+    if (boosted > 0)
+        g_debug("Hints: boosted %d apps", boosted);
+}
+
+/**
+ * Write hint counters to the stats file
+ */
+void
+kp_hints_dump(FILE *f)
+{
+    fprintf(f, "\n# Live Hints\n");
+    fprintf(f, "hints_received=%lu\n", hints.received);
+    fprintf(f, "hints_active=%u\n", hints.hints ? g_hash_table_size(hints.hints) : 0);
+    fprintf(f, "hints_homes=%u\n", hints.homes ? g_hash_table_size(hints.homes) : 0);
+}
+
+/**
+ * Free live hint resources
+ */
+void
+kp_hints_free(void)
+{
+    if (hints.homes)
+        g_hash_table_destroy(hints.homes);  /* Removes watches */
+    if (hints.hints)
+        g_hash_table_destroy(hints.hints);
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_free(hints.watch);
+    hints.watch = NULL;
+#endif
+
+    hints.homes = NULL;
+    hints.hints = NULL;
+}
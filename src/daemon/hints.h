@@ -0,0 +1,53 @@
+/* hints.h - Live usage hints for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HINTS_H
+#define HINTS_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * Initialize live hints
+ * Watches recently-used.xbel and shell history in the daemon's own home.
+ * Call before kp_session_init() so existing sessions are watched too.
+ */
+void kp_hints_init(void);
+
+/**
+ * Watch the home directory of a logged-in user
+ * Called by session.c when a session appears
+ */
+void kp_hints_watch_user(uid_t uid);
+
+/**
+ * Stop watching the home directory of a user who logged out
+ */
+void kp_hints_unwatch_user(uid_t uid);
+
+/**
+ * Bid for every hinted exe in the current prediction
+ * Called by the prophet after probabilities are reset; a no-op
+ * when system.recenthints is off
+ */
+void kp_hints_boost(void);
+
+/**
+ * Write hint counters to the stats file
+ */
+void kp_hints_dump(FILE *f);
+
+/**
+ * Free live hint resources
+ */
+void kp_hints_free(void);
+
+#endif /* HINTS_H */
@@ -25,17 +25,28 @@
  *   1. parse_cmdline()     → Process command-line arguments
  *   2. kp_log_init()       → Set up logging
  *   3. kp_config_load()    → Load configuration from INI file
- *   4. kp_blacklist_init() → Load application blacklist
- *   5. kp_session_init()   → Initialize session detection
- *   6. kp_signals_init()   → Set up signal handlers
- *   7. kp_daemonize()      → Fork to background (unless -f)
- *   8. kp_state_load()     → Load learned state from disk
- *   9. kp_daemon_run()     → Enter main event loop
+ *   4. kp_stats_init()     → Statistics (the state parser records into it)
+ *      kp_signals_init()   → Set up signal handlers
+ *   5. kp_daemonize()      → Fork to background (unless -f)
+ *   6. In parallel:
+ *        worker thread: kp_state_load()      → Load learned state from disk
+ *        main thread:   kp_hotset_load()     → Read the saved hot set and
+ *                                              issue the first readahead
+ *                       kp_blacklist_init()  → Load application blacklist
+ *                       kp_desktop_init()    → Index .desktop files
+ *                       kp_hints_init()      → Watch recently-used.xbel and history
+ *                       kp_session_init()    → Initialize session detection
+ *   7. Reclassify, priority mesh, manual apps, initial save
+ *   8. kp_daemon_run()     → Enter main event loop
+ *
+ *   Every phase is timed (startup.c); the breakdown is logged once
+ *   initialization finishes and written to the stats file.
  *
  * SHUTDOWN SEQUENCE:
- *   1. kp_state_save()     → Persist learned state
- *   2. kp_state_free()     → Release memory
- *   3. exit(0)
+ *   1. kp_pipeline_stop()  → Join the scan and I/O threads
+ *   2. kp_state_save()     → Persist learned state
+ *   3. kp_state_free()     → Release memory, close the trace
+ *   4. exit(0)
  *
  * SELF-TEST MODE (-t):
  *   Runs diagnostics without starting daemon:
@@ -52,11 +63,21 @@
 #include "../config/config.h"
 #include "../config/blacklist.h"
 #include "../utils/desktop.h"
+#include "../utils/seeding.h"
+#include "../utils/lib_scanner.h"
+#include "../readahead/iocost.h"
+#include "../monitor/proc.h"
 #include "daemon.h"
 #include "signals.h"
 #include "session.h"
+#include "hints.h"
 #include "stats.h"
+#include "startup.h"
+#include "pipeline.h"
+#include "trace.h"
 #include "../state/state.h"
+#include "../state/state_hotset.h"
+#include "../predict/prophet.h"
 
 #include <getopt.h>
 #include <dirent.h>
@@ -168,6 +189,11 @@ parse_cmdline(int *argc, char ***argv)
                 exit(EXIT_FAILURE);
         }
     }
+
+    /* Own copies: main() frees them at exit */
+    conffile = g_strdup(conffile);
+    statefile = g_strdup(statefile);
+    logfile = g_strdup(logfile);
 }
 
 /**
@@ -407,6 +433,64 @@ run_self_test(void)
     }
 }
 
+/* State file parse run on its own thread during startup */
+typedef struct {
+    const char *statefile;
+    gint64 start_us;
+    gint64 end_us;
+} state_load_job_t;
+
+static gpointer
+state_load_thread(gpointer data)
+{
+    state_load_job_t *job = data;
+
+    job->start_us = kp_startup_now();
+    kp_state_load(job->statefile);
+    job->end_us = kp_startup_now();
+    return NULL;
+}
+
+/**
+ * Startup work that runs while the state file is being parsed
+ *
+ * None of it may touch kp_state: the hot set lives outside it, and the
+ * blacklist, desktop index, live hint and session watches only read their
+ * own files.
+ */
+static void
+run_concurrent_init(void)
+{
+    gint64 t0;
+
+    /* First readahead from the top of the state file, before the model */
+    t0 = kp_startup_now();
+    if (kp_hotset_load(statefile) > 0)
+        kp_prophet_readahead_hotset();
+    kp_startup_phase("hotset", t0, kp_startup_now(), TRUE);
+
+    t0 = kp_startup_now();
+    kp_blacklist_init();
+    kp_startup_phase("blacklist", t0, kp_startup_now(), TRUE);
+
+    /* Desktop file scanner for GUI app discovery.
+     * The index cache lives next to the state file. */
+    t0 = kp_startup_now();
+    {
+        char *state_dir = g_path_get_dirname(statefile);
+        kp_desktop_init(state_dir);
+        g_free(state_dir);
+    }
+    kp_startup_phase("desktop-index", t0, kp_startup_now(), TRUE);
+
+    /* Live hints, then session detection (which adds the homes of
+     * logged-in users to the hint watches) */
+    t0 = kp_startup_now();
+    kp_hints_init();
+    kp_session_init();
+    kp_startup_phase("hints-sessions", t0, kp_startup_now(), TRUE);
+}
+
 /**
  * Main entry point
  * (Structure from upstream preload main)
@@ -414,6 +498,11 @@ run_self_test(void)
 int
 main(int argc, char **argv)
 {
+    gint64 t0, t_conc;
+    state_load_job_t job;
+
+    kp_startup_begin();
+
     /* Initialize */
     parse_cmdline(&argc, &argv);
 
@@ -431,22 +520,22 @@ main(int argc, char **argv)
     }
 
     /* Load configuration */
+    t0 = kp_startup_now();
     kp_config_load(conffile, TRUE);
+    kp_startup_phase("config", t0, kp_startup_now(), FALSE);
 
-    /* Initialize blacklist */
-    kp_blacklist_init();
-    
-    /* Initialize desktop file scanner for GUI app discovery */
-    kp_desktop_init();
+    /* Fixed for the daemon's lifetime: the scan thread reads it unlocked */
+    kp_proc_set_root(kp_conf->system.procroot);
 
-    /* Initialize session detection */
-    kp_session_init();
+    kp_trace_open();
 
-    /* Initialize statistics */
+    /* Initialize statistics (the state parser feeds it preload times) */
+    t0 = kp_startup_now();
     kp_stats_init();
-
     kp_signals_init();
+    kp_startup_phase("stats-signals", t0, kp_startup_now(), FALSE);
 
+    /* Fork before any thread exists */
     if (!foreground)
         kp_daemonize();
 
@@ -455,30 +544,67 @@ main(int argc, char **argv)
 
     g_debug("starting up");
 
-    /* Load state from file */
-    kp_state_load(statefile);
+    /* The state file parse, blacklist, desktop index and watches don't
+     * depend on each other: parse the state file on a worker thread while
+     * the main thread does the rest */
+    job.statefile = statefile;
+    t_conc = kp_startup_now();
+#if GLIB_CHECK_VERSION(2, 32, 0)
+    {
+        GThread *loader = g_thread_new("state-load", state_load_thread, &job);
+        run_concurrent_init();
+        g_thread_join(loader);
+    }
+#else
+    run_concurrent_init();      /* Hot set first: it is what reads ahead */
+    state_load_thread(&job);
+#endif
+    kp_startup_phase("state-load", job.start_us, job.end_us, TRUE);
+    kp_startup_phase("parallel-init", t_conc, kp_startup_now(), FALSE);
+
+    /* Exes parsed while the blacklist was loading weren't checked */
+    kp_blacklist_refresh_exes();
+    kp_desktop_set_notify(kp_stats_desktop_changed);
+    kp_seed_set_done(kp_stats_reclassify_all);
 
     /* Reclassify all loaded apps (fixes cached pool values) */
+    t0 = kp_startup_now();
     kp_stats_reclassify_all();
+    kp_startup_phase("reclassify", t0, kp_startup_now(), FALSE);
 
     /* Build Markov chains between priority apps (needed for prediction) */
+    t0 = kp_startup_now();
     kp_markov_build_priority_mesh();
+    kp_startup_phase("priority-mesh", t0, kp_startup_now(), FALSE);
 
     /* Register manual apps that aren't already tracked */
+    t0 = kp_startup_now();
     kp_state_register_manual_apps();
+    kp_startup_phase("manual-apps", t0, kp_startup_now(), FALSE);
 
     /* Save state immediately so preheat-ctl commands work right away */
+    t0 = kp_startup_now();
     kp_state->dirty = TRUE;  /* Ensure save actually writes */
     kp_state_save(statefile);
+    kp_startup_phase("initial-save", t0, kp_startup_now(), FALSE);
 
+    kp_startup_ready();
     g_message("%s %s started", PACKAGE, VERSION);
 
     /* Main loop */
     kp_daemon_run(statefile);
 
     /* Clean up */
+    kp_pipeline_stop();     /* Join workers; queued saves are written */
+    kp_seed_stop();         /* Merge a first-run seed still in progress */
     kp_state_save(statefile);
+    kp_desktop_free();      /* Writes the index cache if it changed */
+    kp_hints_free();
     kp_state_free();
+    kp_hotset_free();
+    kp_lib_scanner_free();
+    kp_iocost_free();
+    kp_trace_close();
 
     /* Release PID file lock */
     release_pidfile_lock();
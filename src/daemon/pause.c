@@ -22,10 +22,15 @@
  *   - Survives daemon restarts (but not reboots)
  *   - Contains expiry timestamp (0 = until reboot)
  *   - Is readable by preheat-ctl for status queries
+ *   - Is the only channel: preheat-ctl pause/resume and bench write or
+ *     remove it, and kp_pause_is_active() re-reads it when a stat()
+ *     shows it changed
  *
  * EXPIRY HANDLING:
  *   kp_pause_is_active() checks if pause has expired and automatically
- *   clears the state, so the daemon resumes preloading seamlessly.
+ *   clears the state, so the daemon resumes preloading seamlessly. A timer
+ *   on the event core (events.c) also fires at the expiry, so the pause
+ *   ends on time even while no tick asks.
  *
  * USE CASES:
  *   - Heavy I/O operations (large downloads, builds)
@@ -38,6 +43,7 @@
 #include "common.h"
 #include "pause.h"
 #include "../utils/logging.h"
+#include "events.h"
 
 #include <sys/stat.h>
 
@@ -49,8 +55,47 @@ static struct {
     gboolean active;       /* Is pause currently active? */
     time_t expiry;         /* When pause expires (0 = until reboot) */
     gboolean initialized;  /* Has init been called? */
+    gboolean file_seen;    /* Did the file exist when last read? */
+    struct stat file_st;   /* Its stat() then, to notice changes */
 } pause_state = {0};
 
+static kp_event_timer_t *expiry_timer = NULL;
+
+static void arm_expiry(void);
+
+/* Expiry timer: clears the pause if it is due (re-arms if run early) */
+static void
+pause_expired(gpointer data)
+{
+    (void)data;
+
+    if (kp_pause_is_active())
+        arm_expiry();
+}
+
+/**
+ * Point the expiry timer at the current expiry (or disarm it)
+ */
+static void
+arm_expiry(void)
+{
+    time_t now;
+    gint64 delay_ms;
+
+    if (!pause_state.active || pause_state.expiry <= 0) {
+        if (expiry_timer)
+            kp_event_timer_disarm(expiry_timer);
+        return;
+    }
+
+    if (!expiry_timer)
+        expiry_timer = kp_event_timer_new("pause-expiry", 1000, pause_expired, NULL);
+
+    now = time(NULL);
+    delay_ms = pause_state.expiry > now ? (gint64)(pause_state.expiry - now) * 1000 : 0;
+    kp_event_timer_arm(expiry_timer, (guint)MIN(delay_ms, (gint64)G_MAXUINT));
+}
+
 /**
  * Read pause state from file
  */
@@ -101,6 +146,34 @@ load_pause_file(void)
     }
 }
 
+/**
+ * Remember the file as it is now, so only changes by others are reloaded
+ */
+static void
+stamp_pause_file(void)
+{
+    pause_state.file_seen = stat(PAUSE_FILE, &pause_state.file_st) == 0;
+}
+
+/**
+ * Has preheat-ctl written or removed the file since we last read it?
+ */
+static gboolean
+pause_file_changed(void)
+{
+    struct stat st;
+    const struct stat *old = &pause_state.file_st;
+
+    if (stat(PAUSE_FILE, &st) < 0)
+        return pause_state.file_seen;
+
+    return !pause_state.file_seen ||
+           st.st_ino != old->st_ino ||
+           st.st_size != old->st_size ||
+           st.st_mtim.tv_sec != old->st_mtim.tv_sec ||
+           st.st_mtim.tv_nsec != old->st_mtim.tv_nsec;
+}
+
 /**
  * Write pause state to file
  */
@@ -117,7 +190,7 @@ save_pause_file(time_t expiry)
 
     fprintf(fp, "%ld\n", expiry);
     fclose(fp);
-
+    stamp_pause_file();
 }
 
 /**
@@ -129,6 +202,8 @@ kp_pause_init(void)
     g_debug("Initializing pause subsystem");
     pause_state.initialized = TRUE;
     load_pause_file();
+    stamp_pause_file();
+    arm_expiry();
 }
 
 /**
@@ -141,6 +216,14 @@ kp_pause_is_active(void)
 
     if (!pause_state.initialized) {
         kp_pause_init();
+    } else if (pause_file_changed()) {
+        gboolean was_active = pause_state.active;
+
+        load_pause_file();
+        stamp_pause_file();
+        arm_expiry();
+        if (was_active && !pause_state.active)
+            g_message("Pause file removed, resuming preloading");
     }
 
     if (!pause_state.active) {
@@ -212,6 +295,7 @@ kp_pause_set(int duration_sec)
     pause_state.active = TRUE;
     pause_state.expiry = expiry;
     save_pause_file(expiry);
+    arm_expiry();
 }
 
 /**
@@ -222,12 +306,14 @@ kp_pause_clear(void)
 {
     pause_state.active = FALSE;
     pause_state.expiry = -1;
+    arm_expiry();
 
     if (unlink(PAUSE_FILE) == 0) {
         g_message("Preloading resumed (pause cleared)");
     } else if (errno != ENOENT) {
         g_warning("Cannot remove pause file %s: %s", PAUSE_FILE, strerror(errno));
     }
+    stamp_pause_file();
 }
 
 /**
@@ -251,4 +337,5 @@ kp_pause_free(void)
     pause_state.active = FALSE;
     pause_state.expiry = -1;
     pause_state.initialized = FALSE;
+    arm_expiry();
 }
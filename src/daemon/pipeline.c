@@ -0,0 +1,439 @@
+/* pipeline.c - Worker threads for scanning and I/O
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Worker Pipeline
+ * =============================================================================
+ *
+ * A tick used to do everything on the main loop: walk /proc, update the
+ * model, predict, then block in readahead until the batch was issued, and
+ * every autosave blocked in write() and fsync(). While that ran, signals,
+ * control requests, inotify hints and session events waited.
+ *
+ * The pipeline moves the blocking parts onto two threads:
+ *
+ *   main loop                 scan thread             I/O thread
+ *   ─────────                 ───────────             ──────────
+ *   tick ── request ────────► read /proc
+ *        ◄─ snapshot ──────── (kp_proc_snapshot)
+ *   model update, predict
+ *        ── batch (copies) ─────────────────────────► kp_readahead_batch
+ *        ◄─ result ─────────────────────────────────┘
+ *   account stats, iocost
+ *   autosave: serialize ── buffer ──────────────────► write, fsync, rename
+ *
+ * The model itself stays single-owner: only the main loop reads or writes
+ * kp_state, so no module needs locking. The threads only ever see copies
+ * (a snapshot of /proc, copied maps, a serialized state buffer).
+ *
+ * Every link is a bounded kp_queue_t. A scan is only requested when the
+ * previous one has been applied; a readahead batch is dropped when the
+ * I/O thread still has IO_QUEUE_SIZE batches outstanding (the next tick
+ * predicts again with fresher data).
+ *
+ * Saves don't queue: the buffer goes into a single slot, replacing one the
+ * I/O thread hasn't picked up yet, since only the newest state matters.
+ * The thread is woken through io_jobs if there is room and checks the
+ * slot after every job, so the main loop never waits for a save.
+ *
+ * Without GLib 2.32 threads, or with "pipeline = false", everything runs
+ * on the main loop as before.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../utils/logging.h"
+#include "../utils/queue.h"
+#include "../config/config.h"
+#include "../readahead/readahead.h"
+#include "../state/state.h"
+#include "pipeline.h"
+#include "startup.h"
+
+#if KP_HAVE_THREADS
+
+#include <pthread.h>
+#include <signal.h>
+
+#define IO_QUEUE_SIZE 4     /* Jobs waiting for the I/O thread */
+
+/* Scan request, returned with the snapshot filled in */
+typedef struct _scan_job_t
+{
+    kp_pipeline_scan_func func;
+    gpointer data;
+    kp_proc_snapshot_t *snap;
+} scan_job_t;
+
+/* Readahead request, returned when done */
+typedef struct _io_job_t
+{
+    kp_map_t **orig;            /* Referenced maps of the model */
+    kp_map_t **copies;          /* Private copies, same order as orig */
+    int count;
+    kp_readahead_opts_t opts;
+    kp_readahead_result_t res;
+    int issued;
+} io_job_t;
+
+/* Pushed to make a thread exit */
+static char stop_marker;
+#define STOP_JOB ((gpointer)&stop_marker)
+
+/* Pushed to wake the I/O thread for the save slot */
+static char save_marker;
+#define SAVE_JOB ((gpointer)&save_marker)
+
+static struct
+{
+    gboolean running;
+    gboolean scan_pending;
+    int readahead_inflight;     /* Batches not yet back on the main loop */
+
+    GThread *scan_thread;
+    kp_queue_t *scan_requests;
+    kp_queue_t *scan_results;
+
+    GThread *io_thread;
+    kp_queue_t *io_jobs;
+    kp_queue_t *io_done;
+
+    GMutex save_lock;           /* Guards the save slot */
+    char *save_file;            /* Latest save not yet written, or NULL */
+    GString *save_content;
+} pipe_ = { 0 };
+
+/* ========================================================================
+ * WORKER THREADS
+ * ======================================================================== */
+
+static gpointer
+scan_thread(gpointer data)
+{
+    (void)data;
+
+    for (;;) {
+        scan_job_t *job = kp_queue_pop(pipe_.scan_requests);
+
+        if (job == STOP_JOB)
+            break;
+
+        job->snap = kp_proc_snapshot();
+        kp_queue_push(pipe_.scan_results, job);
+    }
+    return NULL;
+}
+
+/* Write the save in the slot, if any (I/O thread) */
+static void
+save_flush(void)
+{
+    char *statefile;
+    GString *content;
+
+    g_mutex_lock(&pipe_.save_lock);
+    statefile = pipe_.save_file;
+    content = pipe_.save_content;
+    pipe_.save_file = NULL;
+    pipe_.save_content = NULL;
+    g_mutex_unlock(&pipe_.save_lock);
+
+    if (!content)
+        return;
+
+    kp_state_write_file(statefile, content);
+    g_string_free(content, TRUE);
+    g_free(statefile);
+}
+
+static gpointer
+io_thread(gpointer data)
+{
+    (void)data;
+
+    for (;;) {
+        io_job_t *job = kp_queue_pop(pipe_.io_jobs);
+
+        /* Also covers a save whose wakeup found the queue full */
+        save_flush();
+
+        if (job == STOP_JOB)
+            break;
+        if (job == SAVE_JOB)
+            continue;
+
+        /* kp_readahead_batch() sorts the array it gets; keep copies[] in
+         * step with orig[] and sort a second array of the same pointers */
+        kp_map_t **work = g_new(kp_map_t *, job->count);
+        memcpy(work, job->copies, sizeof(kp_map_t *) * job->count);
+        job->issued = kp_readahead_batch(work, job->count, &job->opts, &job->res);
+        g_free(work);
+
+        kp_queue_push(pipe_.io_done, job);
+    }
+    return NULL;
+}
+
+/* ========================================================================
+ * MAIN LOOP SIDE
+ * ======================================================================== */
+
+static void
+scan_done(gpointer item, gpointer user_data)
+{
+    scan_job_t *job = item;
+
+    (void)user_data;
+
+    pipe_.scan_pending = FALSE;
+    job->func(job->snap, job->data);
+    kp_proc_snapshot_free(job->snap);
+    g_free(job);
+}
+
+static void
+readahead_job_free(io_job_t *job)
+{
+    for (int i = 0; i < job->count; i++) {
+        kp_map_free(job->copies[i]);
+        kp_map_unref(job->orig[i]);
+    }
+    g_free(job->copies);
+    g_free(job->orig);
+    g_free(job);
+}
+
+static void
+readahead_done(gpointer item, gpointer user_data)
+{
+    io_job_t *job = item;
+
+    (void)user_data;
+
+    pipe_.readahead_inflight--;
+
+    /* Keep the block numbers looked up on the thread */
+    for (int i = 0; i < job->count; i++)
+        job->orig[i]->block = job->copies[i]->block;
+
+    kp_readahead_result_apply(&job->res);
+    kp_startup_first_preload();
+    g_debug("readahead %d files (I/O thread)", job->issued);
+
+    readahead_job_free(job);
+}
+
+/* Copy of a map for the I/O thread; refcount 0 so kp_map_free() takes it */
+static kp_map_t *
+map_copy(const kp_map_t *map)
+{
+    kp_map_t *copy = g_slice_new(kp_map_t);
+
+    *copy = *map;
+    copy->path = g_strdup(map->path);
+    copy->refcount = 0;
+    return copy;
+}
+
+/**
+ * Start the scan and I/O threads
+ */
+void
+kp_pipeline_start(void)
+{
+    sigset_t all, old;
+
+    if (pipe_.running || !kp_conf->system.pipeline)
+        return;
+
+    pipe_.scan_requests = kp_queue_new(1);
+    pipe_.scan_results = kp_queue_new(1);
+    pipe_.io_jobs = kp_queue_new(IO_QUEUE_SIZE);
+    pipe_.io_done = kp_queue_new(IO_QUEUE_SIZE);
+    g_mutex_init(&pipe_.save_lock);
+
+    kp_queue_watch(pipe_.scan_results, scan_done, NULL);
+    kp_queue_watch(pipe_.io_done, readahead_done, NULL);
+
+    /* Signals belong to the main thread; threads inherit this mask */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    pipe_.scan_thread = g_thread_new("scan", scan_thread, NULL);
+    pipe_.io_thread = g_thread_new("io", io_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    pipe_.running = TRUE;
+    g_message("pipeline: scan and I/O threads started");
+}
+
+/**
+ * Stop and join the threads
+ */
+void
+kp_pipeline_stop(void)
+{
+    gpointer item;
+
+    if (!pipe_.running)
+        return;
+
+    pipe_.running = FALSE;
+
+    kp_queue_push(pipe_.scan_requests, STOP_JOB);
+    g_thread_join(pipe_.scan_thread);
+    kp_queue_push(pipe_.io_jobs, STOP_JOB);
+    g_thread_join(pipe_.io_thread);     /* Writes a pending save */
+
+    /* The main loop has exited: a snapshot nobody waits for is dropped,
+     * finished batches are still accounted */
+    while ((item = kp_queue_try_pop(pipe_.scan_results))) {
+        scan_job_t *job = item;
+        kp_proc_snapshot_free(job->snap);
+        g_free(job);
+    }
+    while ((item = kp_queue_try_pop(pipe_.io_done)))
+        readahead_done(item, NULL);
+
+    kp_queue_free(pipe_.scan_requests);
+    kp_queue_free(pipe_.scan_results);
+    kp_queue_free(pipe_.io_jobs);
+    kp_queue_free(pipe_.io_done);
+    g_mutex_clear(&pipe_.save_lock);
+    memset(&pipe_, 0, sizeof(pipe_));
+
+    g_debug("pipeline stopped");
+}
+
+gboolean
+kp_pipeline_running(void)
+{
+    return pipe_.running;
+}
+
+/**
+ * Take a /proc snapshot on the scan thread
+ */
+gboolean
+kp_pipeline_scan(kp_pipeline_scan_func func, gpointer data)
+{
+    scan_job_t *job;
+
+    if (!pipe_.running || pipe_.scan_pending)
+        return FALSE;
+
+    job = g_new0(scan_job_t, 1);
+    job->func = func;
+    job->data = data;
+
+    if (!kp_queue_try_push(pipe_.scan_requests, job)) {
+        g_free(job);
+        return FALSE;
+    }
+    pipe_.scan_pending = TRUE;
+    return TRUE;
+}
+
+/**
+ * Issue a readahead batch on the I/O thread
+ */
+gboolean
+kp_pipeline_readahead(kp_map_t **maps, int count)
+{
+    io_job_t *job;
+
+    if (!pipe_.running)
+        return FALSE;
+
+    /* Completions are never more than io_done holds, so the I/O thread
+     * cannot block on them while kp_pipeline_stop() joins it */
+    if (pipe_.readahead_inflight >= IO_QUEUE_SIZE) {
+        g_debug("I/O thread busy, dropping readahead of %d files", count);
+        return TRUE;
+    }
+
+    job = g_new0(io_job_t, 1);
+    job->count = count;
+    job->orig = g_new(kp_map_t *, count);
+    job->copies = g_new(kp_map_t *, count);
+    for (int i = 0; i < count; i++) {
+        kp_map_ref(maps[i]);
+        job->orig[i] = maps[i];
+        job->copies[i] = map_copy(maps[i]);
+    }
+    kp_readahead_opts_init(&job->opts, kp_state->cycle);
+
+    if (!kp_queue_try_push(pipe_.io_jobs, job)) {
+        g_debug("I/O thread busy, dropping readahead of %d files", count);
+        readahead_job_free(job);
+    } else {
+        pipe_.readahead_inflight++;
+    }
+    return TRUE;
+}
+
+/**
+ * Write serialized state on the I/O thread
+ */
+gboolean
+kp_pipeline_save(const char *statefile, GString *content)
+{
+    gboolean was_empty;
+
+    if (!pipe_.running)
+        return FALSE;
+
+    g_mutex_lock(&pipe_.save_lock);
+    was_empty = !pipe_.save_content;
+    if (!was_empty) {
+        g_debug("replacing a state save the I/O thread has not written yet");
+        g_string_free(pipe_.save_content, TRUE);
+        g_free(pipe_.save_file);
+    }
+    pipe_.save_file = g_strdup(statefile);
+    pipe_.save_content = content;
+    g_mutex_unlock(&pipe_.save_lock);
+
+    /* A full queue is fine: the thread checks the slot after every job */
+    if (was_empty)
+        kp_queue_try_push(pipe_.io_jobs, SAVE_JOB);
+    return TRUE;
+}
+
+#else /* !KP_HAVE_THREADS */
+
+void kp_pipeline_start(void) { }
+void kp_pipeline_stop(void) { }
+gboolean kp_pipeline_running(void) { return FALSE; }
+
+gboolean
+kp_pipeline_scan(kp_pipeline_scan_func func, gpointer data)
+{
+    (void)func;
+    (void)data;
+    return FALSE;
+}
+
+gboolean
+kp_pipeline_readahead(kp_map_t **maps, int count)
+{
+    (void)maps;
+    (void)count;
+    return FALSE;
+}
+
+gboolean
+kp_pipeline_save(const char *statefile, GString *content)
+{
+    (void)statefile;
+    (void)content;
+    return FALSE;
+}
+
+#endif /* KP_HAVE_THREADS */
@@ -0,0 +1,72 @@
+/* pipeline.h - Worker threads for scanning and I/O
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <glib.h>
+#include "../state/state.h"
+#include "../monitor/proc.h"
+
+/* Called on the main loop with a finished /proc snapshot */
+typedef void (*kp_pipeline_scan_func)(const kp_proc_snapshot_t *snap, gpointer data);
+
+/**
+ * Start the scan and I/O threads (if enabled and supported)
+ *
+ * Call from the main thread once the state is loaded.
+ */
+void kp_pipeline_start(void);
+
+/**
+ * Stop and join the threads
+ *
+ * A pending state save is written, readahead completions are accounted.
+ * Must run before the final kp_state_save() and kp_state_free().
+ */
+void kp_pipeline_stop(void);
+
+/**
+ * Whether work is being handed to the threads
+ */
+gboolean kp_pipeline_running(void);
+
+/**
+ * Take a /proc snapshot on the scan thread
+ *
+ * @param func  Called on the main loop when the snapshot is ready
+ * @return      FALSE if the pipeline is not running or a scan is still
+ *              in flight; the caller should scan synchronously
+ */
+gboolean kp_pipeline_scan(kp_pipeline_scan_func func, gpointer data);
+
+/**
+ * Issue a readahead batch on the I/O thread
+ *
+ * The maps are copied and referenced until the batch completes; results
+ * are accounted on the main loop. A batch is dropped if the I/O thread
+ * is still busy with earlier ones.
+ *
+ * @return  FALSE if the pipeline is not running; the caller should read
+ *          synchronously
+ */
+gboolean kp_pipeline_readahead(kp_map_t **maps, int count);
+
+/**
+ * Write serialized state on the I/O thread
+ *
+ * Never waits: a save the thread has not started yet is replaced.
+ *
+ * @param content  Taken over by the pipeline on success
+ * @return         FALSE if the pipeline is not running
+ */
+gboolean kp_pipeline_save(const char *statefile, GString *content);
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,187 @@
+/* power.c - Power-source-aware budgets for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Power Source Budgets
+ * =============================================================================
+ *
+ * On AC preloading can be aggressive; on battery every disk spin-up or
+ * NVMe power-state exit costs energy. This module tells the rest of the
+ * daemon which budget applies right now:
+ *
+ *   [model]/[system] keys  → AC budget
+ *   [battery] keys         → battery budget
+ *
+ * DETECTION:
+ *   <system.sysfsroot>/class/power_supply/<name>/ is scanned each cycle:
+ *   - Any "Mains" or "USB*" supply with online=1 means AC
+ *   - Otherwise a "Battery" with status=Discharging means battery
+ *   - No supplies at all (desktops, VMs) means AC
+ *   sysfs attributes don't support inotify, so polling once per cycle is
+ *   the cheapest reliable way to notice a switch.
+ *
+ * CONSUMERS:
+ *   - prophet.c: memory percentages and batch coalescing
+ *   - readahead.c: worker count
+ *   - state.c: adaptive cycle bounds
+ *   All read kp_power_budget() when they need a value, so a switch takes
+ *   effect from the next cycle on.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "power.h"
+#include "../config/config.h"
+
+#include <dirent.h>
+
+static kp_power_source_t current_source = KP_POWER_AC;
+static gboolean detected = FALSE;
+
+/**
+ * Read the first line of <dir>/<attr> into buf
+ *
+ * @return  TRUE if something was read
+ */
+static gboolean
+read_attr(const char *dir, const char *attr, char *buf, size_t size)
+{
+    char path[PATH_MAX];
+    FILE *f;
+    gboolean ok = FALSE;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, attr);
+    f = fopen(path, "r");
+    if (!f)
+        return FALSE;
+
+    if (fgets(buf, size, f)) {
+        g_strchomp(buf);
+        ok = TRUE;
+    }
+    fclose(f);
+    return ok;
+}
+
+/**
+ * Classify power supplies under the sysfs root
+ */
+static kp_power_source_t
+detect_source(void)
+{
+    const char *root = kp_conf->system.sysfsroot;
+    char dirpath[PATH_MAX];
+    char supply[PATH_MAX];
+    char type[32], value[32];
+    gboolean external = FALSE;
+    gboolean discharging = FALSE;
+    struct dirent *ent;
+    DIR *dir;
+
+    snprintf(dirpath, sizeof(dirpath), "%s/class/power_supply",
+             root && *root ? root : "/sys");
+
+    dir = opendir(dirpath);
+    if (!dir)
+        return KP_POWER_AC;
+
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.')
+            continue;
+
+        snprintf(supply, sizeof(supply), "%s/%s", dirpath, ent->d_name);
+        if (!read_attr(supply, "type", type, sizeof(type)))
+            continue;
+
+        if (!strcmp(type, "Mains") || g_str_has_prefix(type, "USB")) {
+            if (read_attr(supply, "online", value, sizeof(value)) && atoi(value) == 1)
+                external = TRUE;
+        } else if (!strcmp(type, "Battery")) {
+            /* Peripheral batteries (mice, headsets) don't power us */
+            if (read_attr(supply, "scope", value, sizeof(value)) &&
+                !strcmp(value, "Device"))
+                continue;
+            if (read_attr(supply, "status", value, sizeof(value)) &&
+                !strcmp(value, "Discharging"))
+                discharging = TRUE;
+        }
+    }
+    closedir(dir);
+
+    if (external)
+        return KP_POWER_AC;
+    return discharging ? KP_POWER_BATTERY : KP_POWER_AC;
+}
+
+/**
+ * Re-read the power source from sysfs
+ */
+kp_power_source_t
+kp_power_update(void)
+{
+    kp_power_source_t source = detect_source();
+
+    if (!detected || source != current_source) {
+        g_message("power source: %s%s", kp_power_source_name(source),
+                  source == KP_POWER_BATTERY && !kp_conf->battery.enabled
+                      ? " (battery budget disabled)" : "");
+        current_source = source;
+        detected = TRUE;
+    }
+
+    return current_source;
+}
+
+/**
+ * Power source seen by the last update
+ */
+kp_power_source_t
+kp_power_source(void)
+{
+    return current_source;
+}
+
+/**
+ * Name of a power source
+ */
+const char *
+kp_power_source_name(kp_power_source_t source)
+{
+    return source == KP_POWER_BATTERY ? "battery" : "ac";
+}
+
+/**
+ * Budget for the current power source
+ */
+const kp_power_budget_t *
+kp_power_budget(void)
+{
+    static kp_power_budget_t budget;
+
+    if (current_source == KP_POWER_BATTERY && kp_conf->battery.enabled) {
+        budget.memtotal  = kp_conf->battery.memtotal;
+        budget.memfree   = kp_conf->battery.memfree;
+        budget.memcached = kp_conf->battery.memcached;
+        budget.maxprocs  = kp_conf->battery.maxprocs;
+        budget.mincycle  = kp_conf->battery.mincycle;
+        budget.maxcycle  = kp_conf->battery.maxcycle;
+        budget.coalesce  = kp_conf->battery.coalesce;
+    } else {
+        budget.memtotal  = kp_conf->model.memtotal;
+        budget.memfree   = kp_conf->model.memfree;
+        budget.memcached = kp_conf->model.memcached;
+        budget.maxprocs  = kp_conf->system.maxprocs;
+        budget.mincycle  = kp_conf->model.mincycle;
+        budget.maxcycle  = kp_conf->model.maxcycle;
+        budget.coalesce  = 0;
+    }
+
+    return &budget;
+}
@@ -0,0 +1,64 @@
+/* power.h - Power-source-aware budgets for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <glib.h>
+
+/**
+ * Where the machine draws power from
+ */
+typedef enum {
+    KP_POWER_AC = 0,        /* Mains, USB charger, or no battery at all */
+    KP_POWER_BATTERY = 1    /* Running on battery */
+} kp_power_source_t;
+
+/**
+ * Budget in effect for the current power source
+ */
+typedef struct _kp_power_budget_t {
+    int memtotal;           /* Memory percentages (see [model]) */
+    int memfree;
+    int memcached;
+    int maxprocs;           /* Parallel readahead workers */
+    int mincycle;           /* Adaptive cycle bounds (seconds) */
+    int maxcycle;
+    int coalesce;           /* Minimum gap between readahead batches (seconds) */
+} kp_power_budget_t;
+
+/**
+ * Re-read the power source from sysfs
+ *
+ * Logs when the source switches. Cheap enough to call every cycle.
+ *
+ * @return  Current power source
+ */
+kp_power_source_t kp_power_update(void);
+
+/**
+ * Power source seen by the last kp_power_update()
+ */
+kp_power_source_t kp_power_source(void);
+
+/**
+ * Name of a power source ("ac" or "battery")
+ */
+const char *kp_power_source_name(kp_power_source_t source);
+
+/**
+ * Budget for the current power source
+ *
+ * Values come from [model]/[system] on AC and from [battery] on battery,
+ * read from kp_conf on every call so configuration reloads apply at once.
+ */
+const kp_power_budget_t *kp_power_budget(void);
+
+#endif /* POWER_H */
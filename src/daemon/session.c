@@ -15,24 +15,30 @@
  * the "boot window" (first 3 minutes after login).
  *
  * SESSION DETECTION:
- *   Monitors /run/user/$UID directory creation, which indicates:
- *   - User has logged in via display manager (GDM, SDDM, LightDM)
- *   - systemd-logind has created user session
+ *   An inotify watch on /run/user reports every /run/user/$UID directory
+ *   that systemd-logind creates at login, so the boot window opens within
+ *   milliseconds and the first preload runs right away instead of on the
+ *   next cycle. Every UID gets its own window; removing the directory
+ *   (last logout) ends it, so the next login opens a fresh one.
+ *
+ *   Without inotify, or before /run/user exists, kp_session_check() scans
+ *   the directory each cycle and keeps retrying the watch.
  *
  * BOOT WINDOW BEHAVIOR:
  *   ┌─────────────────────────────────────────────────────────────┐
- *   │ Time 0 (login)                                              │
- *   │   ↓ Session detected, window opens                          │
- *   │   ↓ kp_session_preload_top_apps(5) boosts top 5 apps        │
- *   │   ↓ Apps get lnprob = -15.0 (very high priority)            │
- *   │   ↓ Next prediction cycle immediately preloads them         │
+ *   │ Time 0 (login of UID u)                                     │
+ *   │   ↓ IN_CREATE on /run/user/u, window for u opens            │
+ *   │   ↓ Immediate prediction: u's top 5 apps get                │
+ *   │     lnprob = -15.0 (very high priority) and are read in     │
  *   │ Time 180s (3 min)                                           │
- *   │   ↓ Window closes, normal prediction resumes                │
+ *   │   ↓ Window for u closes, normal prediction resumes          │
  *   └─────────────────────────────────────────────────────────────┘
  *
  * TOP APP SELECTION:
  *   Apps are ranked by total running time (exe->time). Applications
  *   with more usage history are assumed to be more important to the user.
+ *   Only apps last launched by that UID (exe->uid) or by an unknown user
+ *   count, so each user gets their own set.
  *
  * MEMORY SAFETY:
  *   Aggressive preloading only runs if ≥20% memory is available,
@@ -44,10 +50,14 @@
 #include "common.h"
 #include "session.h"
 #include "../utils/logging.h"
-#include "../utils/lib_scanner.h"
 #include "../config/config.h"
 #include "../state/state.h"
+#include "../monitor/proc.h"
+#include "../state/state_closure.h"
 #include "../predict/prophet.h"
+#include "pause.h"
+#include "hints.h"
+#include "../utils/fswatch.h"
 
 #include <sys/stat.h>
 #include <dirent.h>
@@ -57,69 +67,24 @@
 #define SESSION_WINDOW_DEFAULT 180    /* 3 minutes */
 #define SESSION_MAX_APPS_DEFAULT 5
 #define SESSION_MEMORY_THRESHOLD 20   /* 20% minimum free */
+#define SESSION_BOOST_LNPROB -15.0    /* Very high priority */
 
-/**
- * Load a single file as a map for an exe
- */
-static gboolean
-load_single_map(kp_exe_t *exe, const char *path)
-{
-    struct stat st;
-    kp_map_t *map;
-    kp_exemap_t *exemap;
-    
-    if (stat(path, &st) < 0)
-        return FALSE;
-    
-    if ((size_t)st.st_size < (size_t)kp_conf->model.minsize)
-        return FALSE;
-    
-    map = kp_map_new(path, 0, st.st_size);
-    if (!map)
-        return FALSE;
-    
-    exemap = kp_exe_map_new(exe, map);
-    if (!exemap) {
-        kp_map_free(map);
-        return FALSE;
-    }
-    
-    exemap->prob = 1.0;
-    exe->size += st.st_size;
-    
-    return TRUE;
-}
 
 /**
  * Load memory maps for a session app including shared libraries
+ *
+ * The library set comes from the persistent closure cache, so after a
+ * restart the top apps are mapped without resolving dependencies again.
  */
 static gboolean
 load_maps_for_session_app(kp_exe_t *exe)
 {
-    char **libs;
-    int loaded = 0;
+    int loaded;
     
     if (!exe || !exe->path)
         return FALSE;
     
-    exe->size = 0;  /* Reset size counter */
-    
-    /* Load main binary */
-    if (load_single_map(exe, exe->path)) {
-        loaded++;
-        g_debug("Session: loaded binary %s", exe->path);
-    }
-    
-    /* Scan and load shared libraries */
-    libs = kp_scan_libraries(exe->path);
-    if (libs) {
-        for (int i = 0; libs[i]; i++) {
-            if (load_single_map(exe, libs[i])) {
-                loaded++;
-            }
-        }
-        kp_free_library_list(libs);
-    }
+    loaded = kp_closure_load_maps(exe);
     
     if (loaded > 0) {
         g_message("Session: loaded %d maps for %s (%.1f MB total)",
@@ -130,39 +95,48 @@ load_maps_for_session_app(kp_exe_t *exe)
     return FALSE;
 }
 
+/* Boot window of one logged-in user */
+typedef struct {
+    uid_t uid;
+    time_t session_start;       /* Creation time of /run/user/$UID */
+    time_t window_end;
+    gboolean preload_done;      /* Window over (or opened too late) */
+    gboolean announced;         /* First boost logged */
+} session_user_t;
+
 /* Global session state */
 static struct {
     gboolean initialized;
-    gboolean session_detected;
-    time_t session_start;
-    time_t window_end;
     int window_duration_sec;
     int max_apps;
-    uid_t target_uid;
-    gboolean preload_done;
+    GHashTable *users;          /* GUINT_TO_POINTER(uid) → session_user_t* */
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_t *watch;        /* NULL when not watching */
+#endif
+    gboolean opened;            /* inotify batch opened a window */
+    char *run_user_dir;         /* <runroot>/user */
 } session_state = {0};
 
 /**
- * Get the primary user UID (first non-root user with UID >= 1000)
+ * Parse a /run/user entry name as UID
+ *
+ * @return TRUE if name is all digits
  */
-static uid_t
-get_primary_user_uid(void)
+static gboolean
+parse_uid(const char *name, uid_t *uid)
 {
-    uid_t uid = getuid();
-
-    /* If running as root, try to find the primary user */
-    if (uid == 0) {
-        /* Check SUDO_UID first */
-        const char *sudo_uid = getenv("SUDO_UID");
-        if (sudo_uid) {
-            return (uid_t)atoi(sudo_uid);
-        }
+    char *end;
+    unsigned long value;
 
-        /* Default to UID 1000 (typical first user) */
-        return 1000;
-    }
+    if (!name || !g_ascii_isdigit(*name))
+        return FALSE;
 
-    return uid;
+    value = strtoul(name, &end, 10);
+    if (*end)
+        return FALSE;
+
+    *uid = (uid_t)value;
+    return TRUE;
 }
 
 /**
@@ -174,10 +148,10 @@ get_primary_user_uid(void)
 static time_t
 get_session_creation_time(uid_t uid)
 {
-    char path[256];
+    char path[PATH_MAX];
     struct stat st;
 
-    snprintf(path, sizeof(path), "/run/user/%d", uid);
+    snprintf(path, sizeof(path), "%s/%u", session_state.run_user_dir, (unsigned)uid);
 
     if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
         /* On Linux, st_ctime is metadata change time (close to creation).
@@ -190,38 +164,197 @@ get_session_creation_time(uid_t uid)
 }
 
 /**
- * Check if user session directory exists
- * Uses /run/user/$UID as session indicator
+ * Open the boot window for a user whose session directory exists
+ *
+ * @param uid      User
+ * @param created  Session start (directory creation time)
+ * @return         TRUE if the window is open (login was recent)
  */
 static gboolean
-check_user_session_exists(uid_t uid)
+session_open(uid_t uid, time_t created)
+{
+    session_user_t *user;
+    time_t now = time(NULL);
+    long age = (long)(now - created);
+
+    if (g_hash_table_lookup(session_state.users, GUINT_TO_POINTER(uid)))
+        return FALSE;
+
+    user = g_new0(session_user_t, 1);
+    user->uid = uid;
+    user->session_start = created;      /* Use REAL login time! */
+    user->window_end = created + session_state.window_duration_sec;
+    g_hash_table_insert(session_state.users, GUINT_TO_POINTER(uid), user);
+    kp_hints_watch_user(uid);
+
+    if (age >= session_state.window_duration_sec) {
+        /* Window already expired - user logged in too long ago */
+        g_message("Session for UID %u started %ld seconds ago, boot window expired",
+                  (unsigned)uid, age);
+        user->preload_done = TRUE;  /* Skip aggressive preload */
+        return FALSE;
+    }
+
+    g_message("Session detected for UID %u, boot window active (%ld sec remaining)",
+              (unsigned)uid, session_state.window_duration_sec - age);
+    return TRUE;
+}
+
+/**
+ * Forget a user whose session directory disappeared (logged out)
+ */
+static void
+session_close(uid_t uid)
 {
-    return get_session_creation_time(uid) > 0;
+    if (g_hash_table_remove(session_state.users, GUINT_TO_POINTER(uid))) {
+        g_debug("Session for UID %u ended", (unsigned)uid);
+        kp_hints_unwatch_user(uid);
+    }
 }
 
 /**
- * Check system memory availability
- * @return TRUE if enough memory available for aggressive preload
+ * Register every session directory under /run/user
+ *
+ * @return Number of users whose boot window just opened
+ */
+static int
+scan_sessions(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    int opened = 0;
+
+    dir = opendir(session_state.run_user_dir);
+    if (!dir)
+        return 0;
+
+    while ((ent = readdir(dir)) != NULL) {
+        uid_t uid;
+        time_t created;
+
+        if (!parse_uid(ent->d_name, &uid))
+            continue;
+        if (g_hash_table_lookup(session_state.users, GUINT_TO_POINTER(uid)))
+            continue;
+
+        created = get_session_creation_time(uid);
+        if (created > 0 && session_open(uid, created))
+            opened++;
+    }
+    closedir(dir);
+
+    return opened;
+}
+
+/**
+ * Run a prediction now so a new user's top apps are read in immediately
+ */
+static void
+session_preload_now(void)
+{
+    if (!kp_conf->system.dopredict || kp_pause_is_active() || !kp_state->exes)
+        return;
+
+    g_debug("Session preload: predicting immediately");
+    kp_prophet_predict(NULL);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/**
+ * inotify event: a session directory created or removed
  */
 static gboolean
-check_memory_available(void)
+session_inotify_event(const struct inotify_event *ev, gpointer data)
 {
-    FILE *f;
-    char line[256];
-    long mem_total = 0, mem_available = 0;
+    uid_t uid;
 
-    f = fopen("/proc/meminfo", "r");
-    if (!f) return FALSE;
+    (void)data;
 
-    while (fgets(line, sizeof(line), f)) {
-        if (sscanf(line, "MemTotal: %ld kB", &mem_total) == 1) continue;
-        if (sscanf(line, "MemAvailable: %ld kB", &mem_available) == 1) break;
+    /* /run/user itself went away: fall back to polling */
+    if (ev->mask & (IN_IGNORED | IN_DELETE_SELF))
+        return FALSE;
+
+    if (!ev->len || !(ev->mask & IN_ISDIR) || !parse_uid(ev->name, &uid))
+        return TRUE;
+
+    if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+        if (session_open(uid, time(NULL)))
+            session_state.opened = TRUE;
+    } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        session_close(uid);
     }
-    fclose(f);
+    return TRUE;
+}
 
-    if (mem_total == 0) return FALSE;
+/**
+ * End of an inotify batch, or the watch lost
+ */
+static void
+session_inotify_done(gboolean active, gpointer data)
+{
+    (void)data;
 
-    int percent_available = (int)((mem_available * 100) / mem_total);
+    if (!active) {
+        kp_fswatch_free(session_state.watch);
+        session_state.watch = NULL;
+    } else if (session_state.opened) {
+        session_preload_now();
+    }
+    session_state.opened = FALSE;
+}
+#endif
+
+/**
+ * Start watching /run/user for session directories
+ *
+ * @return TRUE if the watch is active
+ */
+static gboolean
+session_watch_start(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_t *watch;
+
+    if (session_state.watch)
+        return TRUE;
+
+    watch = kp_fswatch_new(session_inotify_event, session_inotify_done, NULL);
+    if (!watch) {
+        g_debug("inotify unavailable (%s), polling for sessions", strerror(errno));
+        return FALSE;
+    }
+
+    if (kp_fswatch_add(watch, session_state.run_user_dir,
+                       IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM |
+                       IN_DELETE_SELF | IN_ONLYDIR) < 0) {
+        g_debug("cannot watch %s (%s), polling for sessions",
+                session_state.run_user_dir, strerror(errno));
+        kp_fswatch_free(watch);
+        return FALSE;
+    }
+
+    session_state.watch = watch;
+
+    g_debug("watching %s for logins", session_state.run_user_dir);
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * Check system memory availability
+ * @return TRUE if enough memory available for aggressive preload
+ */
+static gboolean
+check_memory_available(void)
+{
+    kp_memory_t mem;
+
+    kp_proc_get_memstat(&mem);
+    if (mem.total == 0) return FALSE;
+
+    int percent_available = (int)(((long)mem.available * 100) / mem.total);
 
     if (percent_available < SESSION_MEMORY_THRESHOLD) {
         g_debug("Session preload: low memory (%d%% available), skipping", percent_available);
@@ -238,40 +371,30 @@ void
 kp_session_init(void)
 {
     session_state.initialized = TRUE;
-    session_state.session_detected = FALSE;
-    session_state.preload_done = FALSE;
     session_state.window_duration_sec = SESSION_WINDOW_DEFAULT;
     session_state.max_apps = SESSION_MAX_APPS_DEFAULT;
-    session_state.target_uid = get_primary_user_uid();
-
-    /* Check if session already exists (daemon started after login) */
-    time_t session_created = get_session_creation_time(session_state.target_uid);
-    if (session_created > 0) {
-        time_t now = time(NULL);
-        time_t session_age = now - session_created;
-        
-        session_state.session_detected = TRUE;
-        session_state.session_start = session_created;  /* Use REAL login time! */
-        session_state.window_end = session_created + session_state.window_duration_sec;
-        
-        if (session_age >= session_state.window_duration_sec) {
-            /* Window already expired - user logged in too long ago */
-            g_message("Session for UID %d started %ld seconds ago, boot window expired",
-                      session_state.target_uid, (long)session_age);
-            session_state.preload_done = TRUE;  /* Skip aggressive preload */
-        } else {
-            /* Still within window */
-            int remaining = session_state.window_duration_sec - (int)session_age;
-            g_message("Session for UID %d started %ld sec ago, boot window active (%d sec remaining)",
-                      session_state.target_uid, (long)session_age, remaining);
-        }
+    if (!session_state.run_user_dir) {
+        const char *root = kp_conf->system.runroot;
+        session_state.run_user_dir = g_build_filename(root && *root ? root : "/run",
+                                                      "user", NULL);
     }
+    if (!session_state.users)
+        session_state.users = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                    NULL, g_free);
+
+    /* Watch first so no login slips between the scan and the watch,
+     * then pick up sessions that already exist (daemon started after login) */
+    session_watch_start();
+    scan_sessions();
 
-    g_debug("Session detection initialized for UID %d", session_state.target_uid);
+    g_debug("Session detection initialized (%u sessions)",
+            g_hash_table_size(session_state.users));
 }
 
 /**
  * Check for user session start
+ *
+ * Only needed when the inotify watch is not active; retries it.
  */
 gboolean
 kp_session_check(void)
@@ -280,25 +403,33 @@ kp_session_check(void)
         kp_session_init();
     }
 
-    /* Already detected */
-    if (session_state.session_detected) {
+#ifdef HAVE_SYS_INOTIFY_H
+    if (session_state.watch)
         return FALSE;
-    }
+#endif
 
-    /* Check if session directory appeared */
-    time_t session_created = get_session_creation_time(session_state.target_uid);
-    if (session_created > 0) {
-        session_state.session_detected = TRUE;
-        session_state.session_start = session_created;  /* Use REAL creation time */
-        session_state.window_end = session_created + session_state.window_duration_sec;
+    /* Polling fallback: retry the watch (e.g. /run/user created late) */
+    session_watch_start();
+    return scan_sessions() > 0;
+}
 
-        g_message("Session detected for UID %d, starting %d second boot window",
-                  session_state.target_uid, session_state.window_duration_sec);
+/**
+ * Remaining window of one user, closing it when expired
+ */
+static int
+user_window_remaining(session_user_t *user, time_t now)
+{
+    if (user->preload_done)
+        return 0;
 
-        return TRUE;
+    if (now >= user->window_end) {
+        g_message("Session boot window for UID %u ended after %d seconds",
+                  (unsigned)user->uid, session_state.window_duration_sec);
+        user->preload_done = TRUE;
+        return 0;
     }
 
-    return FALSE;
+    return (int)(user->window_end - now);
 }
 
 /**
@@ -307,47 +438,28 @@ kp_session_check(void)
 gboolean
 kp_session_in_boot_window(void)
 {
-    time_t now;
-
-    if (!session_state.session_detected) {
-        return FALSE;
-    }
-
-    if (session_state.preload_done) {
-        return FALSE;
-    }
-
-    now = time(NULL);
-
-    if (now >= session_state.window_end) {
-        g_message("Session boot window ended after %d seconds",
-                  session_state.window_duration_sec);
-        session_state.preload_done = TRUE;
-        return FALSE;
-    }
-
-    return TRUE;
+    return kp_session_window_remaining() > 0;
 }
 
 /**
- * Get remaining seconds in boot window
+ * Get remaining seconds in boot window (longest of all users)
  */
 int
 kp_session_window_remaining(void)
 {
-    time_t now;
+    GHashTableIter iter;
+    gpointer value;
+    time_t now = time(NULL);
+    int remaining = 0;
 
-    if (!session_state.session_detected || session_state.preload_done) {
+    if (!session_state.users)
         return 0;
-    }
 
-    now = time(NULL);
+    g_hash_table_iter_init(&iter, session_state.users);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        remaining = MAX(remaining, user_window_remaining(value, now));
 
-    if (now >= session_state.window_end) {
-        return 0;
-    }
-
-    return (int)(session_state.window_end - now);
+    return remaining;
 }
 
 /**
@@ -366,10 +478,13 @@ exe_usage_compare(gconstpointer a, gconstpointer b)
 }
 
 /**
- * Get top N most-used applications
+ * Get top N most-used applications of a user
+ *
+ * Apps whose launching user is unknown (never seen running since the
+ * state was created) count for everyone.
  */
 static GPtrArray *
-get_top_apps(int max_apps)
+get_top_apps(uid_t uid, int max_apps)
 {
     GPtrArray *apps;
     GHashTableIter iter;
@@ -387,6 +502,12 @@ get_top_apps(int max_apps)
     while (g_hash_table_iter_next(&iter, &key, &value)) {
         kp_exe_t *exe = (kp_exe_t *)value;
 
+        /* Never boost blacklisted apps */
+        if (exe->blacklisted) continue;
+
+        /* Skip other users' apps */
+        if (exe->uid != KP_UID_UNKNOWN && exe->uid != uid) continue;
+
         /* Skip if currently running */
         if (exe_is_running(exe)) continue;
 
@@ -408,47 +529,82 @@ get_top_apps(int max_apps)
 }
 
 /**
- * Trigger aggressive preload of top N apps
+ * Boost the top apps of one user
+ *
+ * @return Number of apps boosted
+ */
+static int
+boost_user_apps(session_user_t *user, int max_apps, int *maps_loaded)
+{
+    GPtrArray *top_apps = get_top_apps(user->uid, max_apps);
+    int boosted = 0;
+
+    for (guint i = 0; i < top_apps->len; i++) {
+        kp_exe_t *exe = g_ptr_array_index(top_apps, i);
+
+        /* Load maps if size is too small (maps may be stale/empty from state file) */
+        if (exe->size < (size_t)kp_conf->model.minsize) {
+            if (load_maps_for_session_app(exe)) {
+                (*maps_loaded)++;
+            }
+        }
+
+        /* Give strong negative lnprob to trigger immediate preload,
+         * and expect the app within the next cycle */
+        exe->lnprob = MIN(exe->lnprob, SESSION_BOOST_LNPROB);
+        exe->launch_rate += 1.0 / MAX(1, kp_state->cycle);
+        boosted++;
+
+        g_debug("Session preload: boosting %s for UID %u (usage: %d sec, maps: %u)",
+                exe->path, (unsigned)user->uid, exe->time, g_set_size(exe->exemaps));
+    }
+
+    g_ptr_array_free(top_apps, TRUE);
+    return boosted;
+}
+
+/**
+ * Boost the top N apps of every user in a boot window
  */
 void
 kp_session_preload_top_apps(int max_apps)
 {
-    GPtrArray *top_apps;
+    GHashTableIter iter;
+    gpointer value;
+    time_t now = time(NULL);
     int preloaded = 0;
     int maps_loaded = 0;
+    gboolean announce = FALSE;
+
+    if (!session_state.users || !kp_session_in_boot_window())
+        return;
 
     if (!check_memory_available()) {
         g_debug("Session preload: skipping due to memory constraints");
         return;
     }
 
-    top_apps = get_top_apps(max_apps);
+    g_hash_table_iter_init(&iter, session_state.users);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        session_user_t *user = value;
 
-    g_message("Session preload: boosting top %d applications", top_apps->len);
+        if (!user_window_remaining(user, now))
+            continue;
 
-    for (guint i = 0; i < top_apps->len; i++) {
-        kp_exe_t *exe = g_ptr_array_index(top_apps, i);
+        preloaded += boost_user_apps(user, max_apps, &maps_loaded);
 
-        /* Load maps if size is too small (maps may be stale/empty from state file) */
-        if (exe->size < (size_t)kp_conf->model.minsize) {
-            if (load_maps_for_session_app(exe)) {
-                maps_loaded++;
-            }
+        if (!user->announced) {
+            user->announced = TRUE;
+            announce = TRUE;
         }
-
-        /* Give strong negative lnprob to trigger immediate preload */
-        exe->lnprob = -15.0;  /* Very high priority */
-        preloaded++;
-
-        g_debug("Session preload: boosting %s (usage: %d sec, maps: %u)",
-                exe->path, exe->time, g_set_size(exe->exemaps));
     }
 
-    g_ptr_array_free(top_apps, TRUE);
-
     if (preloaded > 0) {
-        g_message("Session preload: %d apps boosted (%d maps loaded)", 
-                  preloaded, maps_loaded);
+        if (announce)
+            g_message("Session preload: %d apps boosted (%d maps loaded)",
+                      preloaded, maps_loaded);
+        else
+            g_debug("Session preload: %d apps boosted", preloaded);
     }
 }
 
@@ -458,7 +614,15 @@ kp_session_preload_top_apps(int max_apps)
 void
 kp_session_free(void)
 {
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_free(session_state.watch);
+    session_state.watch = NULL;
+#endif
+    if (session_state.users)
+        g_hash_table_destroy(session_state.users);
+
+    session_state.users = NULL;
+    g_free(session_state.run_user_dir);
+    session_state.run_user_dir = NULL;
     session_state.initialized = FALSE;
-    session_state.session_detected = FALSE;
-    session_state.preload_done = FALSE;
 }
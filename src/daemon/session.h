@@ -21,13 +21,14 @@ void kp_session_init(void);
 
 /**
  * Check for user session start
- * Call this periodically to detect login events
- * @return TRUE if session just started, FALSE otherwise
+ * Call this periodically; only polls /run/user while the inotify watch
+ * is unavailable, otherwise logins are handled as they happen
+ * @return TRUE if a session just started, FALSE otherwise
  */
 gboolean kp_session_check(void);
 
 /**
- * Check if currently in boot/login window
+ * Check if any user is in their boot/login window
  * @return TRUE if aggressive preloading should occur
  */
 gboolean kp_session_in_boot_window(void);
@@ -39,8 +40,10 @@ gboolean kp_session_in_boot_window(void);
 int kp_session_window_remaining(void);
 
 /**
- * Trigger aggressive preload of top N apps
- * @param max_apps Maximum apps to preload
+ * Boost the top N apps of every user in a boot window
+ * Called by the prophet after probabilities are reset, so the boost
+ * feeds directly into the current prediction
+ * @param max_apps Maximum apps to boost per user
  */
 void kp_session_preload_top_apps(int max_apps);
 
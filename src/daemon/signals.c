@@ -24,10 +24,13 @@
  * SIGQUIT     │ Graceful shutdown (Ctrl+\)
  * SIGPIPE     │ Ignored (broken pipe from child processes)
  *
- * TWO-PHASE HANDLING:
- *   Signals are caught asynchronously by sig_handler(), which schedules
- *   sig_handler_sync() to run in the main loop context. This avoids
- *   race conditions when accessing shared state (config, state, etc.).
+ * DELIVERY:
+ *   The control signals are blocked and read from a signalfd by the event
+ *   core (events.c); sig_dispatch() runs sig_handler_sync() right away, in
+ *   the main loop iteration the signal arrived in. Where signalfd is not
+ *   available, sig_handler() catches them asynchronously and schedules
+ *   sig_handler_sync() instead. Either way the actions only touch shared
+ *   state (config, state, etc.) from the main loop.
  *
  * USAGE:
  *   systemctl reload preheat  → send SIGHUP
@@ -42,7 +45,10 @@
 #include "../utils/logging.h"
 #include "../config/config.h"
 #include "../config/blacklist.h"
+#include "../utils/desktop.h"
 #include "stats.h"
+#include "events.h"
+#include "trace.h"
 
 #include <signal.h>
 
@@ -82,8 +88,11 @@ sig_handler_sync(gpointer data)
         pending_sighup = 0;
         g_message("SIGHUP received - reloading configuration");
         kp_config_load(conffile, FALSE);
+        kp_trace_open();
         kp_blacklist_reload();
+        kp_desktop_refresh();
         kp_state_register_manual_apps();
+        kp_stats_reclassify_all();  /* Pool cache was invalidated by the reload */
         kp_log_reopen(logfile);
     }
 
@@ -121,8 +130,30 @@ sig_handler_sync(gpointer data)
     return FALSE;  /* Don't repeat */
 }
 
+/* Record a signal in its pending flag */
+static void
+set_pending(int sig)
+{
+    switch (sig) {
+        case SIGHUP:  pending_sighup = 1; break;
+        case SIGUSR1: pending_sigusr1 = 1; break;
+        case SIGUSR2: pending_sigusr2 = 1; break;
+        default:      pending_exit = sig; break;
+    }
+}
+
+/**
+ * Signal read from the signalfd (main loop context)
+ */
+static void
+sig_dispatch(int sig)
+{
+    set_pending(sig);
+    sig_handler_sync(NULL);
+}
+
 /**
- * Asynchronous signal handler
+ * Asynchronous signal handler (no signalfd)
  * 
  * B002 FIX: Sets atomic flag instead of queuing multiple handlers
  */
@@ -130,12 +161,7 @@ static RETSIGTYPE
 sig_handler(int sig)
 {
     /* Set atomic flag - prevents multiple queued handlers */
-    switch (sig) {
-        case SIGHUP:  pending_sighup = 1; break;
-        case SIGUSR1: pending_sigusr1 = 1; break;
-        case SIGUSR2: pending_sigusr2 = 1; break;
-        default:      pending_exit = sig; break;
-    }
+    set_pending(sig);
     g_timeout_add(0, sig_handler_sync, NULL);
 }
 
@@ -145,25 +171,38 @@ sig_handler(int sig)
  * BUG FIXES:
  *   B001: Added SIGCHLD with SA_NOCLDWAIT to auto-reap zombie children
  *   B003: Migrated from deprecated signal() to sigaction()
+ *
+ * Must run before any thread is created, so every thread inherits the
+ * blocked mask and the signals can only be read from the signalfd.
  */
 void
 kp_signals_init(void)
 {
     struct sigaction sa;
-    
-    /* Set up common handler for most signals */
+    sigset_t control;
+
+    sigemptyset(&control);
+    sigaddset(&control, SIGINT);    /* Ctrl+C */
+    sigaddset(&control, SIGQUIT);   /* Ctrl+\ */
+    sigaddset(&control, SIGTERM);   /* systemctl stop */
+    sigaddset(&control, SIGHUP);    /* systemctl reload */
+    sigaddset(&control, SIGUSR1);   /* dump state */
+    sigaddset(&control, SIGUSR2);   /* save state */
+
     memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = sig_handler;
-    sa.sa_flags = SA_RESTART;  /* Restart interrupted syscalls */
     sigemptyset(&sa.sa_mask);
-    
-    /* Trap key signals */
-    sigaction(SIGINT,  &sa, NULL);   /* Ctrl+C */
-    sigaction(SIGQUIT, &sa, NULL);   /* Ctrl+\ */
-    sigaction(SIGTERM, &sa, NULL);   /* systemctl stop */
-    sigaction(SIGHUP,  &sa, NULL);   /* systemctl reload */
-    sigaction(SIGUSR1, &sa, NULL);   /* dump state */
-    sigaction(SIGUSR2, &sa, NULL);   /* save state */
+
+    if (kp_event_watch_signals(&control, sig_dispatch)) {
+        g_debug("Control signals read from signalfd");
+    } else {
+        /* Set up common handler for most signals */
+        sa.sa_handler = sig_handler;
+        sa.sa_flags = SA_RESTART;  /* Restart interrupted syscalls */
+
+        for (int sig = 1; sig < NSIG; sig++)
+            if (sigismember(&control, sig) == 1)
+                sigaction(sig, &sa, NULL);
+    }
     
     /* Ignore SIGPIPE (broken pipe from child processes) */
     sa.sa_handler = SIG_IGN;
@@ -0,0 +1,55 @@
+/* startup.h - Startup critical-path profiler for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <glib.h>
+#include <stdio.h>
+
+/**
+ * Mark the start of the daemon (time zero of all phases)
+ */
+void kp_startup_begin(void);
+
+/**
+ * Current monotonic time in microseconds, for phase boundaries
+ */
+gint64 kp_startup_now(void);
+
+/**
+ * Record one startup phase
+ *
+ * Main thread only; phases run on a worker thread are recorded after
+ * it is joined.
+ *
+ * @param name        Static phase name
+ * @param start_us    kp_startup_now() when the phase began
+ * @param end_us      kp_startup_now() when it ended
+ * @param concurrent  Overlapped with other phases
+ */
+void kp_startup_phase(const char *name, gint64 start_us, gint64 end_us, gboolean concurrent);
+
+/**
+ * Initialization finished: log the phase breakdown
+ */
+void kp_startup_ready(void);
+
+/**
+ * First readahead batch issued: log time-to-first-preload (once)
+ */
+void kp_startup_first_preload(void);
+
+/**
+ * Write startup timing to the stats file
+ */
+void kp_startup_dump(FILE *f);
+
+#endif /* STARTUP_H */
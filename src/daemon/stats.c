@@ -44,21 +44,48 @@
 
 #include "common.h"
 #include "stats.h"
+#include "power.h"
+#include "hints.h"
+#include "startup.h"
+#include "events.h"
+#include "trace.h"
 #include "../utils/logging.h"
 #include "../state/state.h"
 #include "../config/config.h"
 #include "../utils/pattern.h"
 #include "../utils/desktop.h"
+#include "../readahead/iocost.h"
 
 #include <libgen.h>
 
 /* Stats file location for CLI access */
 #define STATS_FILE "/run/preheat.stats"
 
+/* Why an app landed in its pool */
+typedef enum {
+    REASON_MANUAL = 0,      /* Manual apps list */
+    REASON_DESKTOP,         /* Has a .desktop file */
+    REASON_EXCLUDED,        /* Matches excluded_patterns */
+    REASON_USER_DIR,        /* In a user app directory */
+    REASON_DEFAULT          /* No rule matched */
+} pool_reason_t;
+
+/* Memoized classification of one exe path */
+typedef struct {
+    pool_type_t pool;
+    pool_reason_t reason;
+    char *desktop_name;     /* App name for REASON_DESKTOP, else NULL */
+} pool_class_t;
+
+/* Entries beyond this are dropped wholesale (paths come from exes) */
+#define POOL_CACHE_MAX 8192
+
 /* Pool classification info for an app */
 typedef struct {
     pool_type_t pool;
-    char *reason;  /* Why in this pool (for debugging) */
+    const pool_class_t *cls;    /* Classification reason was built from */
+    guint generation;           /* ...and the cache generation it was in */
+    char reason[96];            /* Why in this pool (for debugging) */
 } app_pool_info_t;
 
 /* Global statistics state */
@@ -72,6 +99,11 @@ static struct {
     unsigned long misses;
     unsigned long memory_pressure_events;
 
+    /* Readahead phase timing (microseconds) */
+    unsigned long readahead_batches;
+    gint64 meta_us_total, sort_us_total, data_us_total;
+    gint64 meta_us_last, sort_us_last, data_us_last;
+
     /* Per-app tracking (simple hash) */
     GHashTable *app_launches;   /* app_name -> launch_count */
     GHashTable *preload_times;  /* app_name -> preload_timestamp (time_t) */
@@ -79,8 +111,28 @@ static struct {
     
     /* Hit/miss sliding window (seconds) - default 1 hour */
     int hitstats_window;
+
+    /* Pool classification cache: exe path → pool_class_t*. Valid while
+     * the configuration and desktop index generations are unchanged. */
+    GHashTable *pool_cache;
+    guint pool_cache_conf_gen;
+    guint pool_cache_desktop_gen;
+    guint pool_cache_generation;    /* Bumped on every flush */
 } stats = {0};
 
+/* preload_times is the one table written from two threads: the hot set
+ * readahead and the startup state loader run at the same time */
+G_LOCK_DEFINE_STATIC(preload_times);
+
+static void
+pool_class_free(gpointer data)
+{
+    pool_class_t *cls = data;
+
+    g_free(cls->desktop_name);
+    g_free(cls);
+}
+
 /**
  * Initialize statistics subsystem
  */
@@ -104,12 +156,15 @@ kp_stats_init(void)
     stats.preload_times = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     stats.app_pools = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, 
                                              (GDestroyNotify)g_free);
+    stats.pool_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              pool_class_free);
 
     g_debug("Statistics subsystem initialized");
 }
 
-/* Forward declaration */
-static pool_type_t classify_app_pool(const char *app_path, char **reason_out);
+/* Forward declarations */
+static const pool_class_t *lookup_app_pool(const char *app_path);
+static void format_pool_reason(const pool_class_t *cls, char *buf, size_t size);
 
 /**
  * Reclassify callback for g_hash_table_foreach
@@ -118,27 +173,27 @@ static void
 reclassify_one_exe(gpointer key, gpointer value, gpointer user_data)
 {
     kp_exe_t *exe = (kp_exe_t *)value;
-    char *reason = NULL;
     pool_type_t old_pool = exe->pool;
-    pool_type_t new_pool;
+    const pool_class_t *cls;
     
     (void)key;      /* Unused */
     (void)user_data; /* Unused */
     
     /* Reclassify using current logic */
-    new_pool = classify_app_pool(exe->path, &reason);
+    cls = lookup_app_pool(exe->path);
     
     /* Update if changed */
-    if (new_pool != old_pool) {
-        exe->pool = new_pool;
+    if (cls->pool != old_pool) {
+        char reason[96];
+
+        format_pool_reason(cls, reason, sizeof(reason));
+        exe->pool = cls->pool;
         g_message("Reclassified %s: %s → %s (reason: %s)",
                   exe->path,
                   old_pool == POOL_PRIORITY ? "priority" : "observation",
-                  new_pool == POOL_PRIORITY ? "priority" : "observation",
-                  reason ? reason : "unknown");
+                  cls->pool == POOL_PRIORITY ? "priority" : "observation",
+                  reason);
     }
-    
-    g_free(reason);
 }
 
 /**
@@ -161,6 +216,28 @@ kp_stats_reclassify_all(void)
     g_message("Reclassification complete");
 }
 
+/**
+ * Desktop index listener
+ */
+void
+kp_stats_desktop_changed(const char *exe_path)
+{
+    extern kp_state_t kp_state[1];
+    kp_exe_t *exe;
+
+    if (!exe_path) {
+        kp_stats_reclassify_all();
+        return;
+    }
+
+    if (!kp_state->exes)
+        return;
+
+    exe = g_hash_table_lookup(kp_state->exes, exe_path);
+    if (exe)
+        reclassify_one_exe(NULL, exe, NULL);
+}
+
 /**
  * Extract basename from path
  * 
@@ -217,7 +294,7 @@ is_manual_app(const char *app_path)
  * 5. Default → POOL_OBSERVATION
  */
 static pool_type_t
-classify_app_pool(const char *app_path, char **reason_out)
+classify_app_pool(const char *app_path, pool_reason_t *reason_out, char **desktop_name_out)
 {
     extern kp_conf_t kp_conf[1];
     char *plain_path = NULL;
@@ -225,6 +302,8 @@ classify_app_pool(const char *app_path, char **reason_out)
     const char *check_path = app_path;
     pool_type_t result;
     char resolved[PATH_MAX];
+
+    *desktop_name_out = NULL;
     
     /* Convert file:// URI to plain path if needed */
     if (app_path && g_str_has_prefix(app_path, "file://")) {
@@ -242,28 +321,23 @@ classify_app_pool(const char *app_path, char **reason_out)
     
     /* Priority 1: Manual apps list (highest priority) */
     if (is_manual_app(check_path)) {
-        if (reason_out) *reason_out = g_strdup("manual list");
+        *reason_out = REASON_MANUAL;
         result = POOL_PRIORITY;
         goto cleanup;
     }
     
     /* Priority 2: Has .desktop file */
     if (kp_desktop_has_file(check_path)) {
-        const char *app_name = kp_desktop_get_name(check_path);
-        if (reason_out) {
-            *reason_out = g_strdup_printf(".desktop (%s)", 
-                                           app_name ? app_name : "unknown");
-        }
+        *reason_out = REASON_DESKTOP;
+        *desktop_name_out = g_strdup(kp_desktop_get_name(check_path));
         result = POOL_PRIORITY;
         goto cleanup;
     }
 
     
     /* Priority 3: Excluded pattern check */
-    if (kp_pattern_matches_any(check_path,
-                                kp_conf->system.excluded_patterns_list,
-                                kp_conf->system.excluded_patterns_count)) {
-        if (reason_out) *reason_out = g_strdup("excluded pattern");
+    if (kp_glob_set_match(kp_conf->system.excluded_patterns_set, check_path)) {
+        *reason_out = REASON_EXCLUDED;
         result = POOL_OBSERVATION;
         goto cleanup;
     }
@@ -272,13 +346,13 @@ classify_app_pool(const char *app_path, char **reason_out)
     if (kp_path_in_directories(check_path,
                                  kp_conf->system.user_app_paths_list,
                                  kp_conf->system.user_app_paths_count)) {
-        if (reason_out) *reason_out = g_strdup("user app directory");
+        *reason_out = REASON_USER_DIR;
         result = POOL_PRIORITY;
         goto cleanup;
     }
     
     /* Default: Observation pool */
-    if (reason_out) *reason_out = g_strdup("default (no match)");
+    *reason_out = REASON_DEFAULT;
     result = POOL_OBSERVATION;
     
 cleanup:
@@ -287,6 +361,114 @@ cleanup:
     return result;
 }
 
+/**
+ * Drop all memoized classifications
+ */
+static void
+pool_cache_flush(void)
+{
+    g_hash_table_remove_all(stats.pool_cache);
+    stats.pool_cache_conf_gen = kp_config_generation();
+    stats.pool_cache_desktop_gen = kp_desktop_generation();
+    stats.pool_cache_generation++;
+}
+
+/**
+ * Classify an app, memoized
+ *
+ * classify_app_pool() costs a URI decode, realpath() and a walk over
+ * every rule. Its inputs only change when the configuration is reloaded
+ * or the desktop index changes, so results are cached per path and the
+ * whole cache is dropped when either generation moves. Steady state is
+ * one hash lookup.
+ *
+ * @return Classification owned by the cache (valid until the next flush)
+ */
+static const pool_class_t *
+lookup_app_pool(const char *app_path)
+{
+    pool_class_t *cls;
+
+    if (stats.pool_cache_conf_gen != kp_config_generation() ||
+        stats.pool_cache_desktop_gen != kp_desktop_generation() ||
+        g_hash_table_size(stats.pool_cache) >= POOL_CACHE_MAX)
+        pool_cache_flush();
+
+    cls = g_hash_table_lookup(stats.pool_cache, app_path);
+    if (cls)
+        return cls;
+
+    cls = g_new0(pool_class_t, 1);
+    cls->pool = classify_app_pool(app_path, &cls->reason, &cls->desktop_name);
+    g_hash_table_insert(stats.pool_cache, g_strdup(app_path), cls);
+
+    return cls;
+}
+
+/**
+ * Pool an application belongs to
+ */
+pool_type_t
+kp_stats_classify(const char *app_path)
+{
+    g_return_val_if_fail(app_path, POOL_OBSERVATION);
+
+    return lookup_app_pool(app_path)->pool;
+}
+
+/**
+ * Human-readable reason of a classification
+ */
+static void
+format_pool_reason(const pool_class_t *cls, char *buf, size_t size)
+{
+    switch (cls->reason) {
+    case REASON_MANUAL:
+        g_strlcpy(buf, "manual list", size);
+        break;
+    case REASON_DESKTOP:
+        g_snprintf(buf, size, ".desktop (%s)",
+                   cls->desktop_name ? cls->desktop_name : "unknown");
+        break;
+    case REASON_EXCLUDED:
+        g_strlcpy(buf, "excluded pattern", size);
+        break;
+    case REASON_USER_DIR:
+        g_strlcpy(buf, "user app directory", size);
+        break;
+    default:
+        g_strlcpy(buf, "default (no match)", size);
+        break;
+    }
+}
+
+/**
+ * Remember the pool of an app for the top-apps summary
+ *
+ * Updates the existing entry in place; the reason text is only rebuilt
+ * when the classification changed.
+ */
+static const app_pool_info_t *
+track_app_pool(const char *name, const char *app_path)
+{
+    const pool_class_t *cls = lookup_app_pool(app_path);
+    app_pool_info_t *pool_info = g_hash_table_lookup(stats.app_pools, name);
+
+    if (!pool_info) {
+        pool_info = g_new0(app_pool_info_t, 1);
+        g_hash_table_insert(stats.app_pools, g_strdup(name), pool_info);
+    }
+
+    if (pool_info->cls != cls || pool_info->generation != stats.pool_cache_generation) {
+        pool_info->pool = cls->pool;
+        pool_info->cls = cls;
+        pool_info->generation = stats.pool_cache_generation;
+        format_pool_reason(cls, pool_info->reason, sizeof(pool_info->reason));
+    }
+
+    return pool_info;
+}
+
 /**
  * Record a preload event
  */
@@ -302,7 +484,9 @@ kp_stats_record_preload(const char *app_path)
 
     /* Record preload timestamp for sliding window hit detection */
     time_t now = time(NULL);
+    G_LOCK(preload_times);
     g_hash_table_replace(stats.preload_times, g_strdup(name), GSIZE_TO_POINTER((gsize)now));
+    G_UNLOCK(preload_times);
     
     g_debug("Stats: Preloaded %s at time %ld", name, (long)now);
 }
@@ -315,31 +499,25 @@ kp_stats_record_hit(const char *app_path)
 {
     const char *name;
     gpointer count;
-    pool_type_t pool;
-    char *reason = NULL;
-    app_pool_info_t *pool_info;
+    const app_pool_info_t *pool_info;
 
     if (!stats.initialized) return;
 
     name = get_app_name(app_path);
-    pool = classify_app_pool(app_path, &reason);
     stats.hits++;
 
     /* Track pool classification */
-    pool_info = g_new0(app_pool_info_t, 1);
-    pool_info->pool = pool;
-    pool_info->reason = reason;  /* Takes ownership */
-    g_hash_table_replace(stats.app_pools, g_strdup(name), pool_info);
+    pool_info = track_app_pool(name, app_path);
 
     /* Increment launch count */
     count = g_hash_table_lookup(stats.app_launches, name);
     g_hash_table_replace(stats.app_launches, g_strdup(name),
                          GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
 
-    if (pool == POOL_PRIORITY) {
-        g_debug("Stats: HIT for %s (priority pool: %s)", name, reason ? reason : "unknown");
+    if (pool_info->pool == POOL_PRIORITY) {
+        g_debug("Stats: HIT for %s (priority pool: %s)", name, pool_info->reason);
     } else {
-        g_debug("Stats: HIT for %s (observation pool: %s)", name, reason ? reason : "unknown");
+        g_debug("Stats: HIT for %s (observation pool: %s)", name, pool_info->reason);
     }
 }
 
@@ -351,31 +529,25 @@ kp_stats_record_miss(const char *app_path)
 {
     const char *name;
     gpointer count;
-    pool_type_t pool;
-    char *reason = NULL;
-    app_pool_info_t *pool_info;
+    const app_pool_info_t *pool_info;
 
     if (!stats.initialized) return;
 
     name = get_app_name(app_path);
-    pool = classify_app_pool(app_path, &reason);
     stats.misses++;
 
     /* Track pool classification */
-    pool_info = g_new0(app_pool_info_t, 1);
-    pool_info->pool = pool;
-    pool_info->reason = reason;  /* Takes ownership */
-    g_hash_table_replace(stats.app_pools, g_strdup(name), pool_info);
+    pool_info = track_app_pool(name, app_path);
 
     /* Increment launch count */
     count = g_hash_table_lookup(stats.app_launches, name);
     g_hash_table_replace(stats.app_launches, g_strdup(name),
                          GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
 
-    if (pool == POOL_PRIORITY) {
-        g_debug("Stats: MISS for %s (priority pool: %s)", name, reason ? reason : "unknown");
+    if (pool_info->pool == POOL_PRIORITY) {
+        g_debug("Stats: MISS for %s (priority pool: %s)", name, pool_info->reason);
     } else {
-        g_debug("Stats: MISS for %s (observation pool: %s)", name, reason ? reason : "unknown");
+        g_debug("Stats: MISS for %s (observation pool: %s)", name, pool_info->reason);
     }
 }
 
@@ -467,6 +639,14 @@ kp_stats_get_summary(kp_stats_summary_t *summary)
     summary->total_preloaded_bytes = 0;
     summary->memory_pressure_events = stats.memory_pressure_events;
 
+    summary->readahead_batches = stats.readahead_batches;
+    summary->readahead_meta_us_total = stats.meta_us_total;
+    summary->readahead_sort_us_total = stats.sort_us_total;
+    summary->readahead_data_us_total = stats.data_us_total;
+    summary->readahead_meta_us_last = stats.meta_us_last;
+    summary->readahead_sort_us_last = stats.sort_us_last;
+    summary->readahead_data_us_last = stats.data_us_last;
+
     if (kp_state->exes) {
         g_hash_table_iter_init(&iter, kp_state->exes);
         while (g_hash_table_iter_next(&iter, &key, &value)) {
@@ -632,6 +812,8 @@ kp_stats_dump_to_file(const char *path)
     fprintf(f, "misses=%lu\n", summary.preload_misses);
     fprintf(f, "hit_rate=%.1f\n", summary.hit_rate);
     fprintf(f, "apps_tracked=%d\n", summary.apps_tracked);
+    fprintf(f, "cycle_seconds=%d\n", kp_state->cycle);
+    fprintf(f, "power_source=%s\n", kp_power_source_name(kp_power_source()));
 
     /* Pool breakdown */
     fprintf(f, "\n# Pool Breakdown\n");
@@ -643,6 +825,23 @@ kp_stats_dump_to_file(const char *path)
     fprintf(f, "total_preloaded_mb=%zu\n", summary.total_preloaded_bytes / (1024 * 1024));
     fprintf(f, "memory_pressure_events=%lu\n", summary.memory_pressure_events);
 
+    /* Readahead phases (cumulative and last batch, milliseconds) */
+    fprintf(f, "\n# Readahead Phases (ms)\n");
+    fprintf(f, "readahead_batches=%lu\n", summary.readahead_batches);
+    fprintf(f, "readahead_meta_ms_total=%.1f\n", summary.readahead_meta_us_total / 1000.0);
+    fprintf(f, "readahead_sort_ms_total=%.1f\n", summary.readahead_sort_us_total / 1000.0);
+    fprintf(f, "readahead_data_ms_total=%.1f\n", summary.readahead_data_us_total / 1000.0);
+    fprintf(f, "readahead_meta_ms_last=%.1f\n", summary.readahead_meta_us_last / 1000.0);
+    fprintf(f, "readahead_sort_ms_last=%.1f\n", summary.readahead_sort_us_last / 1000.0);
+    fprintf(f, "readahead_data_ms_last=%.1f\n", summary.readahead_data_us_last / 1000.0);
+
+    /* Learned per-device I/O costs */
+    kp_iocost_dump(f);
+    kp_hints_dump(f);
+    kp_startup_dump(f);
+    kp_event_dump(f);
+    kp_trace_dump(f);
+
     /* Top apps (extended to 20 with more details) */
     fprintf(f, "\n# Top Apps (name:weighted:raw:preloaded:pool)\n");
     for (int i = 0; i < STATS_TOP_APPS; i++) {
@@ -678,6 +877,26 @@ kp_stats_record_memory_pressure(void)
     g_debug("Memory pressure event recorded (total: %lu)", stats.memory_pressure_events);
 }
 
+/**
+ * Record time spent in each phase of one readahead batch
+ *
+ * Called by kp_readahead() after every batch. Lets users see whether
+ * metadata lookups or data reads dominate cold-start preloading.
+ */
+void
+kp_stats_record_readahead_phases(gint64 meta_us, gint64 sort_us, gint64 data_us)
+{
+    if (!stats.initialized) return;
+
+    stats.readahead_batches++;
+    stats.meta_us_total += meta_us;
+    stats.sort_us_total += sort_us;
+    stats.data_us_total += data_us;
+    stats.meta_us_last = meta_us;
+    stats.sort_us_last = sort_us;
+    stats.data_us_last = data_us;
+}
+
 /**
  * Get hit rate for a specific app
  * 
@@ -725,6 +944,11 @@ kp_stats_free(void)
         stats.app_pools = NULL;
     }
 
+    if (stats.pool_cache) {
+        g_hash_table_destroy(stats.pool_cache);
+        stats.pool_cache = NULL;
+    }
+
     stats.initialized = FALSE;
 }
 
@@ -738,32 +962,26 @@ write_preload_time(gpointer key, gpointer value, gpointer user_data)
 {
     const char *app_name = (const char *)key;
     time_t timestamp = (time_t)GPOINTER_TO_SIZE(value);
-    GIOChannel *channel = (GIOChannel *)user_data;
-    gchar *line;
-    
-    line = g_strdup_printf("PRELOAD\t%s\t%ld\n", app_name, (long)timestamp);
-    g_io_channel_write_chars(channel, line, -1, NULL, NULL);
-    g_free(line);
+    GString *out = (GString *)user_data;
+
+    g_string_append_printf(out, "PRELOAD\t%s\t%ld\n", app_name, (long)timestamp);
 }
 
 void
-kp_stats_save_preload_times(GIOChannel *channel)
+kp_stats_save_preload_times(GString *out)
 {
-    gchar *header;
     guint count;
     
-    if (!stats.initialized || !stats.preload_times || !channel) return;
+    if (!stats.initialized || !stats.preload_times || !out) return;
     
     count = g_hash_table_size(stats.preload_times);
     if (count == 0) return;
     
     /* Write header */
-    header = g_strdup_printf("PRELOAD_TIMES\t%u\n", count);
-    g_io_channel_write_chars(channel, header, -1, NULL, NULL);
-    g_free(header);
+    g_string_append_printf(out, "PRELOAD_TIMES\t%u\n", count);
     
     /* Write each preload time */
-    g_hash_table_foreach(stats.preload_times, write_preload_time, channel);
+    g_hash_table_foreach(stats.preload_times, write_preload_time, out);
     
     g_debug("Saved %u preload timestamps to state file", count);
 }
@@ -785,8 +1003,10 @@ kp_stats_load_preload_time(const char *app_name, time_t timestamp)
     if (elapsed < 0) elapsed = 0;  /* Clock skew */
     
     if (elapsed < stats.hitstats_window) {
+        G_LOCK(preload_times);
         g_hash_table_replace(stats.preload_times, g_strdup(app_name), 
                             GSIZE_TO_POINTER((gsize)timestamp));
+        G_UNLOCK(preload_times);
         g_debug("Loaded preload time for %s (age: %ld sec)", app_name, (long)elapsed);
     } else {
         g_debug("Skipped stale preload time for %s (age: %ld sec > window %d)",
@@ -41,6 +41,15 @@ typedef struct _kp_stats_summary {
     size_t total_preloaded_bytes;
     unsigned long memory_pressure_events;
 
+    /* Readahead phase timing (microseconds) */
+    unsigned long readahead_batches;
+    gint64 readahead_meta_us_total;
+    gint64 readahead_sort_us_total;
+    gint64 readahead_data_us_total;
+    gint64 readahead_meta_us_last;
+    gint64 readahead_sort_us_last;
+    gint64 readahead_data_us_last;
+
     /* Top apps */
     struct {
         char *name;
@@ -94,6 +103,14 @@ void kp_stats_get_summary(kp_stats_summary_t *summary);
  */
 void kp_stats_record_memory_pressure(void);
 
+/**
+ * Record time spent in each phase of one readahead batch
+ * @param meta_us  Metadata pre-warm (statx of dirs and files)
+ * @param sort_us  Sorting (including block/inode lookup)
+ * @param data_us  Data readahead until all workers finished
+ */
+void kp_stats_record_readahead_phases(gint64 meta_us, gint64 sort_us, gint64 data_us);
+
 /**
  * Get hit rate for a specific app
  * @param app_path Path of application
@@ -115,9 +132,9 @@ void kp_stats_free(void);
 
 /**
  * Save preload timestamps to state file
- * @param channel File channel to write to
+ * @param out Serialized state to append to
  */
-void kp_stats_save_preload_times(GIOChannel *channel);
+void kp_stats_save_preload_times(GString *out);
 
 /**
  * Load preload timestamps from state file
@@ -126,10 +143,25 @@ void kp_stats_save_preload_times(GIOChannel *channel);
  */
 void kp_stats_load_preload_time(const char *app_name, time_t timestamp);
 
+/**
+ * Pool an application belongs to (priority or observation)
+ *
+ * @param app_path Executable path
+ */
+pool_type_t kp_stats_classify(const char *app_path);
+
 /**
  * Reclassify all loaded applications
  * Should be called after state load to apply updated classification logic
  */
 void kp_stats_reclassify_all(void);
 
+/**
+ * Desktop index listener: reclassify the affected application
+ *
+ * @param exe_path Executable whose .desktop entry changed, or NULL to
+ *                 reclassify everything
+ */
+void kp_stats_desktop_changed(const char *exe_path);
+
 #endif /* STATS_H */
@@ -0,0 +1,587 @@
+/* trace.c - Workload trace recorder for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Trace Recorder
+ * =============================================================================
+ *
+ * With "[system] trace = true" the daemon records what it sees and does
+ * to a ring file, so real desktop workloads can be replayed offline
+ * (preheat-ctl trace --sim | preheat-sim):
+ *
+ *   spy.c      → EXEC, EXIT, and MAPSET when an exe's maps are new or changed
+ *   prophet.c  → CYCLE (budget, selection, top predictions), READAHEAD
+ *
+ * The layout is in include/trace_format.h. The file has a fixed size
+ * ("tracesize"), allocated up front and mapped shared: appending a record
+ * is a memcpy into the mapping, no system call, and the kernel writes the
+ * pages back at its own pace. When the ring is full the oldest records
+ * are overwritten, so disk use never grows past tracesize.
+ *
+ * OVERHEAD:
+ *   Only exes the model tracks are recorded, and a map set is written
+ *   once per exe for as long as it stays in the ring instead of with
+ *   every launch. Time spent in the recorder is measured and reported
+ *   in the stats file (trace_us) next to the record counts.
+ *
+ * All calls come from the main loop.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "trace.h"
+
+#include <sys/mman.h>
+
+#define TOP_EXES        8           /* Predictions kept per CYCLE */
+#define MAX_PAYLOAD     (KP_TRACE_MAX_RECORD - sizeof(kp_trace_record_t))
+
+#define ALIGN_UP(n)     (((n) + KP_TRACE_ALIGN - 1) & ~(size_t)(KP_TRACE_ALIGN - 1))
+
+/* Last MAPSET written for an exe */
+typedef struct _mapset_mark_t
+{
+    guint64 pos;            /* Absolute position (header written) */
+    size_t size;
+    guint count;
+} mapset_mark_t;
+
+static struct
+{
+    int fd;
+    guint8 *base;           /* Whole file, mapped */
+    size_t size;
+    kp_trace_header_t *hdr;
+    guint8 *data;           /* Ring, hdr->capacity bytes */
+
+    GByteArray *buf;        /* Payload being built */
+    GHashTable *mapsets;    /* exe path → mapset_mark_t */
+    guint64 batch_hash;     /* Last READAHEAD written in full */
+    guint64 batch_pos;
+
+    /* Counters for the stats file (this run) */
+    guint64 records;
+    guint64 appended;       /* Record bytes */
+    guint64 wraps;
+    guint64 busy_us;        /* Time spent in the recorder */
+} tr = { -1, NULL, 0, NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0 };
+
+/* ========================================================================
+ * RING
+ * ======================================================================== */
+
+static gboolean
+header_valid(const kp_trace_header_t *h, guint64 capacity)
+{
+    return !memcmp(h->magic, KP_TRACE_MAGIC, sizeof(h->magic)) &&
+           h->version == KP_TRACE_VERSION &&
+           h->header_size == KP_TRACE_HEADER_SIZE &&
+           h->capacity == capacity &&
+           h->head < capacity && h->tail < capacity && h->used <= capacity &&
+           h->head % KP_TRACE_ALIGN == 0 && h->tail % KP_TRACE_ALIGN == 0;
+}
+
+static void
+header_init(kp_trace_header_t *h, guint64 capacity)
+{
+    memset(h, 0, KP_TRACE_HEADER_SIZE);
+    memcpy(h->magic, KP_TRACE_MAGIC, sizeof(h->magic));
+    h->version = KP_TRACE_VERSION;
+    h->header_size = KP_TRACE_HEADER_SIZE;
+    h->capacity = capacity;
+    h->started_us = g_get_real_time();
+}
+
+/* Drop the oldest records until len bytes from head are free */
+static void
+make_room(size_t len)
+{
+    kp_trace_header_t *h = tr.hdr;
+
+    if (!h->used)
+        h->tail = h->head;
+
+    while (h->used && h->tail >= h->head && h->tail < h->head + len) {
+        kp_trace_record_t old;
+
+        memcpy(&old, tr.data + h->tail, sizeof(old));
+        if (old.len < sizeof(old) || old.len % KP_TRACE_ALIGN ||
+            old.len > h->used || h->tail + old.len > h->capacity) {
+            g_warning("trace ring damaged at %" G_GUINT64_FORMAT ", discarding it",
+                      (guint64)h->tail);
+            h->used = 0;
+            h->tail = h->head;
+            break;
+        }
+
+        h->tail += old.len;
+        h->used -= old.len;
+        if (h->tail == h->capacity)
+            h->tail = 0;
+    }
+}
+
+static void
+put_record(guint16 type, guint16 flags, const guint8 *payload, size_t plen, size_t len)
+{
+    kp_trace_header_t *h = tr.hdr;
+    kp_trace_record_t rec;
+    guint8 *p = tr.data + h->head;
+
+    rec.len = (uint32_t)len;
+    rec.type = type;
+    rec.flags = flags;
+    rec.time_us = g_get_real_time();
+
+    memcpy(p, &rec, sizeof(rec));
+    if (plen)
+        memcpy(p + sizeof(rec), payload, plen);
+    memset(p + sizeof(rec) + plen, 0, len - sizeof(rec) - plen);
+
+    /* Header last: a reader never sees a half-written record as valid */
+    h->head += len;
+    h->used += len;
+    h->written += len;
+    if (h->head == h->capacity) {
+        h->head = 0;
+        tr.wraps++;
+    }
+}
+
+/* Append the payload in tr.buf as one record */
+static void
+ring_append(guint16 type, guint16 flags)
+{
+    kp_trace_header_t *h = tr.hdr;
+    size_t len = ALIGN_UP(sizeof(kp_trace_record_t) + tr.buf->len);
+
+    if (len > h->capacity / 2) {
+        h->dropped++;
+        return;
+    }
+
+    if (h->head + len > h->capacity) {
+        size_t pad = h->capacity - h->head;
+        make_room(pad);
+        put_record(KP_TRACE_PAD, 0, NULL, 0, pad);
+    }
+
+    make_room(len);
+    put_record(type, flags, tr.buf->data, tr.buf->len, len);
+    h->records++;
+    tr.records++;
+    tr.appended += len;
+}
+
+/* ========================================================================
+ * PAYLOAD
+ * ======================================================================== */
+
+static void
+payload_begin(void)
+{
+    g_byte_array_set_size(tr.buf, 0);
+}
+
+static void
+put(const void *v, size_t n)
+{
+    g_byte_array_append(tr.buf, v, (guint)n);
+}
+
+static void put_i32(gint32 v)   { put(&v, sizeof(v)); }
+static void put_u32(guint32 v)  { put(&v, sizeof(v)); }
+static void put_i64(gint64 v)   { put(&v, sizeof(v)); }
+static void put_u64(guint64 v)  { put(&v, sizeof(v)); }
+static void put_f64(double v)   { put(&v, sizeof(v)); }
+static void put_str(const char *s) { put(s, strlen(s) + 1); }
+
+/* Room for an entry of n bytes before the record would be too long */
+static gboolean
+fits(size_t n)
+{
+    return tr.buf->len + n <= MAX_PAYLOAD;
+}
+
+/* Overwrite the count reserved at off once the list is written */
+static void
+patch_u32(guint off, guint32 v)
+{
+    memcpy(tr.buf->data + off, &v, sizeof(v));
+}
+
+/* Append count (offset, length, path) entries; returns FALSE if cut short */
+static gboolean
+put_regions(kp_map_t **maps, int count)
+{
+    guint count_off = tr.buf->len;
+    guint32 n = 0;
+    gboolean complete = TRUE;
+
+    put_u32(0);
+    for (int i = 0; i < count; i++) {
+        if (!fits(2 * sizeof(guint64) + strlen(maps[i]->path) + 1)) {
+            complete = FALSE;
+            break;
+        }
+        put_u64(maps[i]->offset);
+        put_u64(maps[i]->length);
+        put_str(maps[i]->path);
+        n++;
+    }
+    patch_u32(count_off, n);
+    return complete;
+}
+
+/* Still in the ring? (pos is a record's absolute position) */
+static gboolean
+is_live(guint64 pos)
+{
+    return pos >= tr.hdr->written - tr.hdr->used;
+}
+
+/* ========================================================================
+ * FILE
+ * ======================================================================== */
+
+static gboolean
+trace_map(guint64 capacity)
+{
+    struct stat st;
+    size_t size = KP_TRACE_HEADER_SIZE + capacity;
+    int err;
+
+    tr.fd = open(KP_TRACE_FILE, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (tr.fd < 0) {
+        g_warning("cannot open trace file %s: %s", KP_TRACE_FILE, strerror(errno));
+        return FALSE;
+    }
+
+    if (fstat(tr.fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        g_warning("trace file %s is not a regular file", KP_TRACE_FILE);
+        goto fail;
+    }
+
+    if ((size_t)st.st_size != size && ftruncate(tr.fd, (off_t)size) < 0) {
+        g_warning("cannot resize trace file %s: %s", KP_TRACE_FILE, strerror(errno));
+        goto fail;
+    }
+
+    /* Allocate now: a write to a hole in a full file system would be a
+     * SIGBUS through the mapping */
+    err = posix_fallocate(tr.fd, 0, (off_t)size);
+    if (err && err != EOPNOTSUPP && err != EINVAL) {
+        g_warning("cannot allocate trace file %s: %s", KP_TRACE_FILE, strerror(err));
+        goto fail;
+    }
+
+    tr.base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, tr.fd, 0);
+    if (tr.base == MAP_FAILED) {
+        tr.base = NULL;
+        g_warning("cannot map trace file %s: %s", KP_TRACE_FILE, strerror(errno));
+        goto fail;
+    }
+
+    tr.size = size;
+    tr.hdr = (kp_trace_header_t *)tr.base;
+    tr.data = tr.base + KP_TRACE_HEADER_SIZE;
+
+    if (header_valid(tr.hdr, capacity)) {
+        g_message("appending to trace %s (%" G_GUINT64_FORMAT " records so far)",
+                  KP_TRACE_FILE, (guint64)tr.hdr->records);
+    } else {
+        header_init(tr.hdr, capacity);
+        g_message("recording trace to %s (%" G_GUINT64_FORMAT " KiB ring)",
+                  KP_TRACE_FILE, capacity / 1024);
+    }
+    return TRUE;
+
+fail:
+    close(tr.fd);
+    tr.fd = -1;
+    return FALSE;
+}
+
+/**
+ * Open, resize or close the trace file to match the configuration
+ */
+void
+kp_trace_open(void)
+{
+    guint64 capacity;
+
+    if (!kp_conf->system.trace) {
+        kp_trace_close();
+        return;
+    }
+
+    capacity = (guint64)kp_conf->system.tracesize & ~(guint64)(KP_TRACE_ALIGN - 1);
+    if (tr.hdr && tr.hdr->capacity == capacity)
+        return;
+
+    kp_trace_close();
+
+    if (!trace_map(capacity))
+        return;
+
+    tr.buf = g_byte_array_sized_new(4096);
+    tr.mapsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    tr.batch_hash = 0;
+}
+
+/**
+ * Flush and close the trace file
+ */
+void
+kp_trace_close(void)
+{
+    if (!tr.hdr)
+        return;
+
+    if (msync(tr.base, tr.size, MS_SYNC) < 0)
+        g_warning("cannot flush trace file: %s", strerror(errno));
+    munmap(tr.base, tr.size);
+    close(tr.fd);
+
+    g_byte_array_free(tr.buf, TRUE);
+    g_hash_table_destroy(tr.mapsets);
+
+    tr.fd = -1;
+    tr.base = NULL;
+    tr.hdr = NULL;
+    tr.data = NULL;
+    tr.buf = NULL;
+    tr.mapsets = NULL;
+}
+
+/* ========================================================================
+ * RECORDS
+ * ======================================================================== */
+
+/* Write a MAPSET unless the ring still holds an identical one */
+static void
+trace_mapset(kp_exe_t *exe)
+{
+    mapset_mark_t *mark = g_hash_table_lookup(tr.mapsets, exe->path);
+    guint count = g_set_size(exe->exemaps);
+    guint count_off;
+    guint32 n = 0;
+    guint16 flags = 0;
+
+    if (mark && is_live(mark->pos) &&
+        mark->size == exe->size && mark->count == count)
+        return;
+
+    payload_begin();
+    count_off = tr.buf->len;
+    put_u32(0);
+    put_str(exe->path);
+    for (guint i = 0; i < count; i++) {
+        kp_map_t *map = ((kp_exemap_t *)g_ptr_array_index(exe->exemaps, i))->map;
+
+        if (!fits(2 * sizeof(guint64) + strlen(map->path) + 1)) {
+            flags |= KP_TRACE_F_TRUNCATED;
+            break;
+        }
+        put_u64(map->offset);
+        put_u64(map->length);
+        put_str(map->path);
+        n++;
+    }
+    patch_u32(count_off, n);
+
+    if (!mark) {
+        mark = g_new0(mapset_mark_t, 1);
+        g_hash_table_insert(tr.mapsets, g_strdup(exe->path), mark);
+    }
+    mark->pos = tr.hdr->written;
+    mark->size = exe->size;
+    mark->count = count;
+
+    ring_append(KP_TRACE_MAPSET, flags);
+}
+
+/**
+ * Record a process start of a tracked exe
+ */
+void
+kp_trace_exec(pid_t pid, pid_t ppid, gboolean user, kp_exe_t *exe)
+{
+    gint64 t0;
+
+    if (!tr.hdr)
+        return;
+    t0 = g_get_monotonic_time();
+
+    /* Map set first, so a replay has the maps when it sees the EXEC */
+    if (exe->exemaps)
+        trace_mapset(exe);
+
+    payload_begin();
+    put_i32(pid);
+    put_i32(ppid);
+    put_str(exe->path);
+    ring_append(KP_TRACE_EXEC, user ? KP_TRACE_F_USER : 0);
+
+    tr.busy_us += g_get_monotonic_time() - t0;
+}
+
+/**
+ * Record a process exit
+ */
+void
+kp_trace_exit(pid_t pid)
+{
+    gint64 t0;
+
+    if (!tr.hdr)
+        return;
+    t0 = g_get_monotonic_time();
+
+    payload_begin();
+    put_i32(pid);
+    ring_append(KP_TRACE_EXIT, 0);
+
+    tr.busy_us += g_get_monotonic_time() - t0;
+}
+
+/* Keep the TOP_EXES exes with the lowest lnprob, sorted */
+static void
+top_exes_add(gpointer key, gpointer value, gpointer user_data)
+{
+    kp_exe_t *exe = value;
+    GPtrArray *top = user_data;
+    guint i;
+
+    (void)key;
+
+    if (!(exe->lnprob < 0))
+        return;
+    if (top->len == TOP_EXES &&
+        exe->lnprob >= ((kp_exe_t *)g_ptr_array_index(top, TOP_EXES - 1))->lnprob)
+        return;
+
+    for (i = 0; i < top->len; i++)
+        if (exe->lnprob < ((kp_exe_t *)g_ptr_array_index(top, i))->lnprob)
+            break;
+
+    if (top->len == TOP_EXES)
+        g_ptr_array_set_size(top, TOP_EXES - 1);
+    g_ptr_array_add(top, NULL);
+    memmove(&top->pdata[i + 1], &top->pdata[i], (top->len - 1 - i) * sizeof(gpointer));
+    top->pdata[i] = exe;
+}
+
+/**
+ * Record a prediction cycle
+ */
+void
+kp_trace_cycle(long budget_kb, long used_kb, int ranked, int selected, guint16 flags)
+{
+    GPtrArray *top;
+    gint64 t0;
+    guint count_off;
+    guint32 n = 0;
+
+    if (!tr.hdr)
+        return;
+    t0 = g_get_monotonic_time();
+
+    top = g_ptr_array_sized_new(TOP_EXES);
+    g_hash_table_foreach(kp_state->exes, top_exes_add, top);
+
+    payload_begin();
+    put_i32(kp_state->time);
+    put_i32(kp_state->cycle);
+    put_i64(budget_kb);
+    put_i64(used_kb);
+    put_u32((guint32)ranked);
+    put_u32((guint32)selected);
+    count_off = tr.buf->len;
+    put_u32(0);
+    for (guint i = 0; i < top->len; i++) {
+        kp_exe_t *exe = g_ptr_array_index(top, i);
+
+        if (!fits(sizeof(double) + strlen(exe->path) + 1))
+            break;
+        put_f64(exe->lnprob);
+        put_str(exe->path);
+        n++;
+    }
+    patch_u32(count_off, n);
+    g_ptr_array_free(top, TRUE);
+
+    ring_append(KP_TRACE_CYCLE, flags);
+
+    tr.busy_us += g_get_monotonic_time() - t0;
+}
+
+/**
+ * Record a readahead batch as issued
+ */
+void
+kp_trace_readahead(kp_map_t **maps, int count, guint16 flags)
+{
+    guint64 total = 0, hash;
+    gint64 t0;
+
+    if (!tr.hdr)
+        return;
+    t0 = g_get_monotonic_time();
+
+    /* FNV-1a over the regions: a steady prediction issues the same
+     * batch every cycle, and the list is what makes the record big */
+    hash = 14695981039346656037ULL;
+    for (int i = 0; i < count; i++) {
+        total += maps[i]->length;
+        hash = (hash ^ (guint64)maps[i]->seq) * 1099511628211ULL;
+        hash = (hash ^ maps[i]->offset) * 1099511628211ULL;
+        hash = (hash ^ maps[i]->length) * 1099511628211ULL;
+    }
+
+    payload_begin();
+    put_u32((guint32)count);
+    put_u64(total);
+    if (hash == tr.batch_hash && is_live(tr.batch_pos)) {
+        put_u32(0);
+        flags |= KP_TRACE_F_REPEAT;
+    } else {
+        tr.batch_hash = hash;
+        tr.batch_pos = tr.hdr->written;
+        if (!put_regions(maps, count))
+            flags |= KP_TRACE_F_TRUNCATED;
+    }
+    ring_append(KP_TRACE_READAHEAD, flags);
+
+    tr.busy_us += g_get_monotonic_time() - t0;
+}
+
+/**
+ * Write recorder counters to the stats file
+ */
+void
+kp_trace_dump(FILE *f)
+{
+    fprintf(f, "\n# Trace Recorder\n");
+    fprintf(f, "trace_enabled=%d\n", tr.hdr ? 1 : 0);
+    if (!tr.hdr)
+        return;
+
+    fprintf(f, "trace_file=%s\n", KP_TRACE_FILE);
+    fprintf(f, "trace_capacity=%" G_GUINT64_FORMAT "\n", (guint64)tr.hdr->capacity);
+    fprintf(f, "trace_used=%" G_GUINT64_FORMAT "\n", (guint64)tr.hdr->used);
+    fprintf(f, "trace_records=%" G_GUINT64_FORMAT "\n", tr.records);
+    fprintf(f, "trace_bytes=%" G_GUINT64_FORMAT "\n", tr.appended);
+    fprintf(f, "trace_wraps=%" G_GUINT64_FORMAT "\n", tr.wraps);
+    fprintf(f, "trace_dropped=%" G_GUINT64_FORMAT "\n", (guint64)tr.hdr->dropped);
+    fprintf(f, "trace_us=%" G_GUINT64_FORMAT "\n", tr.busy_us);
+}
@@ -0,0 +1,74 @@
+/* trace.h - Workload trace recorder for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glib.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "../state/state.h"
+#include "trace_format.h"
+
+#define KP_TRACE_FILE   PKGLOCALSTATEDIR "/" PACKAGE ".trace"
+
+/**
+ * Open, resize or close the trace file to match the configuration
+ *
+ * Called after every configuration load. Does nothing unless [system]
+ * trace is enabled. A file left by an earlier run with the same size is
+ * appended to; otherwise it is started afresh.
+ */
+void kp_trace_open(void);
+
+/**
+ * Flush and close the trace file (no-op if not recording)
+ */
+void kp_trace_close(void);
+
+/**
+ * Record a process start of a tracked exe
+ *
+ * Also records the exe's map set if the ring no longer holds one that
+ * matches it.
+ */
+void kp_trace_exec(pid_t pid, pid_t ppid, gboolean user, kp_exe_t *exe);
+
+/**
+ * Record a process exit
+ */
+void kp_trace_exit(pid_t pid);
+
+/**
+ * Record a prediction cycle: budget, selection and the top predicted exes
+ *
+ * @param budget_kb  Memory available for readahead
+ * @param used_kb    Part of it taken by the selected maps
+ * @param ranked     Maps with a prediction
+ * @param selected   Maps that fit the budget
+ * @param flags      KP_TRACE_F_URGENT, KP_TRACE_F_REWARM, KP_TRACE_F_COALESCED
+ */
+void kp_trace_cycle(long budget_kb, long used_kb, int ranked, int selected,
+                    guint16 flags);
+
+/**
+ * Record a readahead batch as issued
+ *
+ * @param flags  KP_TRACE_F_REWARM, KP_TRACE_F_HOTSET
+ */
+void kp_trace_readahead(kp_map_t **maps, int count, guint16 flags);
+
+/**
+ * Write recorder counters to the stats file
+ */
+void kp_trace_dump(FILE *f);
+
+#endif /* TRACE_H */
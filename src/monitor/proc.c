@@ -31,8 +31,13 @@
  *   /proc/meminfo    - System memory statistics (total, free, cached)
  *   /proc/vmstat     - Virtual memory statistics (page in/out counts)
  *
+ *   All of these are read below the configured procroot (kp_proc_set_root),
+ *   so benchmarks can point the scanner at a generated tree.
+ *
  * DATA FLOW:
- *   kp_proc_foreach() → discovers processes → calls callback with (pid, exe_path)
+ *   kp_proc_snapshot() → discovers processes → pid/exe_path table, plus
+ *                        parent, owner and regions of new processes
+ *   kp_proc_foreach() → snapshot, then callback with (pid, exe_path)
  *   kp_proc_get_maps() → parses /proc/PID/maps → returns memory map regions
  *   kp_proc_get_memstat() → parses /proc/meminfo → returns memory stats
  *
@@ -57,6 +62,19 @@
 #include <dirent.h>
 #include <ctype.h>
 
+/* Root of the proc tree (procroot). Fixed at startup: snapshots are
+ * taken on the scan thread, which must not read kp_conf. */
+static char proc_root[PATH_MAX] = "/proc";
+
+/**
+ * Set the root of the proc tree (NULL or empty for /proc)
+ */
+void
+kp_proc_set_root(const char *root)
+{
+    g_strlcpy(proc_root, root && *root ? root : "/proc", sizeof(proc_root));
+}
+
 /*
  * Prelink Handling Note (from original preload):
  *
@@ -120,35 +138,52 @@ sanitize_file(char *file)
  *   - "!/usr/share"   → Exclude files starting with /usr/share (! prefix)
  *
  * First matching prefix wins. If no prefix matches, file is accepted.
+ * The rules are compiled into a trie at config load, so this costs one
+ * walk over the path regardless of the number of rules.
  *
  * @param file    Full path to check
- * @param prefix  NULL-terminated array of prefix rules, or NULL for no filtering
+ * @param prefix  Compiled prefix rules, or NULL for no filtering
  * @return        TRUE to accept file, FALSE to reject
  *
  * EXAMPLE PREFIXES:
- *   { "/usr", "!/usr/share", "/opt", NULL }
+ *   { "!/usr/share", "/usr", "/opt", NULL }
  *   → Accepts /usr/bin/foo, /opt/bar
- *   → Rejects /usr/share/icons/x.png, /home/user/app
+ *   → Rejects /usr/share/icons/x.png
  */
-static gboolean
-accept_file(char *file, char * const *prefix)
+static inline gboolean
+accept_file(const char *file, const kp_prefix_set_t *prefix)
 {
-    if (prefix)
-        for (; *prefix; prefix++) {
-            const char *p = *prefix;
-            gboolean accept;
-            if (*p == '!') {
-                p++;
-                accept = FALSE;
-            } else {
-                accept = TRUE;
-            }
-            if (!strncmp(file, p, strlen(p)))
-                return accept;
+    return kp_prefix_set_accept(prefix, file);
+}
+
+/*
+ * Count one accepted region, and add it to maps / exemaps when given
+ */
+static void
+map_add(const char *file, size_t offset, size_t length,
+        GHashTable *maps, GSet **exemaps)
+{
+    gpointer orig_map;
+    kp_map_t *map;
+    gpointer value;
+
+    if (!maps && !exemaps)
+        return;
+
+    map = kp_map_new(file, offset, length);
+
+    if (maps) {
+        if (g_hash_table_lookup_extended(maps, map, &orig_map, &value)) {
+            kp_map_free(map);
+            map = (kp_map_t *)orig_map;
         }
+    }
 
-    /* Accept if no match */
-    return TRUE;
+    if (exemaps) {
+        kp_exemap_t *exemap;
+        exemap = kp_exemap_new(map);
+        g_set_add(*exemaps, exemap);
+    }
 }
 
 /**
@@ -175,12 +210,12 @@ accept_file(char *file, char * const *prefix)
 size_t
 kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
 {
-    char name[32];
+    char name[PATH_MAX];
     FILE *in;
     size_t size = 0;
     char buffer[1024];
 
-    g_snprintf(name, sizeof(name) - 1, "/proc/%d/maps", pid);
+    g_snprintf(name, sizeof(name), "%s/%d/maps", proc_root, pid);
     in = fopen(name, "r");
     if (!in) {
         /* This may fail for a variety of reason. Process terminated
@@ -202,7 +237,7 @@ kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
         count = sscanf(buffer, "%lx-%lx %*15s %lx %*x:%*x %*u %"FILELENSTR"s",
                        &start, &end, &offset, file);
 
-        if (count != 4 || !sanitize_file(file) || !accept_file(file, kp_conf->system.mapprefix))
+        if (count != 4 || !sanitize_file(file) || !accept_file(file, kp_conf->system.mapprefix_set))
             continue;
 
         /* BUG 2 FIX: Validate address range */
@@ -212,33 +247,272 @@ kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
         length = end - start;
         size += length;
 
-        if (maps || exemaps) {
-            gpointer orig_map;
-            kp_map_t *map;
-            gpointer value;
+        map_add(file, offset, length, maps, exemaps);
+    }
 
-            map = kp_map_new(file, offset, length);
+    fclose(in);
 
-            if (maps) {
-                if (g_hash_table_lookup_extended(maps, map, &orig_map, &value)) {
-                    kp_map_free(map);
-                    map = (kp_map_t *)orig_map;
-                }
-            }
+    return size;
+}
 
-            if (exemaps) {
-                kp_exemap_t *exemap;
-                exemap = kp_exemap_new(map);
-                g_set_add(*exemaps, exemap);
-            }
-        }
+/**
+ * Read the file-backed regions of a process, without filtering
+ *
+ * Only reads /proc, for the scan thread; kp_proc_regions_to_maps() and
+ * kp_proc_regions_objects() apply mapprefix later.
+ *
+ * @return  Array of kp_proc_region_t, NULL if the maps are unreadable
+ */
+static GArray *
+read_regions(pid_t pid)
+{
+    char name[PATH_MAX];
+    FILE *in;
+    char buffer[1024];
+    GArray *regions;
+
+    g_snprintf(name, sizeof(name), "%s/%d/maps", proc_root, pid);
+    in = fopen(name, "r");
+    if (!in)
+        return NULL;
+
+    regions = g_array_new(FALSE, FALSE, sizeof(kp_proc_region_t));
+
+    while (fgets(buffer, sizeof(buffer) - 1, in)) {
+        char file[FILELEN];
+        unsigned long start, end, offset;
+        kp_proc_region_t r;
+
+        file[0] = '\0';
+        if (sscanf(buffer, "%lx-%lx %*15s %lx %*x:%*x %*u %"FILELENSTR"s",
+                   &start, &end, &offset, file) != 4 ||
+            !sanitize_file(file) || end <= start)
+            continue;
+
+        r.path = g_strdup(file);
+        r.offset = offset;
+        r.length = end - start;
+        g_array_append_val(regions, r);
     }
 
     fclose(in);
+    return regions;
+}
+
+static void
+regions_free(GArray *regions)
+{
+    if (!regions)
+        return;
+
+    for (guint i = 0; i < regions->len; i++)
+        g_free(g_array_index(regions, kp_proc_region_t, i).path);
+    g_array_free(regions, TRUE);
+}
+
+/**
+ * Turn regions read with a snapshot into model maps
+ *
+ * Same result as kp_proc_get_maps() at the time the regions were read.
+ */
+size_t
+kp_proc_regions_to_maps(const GArray *regions, GHashTable *maps, GSet **exemaps)
+{
+    size_t size = 0;
+
+    if (exemaps)
+        *exemaps = g_set_new();
+
+    for (guint i = 0; i < regions->len; i++) {
+        const kp_proc_region_t *r = &g_array_index(regions, kp_proc_region_t, i);
+
+        if (!accept_file(r->path, kp_conf->system.mapprefix_set))
+            continue;
+
+        size += r->length;
+        map_add(r->path, r->offset, r->length, maps, exemaps);
+    }
 
     return size;
 }
 
+/**
+ * Get the real user owning a process
+ *
+ * /proc/PID is owned by the process's effective UID, which for login
+ * sessions is the user.
+ */
+uid_t
+kp_proc_get_uid(pid_t pid)
+{
+    char name[PATH_MAX];
+    struct stat st;
+
+    snprintf(name, sizeof(name), "%s/%d", proc_root, pid);
+    if (stat(name, &st) < 0)
+        return (uid_t)-1;
+
+    return st.st_uid;
+}
+
+/**
+ * Check whether a process exists
+ */
+gboolean
+kp_proc_exists(pid_t pid)
+{
+    char name[PATH_MAX];
+
+    snprintf(name, sizeof(name), "%s/%d", proc_root, pid);
+    return g_file_test(name, G_FILE_TEST_EXISTS);
+}
+
+/**
+ * Get the parent PID of a process
+ *
+ * Reads field 4 from /proc/{pid}/stat which contains the parent PID.
+ */
+pid_t
+kp_proc_get_ppid(pid_t pid)
+{
+    char stat_path[PATH_MAX];
+    FILE *fp;
+    pid_t ppid = 0;
+    
+    snprintf(stat_path, sizeof(stat_path), "%s/%d/stat", proc_root, pid);
+    fp = fopen(stat_path, "r");
+    if (!fp)
+        return 0;
+    
+    /* Format: pid (comm) state ppid ...
+     * SECURITY FIX (B013/B016): comm is in parentheses and can contain
+     * spaces, newlines, or any character except ')'. Use %*s to skip
+     * to the last ')' then parse remaining fields.
+     */
+    char line[1024];
+    if (fgets(line, sizeof(line), fp)) {
+        /* Find last ')' - comm field ends there */
+        char *close_paren = strrchr(line, ')');
+        if (close_paren && close_paren[1] == ' ') {
+            /* Parse: " state ppid ..." after the closing paren */
+            char state;
+            if (sscanf(close_paren + 2, "%c %d", &state, &ppid) != 2)
+                ppid = 0;
+        }
+    }
+    
+    fclose(fp);
+    return ppid;
+}
+
+/**
+ * Get the executable of a process (raw /proc/PID/exe target)
+ */
+char *
+kp_proc_get_exe(pid_t pid)
+{
+    char name[PATH_MAX];
+    char path[PATH_MAX];
+    ssize_t len;
+
+    snprintf(name, sizeof(name), "%s/%d/exe", proc_root, pid);
+    len = readlink(name, path, sizeof(path) - 1);
+    if (len < 0)
+        return NULL;
+
+    path[len] = '\0';
+    return g_strdup(path);
+}
+
+/* Whether a mapped file looks like a shared object (.so or .so.N) */
+static gboolean
+is_shared_object(const char *file)
+{
+    const char *base = strrchr(file, '/');
+
+    base = base ? base + 1 : file;
+    return g_str_has_suffix(base, ".so") || strstr(base, ".so.") != NULL;
+}
+
+/**
+ * List shared objects mapped by a process
+ *
+ * Returns each distinct file-backed mapping whose name looks like a
+ * shared object (.so or .so.N), filtered by mapprefix. Used to learn
+ * which plugins an app actually dlopen()s.
+ *
+ * @param pid Process ID to scan
+ * @return Array of paths (g_free'd by the array), or NULL if unreadable
+ */
+GPtrArray *
+kp_proc_get_shared_objects(pid_t pid)
+{
+    char name[PATH_MAX];
+    FILE *in;
+    char buffer[1024];
+    GPtrArray *sos;
+    GHashTable *seen;
+
+    g_snprintf(name, sizeof(name), "%s/%d/maps", proc_root, pid);
+    in = fopen(name, "r");
+    if (!in)
+        return NULL;
+
+    sos = g_ptr_array_new_with_free_func(g_free);
+    seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+    while (fgets(buffer, sizeof(buffer) - 1, in)) {
+        char file[FILELEN];
+        char *copy;
+
+        file[0] = '\0';
+        if (1 != sscanf(buffer, "%*x-%*x %*15s %*x %*x:%*x %*u %"FILELENSTR"s", file))
+            continue;
+
+        if (!sanitize_file(file) || !accept_file(file, kp_conf->system.mapprefix_set) ||
+            !is_shared_object(file))
+            continue;
+
+        if (g_hash_table_contains(seen, file))
+            continue;
+
+        copy = g_strdup(file);
+        g_ptr_array_add(sos, copy);
+        g_hash_table_add(seen, copy);
+    }
+
+    g_hash_table_destroy(seen);
+    fclose(in);
+
+    return sos;
+}
+
+/**
+ * Shared objects among regions read with a snapshot
+ */
+GPtrArray *
+kp_proc_regions_objects(const GArray *regions)
+{
+    GPtrArray *sos = g_ptr_array_new_with_free_func(g_free);
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (guint i = 0; i < regions->len; i++) {
+        const char *file = g_array_index(regions, kp_proc_region_t, i).path;
+        char *copy;
+
+        if (!accept_file(file, kp_conf->system.mapprefix_set) || !is_shared_object(file) ||
+            g_hash_table_contains(seen, file))
+            continue;
+
+        copy = g_strdup(file);
+        g_ptr_array_add(sos, copy);
+        g_hash_table_add(seen, copy);
+    }
+
+    g_hash_table_destroy(seen);
+    return sos;
+}
+
 /**
  * Check if string contains only digits
  * (VERBATIM from upstream all_digits)
@@ -253,41 +527,156 @@ all_digits(const char *s)
     return TRUE;
 }
 
+/* One process of a snapshot */
+typedef struct {
+    pid_t pid;
+    char *exe;
+} proc_entry_t;
+
+struct _kp_proc_snapshot_t
+{
+    GArray *entries;    /* proc_entry_t */
+    GHashTable *info;   /* pid → kp_proc_info_t*, NULL if nothing was read */
+};
+
+/*
+ * What the last snapshot saw, so the next one reads details only for what
+ * is new. Snapshots are taken on the scan thread, and on the main loop
+ * while one is in flight; the lock only covers swapping the tables.
+ */
+G_LOCK_DEFINE_STATIC(scanner);
+static struct {
+    GHashTable *pids;       /* pids of the last snapshot */
+    GHashTable *exes;       /* exe paths of the last snapshot */
+    GHashTable *want;       /* pids passed to kp_proc_want_regions() */
+} scanner;
+
+static void
+info_free(gpointer data)
+{
+    kp_proc_info_t *info = data;
+
+    g_free(info->parent_exe);
+    regions_free(info->regions);
+    g_free(info);
+}
+
+static kp_proc_info_t *
+snapshot_info_new(kp_proc_snapshot_t *snap, pid_t pid)
+{
+    kp_proc_info_t *info = g_new0(kp_proc_info_t, 1);
+
+    info->uid = (uid_t)-1;
+    if (!snap->info)
+        snap->info = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, info_free);
+    g_hash_table_insert(snap->info, GINT_TO_POINTER(pid), info);
+    return info;
+}
+
+/*
+ * Read what the main loop needs of new processes: parent and owner of
+ * pids not seen last time, regions of the first pid of an exe not seen
+ * last time and of requested pids
+ */
+static void
+snapshot_read_details(kp_proc_snapshot_t *snap)
+{
+    GHashTable *prev_pids = NULL, *prev_exes = NULL, *want;
+    GHashTable *pids, *exes;
+
+    G_LOCK(scanner);
+    if (scanner.pids) {
+        prev_pids = g_hash_table_ref(scanner.pids);
+        prev_exes = g_hash_table_ref(scanner.exes);
+    }
+    want = scanner.want;
+    scanner.want = NULL;
+    G_UNLOCK(scanner);
+
+    pids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    exes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    for (guint i = 0; i < snap->entries->len; i++) {
+        proc_entry_t *e = &g_array_index(snap->entries, proc_entry_t, i);
+        gpointer key = GINT_TO_POINTER(e->pid);
+        kp_proc_info_t *info = NULL;
+        gboolean new_exe;
+
+        new_exe = !g_hash_table_contains(exes, e->exe) &&
+                  !(prev_exes && g_hash_table_contains(prev_exes, e->exe));
+        g_hash_table_add(pids, key);
+        g_hash_table_add(exes, g_strdup(e->exe));
+
+        if (!prev_pids || !g_hash_table_contains(prev_pids, key)) {
+            info = snapshot_info_new(snap, e->pid);
+            info->ppid = kp_proc_get_ppid(e->pid);
+            info->uid = kp_proc_get_uid(e->pid);
+            if (info->ppid > 0)
+                info->parent_exe = kp_proc_get_exe(info->ppid);
+        }
+
+        if (new_exe || (want && g_hash_table_contains(want, key))) {
+            if (!info)
+                info = snapshot_info_new(snap, e->pid);
+            info->regions = read_regions(e->pid);
+        }
+    }
+
+    G_LOCK(scanner);
+    if (scanner.pids) {
+        g_hash_table_unref(scanner.pids);
+        g_hash_table_unref(scanner.exes);
+    }
+    scanner.pids = pids;
+    scanner.exes = exes;
+    G_UNLOCK(scanner);
+
+    if (prev_pids) {
+        g_hash_table_unref(prev_pids);
+        g_hash_table_unref(prev_exes);
+    }
+    if (want)
+        g_hash_table_destroy(want);
+}
+
 /**
- * Iterate over all running processes on the system
- *
- * Scans /proc for numeric directories (PIDs), reads /proc/PID/exe to get
- * the executable path, and calls the callback for each valid process.
+ * Read the executables of all running processes
  *
- * @param func       GHFunc callback: func(GINT_TO_POINTER(pid), exe_path, user_data)
- * @param user_data  Passed through to callback
+ * Scans /proc for numeric directories (PIDs) and reads /proc/PID/exe to
+ * get the executable path, then the details of new processes (see
+ * kp_proc_snapshot_info()). Touches nothing but /proc: safe off the main
+ * thread.
  *
  * SKIPPED PROCESSES:
  *   - Our own PID (self-preloading is pointless)
  *   - Kernel threads (no /proc/PID/exe symlink)
  *   - Processes that exit between scan and read
- *   - Files filtered by exeprefix configuration
  *
  * GRACEFUL DEGRADATION:
- *   If /proc cannot be opened (very unusual), logs a warning and returns.
- *   The daemon continues, hoping /proc becomes available next cycle.
+ *   If /proc cannot be opened (very unusual), logs a warning and returns
+ *   an empty snapshot. The daemon continues, hoping /proc becomes
+ *   available next cycle.
  */
-void
-kp_proc_foreach(GHFunc func, gpointer user_data)
+kp_proc_snapshot_t *
+kp_proc_snapshot(void)
 {
     DIR *proc;
     struct dirent *entry;
     pid_t selfpid = getpid();
     static int proc_fail_logged = 0;
+    kp_proc_snapshot_t *snap;
+
+    snap = g_new0(kp_proc_snapshot_t, 1);
+    snap->entries = g_array_new(FALSE, FALSE, sizeof(proc_entry_t));
 
-    proc = opendir("/proc");
+    proc = opendir(proc_root);
     if (!proc) {
         /* Graceful degradation: log once and skip this cycle */
         if (!proc_fail_logged) {
-            g_warning("failed opening /proc: %s - will retry next cycle", strerror(errno));
+            g_warning("failed opening %s: %s - will retry next cycle", proc_root, strerror(errno));
             proc_fail_logged = 1;
         }
-        return;  /* Skip this scan cycle, don't crash */
+        return snap;  /* Skip this scan cycle, don't crash */
     }
 
     /* Reset failure counter on success */
@@ -296,15 +685,16 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
     while ((entry = readdir(proc))) {
         if (all_digits(entry->d_name)) {
             pid_t pid;
-            char name[32];
+            char name[PATH_MAX];
             char exe_buffer[FILELEN];
             int len;
+            proc_entry_t e;
 
             pid = atoi(entry->d_name);
             if (pid == selfpid)
                 continue;
 
-            g_snprintf(name, sizeof(name) - 1, "/proc/%s/exe", entry->d_name);
+            g_snprintf(name, sizeof(name), "%s/%s/exe", proc_root, entry->d_name);
 
             len = readlink(name, exe_buffer, sizeof(exe_buffer));
 
@@ -313,8 +703,9 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
                 int err = errno;
                 if (err == EACCES || err == EPERM) {
                     /* Try fallback: read /proc/PID/cmdline for snap apps */
-                    char cmdline_path[64];
-                    g_snprintf(cmdline_path, sizeof(cmdline_path), "/proc/%s/cmdline", entry->d_name);
+                    char cmdline_path[PATH_MAX];
+                    g_snprintf(cmdline_path, sizeof(cmdline_path), "%s/%s/cmdline",
+                               proc_root, entry->d_name);
                     
                     FILE *cmdline_file = fopen(cmdline_path, "r");
                     if (cmdline_file) {
@@ -354,17 +745,92 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
 process_exe:
             if (!sanitize_file(exe_buffer))
                 continue;
-            
-            if (!accept_file(exe_buffer, kp_conf->system.exeprefix))
-                continue;
 
-            func(GUINT_TO_POINTER(pid), exe_buffer, user_data);
+            e.pid = pid;
+            e.exe = g_strdup(exe_buffer);
+            g_array_append_val(snap->entries, e);
         }
     }
 
     closedir(proc);
+    snapshot_read_details(snap);
+    return snap;
 }
 
+/**
+ * Call func for each process whose exe passes the exeprefix filter
+ */
+void
+kp_proc_snapshot_foreach(const kp_proc_snapshot_t *snap, GHFunc func, gpointer user_data)
+{
+    for (guint i = 0; i < snap->entries->len; i++) {
+        proc_entry_t *e = &g_array_index(snap->entries, proc_entry_t, i);
+
+        if (!accept_file(e->exe, kp_conf->system.exeprefix_set))
+            continue;
+
+        func(GUINT_TO_POINTER(e->pid), e->exe, user_data);
+    }
+}
+
+/**
+ * Free a snapshot
+ */
+void
+kp_proc_snapshot_free(kp_proc_snapshot_t *snap)
+{
+    if (!snap)
+        return;
+
+    for (guint i = 0; i < snap->entries->len; i++)
+        g_free(g_array_index(snap->entries, proc_entry_t, i).exe);
+    g_array_free(snap->entries, TRUE);
+    if (snap->info)
+        g_hash_table_destroy(snap->info);
+    g_free(snap);
+}
+
+/**
+ * Details read with a snapshot
+ */
+const kp_proc_info_t *
+kp_proc_snapshot_info(const kp_proc_snapshot_t *snap, pid_t pid)
+{
+    return snap->info ? g_hash_table_lookup(snap->info, GINT_TO_POINTER(pid)) : NULL;
+}
+
+/**
+ * Have the next snapshot read the regions of a process
+ */
+void
+kp_proc_want_regions(pid_t pid)
+{
+    G_LOCK(scanner);
+    if (!scanner.want)
+        scanner.want = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_hash_table_add(scanner.want, GINT_TO_POINTER(pid));
+    G_UNLOCK(scanner);
+}
+
+/**
+ * Iterate over all running processes on the system
+ *
+ * @param func       GHFunc callback: func(GINT_TO_POINTER(pid), exe_path, user_data)
+ * @param user_data  Passed through to callback
+ *
+ * Processes whose exe is filtered by the exeprefix configuration are
+ * skipped (see kp_proc_snapshot() for the others).
+ */
+void
+kp_proc_foreach(GHFunc func, gpointer user_data)
+{
+    kp_proc_snapshot_t *snap = kp_proc_snapshot();
+
+    kp_proc_snapshot_foreach(snap, func, user_data);
+    kp_proc_snapshot_free(snap);
+}
+
+
 /* Macros for reading /proc files (VERBATIM from upstream) */
 #define open_file(filename) G_STMT_START {              \
     int fd, len;                                        \
@@ -415,24 +881,29 @@ kp_proc_get_memstat(kp_memory_t *mem)
 {
     static int pagesize = 0;
     char buf[4096];
+    char path[PATH_MAX];
 
     memset(mem, 0, sizeof(*mem));
 
     if (!pagesize)
         pagesize = getpagesize();
 
-    open_file("/proc/meminfo");
+    snprintf(path, sizeof(path), "%s/meminfo", proc_root);
+    open_file(path);
     read_tag("MemTotal:", mem->total);
     read_tag("MemFree:", mem->free);
+    read_tag("MemAvailable:", mem->available);
     read_tag("Buffers:", mem->buffers);
     read_tag("Cached:", mem->cached);
 
-    open_file("/proc/vmstat");
+    snprintf(path, sizeof(path), "%s/vmstat", proc_root);
+    open_file(path);
     read_tag("pgpgin", mem->pagein);
     read_tag("pgpgout", mem->pageout);
 
     if (!mem->pagein) {
-        open_file("/proc/stat");
+        snprintf(path, sizeof(path), "%s/stat", proc_root);
+        open_file(path);
         read_tag2("page", mem->pagein, mem->pageout);
     }
 
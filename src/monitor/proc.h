@@ -25,12 +25,21 @@ typedef struct _kp_memory_t
     int free;       /* Free memory */
     int buffers;    /* Buffers memory */
     int cached;     /* Page-cache memory */
+    int available;  /* MemAvailable (0 before Linux 3.14) */
 
     int pagein;     /* Total data paged (read) in since boot */
     int pageout;    /* Total data paged (written) out since boot */
 
 } kp_memory_t;
 
+/**
+ * Set the root of the proc tree read by this module
+ *
+ * @param root  Directory laid out like /proc; NULL or "" for /proc.
+ *              Call before the pipeline threads start.
+ */
+void kp_proc_set_root(const char *root);
+
 /**
  * Read system memory information from /proc/meminfo and /proc/vmstat
  * (VERBATIM signature from upstream)
@@ -49,6 +58,40 @@ void kp_proc_get_memstat(kp_memory_t *mem);
  */
 size_t kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps);
 
+/**
+ * List distinct shared objects (.so / .so.N) mapped by a process
+ *
+ * @param pid Process ID to scan
+ * @return Array of paths owning its strings, or NULL if maps unreadable
+ */
+GPtrArray *kp_proc_get_shared_objects(pid_t pid);
+
+/**
+ * Get the real user owning a process
+ *
+ * @param pid Process ID
+ * @return Owner UID, or (uid_t)-1 if the process is gone
+ */
+uid_t kp_proc_get_uid(pid_t pid);
+
+/**
+ * Check whether a process exists
+ */
+gboolean kp_proc_exists(pid_t pid);
+
+/**
+ * Get the parent PID of a process
+ * @return Parent PID, or 0 if couldn't be determined
+ */
+pid_t kp_proc_get_ppid(pid_t pid);
+
+/**
+ * Get the executable of a process, as the /proc/PID/exe link reads
+ * (no prelink or "(deleted)" handling)
+ * @return Newly allocated path, or NULL if the process is gone
+ */
+char *kp_proc_get_exe(pid_t pid);
+
 /**
  * Iterate over all running processes
  * (VERBATIM signature from upstream)
@@ -58,4 +101,84 @@ size_t kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps);
  */
 void kp_proc_foreach(GHFunc func, gpointer user_data);
 
+/**
+ * kp_proc_region_t: One line of /proc/PID/maps naming a file
+ *
+ * Unfiltered: mapprefix is applied by kp_proc_regions_to_maps() and
+ * kp_proc_regions_objects() on the main loop.
+ */
+typedef struct _kp_proc_region_t
+{
+    char *path;
+    size_t offset;
+    size_t length;
+} kp_proc_region_t;
+
+/**
+ * kp_proc_info_t: Details of a process, read along with a snapshot
+ */
+typedef struct _kp_proc_info_t
+{
+    pid_t ppid;             /* 0 if unknown */
+    uid_t uid;              /* (uid_t)-1 if unknown */
+    char *parent_exe;       /* NULL if unknown */
+    GArray *regions;        /* kp_proc_region_t, NULL if not read */
+} kp_proc_info_t;
+
+/**
+ * kp_proc_snapshot_t: Running processes and their executables
+ *
+ * Taking a snapshot only reads /proc, so the pipeline's scan thread can
+ * do it; the exeprefix filter is applied by kp_proc_snapshot_foreach()
+ * on the main loop, where the configuration lives.
+ *
+ * The snapshot also reads what the main loop would otherwise read for
+ * each new process (see kp_proc_snapshot_info()).
+ */
+typedef struct _kp_proc_snapshot_t kp_proc_snapshot_t;
+
+/**
+ * Read the pid → exe table from /proc
+ */
+kp_proc_snapshot_t *kp_proc_snapshot(void);
+
+/**
+ * Call func(pid, exe path, user_data) for each accepted process
+ */
+void kp_proc_snapshot_foreach(const kp_proc_snapshot_t *snap, GHFunc func, gpointer user_data);
+
+/**
+ * Details read with a snapshot
+ *
+ * Parent, parent exe and owner are read for pids that were not in the
+ * previous snapshot; regions for the first pid of an exe that was not,
+ * and for pids passed to kp_proc_want_regions() since.
+ *
+ * @return  NULL if nothing was read for @pid; read it directly then
+ */
+const kp_proc_info_t *kp_proc_snapshot_info(const kp_proc_snapshot_t *snap, pid_t pid);
+
+/**
+ * Have the next snapshot read the regions of a process
+ *
+ * Safe from any thread.
+ */
+void kp_proc_want_regions(pid_t pid);
+
+/**
+ * Turn regions into model maps, as kp_proc_get_maps() does (main thread)
+ */
+size_t kp_proc_regions_to_maps(const GArray *regions, GHashTable *maps, GSet **exemaps);
+
+/**
+ * Shared objects among regions, as kp_proc_get_shared_objects() lists
+ * them (main thread)
+ */
+GPtrArray *kp_proc_regions_objects(const GArray *regions);
+
+/**
+ * Free a snapshot
+ */
+void kp_proc_snapshot_free(kp_proc_snapshot_t *snap);
+
 #endif /* PROC_H */
@@ -43,6 +43,11 @@
  *   - time: Total time spent running (for frequency weighting)
  *   - change_timestamp: Last state transition (running ↔ not running)
  *
+ * PLUGIN SAMPLING:
+ *   Once per run of a priority app, after it has been up for one cycle,
+ *   the shared objects it mapped are recorded (kp_closure_record_plugins)
+ *   so its closure can preload dlopen()ed plugins it actually uses.
+ *
  * =============================================================================
  */
 
@@ -50,7 +55,9 @@
 #include "spy.h"
 #include "../config/config.h"
 #include "../state/state.h"
+#include "../state/state_closure.h"
 #include "../daemon/stats.h"
+#include "../daemon/trace.h"
 #include "../utils/desktop.h"
 #include "proc.h"
 #include <math.h>
@@ -62,7 +69,42 @@
  */
 static GSList *state_changed_exes;  /* Exes that started or stopped running */
 static GSList *new_running_exes;    /* Currently running exe list (rebuilt each scan) */
-static GHashTable *new_exes;        /* Newly discovered exe paths → PIDs */
+static GHashTable *new_exes;        /* Newly discovered exe paths → new_exe_t* */
+static const kp_proc_snapshot_t *scan_snap;    /* Snapshot being applied */
+
+/* A newly discovered exe, with what the snapshot read of its process */
+typedef struct {
+    pid_t pid;
+    uid_t uid;              /* KP_UID_UNKNOWN if not read */
+    GArray *regions;        /* kp_proc_region_t copies, NULL if not read */
+} new_exe_t;
+
+static GArray *
+regions_dup(const GArray *regions)
+{
+    GArray *copy = g_array_sized_new(FALSE, FALSE, sizeof(kp_proc_region_t), regions->len);
+
+    for (guint i = 0; i < regions->len; i++) {
+        kp_proc_region_t r = g_array_index(regions, kp_proc_region_t, i);
+
+        r.path = g_strdup(r.path);
+        g_array_append_val(copy, r);
+    }
+    return copy;
+}
+
+static void
+new_exe_free(gpointer data)
+{
+    new_exe_t *ne = data;
+
+    if (ne->regions) {
+        for (guint i = 0; i < ne->regions->len; i++)
+            g_free(g_array_index(ne->regions, kp_proc_region_t, i).path);
+        g_array_free(ne->regions, TRUE);
+    }
+    g_free(ne);
+}
 
 /*
  * =============================================================================
@@ -70,51 +112,10 @@ static GHashTable *new_exes;        /* Newly discovered exe paths → PIDs */
  * =============================================================================
  */
 
-/**
- * Get parent PID of a process
- *
- * @param pid  Process ID
- * @return Parent PID, or 0 if couldn't be determined
- *
- * Reads field 4 from /proc/{pid}/stat which contains the parent PID.
- */ 
-pid_t
-get_parent_pid(pid_t pid)
-{
-    char stat_path[64];
-    FILE *fp;
-    pid_t ppid = 0;
-    
-    snprintf(stat_path, sizeof(stat_path), "/proc/%d/stat", pid);
-    fp = fopen(stat_path, "r");
-    if (!fp)
-        return 0;
-    
-    /* Format: pid (comm) state ppid ...
-     * SECURITY FIX (B013/B016): comm is in parentheses and can contain
-     * spaces, newlines, or any character except ')'. Use %*s to skip
-     * to the last ')' then parse remaining fields.
-     */
-    char line[1024];
-    if (fgets(line, sizeof(line), fp)) {
-        /* Find last ')' - comm field ends there */
-        char *close_paren = strrchr(line, ')');
-        if (close_paren && close_paren[1] == ' ') {
-            /* Parse: " state ppid ..." after the closing paren */
-            char state;
-            if (sscanf(close_paren + 2, "%c %d", &state, &ppid) != 2)
-                ppid = 0;
-        }
-    }
-    
-    fclose(fp);
-    return ppid;
-}
-
 /**
  * Detect if process was initiated by user (not automated/script)
  *
- * @param parent_pid  Parent process ID
+ * @param parent_exe_path  Executable of the parent process, NULL if unknown
  * @return TRUE if user-initiated (shell, terminal, desktop launcher)
  *
  * HEURISTICS:
@@ -125,22 +126,15 @@ get_parent_pid(pid_t pid)
  * Graceful fallback: If parent cannot be determined, assume automated.
  */
 static gboolean
-is_user_initiated(pid_t parent_pid)
+is_user_initiated(const char *parent_exe_path)
 {
-    char parent_exe_path[PATH_MAX];
     char *parent_basename;
     gboolean result = FALSE;
 
-    /* Read /proc/{parent_pid}/exe */
-    char proc_path[64];
-    snprintf(proc_path, sizeof(proc_path), "/proc/%d/exe", parent_pid);
-    
-    ssize_t len = readlink(proc_path, parent_exe_path, sizeof(parent_exe_path) - 1);
-    if (len < 0) {
+    if (!parent_exe_path) {
         /* Parent process may have exited, assume automated */
         return FALSE;
     }
-    parent_exe_path[len] = '\0';
 
     parent_basename = g_path_get_basename(parent_exe_path);
     
@@ -262,9 +256,10 @@ exe_has_user_initiated_running(kp_exe_t *exe)
  * @param exe         Executable structure
  * @param pid         Process ID
  * @param parent_pid  Parent process ID
+ * @param parent_exe  Executable of the parent, NULL if unknown
  */
 static void
-track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid)
+track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid, const char *parent_exe)
 {
     process_info_t *proc_info;
     time_t now = time(NULL);
@@ -281,7 +276,7 @@ track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid)
     proc_info->parent_pid = parent_pid;
     proc_info->start_time = now;
     proc_info->last_weight_update = now;
-    proc_info->user_initiated = is_user_initiated(parent_pid);
+    proc_info->user_initiated = is_user_initiated(parent_exe);
     
     /* FALLBACK for snap/flatpak/container apps:
      * Only triggers when is_user_initiated() returned FALSE.
@@ -322,6 +317,7 @@ track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid)
     }
     
     g_hash_table_insert(exe->running_pids, GINT_TO_POINTER(pid), proc_info);
+    kp_trace_exec(pid, parent_pid, proc_info->user_initiated, exe);
 }
 
 /**
@@ -365,6 +361,7 @@ track_process_exit(kp_exe_t *exe, pid_t pid)
     }
     
     exe->total_duration_sec += (unsigned long)total_duration;
+    kp_trace_exit(pid);
     
     /* NOTE: Do NOT remove from hash table here - it's done automatically by
      * g_hash_table_foreach_remove() when clean_exited_pids_callback returns TRUE */
@@ -379,9 +376,7 @@ track_process_exit(kp_exe_t *exe, pid_t pid)
 static gboolean
 is_pid_alive(pid_t pid)
 {
-    char proc_path[64];
-    snprintf(proc_path, sizeof(proc_path), "/proc/%d", pid);
-    return g_file_test(proc_path, G_FILE_TEST_EXISTS);
+    return kp_proc_exists(pid);
 }
 
 /**
@@ -460,6 +455,46 @@ update_running_weights(kp_exe_t *exe)
 }
 
 
+/**
+ * Record plugins mapped by a priority app, once per run
+ *
+ * Sampling waits one cycle after process start so that plugins loaded
+ * during initialization are already mapped. The maps come from the
+ * snapshot: when due, the next snapshot is asked to read them.
+ */
+static void
+sample_plugins(kp_exe_t *exe, pid_t pid)
+{
+    process_info_t *proc_info;
+    const kp_proc_info_t *info;
+    GPtrArray *sos;
+
+    if (exe->pool != POOL_PRIORITY)
+        return;
+
+    proc_info = g_hash_table_lookup(exe->running_pids, GINT_TO_POINTER(pid));
+    if (!proc_info || proc_info->plugins_sampled)
+        return;
+
+    if (time(NULL) - proc_info->start_time < kp_conf->model.cycle)
+        return;
+
+    info = kp_proc_snapshot_info(scan_snap, pid);
+    if (!info || !info->regions) {
+        kp_proc_want_regions(pid);
+        return;
+    }
+
+    proc_info->plugins_sampled = TRUE;
+
+    sos = kp_proc_regions_objects(info->regions);
+    if (!sos)
+        return;
+
+    kp_closure_record_plugins(exe->path, sos);
+    g_ptr_array_free(sos, TRUE);
+}
+
 /**
  * Callback for every running process
  * Check whether we know what it is, and add it to appropriate list
@@ -468,10 +503,16 @@ update_running_weights(kp_exe_t *exe)
 static void
 running_process_callback(pid_t pid, const char *path)
 {
+    const kp_proc_info_t *info;
     kp_exe_t *exe;
 
     g_return_if_fail(path);
 
+    /* Read by the scan for new pids; direct reads are the fallback */
+    info = kp_proc_snapshot_info(scan_snap, pid);
+    if (info && info->uid == KP_UID_UNKNOWN)
+        info = NULL;
+
     exe = g_hash_table_lookup(kp_state->exes, path);
     if (exe) {
         /* Already existing exe */
@@ -487,13 +528,36 @@ running_process_callback(pid_t pid, const char *path)
         
         /* Track process start for weighted counting */
         if (!g_hash_table_lookup(exe->running_pids, GINT_TO_POINTER(pid))) {
-            pid_t parent_pid = get_parent_pid(pid);
-            track_process_start(exe, pid, parent_pid);
+            uid_t uid;
+
+            if (info) {
+                uid = info->uid;
+                track_process_start(exe, pid, info->ppid, info->parent_exe);
+            } else {
+                pid_t parent_pid = kp_proc_get_ppid(pid);
+                char *parent_exe = kp_proc_get_exe(parent_pid);
+
+                uid = kp_proc_get_uid(pid);
+                track_process_start(exe, pid, parent_pid, parent_exe);
+                g_free(parent_exe);
+            }
+            if (uid != KP_UID_UNKNOWN)
+                exe->uid = uid;     /* Session preload picks per-user apps */
+        } else {
+            sample_plugins(exe, pid);
         }
 
-    } else if (!g_hash_table_lookup(kp_state->bad_exes, path)) {
+    } else if (!g_hash_table_lookup(kp_state->bad_exes, path) &&
+               !g_hash_table_contains(new_exes, path)) {
         /* An exe we have never seen before, just queue it */
-        g_hash_table_insert(new_exes, g_strdup(path), GUINT_TO_POINTER(pid));
+        new_exe_t *ne = g_new0(new_exe_t, 1);
+        const kp_proc_info_t *snap_info = kp_proc_snapshot_info(scan_snap, pid);
+
+        ne->pid = pid;
+        ne->uid = info ? info->uid : KP_UID_UNKNOWN;
+        if (snap_info && snap_info->regions)
+            ne->regions = regions_dup(snap_info->regions);
+        g_hash_table_insert(new_exes, g_strdup(path), ne);
     }
 }
 
@@ -516,12 +580,16 @@ already_running_exe_callback(kp_exe_t *exe)
  * (VERBATIM from upstream new_exe_callback)
  */
 static void
-new_exe_callback(char *path, pid_t pid)
+new_exe_callback(char *path, const new_exe_t *ne)
 {
     gboolean want_it;
     size_t size;
 
-    size = kp_proc_get_maps(pid, NULL, NULL);
+    /* Maps read by the scan when the process was first seen, if any */
+    if (ne->regions)
+        size = kp_proc_regions_to_maps(ne->regions, NULL, NULL);
+    else
+        size = kp_proc_get_maps(ne->pid, NULL, NULL);
 
     if (!size) /* process died or something */
         return;
@@ -532,7 +600,10 @@ new_exe_callback(char *path, pid_t pid)
         kp_exe_t *exe;
         GSet *exemaps;
 
-        size = kp_proc_get_maps(pid, kp_state->maps, &exemaps);
+        if (ne->regions)
+            size = kp_proc_regions_to_maps(ne->regions, kp_state->maps, &exemaps);
+        else
+            size = kp_proc_get_maps(ne->pid, kp_state->maps, &exemaps);
         if (!size) {
             /* Process just died, clean up */
             g_set_foreach(exemaps, (GFunc)(void (*)(void))kp_exemap_free, NULL);
@@ -541,6 +612,8 @@ new_exe_callback(char *path, pid_t pid)
         }
 
         exe = kp_exe_new(path, TRUE, exemaps);
+        exe->uid = ne->uid != KP_UID_UNKNOWN ? ne->uid : kp_proc_get_uid(ne->pid);
+        exe->pool = kp_stats_classify(path);    /* Decides Markov creation */
         kp_state_register_exe(exe, TRUE);
         kp_state->running_exes = g_slist_prepend(kp_state->running_exes, exe);
 
@@ -603,12 +676,33 @@ already_running_exe_callback_wrapper(gpointer data, gpointer user_data)
     already_running_exe_callback((kp_exe_t *)data);
 }
 
+/* Activity of the last scan, for kp_spy_last_activity() */
+static int last_scan_changes = 0;
+static int last_scan_launches = 0;
+
+/* Count exes that started running (GFunc for g_slist_foreach) */
+static void
+count_launch(gpointer data, gpointer user_data)
+{
+    if (exe_is_running((kp_exe_t *)data))
+        (*(int *)user_data)++;
+}
+
 void
 kp_spy_scan(gpointer data)
+{
+    kp_proc_snapshot_t *snap = kp_proc_snapshot();
+
+    kp_spy_scan_snapshot(snap, data);
+    kp_proc_snapshot_free(snap);
+}
+
+void
+kp_spy_scan_snapshot(const kp_proc_snapshot_t *snap, gpointer data)
 {
     /* Scan processes */
     state_changed_exes = new_running_exes = NULL;
-    new_exes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    new_exes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, new_exe_free);
 
     /* Clean exited PIDs first so app restarts are counted as new launches */
     GHashTableIter iter;
@@ -620,7 +714,9 @@ kp_spy_scan(gpointer data)
     }
 
     /* Mark each running exe with fresh timestamp */
-    kp_proc_foreach(running_process_callback_wrapper, data);
+    scan_snap = snap;
+    kp_proc_snapshot_foreach(snap, running_process_callback_wrapper, data);
+    scan_snap = NULL;
     kp_state->last_running_timestamp = kp_state->time;
 
     /* Figure out who's not running by checking their timestamp */
@@ -635,6 +731,22 @@ kp_spy_scan(gpointer data)
 
     g_slist_free(kp_state->running_exes);
     kp_state->running_exes = new_running_exes;
+
+    /* Never-seen exes are launches too */
+    last_scan_launches = g_hash_table_size(new_exes);
+    g_slist_foreach(state_changed_exes, count_launch, &last_scan_launches);
+    last_scan_changes = g_slist_length(state_changed_exes) + g_hash_table_size(new_exes);
+}
+
+/**
+ * Activity seen by the last scan
+ */
+int
+kp_spy_last_activity(int *launches)
+{
+    if (launches)
+        *launches = last_scan_launches;
+    return last_scan_changes;
 }
 
 /* Wrapper with correct GHFunc signature for new_exe_callback */
@@ -642,7 +754,7 @@ static void
 new_exe_callback_wrapper(gpointer key, gpointer value, gpointer user_data)
 {
     (void)user_data;
-    new_exe_callback((char *)key, GPOINTER_TO_INT(value));
+    new_exe_callback((char *)key, value);
 }
 
 /* Wrapper with correct GFunc signature for exe_changed_callback */
@@ -733,9 +845,7 @@ get_foreground_time_ratio(process_info_t *proc_info)
 static gboolean __attribute__((unused))
 is_process_still_running(pid_t pid)
 {
-    char proc_path[64];
-    snprintf(proc_path, sizeof(proc_path), "/proc/%d", pid);
-    return (access(proc_path, F_OK) == 0);
+    return kp_proc_exists(pid);
 }
 
 /* Note: Integrate into clean_exited_pids_callback for proper handling */
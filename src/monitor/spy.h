@@ -13,16 +13,31 @@
 #ifndef SPY_H
 #define SPY_H
 
+#include "proc.h"
+
 /**
  * Scan running processes
  * (VERBATIM signature from upstream preload_spy_scan)
  */
 void kp_spy_scan(gpointer data);
 
+/**
+ * Scan using a process table read earlier (e.g. by the scan thread)
+ */
+void kp_spy_scan_snapshot(const kp_proc_snapshot_t *snap, gpointer data);
+
 /**
  * Update prediction model
  * (VERBATIM signature from upstream preload_spy_update_model)
  */
 void kp_spy_update_model(gpointer data);
 
+/**
+ * Activity seen by the last scan (drives the adaptive cycle)
+ *
+ * @param launches  Out: exes that started running (may be NULL)
+ * @return          Exes that changed state, started or stopped
+ */
+int kp_spy_last_activity(int *launches);
+
 #endif /* SPY_H */
@@ -19,7 +19,8 @@
  *
  *   1. RESET: Zero all exe and map probabilities
  *
- *   2. BOOST MANUAL APPS: Apps in /etc/preheat.d/apps.list get priority
+ *   2. BOOST MANUAL APPS: Apps in /etc/preheat.d/apps.list get priority,
+ *      then session top apps and live hints (daemon/hints.c)
  *
  *   3. MARKOV → EXE: Each Markov chain bids on its exes
  *      ┌─────────────────────────────────────────────────────────────┐
@@ -37,7 +38,16 @@
  *
  *   5. SORT: Maps sorted by lnprob (most negative = most needed)
  *
- *   6. READAHEAD: Preload maps until memory budget exhausted
+ *   5b. DEADLINES: Alongside lnprob, Markov bids accumulate a launch rate
+ *      per exe; 1/rate is its expected time-to-launch, and each map gets
+ *      the earliest one of the exes using it (map.eta). readahead.c
+ *      schedules batches earliest-deadline-first from it.
+ *
+ *   6. COST RANKING (model.costmodel): Maps that are likely needed
+ *      (lnprob < 0) are re-ranked by expected launch latency saved per
+ *      second of readahead I/O, using the per-device model in iocost.c
+ *
+ *   7. READAHEAD: Preload maps until memory budget exhausted
  *
  * PROBABILITY MATH:
  *   We compute log-probability of NOT needing each item:
@@ -57,11 +67,20 @@
 #include "prophet.h"
 #include "../utils/logging.h"
 #include "../config/config.h"
-#include "../config/blacklist.h"
 #include "../state/state.h"
+#include "../state/state_closure.h"
+#include "../state/state_hotset.h"
 #include "../monitor/proc.h"
 #include "../readahead/readahead.h"
+#include "../readahead/iocost.h"
+#include "../daemon/power.h"
+#include "../daemon/pause.h"
+#include "../daemon/pipeline.h"
+#include "../daemon/session.h"
+#include "../daemon/hints.h"
 #include "../daemon/stats.h"
+#include "../daemon/startup.h"
+#include "../daemon/trace.h"
 
 #include <math.h>
 
@@ -75,6 +94,8 @@
  */
 #define MANUAL_APP_BOOST_LNPROB -10.0
 
+#define SESSION_TOP_APPS 5          /* Apps boosted per user at login */
+
 /* CRITICAL ALGORITHM: Markov-based probability inference
  * (VERBATIM from upstream lines 33-49)
  *
@@ -121,7 +142,7 @@ markov_bid_for_exe(kp_markov_t *markov,
      * 1.5 multiplier: Empirically tuned from upstream preload.
      * Provides lookahead beyond current cycle to catch transitions.
      */
-    p_state_change = -kp_conf->model.cycle * 1.5 / markov->time_to_leave[state];
+    p_state_change = -kp_state->cycle * 1.5 / markov->time_to_leave[state];
     p_state_change = 1 - exp(p_state_change);
 
     /* p_y_runs_next estimates the probability that Y runs, given that a state
@@ -147,6 +168,11 @@ markov_bid_for_exe(kp_markov_t *markov,
     p_runs = correlation * p_state_change * p_y_runs_next;
 
     y->lnprob += log(1 - p_runs);
+
+    /* Same bid as a rate: the state is left at rate 1/time_to_leave and
+     * a fraction p_y_runs_next of departures start Y. Competing chains
+     * add up, so 1/Σrate is Y's expected time-to-launch. */
+    y->launch_rate += correlation * MIN(1.0, p_y_runs_next) / markov->time_to_leave[state];
 }
 
 /**
@@ -177,6 +203,7 @@ static void
 map_zero_prob(kp_map_t *map)
 {
     map->lnprob = 0;
+    map->eta = G_MAXDOUBLE;
 }
 
 /**
@@ -190,6 +217,62 @@ map_prob_compare(const kp_map_t **pa, const kp_map_t **pb)
     return a->lnprob < b->lnprob ? -1 : a->lnprob > b->lnprob ? 1 : 0;
 }
 
+/* Candidate map with its cost-model score */
+typedef struct {
+    kp_map_t *map;
+    double score;
+} map_score_t;
+
+static int
+map_score_compare(gconstpointer a, gconstpointer b)
+{
+    const map_score_t *sa = a, *sb = b;
+
+    if (sa->score != sb->score)
+        return sa->score > sb->score ? -1 : 1;
+    /* Tie: keep probability order */
+    return sa->map->lnprob < sb->map->lnprob ? -1 : sa->map->lnprob > sb->map->lnprob ? 1 : 0;
+}
+
+/**
+ * Re-rank likely-needed maps by latency saved per unit of I/O
+ *
+ * Only the prefix with lnprob < 0 is touched; it stays a prefix, so
+ * the budget cutoff in kp_prophet_readahead() works unchanged.
+ *
+ * @param maps_arr  Maps sorted by lnprob
+ */
+static void
+rank_by_cost(GPtrArray *maps_arr)
+{
+    GArray *ranked;
+    guint n = 0;
+
+    while (n < maps_arr->len &&
+           ((kp_map_t *)g_ptr_array_index(maps_arr, n))->lnprob < 0)
+        n++;
+
+    if (n < 2)
+        return;
+
+    ranked = g_array_sized_new(FALSE, FALSE, sizeof(map_score_t), n);
+    for (guint i = 0; i < n; i++) {
+        map_score_t ms;
+
+        ms.map = g_ptr_array_index(maps_arr, i);
+        /* lnprob = log P(not needed) */
+        ms.score = kp_iocost_map_score(ms.map, 1.0 - exp(ms.map->lnprob));
+        g_array_append_val(ranked, ms);
+    }
+
+    g_array_sort(ranked, map_score_compare);
+
+    for (guint i = 0; i < n; i++)
+        maps_arr->pdata[i] = g_array_index(ranked, map_score_t, i).map;
+
+    g_array_free(ranked, TRUE);
+}
+
 /**
  * Zero exe probability
  * (VERBATIM from upstream exe_zero_prob, extended with blacklist check)
@@ -198,11 +281,13 @@ static void
 exe_zero_prob(gpointer G_GNUC_UNUSED key, kp_exe_t *exe)
 {
     /* Skip blacklisted apps - they get no probability boost */
-    if (kp_blacklist_contains(exe->path)) {
+    if (exe->blacklisted) {
         exe->lnprob = 1;  /* Positive = low priority, won't be preloaded */
+        exe->launch_rate = 0;
         return;
     }
     exe->lnprob = 0;
+    exe->launch_rate = 0;
 }
 
 /* CRITICAL ALGORITHM: Map probability inference
@@ -243,6 +328,10 @@ exemap_bid_in_maps(kp_exemap_t *exemap, kp_exe_t *exe)
         /* Normal case: Accumulate exe's lnprob into map's lnprob.
          * This implements: lnprob(M) = Σ lnprob(Xi) for non-running exes. */
         exemap->map->lnprob += exe->lnprob;
+
+        /* Deadline: needed when the first of its exes launches */
+        if (exe->launch_rate > 0)
+            exemap->map->eta = MIN(exemap->map->eta, 1.0 / exe->launch_rate);
     }
 }
 
@@ -298,8 +387,8 @@ exemap_bid_in_maps_wrapper(gpointer exemap, gpointer exe, gpointer user_data)
  * Record preload timestamps for exes whose maps are being preloaded.
  * Used for hit/miss tracking when processes start.
  */
-static void
-record_preloaded_exes(kp_map_t **maps, int count)
+void
+kp_prophet_record_preloaded_exes(kp_map_t **maps, int count)
 {
     GHashTable *recorded = g_hash_table_new(g_str_hash, g_str_equal);
     
@@ -335,24 +424,50 @@ record_preloaded_exes(kp_map_t **maps, int count)
     g_hash_table_destroy(recorded);
 }
 
-void
-kp_prophet_readahead(GPtrArray *maps_arr)
+/* Monotonic time of the last readahead batch (battery coalescing) */
+static gint64 last_batch_us = 0;
+
+/**
+ * Memory we are allowed to use for prefetching, in kilobytes
+ * (VERBATIM upstream formula lines 196-199)
+ */
+static long
+memory_budget_kb(const kp_memory_t *memstat)
+{
+    const kp_power_budget_t *budget = kp_power_budget();
+    long memavail;
+
+    memavail  = clamp_percent(budget->memtotal)  * (memstat->total  / 100)
+              + clamp_percent(budget->memfree)   * (memstat->free   / 100);
+    memavail  = max(0, memavail);
+    memavail += clamp_percent(budget->memcached) * (memstat->cached / 100);
+
+    return memavail;
+}
+
+/**
+ * Select maps within the memory budget and read them in
+ *
+ * @param maps_arr  Maps sorted by prediction
+ * @param rewarm    Skip fully resident maps and don't coalesce
+ */
+static void
+prophet_readahead(GPtrArray *maps_arr, gboolean rewarm)
 {
     int i;
     long memavail, memavailtotal; /* in kilobytes - use long for 32-bit safety */
     kp_memory_t memstat;
     kp_map_t *map;
+    const kp_power_budget_t *budget = kp_power_budget();
+    gboolean urgent = FALSE, coalesced = FALSE;
+    GPtrArray *cold_set = rewarm ? g_ptr_array_new() : NULL;
+    int resident = 0;
+    kp_map_t **batch;
+    int count;
 
     kp_proc_get_memstat(&memstat);
 
-    /* Memory we are allowed to use for prefetching
-     * (VERBATIM upstream formula lines 196-199)
-     */
-    memavail  = clamp_percent(kp_conf->model.memtotal)  * (memstat.total  / 100)
-              + clamp_percent(kp_conf->model.memfree)   * (memstat.free   / 100);
-    memavail  = max(0, memavail);
-    memavail += clamp_percent(kp_conf->model.memcached) * (memstat.cached / 100);
-
+    memavail = memory_budget_kb(&memstat);
     memavailtotal = memavail;
 
     memcpy(&(kp_state->memstat), &memstat, sizeof(memstat));
@@ -364,80 +479,158 @@ kp_prophet_readahead(GPtrArray *maps_arr)
            map->lnprob < 0 && kb(map->length) <= memavail) {
         i++;
 
+        /* Still in the page cache after resume: nothing to read */
+        if (rewarm) {
+            if (kp_readahead_cold_bytes(map) == 0) {
+                resident++;
+                continue;
+            }
+            g_ptr_array_add(cold_set, map);
+        }
+
         memavail -= kb(map->length);
 
+        if (map->eta <= kp_state->cycle)
+            urgent = TRUE;
+
         /* Debug logging for individual maps (if log level high enough) */
         if (kp_is_debugging()) {
-            g_debug("ln(prob(~MAP)) = %13.10lf %s", map->lnprob, map->path);
+            g_debug("ln(prob(~MAP)) = %13.10lf cost %.0f us eta %.0f s %s",
+                    map->lnprob, map->cost_us,
+                    map->eta < G_MAXDOUBLE ? map->eta : -1.0, map->path);
         }
     }
 
     g_debug("%ldkb available for preloading, using %ldkb of it",
             memavailtotal, memavailtotal - memavail);
 
-    if (i) {
+    /* On battery, merge batches so the disk can stay idle in between.
+     * An app expected within this cycle still gets its files now. */
+    batch = rewarm ? (kp_map_t **)cold_set->pdata : (kp_map_t **)maps_arr->pdata;
+    count = rewarm ? (int)cold_set->len : i;
+
+    if (rewarm)
+        g_message("resume rewarm: %d files cold, %d still resident", count, resident);
+
+    if (count && !rewarm && budget->coalesce > 0 && !urgent) {
+        gint64 now = g_get_monotonic_time();
+        coalesced = last_batch_us &&
+                    now - last_batch_us < (gint64)budget->coalesce * G_USEC_PER_SEC;
+    }
+
+    kp_trace_cycle(memavailtotal, memavailtotal - memavail, (int)maps_arr->len, i,
+                   (urgent ? KP_TRACE_F_URGENT : 0) |
+                   (rewarm ? KP_TRACE_F_REWARM : 0) |
+                   (coalesced ? KP_TRACE_F_COALESCED : 0));
+
+    if (coalesced) {
+        g_debug("coalescing readahead of %d files into a later batch", count);
+        return;
+    }
+
+    if (count) {
+        last_batch_us = g_get_monotonic_time();
+        kp_trace_readahead(batch, count, rewarm ? KP_TRACE_F_REWARM : 0);
+
         /* Record preload times for hit tracking */
-        record_preloaded_exes((kp_map_t **)maps_arr->pdata, i);
-        
-        i = kp_readahead((kp_map_t **)maps_arr->pdata, i);
-        g_debug("readahead %d files", i);
+        kp_prophet_record_preloaded_exes(batch, count);
+
+        /* The top of the prediction is what the next boot reads first */
+        if (!rewarm)
+            kp_hotset_record(batch, count);
+
+        /* Off the main loop when the I/O thread runs; it accounts the
+         * batch when it comes back */
+        if (!kp_pipeline_readahead(batch, count)) {
+            count = kp_readahead(batch, count);
+            kp_startup_first_preload();
+            g_debug("readahead %d files", count);
+        }
     } else {
         g_debug("nothing to readahead");
     }
+
+    if (cold_set)
+        g_ptr_array_free(cold_set, TRUE);
+}
+
+void
+kp_prophet_readahead(GPtrArray *maps_arr)
+{
+    prophet_readahead(maps_arr, FALSE);
+}
+
+/**
+ * Read in the hot set saved with the state, before the model is loaded
+ */
+int
+kp_prophet_readahead_hotset(void)
+{
+    GPtrArray *hot = kp_hotset_maps();
+    kp_readahead_opts_t opts;
+    kp_memory_t memstat;
+    kp_map_t **batch;
+    long memavail;
+    int count = 0;
+
+    if (!hot || !kp_conf->system.dopredict || kp_pause_is_active())
+        return 0;
+
+    kp_proc_get_memstat(&memstat);
+    memavail = memory_budget_kb(&memstat);
+
+    /* Saved in ranking order: keep the prefix that fits today's budget */
+    batch = g_new(kp_map_t *, hot->len);
+    for (guint i = 0; i < hot->len; i++) {
+        kp_map_t *map = g_ptr_array_index(hot, i);
+        if (kb(map->length) > memavail)
+            break;
+        memavail -= kb(map->length);
+        batch[count++] = map;
+    }
+
+    if (count) {
+        last_batch_us = g_get_monotonic_time();
+        kp_trace_readahead(batch, count, KP_TRACE_F_HOTSET);
+
+        /* kp_state is still being loaded on another thread: take the
+         * cycle from the configuration */
+        kp_readahead_opts_init(&opts, kp_conf->model.cycle);
+        count = kp_readahead_with_opts(batch, count, &opts);
+        kp_startup_first_preload();
+        g_message("Hot set: %d readahead requests from %u saved files", count, hot->len);
+    }
+
+    g_free(batch);
+    return count;
 }
 
 /**
  * Load memory maps for an executable that has none (lazy loading)
  * 
- * Creates a single map covering the entire binary file. This is used for
- * manual apps that weren't discovered through process scanning.
+ * Attaches the binary plus its resolved library closure. The closure is
+ * cached persistently in the state, so this is a few stat() calls after
+ * the first resolution. Used for manual apps that weren't discovered
+ * through process scanning.
  * 
  * @param exe Executable to load maps for
- * @return TRUE if successfully loaded, FALSE if file doesn't exist or is too small
+ * @return TRUE if any map was loaded, FALSE if file doesn't exist or is too small
  */
 static gboolean
 load_maps_for_exe(kp_exe_t *exe)
 {
-    struct stat st;
-    kp_map_t *map;
-    kp_exemap_t *exemap;
+    int loaded;
     
     g_return_val_if_fail(exe, FALSE);
     g_return_val_if_fail(exe->path, FALSE);
     
-    /* Check if file exists and get size */
-    if (stat(exe->path, &st) < 0) {
-        g_warning("Cannot stat manual app: %s (%s)", exe->path, strerror(errno));
+    loaded = kp_closure_load_maps(exe);
+    if (loaded == 0) {
+        g_debug("Manual app has nothing to preload: %s", exe->path);
         return FALSE;
     }
     
-    /* Check minimum size threshold */
-    if ((size_t)st.st_size < (size_t)kp_conf->model.minsize) {
-        g_debug("Manual app too small to preload: %s (%zu bytes < %d)",
-                exe->path, (size_t)st.st_size, kp_conf->model.minsize);
-        return FALSE;
-    }
-    
-    /* Create single map for entire file */
-    map = kp_map_new(exe->path, 0, st.st_size);
-    if (!map) {
-        g_warning("Failed to create map for manual app: %s", exe->path);
-        return FALSE;
-    }
-    
-    /* Create exemap and add to exe.
-     * NOTE: kp_exe_map_new() takes ownership of map via kp_map_ref(),
-     * but if it fails, we must free the map ourselves. */
-    exemap = kp_exe_map_new(exe, map);
-    if (!exemap) {
-        g_warning("Failed to create exemap for manual app: %s", exe->path);
-        kp_map_free(map);  /* FIX: Prevent memory leak on failure */
-        return FALSE;
-    }
-    
-    exemap->prob = 1.0;  /* Assume entire file is needed */
-    
-    g_debug("Loaded map for manual app: %s (%zu bytes)", exe->path, (size_t)st.st_size);
+    g_debug("Loaded %d maps for manual app: %s (%zu bytes)", loaded, exe->path, exe->size);
     
     return TRUE;
 }
@@ -477,8 +670,10 @@ boost_manual_apps(void)
                 }
             }
             
-            /* Boost: set strong negative lnprob = high need */
+            /* Boost: set strong negative lnprob = high need,
+             * and expect it within the next cycle */
             exe->lnprob = MANUAL_APP_BOOST_LNPROB;
+            exe->launch_rate += 1.0 / MAX(1, kp_state->cycle);
             boosted++;
         }
     }
@@ -493,11 +688,10 @@ boost_manual_apps(void)
 }
 
 /**
- * Main prediction function
- * (VERBATIM from upstream preload_prophet_predict)
+ * Compute map probabilities and sort kp_state->maps_arr by them
  */
-void
-kp_prophet_predict(gpointer data)
+static void
+rank_maps(gpointer data)
 {
     /* Reset probabilities that we are gonna compute */
     g_hash_table_foreach(kp_state->exes, exe_zero_prob_wrapper, data);
@@ -506,6 +700,12 @@ kp_prophet_predict(gpointer data)
     /* Boost manual apps first (Preheat extension) */
     boost_manual_apps();
 
+    /* Boost each logged-in user's top apps during their boot window */
+    kp_session_preload_top_apps(SESSION_TOP_APPS);
+
+    /* Apps just named in recently-used.xbel or shell history */
+    kp_hints_boost();
+
     /* Markovs bid in exes */
     kp_markov_foreach(markov_bid_in_exes_wrapper, data);
 
@@ -515,6 +715,31 @@ kp_prophet_predict(gpointer data)
     /* Sort maps on probability */
     g_ptr_array_sort(kp_state->maps_arr, (GCompareFunc)map_prob_compare);
 
+    /* Among likely-needed maps, prefer those that save the most latency
+     * per second of I/O (Preheat extension) */
+    if (kp_conf->model.costmodel)
+        rank_by_cost(kp_state->maps_arr);
+}
+
+/**
+ * Main prediction function
+ * (VERBATIM from upstream preload_prophet_predict)
+ */
+void
+kp_prophet_predict(gpointer data)
+{
+    rank_maps(data);
+
     /* Read them in */
     kp_prophet_readahead(kp_state->maps_arr);
 }
+
+/**
+ * Re-run prediction and read back the evicted part of the top set
+ */
+void
+kp_prophet_rewarm(gpointer data)
+{
+    rank_maps(data);
+    prophet_readahead(kp_state->maps_arr, TRUE);
+}
@@ -15,6 +15,8 @@
 
 #include <glib.h>
 
+#include "../state/state.h"
+
 /**
  * Predict which maps should be preloaded
  * (VERBATIM signature from upstream preload_prophet_predict)
@@ -27,4 +29,30 @@ void kp_prophet_predict(gpointer data);
  */
 void kp_prophet_readahead(GPtrArray *maps_arr);
 
+/**
+ * Record a preload time for every exe that maps one of @maps
+ *
+ * Part of kp_prophet_readahead(); exported for the model benchmark.
+ */
+void kp_prophet_record_preloaded_exes(kp_map_t **maps, int count);
+
+/**
+ * Read in the hot set saved with the state (state_hotset.c)
+ *
+ * Issued at startup while kp_state_load() is still running on the loader
+ * thread, so it uses nothing from kp_state.
+ *
+ * @return  Number of readahead requests issued
+ */
+int kp_prophet_readahead_hotset(void);
+
+/**
+ * Re-run prediction and read back the evicted part of the top set
+ *
+ * Used after resume from suspend or hibernate. Maps that are still fully
+ * resident are skipped, so only the cold part costs I/O and budget, and
+ * battery coalescing is bypassed.
+ */
+void kp_prophet_rewarm(gpointer data);
+
 #endif /* PROPHET_H */
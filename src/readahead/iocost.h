@@ -0,0 +1,80 @@
+/* iocost.h - Per-device I/O cost model for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef IOCOST_H
+#define IOCOST_H
+
+#include <stdio.h>
+#include "../state/state.h"
+
+/**
+ * One timed readahead of cold (non-resident) data
+ *
+ * Fixed size so readahead timer processes can send it through a pipe
+ * in a single atomic write.
+ */
+typedef struct _kp_iocost_sample_t
+{
+    dev_t dev;          /* Block device of the file */
+    size_t cold_bytes;  /* Cold bytes read */
+    int extents;        /* Physical extents covering the range */
+    gint64 elapsed_us;  /* readahead() until the range was readable */
+} kp_iocost_sample_t;
+
+/**
+ * Feed one timing sample into the device model
+ */
+void kp_iocost_observe(const kp_iocost_sample_t *sample);
+
+/**
+ * Estimated time to readahead a region (microseconds)
+ *
+ * @param dev      Block device
+ * @param length   Region length
+ * @param extents  Physical extents covering the region (>= 1)
+ */
+double kp_iocost_readahead_us(dev_t dev, size_t length, int extents);
+
+/**
+ * Estimated time the same region costs when demand-paged at launch
+ *
+ * Page faults read in small windows in access order, so every window
+ * pays a seek.
+ */
+double kp_iocost_demand_us(dev_t dev, size_t length);
+
+/**
+ * Count physical extents of a file range (FIEMAP)
+ *
+ * @return  Extent count, or 1 if unknown
+ */
+int kp_iocost_count_extents(int fd, size_t offset, size_t length);
+
+/**
+ * Fill map->dev and map->extents on first use and return the
+ * expected latency saved per microsecond of readahead I/O
+ *
+ * @param map   Map to score
+ * @param prob  Probability the map is needed in the next period
+ * @return      Score (higher = more worth reading)
+ */
+double kp_iocost_map_score(kp_map_t *map, double prob);
+
+/**
+ * Write per-device model parameters to the stats file
+ */
+void kp_iocost_dump(FILE *f);
+
+/**
+ * Free device models
+ */
+void kp_iocost_free(void);
+
+#endif /* IOCOST_H */
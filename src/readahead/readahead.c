@@ -25,19 +25,57 @@
  *      - SORT_INODE: By inode number (good for HDDs)
  *      - SORT_BLOCK: By physical block number (best for HDDs)
  *
- *   2. MERGING: Adjacent file regions are merged into single requests
+ *   2. DEADLINES: With system.deadlinesort, files are first grouped into
+ *      deadline classes from their expected time-to-launch (map->eta,
+ *      computed by the prophet), and classes are read earliest-deadline-
+ *      first. The sort strategy above orders files within a class, so
+ *      disk locality is kept among files needed at about the same time.
+ *
+ *   2b. MERGING: Adjacent file regions are merged into single requests
  *      to reduce system call overhead.
  *
  *   3. PARALLELISM: Fork child processes (configurable) to overlap
  *      I/O operations across multiple files.
  *
+ *   4. METADATA PRE-WARM: Before any data is read, every predicted file
+ *      and all of its parent directories are stat()ed in one batch, so
+ *      path lookup and inode reads don't interleave with data reads.
+ *      Directories are walked parent-first; files are then stat()ed
+ *      relative to their directory, visiting directories in inode order.
+ *
  * FLOW:
- *   kp_readahead(files, count)
- *     └─ sort_files()       → Optimize read order
- *        └─ for each file:
- *           └─ merge adjacent regions
- *           └─ process_file() → readahead() syscall (possibly forked)
- *        └─ wait_for_children()
+ *   kp_readahead_batch(files, count, opts, result)
+ *     ├─ prewarm_metadata() → statx() dirs + files (system.prewarm)
+ *     ├─ sort_files()       → Optimize read order
+ *     ├─ for each file:
+ *     │  └─ merge adjacent regions
+ *     │  └─ process_file() → readahead() syscall (possibly forked,
+ *     │                       or in a cost timer)
+ *     └─ wait_for_workers()
+ *
+ *   The time spent in each phase is logged and recorded in the stats.
+ *
+ * THREADS:
+ *   kp_readahead_batch() reads settings only from its opts and leaves
+ *   stats and the cost model alone: files read and phase times go into a
+ *   kp_readahead_result_t, cost samples to opts->sample_fd. That lets the
+ *   I/O thread of the pipeline (daemon/pipeline.c) run batches while the
+ *   main loop applies the results with kp_readahead_result_apply().
+ *   kp_readahead() does all three steps inline; kp_readahead_with_opts()
+ *   too, with settings from the caller.
+ *
+ * COST SAMPLES:
+ *   With model.costmodel, up to COST_SAMPLES requests of cold data per
+ *   batch, spread over it, are timed until the last byte of the range is
+ *   readable, and the sample (device, cold bytes, extents, time) is fed
+ *   to the per-device model in iocost.c. Waiting for that byte blocks
+ *   until the disk has read it, so a timed request is issued by its own
+ *   detached timer process, in its place in the batch: the clock starts
+ *   at that request's readahead() and stops at its last byte, and the
+ *   batch itself never waits on a physical read. Timers write to a
+ *   non-blocking pipe whose read end belongs to the main thread;
+ *   kp_readahead_result_apply() collects whatever has arrived, so
+ *   samples are accounted a batch or so late.
  *
  * =============================================================================
  */
@@ -46,9 +84,13 @@
 #include "readahead.h"
 #include "../utils/logging.h"
 #include "../config/config.h"
+#include "../daemon/power.h"
 #include "../daemon/stats.h"
+#include "iocost.h"
 
+#include <math.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #ifdef HAVE_LINUX_FS_H
 #include <linux/fs.h>
@@ -188,35 +230,558 @@ map_block_compare(const kp_map_t **pa, const kp_map_t **pb)
     return i;
 }
 
-/*
- * Process tracking for parallel readahead.
- * Counts active child processes to enforce maxprocs limit.
+/* ========================================================================
+ * DEADLINE CLASSES
+ * ======================================================================== */
+
+#define DEADLINE_CLASSES 16     /* Last class = no expected launch */
+
+/**
+ * Map an expected time-to-launch to a deadline class
+ *
+ * Class 0 is "within the next cycle"; after that classes double in
+ * width (1-2 cycles, 2-4 cycles, ...), so an app expected in 30 s is
+ * read before one expected in 10 minutes, while apps expected at about
+ * the same time share a class and keep disk order among themselves.
+ */
+static int
+deadline_class(double eta, int cycle)
+{
+    double cycles;
+    int cls;
+
+    if (eta >= G_MAXDOUBLE)
+        return DEADLINE_CLASSES - 1;
+
+    cycles = eta / MAX(1, cycle);
+    if (cycles <= 1.0)
+        return 0;
+
+    cls = 1 + (int)log2(cycles);
+    return MIN(cls, DEADLINE_CLASSES - 2);
+}
+
+/**
+ * Store deadline classes in map->priv (0 for all when disabled)
+ */
+static void
+set_deadline_classes(kp_map_t **files, int file_count, const kp_readahead_opts_t *opts)
+{
+    for (int i = 0; i < file_count; i++)
+        files[i]->priv = opts->deadlinesort ? deadline_class(files[i]->eta, opts->cycle) : 0;
+}
+
+/* Compare deadline classes, then device, then disk location */
+static int
+map_deadline_block_compare(const kp_map_t **pa, const kp_map_t **pb)
+{
+    const kp_map_t *a = *pa, *b = *pb;
+
+    if (a->priv != b->priv)
+        return a->priv < b->priv ? -1 : 1;
+    if (a->dev != b->dev)
+        return a->dev < b->dev ? -1 : 1;
+    return map_block_compare(pa, pb);
+}
+
+/* Compare deadline classes, then path */
+static int
+map_deadline_path_compare(const kp_map_t **pa, const kp_map_t **pb)
+{
+    const kp_map_t *a = *pa, *b = *pb;
+
+    if (a->priv != b->priv)
+        return a->priv < b->priv ? -1 : 1;
+    return map_path_compare(pa, pb);
+}
+
+/* ========================================================================
+ * METADATA PRE-WARM
+ * ======================================================================== */
+
+/* Directory visited by the metadata pass */
+typedef struct {
+    char *path;
+    ino_t ino;          /* 0 until stat()ed */
+    GPtrArray *names;   /* Predicted file basenames (borrowed), may be empty */
+} prewarm_dir_t;
+
+static void
+prewarm_dir_free(gpointer data)
+{
+    prewarm_dir_t *dir = data;
+
+    if (dir->names)
+        g_ptr_array_free(dir->names, TRUE);
+    g_free(dir->path);
+    g_slice_free(prewarm_dir_t, dir);
+}
+
+/**
+ * Look up (or create) a directory and all its ancestors
  */
-static int procs = 0;
+static prewarm_dir_t *
+prewarm_add_dir(GHashTable *dirs, const char *path)
+{
+    prewarm_dir_t *dir;
+    char *parent;
+
+    dir = g_hash_table_lookup(dirs, path);
+    if (dir)
+        return dir;
+
+    dir = g_slice_new0(prewarm_dir_t);
+    dir->path = g_strdup(path);
+    g_hash_table_insert(dirs, dir->path, dir);
+
+    if (strcmp(path, "/") != 0) {
+        parent = g_path_get_dirname(path);
+        prewarm_add_dir(dirs, parent);
+        g_free(parent);
+    }
+
+    return dir;
+}
 
 /**
- * Wait for all child processes to complete
+ * Stat a path without following a trailing symlink
  *
- * Called when we've reached maxprocs limit or when finishing
- * the readahead batch. Blocks until all children exit.
+ * Only the inode is requested: the point is to pull dentries and inodes
+ * into the caches, not to read attributes.
  *
- * B006 FIX: Handle EINTR properly - retry wait() if interrupted.
+ * @return  Inode number, or 0 on error
  */
-static void
-wait_for_children(void)
+static ino_t
+prewarm_stat(int dirfd, const char *name)
 {
-    while (procs > 0) {
-        int status;
-        pid_t pid = wait(&status);
-        if (pid > 0) {
-            procs--;
-        } else if (pid < 0 && errno != EINTR) {
-            /* Real error - reset to avoid infinite loop */
-            procs = 0;
-            break;
+#ifdef HAVE_STATX
+    struct statx stx;
+
+    if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+              STATX_TYPE | STATX_INO, &stx) < 0)
+        return 0;
+    return stx.stx_ino;
+#else
+    struct stat st;
+
+    if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+        return 0;
+    return st.st_ino;
+#endif
+}
+
+static int
+prewarm_dir_path_compare(gconstpointer a, gconstpointer b)
+{
+    const prewarm_dir_t *da = *(prewarm_dir_t * const *)a;
+    const prewarm_dir_t *db = *(prewarm_dir_t * const *)b;
+    return strcmp(da->path, db->path);
+}
+
+static int
+prewarm_dir_ino_compare(gconstpointer a, gconstpointer b)
+{
+    const prewarm_dir_t *da = *(prewarm_dir_t * const *)a;
+    const prewarm_dir_t *db = *(prewarm_dir_t * const *)b;
+
+    if (da->ino < db->ino) return -1;
+    if (da->ino > db->ino) return 1;
+    return strcmp(da->path, db->path);
+}
+
+static int
+prewarm_name_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+/**
+ * Resolve dentries and inodes of all predicted files in one pass
+ *
+ * PASS 1: Every parent directory, sorted by path. Sorting puts each
+ *         parent before its children, so every lookup only has one
+ *         uncached component.
+ * PASS 2: Directories in inode order (ext* allocates a directory's
+ *         inodes in its block group, so this approximates disk order);
+ *         files of each directory by name, stat()ed relative to an
+ *         O_PATH descriptor of the directory.
+ *
+ * @param files       Maps about to be read
+ * @param file_count  Number of maps
+ * @return            Number of directories and files stat()ed
+ */
+static int
+prewarm_metadata(kp_map_t **files, int file_count)
+{
+    GHashTable *dirs, *seen_files;
+    GPtrArray *order;
+    GHashTableIter iter;
+    gpointer value;
+    int done = 0;
+
+    dirs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, prewarm_dir_free);
+    seen_files = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (int i = 0; i < file_count; i++) {
+        const char *path = files[i]->path;
+        const char *slash;
+        prewarm_dir_t *dir;
+        char *dirpath;
+
+        if (!path || path[0] != '/' || g_hash_table_contains(seen_files, path))
+            continue;
+        g_hash_table_add(seen_files, (gpointer)path);
+
+        slash = strrchr(path, '/');
+        dirpath = slash == path ? g_strdup("/") : g_strndup(path, slash - path);
+        dir = prewarm_add_dir(dirs, dirpath);
+        g_free(dirpath);
+
+        if (!dir->names)
+            dir->names = g_ptr_array_new();
+        g_ptr_array_add(dir->names, (gpointer)(slash + 1));
+    }
+
+    order = g_ptr_array_sized_new(g_hash_table_size(dirs));
+    g_hash_table_iter_init(&iter, dirs);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_ptr_array_add(order, value);
+
+    /* Pass 1: directories, parents first */
+    g_ptr_array_sort(order, prewarm_dir_path_compare);
+    for (guint i = 0; i < order->len; i++) {
+        prewarm_dir_t *dir = g_ptr_array_index(order, i);
+        dir->ino = prewarm_stat(AT_FDCWD, dir->path);
+        done++;
+    }
+
+    /* Pass 2: files, grouped by directory in inode order */
+    g_ptr_array_sort(order, prewarm_dir_ino_compare);
+    for (guint i = 0; i < order->len; i++) {
+        prewarm_dir_t *dir = g_ptr_array_index(order, i);
+        int dirfd;
+
+        if (!dir->names || !dir->ino)
+            continue;
+
+        dirfd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC
+#ifdef O_PATH
+                     | O_PATH
+#endif
+                    );
+        if (dirfd < 0)
+            continue;
+
+        g_ptr_array_sort(dir->names, prewarm_name_compare);
+        for (guint j = 0; j < dir->names->len; j++) {
+            prewarm_stat(dirfd, g_ptr_array_index(dir->names, j));
+            done++;
+        }
+
+        close(dirfd);
+    }
+
+    g_ptr_array_free(order, TRUE);
+    g_hash_table_destroy(seen_files);
+    g_hash_table_destroy(dirs);
+
+    return done;
+}
+
+#define COST_SAMPLES        4   /* Timed requests per batch */
+#define COST_PREPARE_MAX    16  /* Requests checked for cold data per batch */
+
+/* Pipe carrying kp_iocost_sample_t from timers ([0] read, [1] write).
+ * Opened and drained by the main thread; batches only get [1] via opts. */
+static int cost_pipe[2] = { -1, -1 };
+
+/* A timed request, waiting for its timer */
+typedef struct {
+    char *path;
+    size_t offset;
+    size_t length;
+    gboolean started;       /* Issued by a cost timer */
+    kp_iocost_sample_t sample;
+} cost_pending_t;
+
+/* Which requests of a batch to time */
+typedef struct {
+    GArray *pending;        /* cost_pending_t */
+    int stride;             /* Requests between samples */
+    int next;               /* Request number to check next */
+    int checked;            /* Requests checked for cold data */
+} cost_plan_t;
+
+/**
+ * Count bytes of a file range that are not in the page cache
+ *
+ * @return  Cold bytes, 0 if fully cached or on error
+ */
+static size_t
+count_cold_bytes(int fd, size_t offset, size_t length)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t start, span, pages, cold = 0;
+    unsigned char *vec;
+    void *addr;
+
+    if (page <= 0 || length == 0)
+        return 0;
+
+    start = offset - offset % page;
+    span = offset + length - start;
+    pages = (span + page - 1) / page;
+
+    addr = mmap(NULL, span, PROT_READ, MAP_SHARED, fd, start);
+    if (addr == MAP_FAILED)
+        return 0;
+
+    vec = g_malloc(pages);
+    if (mincore(addr, span, vec) == 0) {
+        for (size_t i = 0; i < pages; i++)
+            if (!(vec[i] & 1))
+                cold += page;
+    }
+    g_free(vec);
+    munmap(addr, span);
+
+    return MIN(cold, length);
+}
+
+/**
+ * Bytes of a map that are not in the page cache
+ */
+size_t
+kp_readahead_cold_bytes(const kp_map_t *map)
+{
+    struct stat st;
+    size_t length;
+    size_t cold = 0;
+    int fd;
+
+    g_return_val_if_fail(map, 0);
+
+    fd = open(map->path, O_RDONLY | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (off_t)map->offset < st.st_size) {
+        length = MIN(map->length, (size_t)st.st_size - map->offset);
+        cold = count_cold_bytes(fd, map->offset, length);
+    }
+
+    close(fd);
+    return cold;
+}
+
+/**
+ * Prepare a cost sample for a readahead request
+ *
+ * Clamps the range to the file size. Only ranges with cold data are
+ * worth timing.
+ *
+ * @return  TRUE if the request should be timed
+ */
+static gboolean
+sample_prepare(int fd, size_t offset, size_t *length, kp_iocost_sample_t *sample)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || (off_t)offset >= st.st_size)
+        return FALSE;
+
+    if (offset + *length > (size_t)st.st_size)
+        *length = st.st_size - offset;
+
+    memset(sample, 0, sizeof(*sample));
+    sample->dev = st.st_dev;
+    sample->cold_bytes = count_cold_bytes(fd, offset, *length);
+    if (sample->cold_bytes == 0)
+        return FALSE;
+
+    sample->extents = kp_iocost_count_extents(fd, offset, *length);
+    return TRUE;
+}
+
+/**
+ * Decide whether to time request number @req, before it is issued
+ *
+ * Requests are checked every stride; a request with no cold data is
+ * skipped and the next one checked instead.
+ *
+ * @return  Pending sample to fill in, or NULL if not timed
+ */
+static cost_pending_t *
+cost_plan_check(cost_plan_t *plan, int req, const char *path, size_t offset, size_t length)
+{
+    cost_pending_t p;
+    int fd;
+
+    if (!plan->pending || req < plan->next ||
+        plan->pending->len >= COST_SAMPLES || plan->checked >= COST_PREPARE_MAX)
+        return NULL;
+
+    plan->checked++;
+    plan->next = req + 1;
+
+    fd = open(path, O_RDONLY | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    memset(&p, 0, sizeof(p));
+    p.offset = offset;
+    p.length = length;
+    if (!sample_prepare(fd, offset, &p.length, &p.sample) || p.length == 0) {
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    p.path = g_strdup(path);
+    plan->next = req + plan->stride;
+    g_array_append_val(plan->pending, p);
+
+    return &g_array_index(plan->pending, cost_pending_t, plan->pending->len - 1);
+}
+
+/**
+ * Issue a timed request from a timer, without waiting for it
+ *
+ * Forks a short-lived child that forks the timer and exits, so the timer
+ * is reparented to init and nobody has to reap it. The timer issues the
+ * readahead() itself, then reads the last byte of the range - the page
+ * issued last - and reports the time in between. Only this request's
+ * own reads are counted, not those issued after it.
+ *
+ * @return  FALSE if no timer could be started; issue the request as usual
+ */
+static gboolean
+cost_timer_start(const cost_pending_t *p, int sample_fd)
+{
+    pid_t pid;
+
+    if (sample_fd < 0)
+        return FALSE;
+
+    pid = fork();
+    if (pid < 0)
+        return FALSE;
+
+    if (pid == 0) {
+        kp_iocost_sample_t sample = p->sample;
+        pid_t timer = fork();
+        gint64 issued;
+        int fd;
+        char c;
+
+        if (timer > 0)
+            _exit(0);
+
+        fd = open(p->path,
+                  O_RDONLY
+                | O_NOCTTY
+                | O_NOFOLLOW
+#ifdef O_NOATIME
+                | O_NOATIME
+#endif
+               );
+        if (fd < 0)
+            _exit(0);
+
+        issued = g_get_monotonic_time();
+        readahead(fd, p->offset, p->length);
+
+        /* No timer: the request is issued, but must not be waited for */
+        if (timer < 0)
+            _exit(0);
+
+        if (pread(fd, &c, 1, p->offset + p->length - 1) == 1) {
+            sample.elapsed_us = g_get_monotonic_time() - issued;
+            /* Atomic (< PIPE_BUF); dropped if the pipe is full */
+            if (write(sample_fd, &sample, sizeof(sample)) < 0) {
+                /* Nothing useful to do in a timer */
+            }
         }
-        /* EINTR: just retry */
+        _exit(0);
+    }
+
+    /* Returns at once: the child only forks, or issues */
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+        ;
+    return TRUE;
+}
+
+static void
+cost_plan_clear(cost_plan_t *plan)
+{
+    if (!plan->pending)
+        return;
+
+    for (guint i = 0; i < plan->pending->len; i++)
+        g_free(g_array_index(plan->pending, cost_pending_t, i).path);
+    g_array_free(plan->pending, TRUE);
+    plan->pending = NULL;
+}
+
+/**
+ * Open the timer pipe (main thread)
+ *
+ * @return  Write end, or -1 if unavailable
+ */
+static int
+cost_pipe_open(void)
+{
+    if (cost_pipe[1] >= 0)
+        return cost_pipe[1];
+
+    if (pipe(cost_pipe) < 0) {
+        cost_pipe[0] = cost_pipe[1] = -1;
+        return -1;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(cost_pipe[i], F_SETFL, fcntl(cost_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(cost_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    return cost_pipe[1];
+}
+
+/**
+ * Feed samples the timers have sent so far to the cost model (main thread)
+ */
+static void
+cost_pipe_drain(void)
+{
+    kp_iocost_sample_t sample;
+
+    if (cost_pipe[0] < 0)
+        return;
+
+    while (read(cost_pipe[0], &sample, sizeof(sample)) == (ssize_t)sizeof(sample))
+        kp_iocost_observe(&sample);
+}
+
+/**
+ * Wait for the forked workers of a batch to complete
+ *
+ * Called when the batch has maxprocs workers running or when it is
+ * finished. Only the batch's own pids are waited for, so children of
+ * other batches or subsystems are left alone. With SIGCHLD set to
+ * SA_NOCLDWAIT the kernel reaps them itself: waitpid() returns ECHILD
+ * once the worker is gone.
+ *
+ * B006 FIX: Handle EINTR properly - retry waitpid() if interrupted.
+ */
+static void
+wait_for_workers(GArray *workers)
+{
+    for (guint i = 0; i < workers->len; i++) {
+        pid_t pid = g_array_index(workers, pid_t, i);
+
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+            ;
     }
+    g_array_set_size(workers, 0);
 }
 
 /**
@@ -229,11 +794,15 @@ wait_for_children(void)
  * @param path    Absolute path to the file
  * @param offset  Start offset within the file (bytes)
  * @param length  Number of bytes to readahead
+ * @param workers Running workers of the batch (pid_t)
+ * @param timed   Cost sample to take, or NULL
  *
  * PARALLELISM:
  *   If maxprocs > 0, this function forks a child process to do the
  *   readahead. This allows overlapping multiple disk reads. The parent
  *   returns immediately while the child does the I/O and exits.
+ *   A timed request is issued by its cost timer instead, which does not
+ *   count against maxprocs.
  *
  * FILE FLAGS:
  *   O_RDONLY  - Read-only access
@@ -241,30 +810,28 @@ wait_for_children(void)
  *   O_NOATIME - Don't update access time (if available)
  */
 static void
-process_file(const char *path, size_t offset, size_t length)
+process_file(const char *path, size_t offset, size_t length,
+             const kp_readahead_opts_t *opts, GArray *workers, cost_pending_t *timed)
 {
     int fd = -1;
-    int maxprocs = kp_conf->system.maxprocs;
+    int maxprocs = opts->maxprocs;
+
+    if (timed && (timed->started = cost_timer_start(timed, opts->sample_fd)))
+        return;
 
-    if (procs >= maxprocs)
-        wait_for_children();
+    if ((int)workers->len >= maxprocs)
+        wait_for_workers(workers);
 
     if (maxprocs > 0) {
-        /* B005 FIX: Increment procs BEFORE fork to prevent race.
-         * If SIGTERM arrives between fork and procs++, child could be orphaned.
-         * By incrementing first, wait_for_children() will always wait for it. */
-        procs++;
-        int status = fork();
-
-        if (status == -1) {
-            /* Fork failed - decrement counter and return */
-            procs--;
-            return;
-        }
+        pid_t pid = fork();
+
+        if (pid == -1)
+            return;     /* Fork failed: skip this request */
 
         /* Return immediately in the parent */
-        if (status > 0) {
-            return;  /* procs already incremented */
+        if (pid > 0) {
+            g_array_append_val(workers, pid);
+            return;
         }
     }
 
@@ -309,7 +876,7 @@ process_file(const char *path, size_t offset, size_t length)
  *   because files in the same directory are grouped together.
  */
 static void
-sort_by_block_or_inode(kp_map_t **files, int file_count)
+sort_by_block_or_inode(kp_map_t **files, int file_count, const kp_readahead_opts_t *opts)
 {
     int i;
     gboolean need_block = FALSE;
@@ -327,11 +894,12 @@ sort_by_block_or_inode(kp_map_t **files, int file_count)
 
         for (i=0; i<file_count; i++)
             if (files[i]->block == -1)
-                set_block(files[i], kp_conf->system.sortstrategy == SORT_INODE);
+                set_block(files[i], opts->sortstrategy == SORT_INODE);
     }
 
-    /* Sorting by block. */
-    qsort(files, file_count, sizeof(*files), (GCompareFunc)map_block_compare);
+    /* Sorting by block, within deadline classes. */
+    set_deadline_classes(files, file_count, opts);
+    qsort(files, file_count, sizeof(*files), (GCompareFunc)map_deadline_block_compare);
 }
 
 /**
@@ -350,38 +918,32 @@ sort_by_block_or_inode(kp_map_t **files, int file_count)
  *   SORT_BLOCK - By physical block (optimal for HDDs, requires FIBMAP)
  */
 static void
-sort_files(kp_map_t **files, int file_count)
+sort_files(kp_map_t **files, int file_count, const kp_readahead_opts_t *opts)
 {
-    switch (kp_conf->system.sortstrategy) {
+    switch (opts->sortstrategy) {
         case SORT_NONE:
             break;
 
         case SORT_PATH:
-            qsort(files, file_count, sizeof(*files), (GCompareFunc)map_path_compare);
-            break;
-
-        case SORT_INODE:
-        case SORT_BLOCK:
-            sort_by_block_or_inode(files, file_count);
+            set_deadline_classes(files, file_count, opts);
+            qsort(files, file_count, sizeof(*files), (GCompareFunc)map_deadline_path_compare);
             break;
 
-        default:
-            g_warning("Invalid value for config key system.sortstrategy: %d",
-                      kp_conf->system.sortstrategy);
-            /* Avoid warning every time */
-            kp_conf->system.sortstrategy = SORT_BLOCK;
+        default:    /* SORT_INODE, SORT_BLOCK (validated in kp_readahead_opts_init) */
+            sort_by_block_or_inode(files, file_count, opts);
             break;
     }
 }
 
 /**
- * Main readahead entry point - preload files into page cache
+ * Readahead entry point - preload files into page cache
  *
  * This is the core function called by the prediction engine to actually
  * load predicted files into memory. It optimizes I/O by:
- *   1. Sorting files to minimize disk seeks
- *   2. Merging adjacent regions in the same file
- *   3. Optionally parallelizing with fork()
+ *   1. Pre-warming dentries and inodes of all files (if enabled)
+ *   2. Sorting files to minimize disk seeks
+ *   3. Merging adjacent regions in the same file
+ *   4. Optionally parallelizing with fork()
  *
  * @param files       Array of kp_map_t pointers (sorted by prediction priority)
  * @param file_count  Number of files to attempt to readahead
@@ -398,14 +960,32 @@ sort_files(kp_map_t **files, int file_count)
  *   Result: 2 readahead calls instead of 3
  */
 int
-kp_readahead(kp_map_t **files, int file_count)
+kp_readahead_batch(kp_map_t **files, int file_count,
+                   const kp_readahead_opts_t *opts, kp_readahead_result_t *res)
 {
     int i;
     const char *path = NULL;
     size_t offset = 0, length = 0;
-    int processed = 0;
+    gint64 t_start, t_meta, t_sort, t_data;
+    cost_plan_t plan = { NULL, 1, 0, 0 };
+    GArray *workers = g_array_sized_new(FALSE, FALSE, sizeof(pid_t), MAX(opts->maxprocs, 1));
+
+    memset(res, 0, sizeof(*res));
+    res->paths = g_ptr_array_new_with_free_func(g_free);
+
+    t_start = g_get_monotonic_time();
+
+    if (opts->costmodel && opts->sample_fd >= 0) {
+        plan.pending = g_array_new(FALSE, FALSE, sizeof(cost_pending_t));
+        plan.stride = MAX(1, file_count / COST_SAMPLES);
+    }
+
+    if (opts->prewarm && file_count > 0)
+        res->prewarmed = prewarm_metadata(files, file_count);
+    t_meta = g_get_monotonic_time();
 
-    sort_files(files, file_count);
+    sort_files(files, file_count, opts);
+    t_sort = g_get_monotonic_time();
 
     for (i=0; i<file_count; i++) {
         if (path &&
@@ -418,9 +998,10 @@ kp_readahead(kp_map_t **files, int file_count)
         }
 
         if (path) {
-            process_file(path, offset, length);
-            kp_stats_record_preload(path);
-            processed++;
+            int req = (int)res->paths->len;
+            process_file(path, offset, length, opts, workers,
+                         cost_plan_check(&plan, req, path, offset, length));
+            g_ptr_array_add(res->paths, g_strdup(path));
             path = NULL;
         }
 
@@ -430,13 +1011,108 @@ kp_readahead(kp_map_t **files, int file_count)
     }
 
     if (path) {
-        process_file(path, offset, length);
-        kp_stats_record_preload(path);
-        processed++;
+        int req = (int)res->paths->len;
+        process_file(path, offset, length, opts, workers,
+                     cost_plan_check(&plan, req, path, offset, length));
+        g_ptr_array_add(res->paths, g_strdup(path));
         path = NULL;
     }
 
-    wait_for_children();
+    wait_for_workers(workers);
+    g_array_free(workers, TRUE);
+    t_data = g_get_monotonic_time();
+
+    for (guint t = 0; plan.pending && t < plan.pending->len; t++)
+        res->timed += g_array_index(plan.pending, cost_pending_t, t).started;
+    cost_plan_clear(&plan);
+
+    res->meta_us = t_meta - t_start;
+    res->sort_us = t_sort - t_meta;
+    res->data_us = t_data - t_sort;
+
+    return (int)res->paths->len;
+}
+
+/**
+ * Current readahead settings
+ */
+void
+kp_readahead_opts_init(kp_readahead_opts_t *opts, int cycle)
+{
+    if (kp_conf->system.sortstrategy < SORT_NONE ||
+        kp_conf->system.sortstrategy > SORT_BLOCK) {
+        g_warning("Invalid value for config key system.sortstrategy: %d",
+                  kp_conf->system.sortstrategy);
+        /* Avoid warning every time */
+        kp_conf->system.sortstrategy = SORT_BLOCK;
+    }
+
+    opts->maxprocs = kp_power_budget()->maxprocs;
+    opts->sortstrategy = kp_conf->system.sortstrategy;
+    opts->prewarm = kp_conf->system.prewarm;
+    opts->deadlinesort = kp_conf->system.deadlinesort;
+    opts->costmodel = kp_conf->model.costmodel;
+    opts->sample_fd = opts->costmodel ? cost_pipe_open() : -1;
+    opts->cycle = cycle;
+}
+
+/**
+ * Account a finished batch and free its result
+ */
+void
+kp_readahead_result_apply(kp_readahead_result_t *res)
+{
+    for (guint i = 0; i < res->paths->len; i++)
+        kp_stats_record_preload(g_ptr_array_index(res->paths, i));
+
+    cost_pipe_drain();
+
+    g_debug("Readahead phases: metadata %d entries %.1f ms, sort %.1f ms, "
+            "data %u requests %.1f ms (%d timed)",
+            res->prewarmed, res->meta_us / 1000.0, res->sort_us / 1000.0,
+            res->paths->len, res->data_us / 1000.0, res->timed);
+
+    kp_stats_record_readahead_phases(res->meta_us, res->sort_us, res->data_us);
+
+    kp_readahead_result_clear(res);
+}
+
+/**
+ * Free the contents of a batch result
+ */
+void
+kp_readahead_result_clear(kp_readahead_result_t *res)
+{
+    if (res->paths)
+        g_ptr_array_free(res->paths, TRUE);
+    res->paths = NULL;
+}
+
+/**
+ * Read a batch on the calling thread with the given settings, and
+ * account it
+ */
+int
+kp_readahead_with_opts(kp_map_t **files, int file_count, const kp_readahead_opts_t *opts)
+{
+    kp_readahead_result_t res;
+    int processed;
+
+    processed = kp_readahead_batch(files, file_count, opts, &res);
+    kp_readahead_result_apply(&res);
 
     return processed;
 }
+
+/**
+ * Read a batch on the calling thread, with settings from the current
+ * configuration and cycle
+ */
+int
+kp_readahead(kp_map_t **files, int file_count)
+{
+    kp_readahead_opts_t opts;
+
+    kp_readahead_opts_init(&opts, kp_state->cycle);
+    return kp_readahead_with_opts(files, file_count, &opts);
+}
@@ -15,13 +15,88 @@
 #include "../state/state.h"
 
 /**
- * Perform readahead on array of maps
- * (Stub - will be implemented in Phase 7)
+ * Settings of one readahead batch
+ *
+ * Copied from the configuration, power budget and cycle when the batch
+ * is created, so the batch can run on another thread. The cycle is passed
+ * in rather than read from kp_state, which may not be loaded yet.
+ */
+typedef struct _kp_readahead_opts_t
+{
+    int maxprocs;           /* Forked workers (0 = inline) */
+    int sortstrategy;       /* SORT_* */
+    gboolean prewarm;       /* Stat dirs and files first */
+    gboolean deadlinesort;  /* Order by deadline class first */
+    gboolean costmodel;     /* Time reads for the I/O cost model */
+    int sample_fd;          /* Where cost timers report (-1 = don't time) */
+    int cycle;              /* Cycle length for deadline classes */
+} kp_readahead_opts_t;
+
+/**
+ * What a batch did, for the main loop to account
+ */
+typedef struct _kp_readahead_result_t
+{
+    GPtrArray *paths;       /* Files read (one per merged request) */
+    int timed;              /* Requests handed to cost timers */
+    int prewarmed;          /* Metadata entries stat()ed */
+    gint64 meta_us, sort_us, data_us;   /* Phase times */
+} kp_readahead_result_t;
+
+/**
+ * Perform readahead on array of maps and account it
  *
  * @param maps Array of kp_map_t pointers
  * @param count Number of maps to readahead
- * @return Number of maps successfully read ahead
+ * @return Number of readahead requests issued
  */
 int kp_readahead(kp_map_t **maps, int count);
 
+/**
+ * Perform readahead with the given settings and account it (main thread)
+ *
+ * Unlike kp_readahead(), does not read kp_state.
+ */
+int kp_readahead_with_opts(kp_map_t **maps, int count, const kp_readahead_opts_t *opts);
+
+/**
+ * Fill opts from the current configuration (main thread)
+ *
+ * @param cycle  Cycle length for deadline classes
+ */
+void kp_readahead_opts_init(kp_readahead_opts_t *opts, int cycle);
+
+/**
+ * Perform readahead without touching shared state
+ *
+ * Sorts @maps in place and may set their block field. Safe on a worker
+ * thread as long as nothing else uses the maps.
+ *
+ * @param res  Filled in; release with kp_readahead_result_apply() or
+ *             kp_readahead_result_clear()
+ * @return     Number of readahead requests issued
+ */
+int kp_readahead_batch(kp_map_t **maps, int count,
+                       const kp_readahead_opts_t *opts, kp_readahead_result_t *res);
+
+/**
+ * Record a batch result in stats, feed the I/O cost model the samples
+ * that have arrived since the last call, then free the result
+ * (main thread)
+ */
+void kp_readahead_result_apply(kp_readahead_result_t *res);
+
+/**
+ * Free a batch result without accounting it
+ */
+void kp_readahead_result_clear(kp_readahead_result_t *res);
+
+/**
+ * Bytes of a map that are not in the page cache
+ *
+ * @param map  Map to check (range clamped to the file size)
+ * @return     Cold bytes; 0 if fully resident or the file is unreadable
+ */
+size_t kp_readahead_cold_bytes(const kp_map_t *map);
+
 #endif /* READAHEAD_H */
@@ -0,0 +1,513 @@
+/* sim.c - Offline trace-replay simulator for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Trace Replay
+ * =============================================================================
+ *
+ * Judging a change to cycle, the memory percentages, correlation or the
+ * ranking used to take days of live use. preheat-sim replays a recorded
+ * process trace through the daemon's own spy, state and prophet code in
+ * seconds, and reports how the page cache would have fared.
+ *
+ * LINK SEAM:
+ *   The program is the daemon minus main.c, signals.c, daemon.c and the
+ *   two modules that touch the kernel:
+ *
+ *     monitor/proc.c        → sim_proc.c   processes come from the trace
+ *     readahead/readahead.c → sim_cache.c  readahead fills an LRU model
+ *
+ *   Wall time comes from the replay clock (see time() below), so launch
+ *   weights, durations and preload timestamps behave as they would have.
+ *
+ * LOOP:
+ *   Each cycle (model.cycle, fixed; the adaptive cycle is not simulated)
+ *   does what state.c's two ticks do:
+ *
+ *     apply events up to t          EXEC/MAP/EXIT; MAP is a cache access
+ *     scan + predict                kp_spy_scan_snapshot, kp_prophet_predict
+ *     apply events up to t+cycle/2
+ *     update model                  kp_spy_update_model
+ *
+ *   The CPU time of scan, predict and update is measured per cycle.
+ *
+ * TRACE FORMAT (text, one record per line, times in seconds from start):
+ *
+ *   <t> EXEC <pid> <ppid> <user 0|1> <exe>
+ *   <t> MAP  <pid> <offset> <length> <path>
+ *   <t> EXIT <pid>
+ *   APP <exe>                       priority app (manual list)
+ *   # comment
+ *
+ *   The manual apps file named in the configuration is not read; APP
+ *   lines stand in for it so a trace replays the same everywhere.
+ *
+ * REPORT (stdout, key=value):
+ *   A launch is a traced process that mapped something; it is a hit if
+ *   every region it mapped was already cached. Bytes preloaded and never
+ *   used before eviction or the end of the trace are wasted.
+ *
+ * USAGE:
+ *   preheat-sim [-c CONF] [-s STATE] [--mem MB] [--anon MB] [-v] TRACE
+ *
+ * Built on demand with "make -C src preheat-sim"; not installed.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../utils/logging.h"
+#include "../utils/linereader.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../monitor/proc.h"
+#include "../monitor/spy.h"
+#include "../predict/prophet.h"
+#include "../daemon/stats.h"
+#include "sim.h"
+
+#include <time.h>
+
+#define DEFAULT_MEM_MB  8192
+
+typedef enum
+{
+    EV_EXEC,
+    EV_MAP,
+    EV_EXIT
+} event_kind_t;
+
+typedef struct _event_t
+{
+    double t;
+    guint seq;              /* Trace order, to keep sorting stable */
+    event_kind_t kind;
+    pid_t pid;
+    pid_t ppid;
+    gboolean user;
+    size_t offset, length;
+    char *path;             /* exe (EXEC) or mapped file (MAP) */
+} event_t;
+
+static struct
+{
+    GArray *events;         /* event_t, by time */
+    GPtrArray *apps;        /* APP lines */
+    guint next;             /* First event not applied */
+
+    time_t base;            /* Wall time of replay second 0 */
+    time_t now;             /* Replay clock */
+
+    /* Launch accounting */
+    guint64 launches, launch_hits;
+    guint64 user_launches, user_launch_hits;
+    guint64 hit_bytes, miss_bytes;
+} sim;
+
+/*
+ * Replay clock: spy.c, stats.c and friends read wall time with
+ * time(NULL). Defining it here makes every caller in this program see
+ * the replayed time instead.
+ */
+time_t
+time(time_t *t)
+{
+    if (t)
+        *t = sim.now;
+    return sim.now;
+}
+
+/* ========================================================================
+ * TRACE
+ * ======================================================================== */
+
+static gint
+event_compare(gconstpointer a, gconstpointer b)
+{
+    const event_t *ea = a, *eb = b;
+
+    if (ea->t != eb->t)
+        return ea->t < eb->t ? -1 : 1;
+    return ea->seq < eb->seq ? -1 : ea->seq > eb->seq;
+}
+
+/* Parse one record; FALSE if malformed */
+static gboolean
+parse_line(char *line, guint seq)
+{
+    event_t ev;
+    char kind[8];
+    int pos = 0, user = 0;
+
+    g_strstrip(line);
+    if (!*line || *line == '#')
+        return TRUE;
+
+    if (g_str_has_prefix(line, "APP ")) {
+        char *exe = g_strstrip(line + 4);
+        if (*exe != '/')
+            return FALSE;
+        g_ptr_array_add(sim.apps, g_strdup(exe));
+        return TRUE;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.seq = seq;
+    if (sscanf(line, "%lf %7s %n", &ev.t, kind, &pos) != 2 || ev.t < 0)
+        return FALSE;
+    line += pos;
+    pos = 0;
+
+    if (!strcmp(kind, "EXEC")) {
+        ev.kind = EV_EXEC;
+        if (sscanf(line, "%d %d %d %n", &ev.pid, &ev.ppid, &user, &pos) != 3 || !line[pos])
+            return FALSE;
+        ev.user = user != 0;
+        ev.path = g_strdup(line + pos);
+    } else if (!strcmp(kind, "MAP")) {
+        ev.kind = EV_MAP;
+        if (sscanf(line, "%d %zu %zu %n", &ev.pid, &ev.offset, &ev.length, &pos) != 3 ||
+            !line[pos])
+            return FALSE;
+        ev.path = g_strdup(line + pos);
+    } else if (!strcmp(kind, "EXIT")) {
+        ev.kind = EV_EXIT;
+        if (sscanf(line, "%d", &ev.pid) != 1)
+            return FALSE;
+    } else {
+        return FALSE;
+    }
+
+    g_array_append_val(sim.events, ev);
+    return TRUE;
+}
+
+/**
+ * Read a whole trace into memory
+ */
+static gboolean
+load_trace(const char *path)
+{
+    kp_linereader_t r = KP_LINEREADER_INIT;
+    const char *line;
+    size_t len;
+    guint lineno = 0;
+    gboolean ok = TRUE;
+
+    if (!kp_linereader_open(&r, path, 0)) {
+        fprintf(stderr, "cannot read %s: %s\n", path, strerror(errno));
+        return FALSE;
+    }
+
+    sim.events = g_array_new(FALSE, FALSE, sizeof(event_t));
+    sim.apps = g_ptr_array_new_with_free_func(g_free);
+
+    while (ok && (line = kp_linereader_next(&r, &len, TRUE))) {
+        char *copy = g_strndup(line, len);
+
+        lineno++;
+        if (!parse_line(copy, lineno)) {
+            fprintf(stderr, "%s:%u: malformed record\n", path, lineno);
+            ok = FALSE;
+        }
+        g_free(copy);
+    }
+    kp_linereader_close(&r);
+
+    g_array_sort(sim.events, event_compare);
+    return ok;
+}
+
+/* Count a finished process as a launch */
+static void
+account_launch(sim_process_t *proc)
+{
+    gboolean hit;
+
+    if (!proc->hit_bytes && !proc->miss_bytes)
+        return;
+
+    hit = proc->miss_bytes == 0;
+    sim.launches++;
+    sim.launch_hits += hit;
+    if (proc->user) {
+        sim.user_launches++;
+        sim.user_launch_hits += hit;
+    }
+}
+
+/**
+ * Apply trace events up to replay second t
+ */
+static void
+apply_events(double t)
+{
+    while (sim.next < sim.events->len) {
+        event_t *ev = &g_array_index(sim.events, event_t, sim.next);
+        sim_process_t *proc;
+
+        if (ev->t > t)
+            break;
+        sim.next++;
+
+        switch (ev->kind) {
+        case EV_EXEC:
+            /* An exec over a running pid ends the old image */
+            proc = sim_proc_exit(ev->pid);
+            if (proc) {
+                account_launch(proc);
+                sim_proc_free(proc);
+            }
+            sim_proc_exec(ev->pid, ev->ppid, ev->user, ev->path);
+            break;
+
+        case EV_MAP:
+            proc = sim_proc_map(ev->pid, ev->path, ev->offset, ev->length);
+            if (!proc)
+                break;
+            if (sim_cache_access(ev->path, ev->offset, ev->length)) {
+                proc->hit_bytes += ev->length;
+                sim.hit_bytes += ev->length;
+            } else {
+                proc->miss_bytes += ev->length;
+                sim.miss_bytes += ev->length;
+            }
+            break;
+
+        case EV_EXIT:
+            proc = sim_proc_exit(ev->pid);
+            if (proc) {
+                account_launch(proc);
+                sim_proc_free(proc);
+            }
+            break;
+        }
+    }
+}
+
+/* ========================================================================
+ * REPLAY
+ * ======================================================================== */
+
+static gint64
+cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+set_clock(double t, int state_time0)
+{
+    sim.now = sim.base + (time_t)t;
+    kp_state->time = state_time0 + (int)t;
+}
+
+/* Loaded maps have no layout yet; keep the cost model off the disk */
+static void
+mark_map_probed(gpointer key, gpointer value, gpointer user_data)
+{
+    kp_map_t *map = key;
+
+    (void)value;
+    (void)user_data;
+    if (map->extents < 0)
+        map->extents = 1;
+}
+
+static void
+finish_running(gpointer data, gpointer user_data)
+{
+    (void)user_data;
+    account_launch(data);
+}
+
+static gint
+ns_compare(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Run the cycles; returns per-cycle CPU times in ns
+ */
+static GArray *
+replay(void)
+{
+    GArray *cpu = g_array_new(FALSE, FALSE, sizeof(gint64));
+    double end = 0;
+    int cycle = MAX(2, kp_conf->model.cycle);
+    int time0 = kp_state->time;
+
+    if (sim.events->len)
+        end = g_array_index(sim.events, event_t, sim.events->len - 1).t;
+
+    kp_state->cycle = cycle;
+
+    for (double t = 0; t <= end + cycle; t += cycle) {
+        gint64 spent, t0;
+
+        apply_events(t);
+        set_clock(t, time0);
+
+        t0 = cpu_ns();
+        if (kp_conf->system.doscan) {
+            kp_proc_snapshot_t *snap = kp_proc_snapshot();
+            kp_spy_scan_snapshot(snap, NULL);
+            kp_proc_snapshot_free(snap);
+        }
+        if (kp_conf->system.dopredict)
+            kp_prophet_predict(NULL);
+        spent = cpu_ns() - t0;
+
+        apply_events(t + cycle / 2);
+        set_clock(t + cycle / 2, time0);
+
+        t0 = cpu_ns();
+        if (kp_conf->system.doscan)
+            kp_spy_update_model(NULL);
+        spent += cpu_ns() - t0;
+
+        g_array_append_val(cpu, spent);
+    }
+
+    sim_proc_foreach(finish_running, NULL);
+    sim_cache_finish();
+    return cpu;
+}
+
+static double
+ratio(guint64 part, guint64 whole)
+{
+    return whole ? (double)part / whole : 0.0;
+}
+
+static void
+report(const char *trace, GArray *cpu)
+{
+    const sim_cache_stats_t *cs = sim_cache_stats();
+    gint64 total = 0, p95 = 0, max = 0;
+
+    if (cpu->len) {
+        for (guint i = 0; i < cpu->len; i++)
+            total += g_array_index(cpu, gint64, i);
+        g_array_sort(cpu, ns_compare);
+        p95 = g_array_index(cpu, gint64, MIN(cpu->len - 1, cpu->len * 95 / 100));
+        max = g_array_index(cpu, gint64, cpu->len - 1);
+    }
+
+    printf("trace=%s\n", trace);
+    printf("events=%u\n", sim.events->len);
+    printf("cycle=%d\n", kp_state->cycle);
+    printf("cycles=%u\n", cpu->len);
+    printf("cache_capacity_bytes=%zu\n", cs->capacity);
+    printf("launches=%" G_GUINT64_FORMAT "\n", sim.launches);
+    printf("launch_hits=%" G_GUINT64_FORMAT "\n", sim.launch_hits);
+    printf("hit_rate=%.4f\n", ratio(sim.launch_hits, sim.launches));
+    printf("user_launches=%" G_GUINT64_FORMAT "\n", sim.user_launches);
+    printf("user_launch_hits=%" G_GUINT64_FORMAT "\n", sim.user_launch_hits);
+    printf("user_hit_rate=%.4f\n", ratio(sim.user_launch_hits, sim.user_launches));
+    printf("byte_hit_ratio=%.4f\n", ratio(sim.hit_bytes, sim.hit_bytes + sim.miss_bytes));
+    printf("readahead_requests=%" G_GUINT64_FORMAT "\n", cs->readahead_requests);
+    printf("preloaded_bytes=%" G_GUINT64_FORMAT "\n", cs->preloaded_bytes);
+    printf("useful_bytes=%" G_GUINT64_FORMAT "\n", cs->useful_bytes);
+    printf("wasted_bytes=%" G_GUINT64_FORMAT "\n", cs->wasted_bytes);
+    printf("demand_bytes=%" G_GUINT64_FORMAT "\n", cs->demand_bytes);
+    printf("evicted_bytes=%" G_GUINT64_FORMAT "\n", cs->evicted_bytes);
+    printf("cpu_us_per_cycle_mean=%.1f\n", cpu->len ? total / 1000.0 / cpu->len : 0.0);
+    printf("cpu_us_per_cycle_p95=%.1f\n", p95 / 1000.0);
+    printf("cpu_us_per_cycle_max=%.1f\n", max / 1000.0);
+    printf("exes=%u\n", g_hash_table_size(kp_state->exes));
+    printf("maps=%u\n", g_hash_table_size(kp_state->maps));
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-c CONF] [-s STATE] [--mem MB] [--anon MB] [-v] TRACE\n",
+            prog);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *conffile = NULL;
+    const char *statefile = NULL;
+    const char *trace = NULL;
+    long mem_mb = DEFAULT_MEM_MB;
+    long anon_mb = -1;
+    struct timespec ts;
+    GArray *cpu;
+
+    kp_log_level = 2;   /* Warnings and worse */
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            conffile = argv[++i];
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            statefile = argv[++i];
+        else if (!strcmp(argv[i], "--mem") && i + 1 < argc)
+            mem_mb = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--anon") && i + 1 < argc)
+            anon_mb = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))
+            kp_log_level++;
+        else if (argv[i][0] != '-' && !trace)
+            trace = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (anon_mb < 0)
+        anon_mb = mem_mb / 4;
+    if (!trace || mem_mb <= 0 || anon_mb >= mem_mb) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    kp_log_init(NULL);
+
+    /* Replay second 0 is the real start time, so saved preload
+     * timestamps in a loaded state keep their meaning */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    sim.base = sim.now = ts.tv_sec;
+
+    if (!load_trace(trace))
+        return 1;
+
+    kp_config_load(conffile, TRUE);
+    kp_conf->system.pipeline = FALSE;   /* Everything inline, one thread */
+
+    g_strfreev(kp_conf->system.manual_apps_loaded);
+    g_ptr_array_add(sim.apps, NULL);
+    kp_conf->system.manual_apps_loaded = g_strdupv((char **)sim.apps->pdata);
+    kp_conf->system.manual_apps_count = (int)sim.apps->len - 1;
+
+    kp_stats_init();
+    sim_proc_init(mem_mb * 1024, anon_mb * 1024);
+    sim_cache_init((size_t)(mem_mb - anon_mb) * 1024 * 1024);
+
+    kp_state_load(statefile);
+    kp_stats_reclassify_all();
+    kp_markov_build_priority_mesh();
+    g_hash_table_foreach(kp_state->maps, mark_map_probed, NULL);
+
+    cpu = replay();
+    report(trace, cpu);
+
+    g_array_free(cpu, TRUE);
+    kp_state_free();
+    sim_cache_free();
+    return 0;
+}
@@ -0,0 +1,124 @@
+/* sim.h - Trace-replay simulator internals for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <glib.h>
+#include <sys/types.h>
+#include "../monitor/proc.h"
+
+/**
+ * sim_process_t: A traced process
+ *
+ * Lives from its EXEC event to its EXIT event. The replay layer in
+ * sim_proc.c answers the proc.h API from these.
+ */
+typedef struct _sim_process_t
+{
+    pid_t pid;
+    pid_t ppid;
+    gboolean user;          /* Started by the user (shell, launcher) */
+    char *exe;
+    GArray *regions;        /* sim_region_t, in MAP order */
+
+    /* Launch accounting (sim.c) */
+    size_t hit_bytes;       /* Mapped bytes already in the cache */
+    size_t miss_bytes;      /* Mapped bytes read on demand */
+} sim_process_t;
+
+/* A mapped region, as the snapshot reads them from /proc */
+typedef kp_proc_region_t sim_region_t;
+
+/* ========================================================================
+ * PROCESS TABLE (sim_proc.c)
+ * ======================================================================== */
+
+/**
+ * Set the memory the fake /proc/meminfo reports
+ *
+ * @param total_kb  MemTotal
+ * @param anon_kb   Memory held by processes (neither free nor cache)
+ */
+void sim_proc_init(long total_kb, long anon_kb);
+
+/**
+ * Start a process (replaces an earlier one with the same pid)
+ */
+sim_process_t *sim_proc_exec(pid_t pid, pid_t ppid, gboolean user, const char *exe);
+
+/**
+ * Add a mapped region to a running process
+ *
+ * @return  The process, or NULL if the pid is not running
+ */
+sim_process_t *sim_proc_map(pid_t pid, const char *path, size_t offset, size_t length);
+
+/**
+ * Look up a running process
+ */
+sim_process_t *sim_proc_lookup(pid_t pid);
+
+/**
+ * Remove a process; the caller frees it with sim_proc_free()
+ *
+ * @return  The process, or NULL if the pid is not running
+ */
+sim_process_t *sim_proc_exit(pid_t pid);
+
+void sim_proc_free(sim_process_t *proc);
+
+/**
+ * Call func(proc, user_data) for every running process
+ */
+void sim_proc_foreach(GFunc func, gpointer user_data);
+
+/* ========================================================================
+ * PAGE CACHE MODEL (sim_cache.c)
+ * ======================================================================== */
+
+/**
+ * sim_cache_stats_t: What the page cache model saw
+ */
+typedef struct _sim_cache_stats_t
+{
+    size_t capacity;
+    size_t used;
+
+    guint64 readahead_requests;
+    guint64 preloaded_bytes;    /* Read by readahead */
+    guint64 useful_bytes;       /* Preloaded, then used by a process */
+    guint64 wasted_bytes;       /* Preloaded, evicted unused */
+    guint64 demand_bytes;       /* Read on demand (cache misses) */
+    guint64 evicted_bytes;
+} sim_cache_stats_t;
+
+/**
+ * Start with an empty cache of @capacity bytes
+ */
+void sim_cache_init(size_t capacity);
+
+/**
+ * A process touches a region
+ *
+ * @return  TRUE if it was resident; otherwise it is read in now
+ */
+gboolean sim_cache_access(const char *path, size_t offset, size_t length);
+
+/**
+ * Count preloaded regions still unused as wasted (end of replay)
+ */
+void sim_cache_finish(void);
+
+const sim_cache_stats_t *sim_cache_stats(void);
+
+void sim_cache_free(void);
+
+#endif /* SIM_H */
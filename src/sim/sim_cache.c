@@ -0,0 +1,257 @@
+/* sim_cache.c - Page cache model for the Preheat simulator
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Simulated Page Cache
+ * =============================================================================
+ *
+ * Takes the place of readahead/readahead.c in preheat-sim. Nothing is
+ * read from disk; the readahead.h API feeds a model of the page cache:
+ *
+ *   - The cache holds regions (path, offset, length), the unit the model
+ *     and the trace both use, in one LRU list of fixed capacity.
+ *   - kp_readahead_batch() inserts regions not yet resident, marked as
+ *     preloaded. Resident ones are left where they are, as readahead()
+ *     of cached pages does not touch the LRU.
+ *   - A process mapping a region (sim_cache_access) is a hit if it is
+ *     resident, otherwise a demand read that inserts it. Either way the
+ *     region moves to the head of the list.
+ *   - Preloaded bytes that are evicted, or still unused when the replay
+ *     ends, are waste; used ones are useful.
+ *
+ * Regions only match exactly. The daemon learns its maps from the same
+ * MAP records the replay touches, so in practice they line up; partial
+ * overlaps are counted as misses.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../readahead/readahead.h"
+#include "../daemon/stats.h"
+#include "sim.h"
+
+typedef struct _cache_entry_t
+{
+    char *key;              /* "offset:length:path" */
+    size_t length;
+    gboolean preloaded;     /* Brought in by readahead */
+    gboolean used;          /* Touched by a process since */
+    GList *link;            /* Node in the LRU list */
+} cache_entry_t;
+
+static struct
+{
+    GHashTable *entries;    /* key → cache_entry_t */
+    GQueue lru;             /* Most recently used first */
+    sim_cache_stats_t stats;
+} cache;
+
+static char *
+region_key(const char *path, size_t offset, size_t length)
+{
+    return g_strdup_printf("%zu:%zu:%s", offset, length, path);
+}
+
+static void
+entry_free(cache_entry_t *e)
+{
+    g_free(e->key);
+    g_free(e);
+}
+
+/**
+ * Start with an empty cache
+ */
+void
+sim_cache_init(size_t capacity)
+{
+    cache.entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                          (GDestroyNotify)entry_free);
+    g_queue_init(&cache.lru);
+    memset(&cache.stats, 0, sizeof(cache.stats));
+    cache.stats.capacity = capacity;
+}
+
+static void
+evict_one(void)
+{
+    cache_entry_t *e = g_queue_pop_tail(&cache.lru);
+
+    cache.stats.used -= e->length;
+    cache.stats.evicted_bytes += e->length;
+    if (e->preloaded && !e->used)
+        cache.stats.wasted_bytes += e->length;
+    g_hash_table_remove(cache.entries, e->key);
+}
+
+/* Insert a region that is not resident; takes @key */
+static cache_entry_t *
+insert(char *key, size_t length, gboolean preloaded)
+{
+    cache_entry_t *e;
+
+    if (length > cache.stats.capacity) {
+        g_free(key);
+        return NULL;
+    }
+
+    while (cache.stats.used + length > cache.stats.capacity)
+        evict_one();
+
+    e = g_new0(cache_entry_t, 1);
+    e->key = key;
+    e->length = length;
+    e->preloaded = preloaded;
+    g_queue_push_head(&cache.lru, e);
+    e->link = cache.lru.head;
+    g_hash_table_insert(cache.entries, e->key, e);
+    cache.stats.used += length;
+    return e;
+}
+
+/**
+ * A process touches a region
+ */
+gboolean
+sim_cache_access(const char *path, size_t offset, size_t length)
+{
+    char *key = region_key(path, offset, length);
+    cache_entry_t *e = g_hash_table_lookup(cache.entries, key);
+
+    if (e) {
+        g_free(key);
+        if (e->preloaded && !e->used)
+            cache.stats.useful_bytes += e->length;
+        e->used = TRUE;
+        g_queue_unlink(&cache.lru, e->link);
+        g_queue_push_head_link(&cache.lru, e->link);
+        return TRUE;
+    }
+
+    cache.stats.demand_bytes += length;
+    e = insert(key, length, FALSE);
+    if (e)
+        e->used = TRUE;
+    return FALSE;
+}
+
+/**
+ * Count preloaded regions still unused as wasted
+ */
+void
+sim_cache_finish(void)
+{
+    for (GList *l = cache.lru.head; l; l = l->next) {
+        cache_entry_t *e = l->data;
+        if (e->preloaded && !e->used)
+            cache.stats.wasted_bytes += e->length;
+    }
+}
+
+const sim_cache_stats_t *
+sim_cache_stats(void)
+{
+    return &cache.stats;
+}
+
+void
+sim_cache_free(void)
+{
+    g_queue_clear(&cache.lru);
+    g_hash_table_destroy(cache.entries);
+    cache.entries = NULL;
+}
+
+/* ========================================================================
+ * readahead.h API
+ * ======================================================================== */
+
+int
+kp_readahead_batch(kp_map_t **maps, int count,
+                   const kp_readahead_opts_t *opts, kp_readahead_result_t *res)
+{
+    (void)opts;
+
+    memset(res, 0, sizeof(*res));
+    res->paths = g_ptr_array_new_with_free_func(g_free);
+
+    for (int i = 0; i < count; i++) {
+        char *key = region_key(maps[i]->path, maps[i]->offset, maps[i]->length);
+
+        if (g_hash_table_contains(cache.entries, key)) {
+            g_free(key);
+            continue;
+        }
+
+        if (insert(key, maps[i]->length, TRUE)) {
+            cache.stats.preloaded_bytes += maps[i]->length;
+            cache.stats.readahead_requests++;
+            g_ptr_array_add(res->paths, g_strdup(maps[i]->path));
+        }
+    }
+
+    return (int)res->paths->len;
+}
+
+void
+kp_readahead_opts_init(kp_readahead_opts_t *opts, int cycle)
+{
+    memset(opts, 0, sizeof(*opts));
+    opts->sample_fd = -1;
+    opts->cycle = cycle;
+}
+
+void
+kp_readahead_result_apply(kp_readahead_result_t *res)
+{
+    for (guint i = 0; i < res->paths->len; i++)
+        kp_stats_record_preload(g_ptr_array_index(res->paths, i));
+
+    kp_readahead_result_clear(res);
+}
+
+void
+kp_readahead_result_clear(kp_readahead_result_t *res)
+{
+    if (res->paths)
+        g_ptr_array_free(res->paths, TRUE);
+    res->paths = NULL;
+}
+
+int
+kp_readahead_with_opts(kp_map_t **maps, int count, const kp_readahead_opts_t *opts)
+{
+    kp_readahead_result_t res;
+    int processed;
+
+    processed = kp_readahead_batch(maps, count, opts, &res);
+    kp_readahead_result_apply(&res);
+
+    return processed;
+}
+
+int
+kp_readahead(kp_map_t **maps, int count)
+{
+    kp_readahead_opts_t opts;
+
+    kp_readahead_opts_init(&opts, kp_state->cycle);
+    return kp_readahead_with_opts(maps, count, &opts);
+}
+
+size_t
+kp_readahead_cold_bytes(const kp_map_t *map)
+{
+    char *key = region_key(map->path, map->offset, map->length);
+    gboolean resident = g_hash_table_contains(cache.entries, key);
+
+    g_free(key);
+    return resident ? 0 : map->length;
+}
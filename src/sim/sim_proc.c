@@ -0,0 +1,442 @@
+/* sim_proc.c - Replayed process table for the Preheat simulator
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Simulated /proc
+ * =============================================================================
+ *
+ * preheat-sim links every model module of the daemon, but this file in
+ * place of monitor/proc.c. It implements the same proc.h API from the
+ * process table the trace builds up, so spy.c and prophet.c run
+ * unchanged:
+ *
+ *   kp_proc_snapshot()      → running traced processes
+ *   kp_proc_get_maps()      → MAP regions recorded for the pid
+ *   kp_proc_snapshot_info() → regions asked for with kp_proc_want_regions();
+ *                             nothing for new pids, spy.c reads those
+ *   kp_proc_get_exe/ppid()  → EXEC fields; parents outside the trace are
+ *                             a shell for user launches, systemd otherwise
+ *   kp_proc_get_memstat()   → configured total, page cache model usage
+ *
+ * The exeprefix and mapprefix filters apply exactly as in proc.c.
+ * Maps created here are marked as one extent, so the cost model never
+ * probes files on the machine running the simulation.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../monitor/proc.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "sim.h"
+
+#define SIM_UID         1000
+#define USER_PARENT     "/usr/bin/bash"
+#define SYSTEM_PARENT   "/usr/lib/systemd/systemd"
+
+static struct
+{
+    GHashTable *procs;      /* pid → sim_process_t */
+    GHashTable *parents;    /* ppid outside the trace → user flag */
+    GHashTable *want;       /* pids for the next snapshot's regions */
+    long total_kb;
+    long anon_kb;
+} sim_proc;
+
+/**
+ * Set the memory the fake /proc/meminfo reports
+ */
+void
+sim_proc_init(long total_kb, long anon_kb)
+{
+    sim_proc.procs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                           (GDestroyNotify)sim_proc_free);
+    sim_proc.parents = g_hash_table_new(g_direct_hash, g_direct_equal);
+    sim_proc.total_kb = total_kb;
+    sim_proc.anon_kb = anon_kb;
+}
+
+void
+sim_proc_free(sim_process_t *proc)
+{
+    if (!proc)
+        return;
+
+    for (guint i = 0; i < proc->regions->len; i++)
+        g_free(g_array_index(proc->regions, sim_region_t, i).path);
+    g_array_free(proc->regions, TRUE);
+    g_free(proc->exe);
+    g_free(proc);
+}
+
+/**
+ * Start a process
+ */
+sim_process_t *
+sim_proc_exec(pid_t pid, pid_t ppid, gboolean user, const char *exe)
+{
+    sim_process_t *proc = g_new0(sim_process_t, 1);
+
+    proc->pid = pid;
+    proc->ppid = ppid;
+    proc->user = user;
+    proc->exe = g_strdup(exe);
+    proc->regions = g_array_new(FALSE, FALSE, sizeof(sim_region_t));
+
+    /* An exec replaces the image of a running pid */
+    g_hash_table_replace(sim_proc.procs, GINT_TO_POINTER(pid), proc);
+
+    if (!g_hash_table_contains(sim_proc.procs, GINT_TO_POINTER(ppid)))
+        g_hash_table_insert(sim_proc.parents, GINT_TO_POINTER(ppid),
+                            GINT_TO_POINTER(user));
+    return proc;
+}
+
+/**
+ * Add a mapped region to a running process
+ */
+sim_process_t *
+sim_proc_map(pid_t pid, const char *path, size_t offset, size_t length)
+{
+    sim_process_t *proc = sim_proc_lookup(pid);
+    sim_region_t r;
+
+    if (!proc)
+        return NULL;
+
+    r.path = g_strdup(path);
+    r.offset = offset;
+    r.length = length;
+    g_array_append_val(proc->regions, r);
+    return proc;
+}
+
+sim_process_t *
+sim_proc_lookup(pid_t pid)
+{
+    return g_hash_table_lookup(sim_proc.procs, GINT_TO_POINTER(pid));
+}
+
+/**
+ * Remove a process
+ */
+sim_process_t *
+sim_proc_exit(pid_t pid)
+{
+    sim_process_t *proc = sim_proc_lookup(pid);
+
+    if (proc)
+        g_hash_table_steal(sim_proc.procs, GINT_TO_POINTER(pid));
+    return proc;
+}
+
+typedef struct {
+    GFunc func;
+    gpointer user_data;
+} foreach_args_t;
+
+static void
+foreach_value(gpointer key, gpointer value, gpointer user_data)
+{
+    foreach_args_t *args = user_data;
+
+    (void)key;
+    args->func(value, args->user_data);
+}
+
+/**
+ * Call func for every running process
+ */
+void
+sim_proc_foreach(GFunc func, gpointer user_data)
+{
+    foreach_args_t args = { func, user_data };
+
+    g_hash_table_foreach(sim_proc.procs, foreach_value, &args);
+}
+
+/* ========================================================================
+ * proc.h API
+ * ======================================================================== */
+
+/* Same rules as sanitize_file() in proc.c, without prelink names */
+static gboolean
+accept_map(const char *path)
+{
+    return path[0] == '/' && !strstr(path, "(deleted)") &&
+           kp_prefix_set_accept(kp_conf->system.mapprefix_set, path);
+}
+
+/* MAP regions of the trace, or copies read with a snapshot */
+static size_t
+regions_to_maps(const GArray *regions, GHashTable *maps, GSet **exemaps)
+{
+    size_t size = 0;
+
+    if (exemaps)
+        *exemaps = g_set_new();
+
+    for (guint i = 0; i < regions->len; i++) {
+        const sim_region_t *r = &g_array_index(regions, sim_region_t, i);
+        kp_map_t *map;
+        gpointer orig_map, value;
+
+        if (!r->length || !accept_map(r->path))
+            continue;
+
+        size += r->length;
+
+        if (!maps && !exemaps)
+            continue;
+
+        map = kp_map_new(r->path, r->offset, r->length);
+        map->extents = 1;       /* Nothing to probe */
+
+        if (maps && g_hash_table_lookup_extended(maps, map, &orig_map, &value)) {
+            kp_map_free(map);
+            map = (kp_map_t *)orig_map;
+        }
+
+        if (exemaps)
+            g_set_add(*exemaps, kp_exemap_new(map));
+    }
+
+    return size;
+}
+
+static GPtrArray *
+regions_objects(const GArray *regions)
+{
+    GPtrArray *sos = g_ptr_array_new_with_free_func(g_free);
+
+    for (guint i = 0; i < regions->len; i++) {
+        const char *path = g_array_index(regions, sim_region_t, i).path;
+        const char *base = strrchr(path, '/');
+        gboolean seen = FALSE;
+
+        base = base ? base + 1 : path;
+        if (!accept_map(path) || (!g_str_has_suffix(base, ".so") && !strstr(base, ".so.")))
+            continue;
+
+        for (guint j = 0; j < sos->len && !seen; j++)
+            seen = !strcmp(g_ptr_array_index(sos, j), path);
+        if (!seen)
+            g_ptr_array_add(sos, g_strdup(path));
+    }
+    return sos;
+}
+
+size_t
+kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
+{
+    sim_process_t *proc = sim_proc_lookup(pid);
+
+    return proc ? regions_to_maps(proc->regions, maps, exemaps) : 0;
+}
+
+GPtrArray *
+kp_proc_get_shared_objects(pid_t pid)
+{
+    sim_process_t *proc = sim_proc_lookup(pid);
+
+    return proc ? regions_objects(proc->regions) : NULL;
+}
+
+size_t
+kp_proc_regions_to_maps(const GArray *regions, GHashTable *maps, GSet **exemaps)
+{
+    return regions_to_maps(regions, maps, exemaps);
+}
+
+GPtrArray *
+kp_proc_regions_objects(const GArray *regions)
+{
+    return regions_objects(regions);
+}
+
+uid_t
+kp_proc_get_uid(pid_t pid)
+{
+    return sim_proc_lookup(pid) ? SIM_UID : KP_UID_UNKNOWN;
+}
+
+gboolean
+kp_proc_exists(pid_t pid)
+{
+    return sim_proc_lookup(pid) != NULL;
+}
+
+pid_t
+kp_proc_get_ppid(pid_t pid)
+{
+    sim_process_t *proc = sim_proc_lookup(pid);
+
+    if (proc)
+        return proc->ppid;
+    return g_hash_table_contains(sim_proc.parents, GINT_TO_POINTER(pid)) ? 1 : 0;
+}
+
+char *
+kp_proc_get_exe(pid_t pid)
+{
+    sim_process_t *proc = sim_proc_lookup(pid);
+    gpointer user;
+
+    if (proc)
+        return g_strdup(proc->exe);
+    if (g_hash_table_lookup_extended(sim_proc.parents, GINT_TO_POINTER(pid), NULL, &user))
+        return g_strdup(GPOINTER_TO_INT(user) ? USER_PARENT : SYSTEM_PARENT);
+    return NULL;
+}
+
+/* One process of a snapshot, as in proc.c */
+typedef struct {
+    pid_t pid;
+    char *exe;
+} proc_entry_t;
+
+struct _kp_proc_snapshot_t
+{
+    GArray *entries;    /* proc_entry_t */
+    GHashTable *info;   /* pid → kp_proc_info_t*, NULL if none asked for */
+};
+
+static void
+info_free(gpointer data)
+{
+    kp_proc_info_t *info = data;
+
+    for (guint i = 0; i < info->regions->len; i++)
+        g_free(g_array_index(info->regions, sim_region_t, i).path);
+    g_array_free(info->regions, TRUE);
+    g_free(info);
+}
+
+/* Copy the regions of a process asked for by kp_proc_want_regions() */
+static void
+snapshot_add_wanted(kp_proc_snapshot_t *snap, sim_process_t *proc)
+{
+    kp_proc_info_t *info = g_new0(kp_proc_info_t, 1);
+
+    info->uid = KP_UID_UNKNOWN;
+    info->regions = g_array_sized_new(FALSE, FALSE, sizeof(sim_region_t),
+                                      proc->regions->len);
+    for (guint i = 0; i < proc->regions->len; i++) {
+        const sim_region_t *r = &g_array_index(proc->regions, sim_region_t, i);
+        sim_region_t copy = { g_strdup(r->path), r->offset, r->length };
+
+        g_array_append_val(info->regions, copy);
+    }
+
+    if (!snap->info)
+        snap->info = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, info_free);
+    g_hash_table_insert(snap->info, GINT_TO_POINTER(proc->pid), info);
+}
+
+static void
+snapshot_add(gpointer key, gpointer value, gpointer user_data)
+{
+    sim_process_t *proc = value;
+    proc_entry_t e;
+
+    (void)key;
+
+    e.pid = proc->pid;
+    e.exe = g_strdup(proc->exe);
+    g_array_append_val(((kp_proc_snapshot_t *)user_data)->entries, e);
+
+    if (sim_proc.want && g_hash_table_contains(sim_proc.want, GINT_TO_POINTER(proc->pid)))
+        snapshot_add_wanted(user_data, proc);
+}
+
+static gint
+entry_pid_compare(gconstpointer a, gconstpointer b)
+{
+    return ((const proc_entry_t *)a)->pid - ((const proc_entry_t *)b)->pid;
+}
+
+kp_proc_snapshot_t *
+kp_proc_snapshot(void)
+{
+    kp_proc_snapshot_t *snap = g_new0(kp_proc_snapshot_t, 1);
+
+    snap->entries = g_array_new(FALSE, FALSE, sizeof(proc_entry_t));
+    g_hash_table_foreach(sim_proc.procs, snapshot_add, snap);
+
+    /* readdir() order is pid order; hash order would make runs differ */
+    g_array_sort(snap->entries, entry_pid_compare);
+
+    if (sim_proc.want)
+        g_hash_table_remove_all(sim_proc.want);
+    return snap;
+}
+
+void
+kp_proc_snapshot_foreach(const kp_proc_snapshot_t *snap, GHFunc func, gpointer user_data)
+{
+    for (guint i = 0; i < snap->entries->len; i++) {
+        proc_entry_t *e = &g_array_index(snap->entries, proc_entry_t, i);
+
+        if (!kp_prefix_set_accept(kp_conf->system.exeprefix_set, e->exe))
+            continue;
+
+        func(GUINT_TO_POINTER(e->pid), e->exe, user_data);
+    }
+}
+
+void
+kp_proc_snapshot_free(kp_proc_snapshot_t *snap)
+{
+    if (!snap)
+        return;
+
+    for (guint i = 0; i < snap->entries->len; i++)
+        g_free(g_array_index(snap->entries, proc_entry_t, i).exe);
+    g_array_free(snap->entries, TRUE);
+    if (snap->info)
+        g_hash_table_destroy(snap->info);
+    g_free(snap);
+}
+
+const kp_proc_info_t *
+kp_proc_snapshot_info(const kp_proc_snapshot_t *snap, pid_t pid)
+{
+    return snap->info ? g_hash_table_lookup(snap->info, GINT_TO_POINTER(pid)) : NULL;
+}
+
+void
+kp_proc_want_regions(pid_t pid)
+{
+    if (!sim_proc.want)
+        sim_proc.want = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_hash_table_add(sim_proc.want, GINT_TO_POINTER(pid));
+}
+
+void
+kp_proc_foreach(GHFunc func, gpointer user_data)
+{
+    kp_proc_snapshot_t *snap = kp_proc_snapshot();
+
+    kp_proc_snapshot_foreach(snap, func, user_data);
+    kp_proc_snapshot_free(snap);
+}
+
+void
+kp_proc_get_memstat(kp_memory_t *mem)
+{
+    const sim_cache_stats_t *cache = sim_cache_stats();
+
+    memset(mem, 0, sizeof(*mem));
+    mem->total = (int)sim_proc.total_kb;
+    mem->cached = (int)(cache->used / 1024);
+    mem->free = (int)MAX(0, sim_proc.total_kb - sim_proc.anon_kb - mem->cached);
+    mem->available = mem->free + mem->cached;
+    mem->pagein = (int)((cache->preloaded_bytes + cache->demand_bytes) / 1024);
+}
@@ -19,6 +19,7 @@
  * - state_exe.c:    Executable management  
  * - state_markov.c: Markov chain management
  * - state_family.c: Application family management
+ * - state_closure.c: Persistent dependency-closure cache
  * - state_io.c:     State file read/write operations
  *
  * This file contains:
@@ -33,15 +34,21 @@
 #include "../utils/logging.h"
 #include "../config/config.h"
 #include "../daemon/pause.h"
+#include "../daemon/power.h"
 #include "../daemon/session.h"
+#include "../daemon/pipeline.h"
+#include "../daemon/events.h"
 #include "state.h"
 #include "state_io.h"
+#include "state_closure.h"
 #include "../monitor/proc.h"
 #include "../monitor/spy.h"
 #include "../predict/prophet.h"
 #include "../utils/seeding.h"
 
 #include <fcntl.h>
+#include <sys/prctl.h>
+#include <time.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
@@ -74,6 +81,9 @@ kp_state_t kp_state[1];
  *   kp_family_new, kp_family_free, kp_family_add_member,
  *   kp_family_update_stats, kp_family_lookup, kp_family_lookup_by_exe
  *
+ * Closure functions -> state_closure.c:
+ *   kp_closure_new, kp_closure_free, kp_closure_get, kp_closure_load_maps
+ *
  * I/O functions -> state_io.c:
  *   All read_*, write_*, handle_corrupt_statefile
  *
@@ -92,6 +102,7 @@ void kp_state_load(const char *statefile)
     gboolean state_was_empty = FALSE;
     
     memset(kp_state, 0, sizeof(*kp_state));
+    kp_state->loading = TRUE;
     kp_state->exes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)kp_exe_free);
     kp_state->bad_exes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     kp_state->maps = g_hash_table_new((GHashFunc)kp_map_hash, (GEqualFunc)kp_map_equal);
@@ -103,6 +114,12 @@ void kp_state_load(const char *statefile)
     kp_state->exe_to_family = g_hash_table_new_full(g_str_hash, g_str_equal, 
                                                       g_free, g_free);
 
+    /* Closures are keyed by their own exe_path copy */
+    kp_state->closures = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 NULL, (GDestroyNotify)kp_closure_free);
+    kp_state->plugin_history = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       NULL, (GDestroyNotify)kp_plugin_history_free);
+
     if (statefile && *statefile) {
         GIOChannel *f;
         GError *err = NULL;
@@ -138,11 +155,12 @@ void kp_state_load(const char *statefile)
 
     /* Smart first-run seeding */
     if (state_was_empty || (kp_state->exes && g_hash_table_size(kp_state->exes) == 0)) {
-        kp_seed_from_sources();
+        kp_seed_start();
     }
 
     kp_proc_get_memstat(&(kp_state->memstat));
     kp_state->memstat_timestamp = kp_state->time;
+    kp_state->loading = FALSE;
 }
 
 /**
@@ -207,57 +225,88 @@ true_func(gpointer key, gpointer value, gpointer user_data)
     return TRUE;
 }
 
+/**
+ * Write serialized state to a file, atomically
+ */
+void
+kp_state_write_file(const char *statefile, const GString *content)
+{
+    int fd = -1;
+    char *tmpfile;
+
+    tmpfile = g_strconcat(statefile, ".tmp", NULL);
+    g_debug("to be honest, saving state to %s", tmpfile);
+
+    fd = open(tmpfile, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    if (fd < 0) {
+        g_critical("cannot open %s for writing, ignoring: %s", tmpfile, strerror(errno));
+    } else {
+        const char *p = content->str;
+        size_t left = content->len;
+
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            p += n;
+            left -= (size_t)n;
+        }
+
+        if (left > 0) {
+            g_critical("failed writing state to %s, ignoring: %s", tmpfile, strerror(errno));
+            close(fd);
+            unlink(tmpfile);
+        } else {
+            if (fsync(fd) < 0) {
+                g_critical("fsync failed for %s: %s - state may be lost on crash",
+                           tmpfile, strerror(errno));
+            }
+            close(fd);
+
+            if (rename(tmpfile, statefile) < 0) {
+                g_critical("failed to rename %s to %s: %s",
+                           tmpfile, statefile, strerror(errno));
+                unlink(tmpfile);
+            } else {
+                g_debug("successfully renamed %s to %s", tmpfile, statefile);
+            }
+        }
+    }
+
+    g_free(tmpfile);
+}
+
 /**
  * Save state to file
+ *
+ * The model is serialized here, on the main loop; with the pipeline
+ * running, writing it out is left to the I/O thread.
  */
 void kp_state_save(const char *statefile)
 {
     if (kp_state->dirty && statefile && *statefile) {
-        int fd = -1;
-        GIOChannel *f;
-        char *tmpfile;
+        GString *content;
+        char *errmsg;
 
         g_message("saving state to %s", statefile);
 
-        tmpfile = g_strconcat(statefile, ".tmp", NULL);
-        g_debug("to be honest, saving state to %s", tmpfile);
+        content = g_string_sized_new(64 * 1024);
+        errmsg = kp_state_write_to_string(content);
 
-        fd = open(tmpfile, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
-        if (fd < 0) {
-            g_critical("cannot open %s for writing, ignoring: %s", tmpfile, strerror(errno));
+        if (errmsg) {
+            g_critical("failed serializing state for %s, ignoring: %s", statefile, errmsg);
+            g_free(errmsg);
+            g_string_free(content, TRUE);
+        } else if (kp_pipeline_save(statefile, content)) {
+            /* I/O thread owns content now */
         } else {
-            char *errmsg;
-
-            f = g_io_channel_unix_new(fd);
-
-            errmsg = kp_state_write_to_channel(f, fd);
-            g_io_channel_flush(f, NULL);
-            g_io_channel_unref(f);
-
-            if (errmsg) {
-                g_critical("failed writing state to %s, ignoring: %s", tmpfile, errmsg);
-                g_free(errmsg);
-                close(fd);
-                unlink(tmpfile);
-            } else {
-                if (fsync(fd) < 0) {
-                    g_critical("fsync failed for %s: %s - state may be lost on crash",
-                               tmpfile, strerror(errno));
-                }
-                close(fd);
-
-                if (rename(tmpfile, statefile) < 0) {
-                    g_critical("failed to rename %s to %s: %s",
-                               tmpfile, statefile, strerror(errno));
-                    unlink(tmpfile);
-                } else {
-                    g_debug("successfully renamed %s to %s", tmpfile, statefile);
-                }
-            }
+            kp_state_write_file(statefile, content);
+            g_string_free(content, TRUE);
         }
 
-        g_free(tmpfile);
-
         kp_state->dirty = FALSE;
 
         g_debug("saving state done");
@@ -289,6 +338,14 @@ void kp_state_free(void)
         g_hash_table_destroy(kp_state->exe_to_family);
         kp_state->exe_to_family = NULL;
     }
+    if (kp_state->closures) {
+        g_hash_table_destroy(kp_state->closures);
+        kp_state->closures = NULL;
+    }
+    if (kp_state->plugin_history) {
+        g_hash_table_destroy(kp_state->plugin_history);
+        kp_state->plugin_history = NULL;
+    }
 
     g_assert(g_hash_table_size(kp_state->maps) == 0);
     g_assert(kp_state->maps_arr->len == 0);
@@ -320,11 +377,145 @@ void kp_state_dump_log(void)
  * STATE PERIODIC TASKS - The Daemon's Heartbeat
  * ======================================================================== */
 
-static gboolean kp_state_tick(gpointer data);
+static void kp_state_tick(gpointer data);
 
-static gboolean
+/* The two halves of a cycle, and the autosave, on the event core */
+static kp_event_timer_t *tick_timer;
+static kp_event_timer_t *tick2_timer;
+static kp_event_timer_t *autosave_timer;
+
+/* An autosave may run this early to share a tick's wakeup */
+#define AUTOSAVE_SLACK_MS (60 * 1000)
+
+/* Shorter gaps between the two clocks are scheduling noise, not sleep */
+#define RESUME_MIN_SLEEP 5  /* seconds */
+
+/* Seconds slept, detected in kp_state_tick2, not yet rewarmed */
+static int resume_pending = 0;
+
+/* Seconds slept, carried from kp_state_tick to tick_scanned */
+static int tick_slept = 0;
+
+/**
+ * Read CLOCK_BOOTTIME in microseconds (0 if unavailable)
+ *
+ * Unlike CLOCK_MONOTONIC it keeps counting through suspend and hibernate.
+ */
+static gint64
+boottime_us(void)
+{
+#ifdef CLOCK_BOOTTIME
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) == 0)
+        return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+/**
+ * Advance kp_state->time by the time that really passed
+ *
+ * Uses the monotonic clock, so the Markov and running-time accounting
+ * stay correct whatever period the timers ran with (adaptive cycle,
+ * timer slack, slow readahead). The monotonic clock stops while the
+ * system sleeps, so a suspend never counts as running time. Sub-second
+ * remainders are carried over so the integer clock doesn't drift.
+ *
+ * @return  Seconds the system slept since the last tick (boottime delta
+ *          minus monotonic delta), 0 if none detected
+ */
+static int
+advance_time(void)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 boot = boottime_us();
+    gint64 slept = 0;
+
+    if (kp_state->tick_monotonic > 0 && now > kp_state->tick_monotonic) {
+        gint64 elapsed = now - kp_state->tick_monotonic;
+
+        if (boot && kp_state->tick_boottime)
+            slept = (boot - kp_state->tick_boottime) - elapsed;
+
+        elapsed += kp_state->time_carry_us;
+        kp_state->time += (int)(elapsed / G_USEC_PER_SEC);
+        kp_state->time_carry_us = elapsed % G_USEC_PER_SEC;
+    }
+    kp_state->tick_monotonic = now;
+    kp_state->tick_boottime = boot;
+
+    return slept >= RESUME_MIN_SLEEP * G_USEC_PER_SEC ? (int)(slept / G_USEC_PER_SEC) : 0;
+}
+
+/**
+ * Clamp a cycle length to the configured bounds
+ */
+static int
+clamp_cycle(int cycle)
+{
+    const kp_power_budget_t *budget = kp_power_budget();
+    int lo = MAX(2, budget->mincycle);
+    int hi = MAX(lo, budget->maxcycle);
+    return CLAMP(cycle, lo, hi);
+}
+
+/**
+ * Set timer slack so the kernel may coalesce our wakeups with others
+ *
+ * 5 ms of slack per second of cycle (100 ms at 20 s), at most 1 s. The
+ * tick timers get the same slack on the event core, so a tick due just
+ * after another wakeup runs with it.
+ */
+static void
+update_timer_slack(int cycle)
+{
+    guint slack_ms = (guint)MIN(cycle * 5, 1000);
+
+#ifdef PR_SET_TIMERSLACK
+    if (prctl(PR_SET_TIMERSLACK, (unsigned long)slack_ms * 1000000UL, 0, 0, 0) < 0)
+        g_debug("PR_SET_TIMERSLACK failed: %s", strerror(errno));
+#endif
+    kp_event_timer_set_slack(tick_timer, slack_ms);
+    kp_event_timer_set_slack(tick2_timer, slack_ms);
+}
+
+/**
+ * Pick the next cycle length from the last scan's activity
+ *
+ *   launches      → snap to mincycle (a burst is likely to continue)
+ *   other changes → halve
+ *   nothing       → double, up to maxcycle
+ */
+static void
+adapt_cycle(void)
+{
+    int launches = 0;
+    int changes = kp_conf->system.doscan ? kp_spy_last_activity(&launches) : 0;
+    int old = kp_state->cycle;
+    int next;
+
+    if (launches > 0)
+        next = kp_power_budget()->mincycle;
+    else if (changes > 0)
+        next = old / 2;
+    else
+        next = old * 2;
+
+    next = clamp_cycle(next);
+    if (next != old) {
+        g_debug("cycle %d -> %d s (%d launches, %d changes)", old, next, launches, changes);
+        kp_state->cycle = next;
+        update_timer_slack(next);
+    }
+}
+
+static void
 kp_state_tick2(gpointer data)
 {
+    /* A resume seen here is handled by the next tick's rewarm pass */
+    resume_pending += advance_time();
+
     if (kp_state->model_dirty) {
         g_debug("state updating begin");
         kp_spy_update_model(data);
@@ -332,17 +523,26 @@ kp_state_tick2(gpointer data)
         g_debug("state updating end");
     }
 
-    kp_state->time += (kp_conf->model.cycle + 1) / 2;
-    g_timeout_add_seconds((kp_conf->model.cycle + 1) / 2, kp_state_tick, data);
-    return FALSE;
+    adapt_cycle();
+
+    kp_event_timer_arm(tick_timer, (kp_state->cycle + 1) / 2 * 1000);
 }
 
-static gboolean
-kp_state_tick(gpointer data)
+/**
+ * Second half of kp_state_tick, once /proc has been read
+ *
+ * Runs directly when scanning synchronously, or from the pipeline's
+ * completion handler when the scan thread took the snapshot.
+ */
+static void
+tick_scanned(const kp_proc_snapshot_t *snap, gpointer data)
 {
-    if (kp_conf->system.doscan) {
-        g_debug("state scanning begin");
-        kp_spy_scan(data);
+    int slept = tick_slept;
+
+    tick_slept = 0;
+
+    if (snap) {
+        kp_spy_scan_snapshot(snap, data);
         kp_state->dirty = kp_state->model_dirty = TRUE;
         g_debug("state scanning end");
     }
@@ -354,18 +554,52 @@ kp_state_tick(gpointer data)
             if (kp_session_in_boot_window()) {
                 g_debug("session boot window active (%d sec remaining)",
                         kp_session_window_remaining());
-                kp_session_preload_top_apps(5);
             }
 
             g_debug("state predicting begin");
-            kp_prophet_predict(data);
+            if (slept) {
+                /* Hibernate, or memory reclaimed during suspend, leaves the
+                 * cache cold: read back what's missing of the top set now */
+                g_message("resumed after %d s asleep, rewarming", slept);
+                kp_prophet_rewarm(data);
+            } else {
+                kp_prophet_predict(data);
+            }
             g_debug("state predicting end");
         }
     }
 
-    kp_state->time += kp_conf->model.cycle / 2;
-    g_timeout_add_seconds(kp_conf->model.cycle / 2, kp_state_tick2, data);
-    return FALSE;
+    kp_event_timer_arm(tick2_timer, MAX(1, kp_state->cycle / 2) * 1000);
+}
+
+static void
+kp_state_tick(gpointer data)
+{
+    kp_power_source_t source = kp_power_source();
+
+    tick_slept = advance_time() + resume_pending;
+    resume_pending = 0;
+
+    /* A power source switch changes the budget; pull the cycle into the
+     * new bounds right away instead of waiting for the next backoff */
+    if (kp_power_update() != source) {
+        kp_state->cycle = clamp_cycle(kp_state->cycle);
+        update_timer_slack(kp_state->cycle);
+    }
+
+    if (kp_conf->system.doscan) {
+        kp_proc_snapshot_t *snap;
+
+        g_debug("state scanning begin");
+        if (kp_pipeline_scan(tick_scanned, data))
+            return;     /* Continues in tick_scanned */
+
+        snap = kp_proc_snapshot();
+        tick_scanned(snap, data);
+        kp_proc_snapshot_free(snap);
+    } else {
+        tick_scanned(NULL, data);
+    }
 }
 
 static const char *autosave_statefile;
@@ -398,7 +632,7 @@ should_evict_exe(gpointer key, gpointer value, gpointer user_data)
     return TRUE;
 }
 
-static gboolean
+static void
 kp_state_autosave(gpointer user_data)
 {
     (void)user_data;
@@ -418,8 +652,7 @@ kp_state_autosave(gpointer user_data)
     
     kp_state_save(autosave_statefile);
 
-    g_timeout_add_seconds(kp_conf->system.autosave, kp_state_autosave, NULL);
-    return FALSE;
+    kp_event_timer_arm(autosave_timer, kp_conf->system.autosave * 1000);
 }
 
 /**
@@ -427,9 +660,22 @@ kp_state_autosave(gpointer user_data)
  */
 void kp_state_run(const char *statefile)
 {
-    g_timeout_add(0, kp_state_tick, NULL);
+    kp_power_update();
+    kp_state->cycle = clamp_cycle(kp_conf->model.cycle);
+    kp_state->tick_monotonic = 0;
+    kp_state->time_carry_us = 0;
+
+    tick_timer = kp_event_timer_new("tick", 0, kp_state_tick, NULL);
+    tick2_timer = kp_event_timer_new("tick2", 0, kp_state_tick2, NULL);
+    update_timer_slack(kp_state->cycle);
+
+    kp_pipeline_start();
+
+    kp_event_timer_arm(tick_timer, 0);
     if (statefile) {
         autosave_statefile = statefile;
-        g_timeout_add_seconds(kp_conf->system.autosave, kp_state_autosave, NULL);
+        autosave_timer = kp_event_timer_new("autosave", AUTOSAVE_SLACK_MS,
+                                            kp_state_autosave, NULL);
+        kp_event_timer_arm(autosave_timer, kp_conf->system.autosave * 1000);
     }
 }
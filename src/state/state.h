@@ -30,7 +30,11 @@
  *       │      └─ kp_map_t (per file region)
  *       │             └─ Represents a specific (path, offset, length) tuple
  *       │
- *       └─ bad_exes: GHashTable<path, size>     ← Executables too small to track
+ *       ├─ bad_exes: GHashTable<path, size>     ← Executables too small to track
+ *       │
+ *       ├─ closures: GHashTable<path, kp_closure_t*> ← Resolved library sets
+ *       │
+ *       └─ plugin_history: GHashTable<path, kp_plugin_history_t*> ← Observed plugins
  *
  * KEY RELATIONSHIPS:
  *
@@ -93,6 +97,10 @@ typedef struct _kp_map_t
     int seq;            /* Unique map sequence number */
     int block;          /* On-disk location of the start of the map */
     int priv;           /* For private local use of functions */
+    dev_t dev;          /* Device holding the file (iocost.c, 0 = unknown) */
+    int extents;        /* Physical extents of the region (-1 = not probed) */
+    double cost_us;     /* Estimated readahead cost from the device model */
+    double eta;         /* Seconds until an exe using it is expected to launch */
 } kp_map_t;
 
 /**
@@ -119,6 +127,7 @@ typedef struct _process_info_t
     time_t start_time;          /* When process started (seconds since epoch) */
     time_t last_weight_update;  /* For incremental weight calculation */
     gboolean user_initiated;    /* TRUE if started by user (shell/terminal/launcher) */
+    gboolean plugins_sampled;   /* Shared objects recorded for this run */
 } process_info_t;
 
 /**
@@ -138,16 +147,21 @@ typedef struct _kp_exe_t
     unsigned long raw_launches; /* Raw launch count (for Markov chains) */
     unsigned long total_duration_sec; /* Total cumulative runtime in seconds */
     GHashTable *running_pids;   /* pid (GINT_TO_POINTER) -> process_info_t* */
+    uid_t uid;                  /* User that last launched it (KP_UID_UNKNOWN if never seen) */
+    gboolean blacklisted;       /* Matches a blacklist rule (set by kp_exe_new, blacklist reload) */
 
     /* Runtime fields: */
     size_t size;                /* Sum of the size of the maps, in bytes */
     int running_timestamp;      /* Last time it was running */
     int change_timestamp;       /* Time started/stopped running */
     double lnprob;              /* Log-probability of NOT being needed in next period */
+    double launch_rate;         /* Expected launches per second (prophet.c) */
     int seq;                    /* Unique exe sequence number */
     pool_type_t pool;           /* Pool classification (priority/observation) */
 } kp_exe_t;
 
+#define KP_UID_UNKNOWN ((uid_t)-1)
+
 #define exe_is_running(exe) ((exe)->running_timestamp >= kp_state->last_running_timestamp)
 
 /**
@@ -241,6 +255,10 @@ typedef struct _kp_state_t
     GHashTable *app_families;       /* family_id → kp_app_family_t* */
     GHashTable *exe_to_family;      /* exe_path → family_id (reverse mapping) */
 
+    /* Resolved dependency sets of apps preloaded without observed maps */
+    GHashTable *closures;           /* exe_path → kp_closure_t* (state_closure.c) */
+    GHashTable *plugin_history;     /* exe_path → kp_plugin_history_t* (state_closure.c) */
+
     /* Runtime fields: */
 
     GSList *running_exes;       /* Set of exe structs currently running */
@@ -258,6 +276,13 @@ typedef struct _kp_state_t
     kp_memory_t memstat;        /* System memory stats */
     int memstat_timestamp;      /* Last time we updated memory stats */
 
+    int cycle;                  /* Current adaptive cycle length (seconds) */
+    gint64 tick_monotonic;      /* Monotonic time (us) of the last tick */
+    gint64 tick_boottime;       /* CLOCK_BOOTTIME (us) of the last tick */
+    gint64 time_carry_us;       /* Sub-second remainder not yet added to time */
+
+    gboolean loading;           /* kp_state_load() in progress (may be off the main thread) */
+
 } kp_state_t;
 
 /* Global state singleton */
@@ -266,6 +291,7 @@ extern kp_state_t kp_state[1];
 /* State management functions */
 void kp_state_load(const char *statefile);
 void kp_state_save(const char *statefile);
+void kp_state_write_file(const char *statefile, const GString *content);
 void kp_state_dump_log(void);
 void kp_state_run(const char *statefile);
 void kp_state_free(void);
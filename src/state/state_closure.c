@@ -0,0 +1,528 @@
+/* state_closure.c - Persistent dependency-closure cache for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * =============================================================================
+ * MODULE: Dependency Closures
+ * =============================================================================
+ *
+ * Apps that have no maps yet (session-boot top apps, manual apps that never
+ * ran under observation) need a file list before they can be preloaded.
+ * Resolving it means walking ELF dependencies and scanning plugin dirs;
+ * this module does that once per exe identity and keeps the result in
+ * kp_state->closures, which is persisted by state_io.c.
+ *
+ * VALIDATION:
+ *   A closure is valid while stat() of the exe returns the same
+ *   (dev, ino, mtime, size) and every library keeps its (ino, mtime).
+ *   Package upgrades replace files (new inode), so they invalidate the
+ *   affected closures automatically.
+ *
+ *   The learned plugin set is refreshed when history first appears for a
+ *   closure built from the blind directory scan, and again each time the
+ *   number of sampled runs doubles.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "../config/config.h"
+#include "../utils/lib_scanner.h"
+#include "state.h"
+#include "state_closure.h"
+
+#define PLUGIN_MIN_FREQ     0.25    /* Mapped in at least 1/4 of past runs */
+#define PLUGIN_HISTORY_MAX  512     /* Tracked shared objects per exe */
+#define PLUGIN_PRUNE_FREQ   0.10    /* Dropped when full and below 10% */
+
+/**
+ * Free a closure library entry
+ */
+static void
+closure_lib_free(gpointer data)
+{
+    kp_closure_lib_t *lib = data;
+    if (lib) {
+        g_free(lib->path);
+        g_slice_free(kp_closure_lib_t, lib);
+    }
+}
+
+/**
+ * Create empty closure
+ *
+ * @param exe_path  Executable path
+ * @return          New closure (caller registers it in kp_state->closures)
+ */
+kp_closure_t *
+kp_closure_new(const char *exe_path)
+{
+    kp_closure_t *closure;
+
+    g_return_val_if_fail(exe_path, NULL);
+
+    closure = g_slice_new0(kp_closure_t);
+    closure->exe_path = g_strdup(exe_path);
+    closure->update_time = kp_state->time;
+    closure->libs = g_ptr_array_new_with_free_func(closure_lib_free);
+    return closure;
+}
+
+/**
+ * Free closure
+ */
+void
+kp_closure_free(kp_closure_t *closure)
+{
+    g_return_if_fail(closure);
+
+    g_ptr_array_free(closure->libs, TRUE);
+    g_free(closure->exe_path);
+    g_slice_free(kp_closure_t, closure);
+}
+
+/**
+ * Append a library to a closure
+ */
+void
+kp_closure_add_lib(kp_closure_t *closure, const char *path,
+                   size_t size, ino_t ino, time_t mtime, double prob)
+{
+    kp_closure_lib_t *lib;
+
+    g_return_if_fail(closure);
+    g_return_if_fail(path);
+
+    lib = g_slice_new(kp_closure_lib_t);
+    lib->path = g_strdup(path);
+    lib->size = size;
+    lib->ino = ino;
+    lib->mtime = mtime;
+    lib->prob = prob;
+    g_ptr_array_add(closure->libs, lib);
+}
+
+/* ========================================================================
+ * LEARNED PLUGIN HISTORY
+ * ======================================================================== */
+
+/**
+ * Create empty plugin history
+ */
+kp_plugin_history_t *
+kp_plugin_history_new(const char *exe_path)
+{
+    kp_plugin_history_t *history;
+
+    g_return_val_if_fail(exe_path, NULL);
+
+    history = g_slice_new0(kp_plugin_history_t);
+    history->exe_path = g_strdup(exe_path);
+    history->counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    return history;
+}
+
+/**
+ * Free plugin history
+ */
+void
+kp_plugin_history_free(kp_plugin_history_t *history)
+{
+    g_return_if_fail(history);
+
+    g_hash_table_destroy(history->counts);
+    g_free(history->exe_path);
+    g_slice_free(kp_plugin_history_t, history);
+}
+
+/* Drop rarely seen objects (GHRFunc for g_hash_table_foreach_remove) */
+static gboolean
+plugin_is_rare(gpointer G_GNUC_UNUSED key, gpointer value, gpointer user_data)
+{
+    const kp_plugin_history_t *history = user_data;
+    return GPOINTER_TO_INT(value) < history->runs * PLUGIN_PRUNE_FREQ;
+}
+
+/**
+ * Record the shared objects one run of an exe mapped
+ */
+void
+kp_closure_record_plugins(const char *exe_path, GPtrArray *sos)
+{
+    kp_plugin_history_t *history;
+
+    g_return_if_fail(exe_path);
+    g_return_if_fail(sos);
+    g_return_if_fail(kp_state->plugin_history);
+
+    history = g_hash_table_lookup(kp_state->plugin_history, exe_path);
+    if (!history) {
+        history = kp_plugin_history_new(exe_path);
+        g_hash_table_insert(kp_state->plugin_history, history->exe_path, history);
+    }
+
+    history->runs++;
+
+    if (g_hash_table_size(history->counts) + sos->len > PLUGIN_HISTORY_MAX)
+        g_hash_table_foreach_remove(history->counts, plugin_is_rare, history);
+
+    for (guint i = 0; i < sos->len; i++) {
+        const char *path = g_ptr_array_index(sos, i);
+        gpointer count;
+
+        if (g_hash_table_lookup_extended(history->counts, path, NULL, &count)) {
+            g_hash_table_insert(history->counts, g_strdup(path),
+                                GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
+        } else if (g_hash_table_size(history->counts) < PLUGIN_HISTORY_MAX) {
+            g_hash_table_insert(history->counts, g_strdup(path), GINT_TO_POINTER(1));
+        }
+    }
+
+    kp_state->dirty = TRUE;
+
+    g_debug("Plugin history: %s run %d, %u shared objects mapped",
+            exe_path, history->runs, sos->len);
+}
+
+/* Merge one history into the aggregate counts */
+static void
+merge_history(const kp_plugin_history_t *history, GHashTable *counts, int *runs)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    *runs += history->runs;
+
+    g_hash_table_iter_init(&iter, history->counts);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        gpointer sum = g_hash_table_lookup(counts, key);
+        g_hash_table_insert(counts, key,
+                            GINT_TO_POINTER(GPOINTER_TO_INT(sum) + GPOINTER_TO_INT(value)));
+    }
+}
+
+/**
+ * Aggregate plugin history of an exe and the members of its family
+ *
+ * @param exe_path  Executable path
+ * @param counts    Out: so_path (borrowed) → summed count
+ * @return          Summed number of sampled runs
+ */
+static int
+collect_plugin_history(const char *exe_path, GHashTable *counts)
+{
+    const kp_plugin_history_t *history;
+    const char *family_id;
+    kp_app_family_t *family;
+    gboolean self_counted = FALSE;
+    int runs = 0;
+
+    family_id = kp_family_lookup_by_exe(exe_path);
+    family = family_id ? kp_family_lookup(family_id) : NULL;
+
+    if (family) {
+        for (guint i = 0; i < family->member_paths->len; i++) {
+            const char *member = g_ptr_array_index(family->member_paths, i);
+
+            if (strcmp(member, exe_path) == 0)
+                self_counted = TRUE;
+
+            history = g_hash_table_lookup(kp_state->plugin_history, member);
+            if (history)
+                merge_history(history, counts, &runs);
+        }
+    }
+
+    if (!self_counted) {
+        history = g_hash_table_lookup(kp_state->plugin_history, exe_path);
+        if (history)
+            merge_history(history, counts, &runs);
+    }
+
+    return runs;
+}
+
+/**
+ * Sampled runs available for an exe (and its family)
+ */
+static int
+plugin_history_runs(const char *exe_path)
+{
+    GHashTable *counts = g_hash_table_new(g_str_hash, g_str_equal);
+    int runs = collect_plugin_history(exe_path, counts);
+    g_hash_table_destroy(counts);
+    return runs;
+}
+
+/**
+ * Check cached closure against the filesystem
+ */
+static gboolean
+closure_is_valid(const kp_closure_t *closure, const struct stat *exe_st)
+{
+    struct stat st;
+
+    if (closure->dev != exe_st->st_dev || closure->ino != exe_st->st_ino ||
+        closure->mtime != exe_st->st_mtime ||
+        closure->size != (size_t)exe_st->st_size)
+        return FALSE;
+
+    for (guint i = 0; i < closure->libs->len; i++) {
+        const kp_closure_lib_t *lib = g_ptr_array_index(closure->libs, i);
+
+        if (stat(lib->path, &st) < 0 ||
+            st.st_ino != lib->ino || st.st_mtime != lib->mtime)
+            return FALSE;
+    }
+
+    /* Refresh the learned plugin set as history accumulates */
+    if (kp_state->plugin_history) {
+        int runs = plugin_history_runs(closure->exe_path);
+
+        if ((closure->plugin_runs == 0 && runs > 0) ||
+            (closure->plugin_runs > 0 && runs >= 2 * closure->plugin_runs))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Learned plugin candidate */
+typedef struct {
+    const char *path;
+    double freq;
+} plugin_candidate_t;
+
+static gint
+plugin_candidate_compare(gconstpointer a, gconstpointer b)
+{
+    const plugin_candidate_t *ca = a, *cb = b;
+    if (ca->freq != cb->freq)
+        return ca->freq < cb->freq ? 1 : -1;
+    return strcmp(ca->path, cb->path);
+}
+
+/**
+ * Add learned plugins to a closure, most frequent first
+ *
+ * @param seen  Paths already in the closure (ELF dependencies)
+ * @return      Number of sampled runs the set was derived from (0 = no history)
+ */
+static int
+closure_add_learned_plugins(kp_closure_t *closure, GHashTable *seen)
+{
+    GHashTable *counts;
+    GHashTableIter iter;
+    gpointer key, value;
+    GArray *candidates;
+    struct stat st;
+    int runs;
+
+    if (!kp_state->plugin_history)
+        return 0;
+
+    counts = g_hash_table_new(g_str_hash, g_str_equal);
+    runs = collect_plugin_history(closure->exe_path, counts);
+    candidates = g_array_new(FALSE, FALSE, sizeof(plugin_candidate_t));
+
+    g_hash_table_iter_init(&iter, counts);
+    while (runs > 0 && g_hash_table_iter_next(&iter, &key, &value)) {
+        plugin_candidate_t c;
+
+        c.path = key;
+        c.freq = MIN(1.0, (double)GPOINTER_TO_INT(value) / runs);
+        if (c.freq >= PLUGIN_MIN_FREQ && !g_hash_table_contains(seen, c.path))
+            g_array_append_val(candidates, c);
+    }
+
+    g_array_sort(candidates, plugin_candidate_compare);
+
+    for (guint i = 0; i < candidates->len; i++) {
+        const plugin_candidate_t *c = &g_array_index(candidates, plugin_candidate_t, i);
+
+        if (stat(c->path, &st) < 0 || !S_ISREG(st.st_mode))
+            continue;
+        kp_closure_add_lib(closure, c->path, st.st_size, st.st_ino, st.st_mtime, c->freq);
+    }
+
+    if (runs > 0)
+        g_debug("Closure %s: %u learned plugins from %d runs",
+                closure->exe_path, candidates->len, runs);
+
+    g_array_free(candidates, TRUE);
+    g_hash_table_destroy(counts);
+
+    return runs;
+}
+
+/**
+ * Append a library list to a closure, skipping paths already present
+ */
+static void
+closure_add_list(kp_closure_t *closure, GHashTable *seen, char **libs)
+{
+    struct stat st;
+
+    for (int i = 0; libs[i]; i++) {
+        if (g_hash_table_contains(seen, libs[i]))
+            continue;
+        if (stat(libs[i], &st) < 0 || !S_ISREG(st.st_mode))
+            continue;
+        kp_closure_add_lib(closure, libs[i], st.st_size, st.st_ino, st.st_mtime, 1.0);
+        g_hash_table_add(seen, ((kp_closure_lib_t *)
+                                g_ptr_array_index(closure->libs, closure->libs->len - 1))->path);
+    }
+}
+
+/**
+ * Resolve closure from scratch
+ */
+static kp_closure_t *
+closure_resolve(const char *exe_path, const struct stat *exe_st)
+{
+    kp_closure_t *closure;
+    GHashTable *seen;
+    char **libs;
+
+    closure = kp_closure_new(exe_path);
+    closure->dev = exe_st->st_dev;
+    closure->ino = exe_st->st_ino;
+    closure->mtime = exe_st->st_mtime;
+    closure->size = exe_st->st_size;
+
+    seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+    libs = kp_scan_libraries(exe_path);
+    if (libs) {
+        closure_add_list(closure, seen, libs);
+        kp_free_library_list(libs);
+    }
+
+    /* dlopen()ed plugins: learned from past runs, blind dir scan as fallback */
+    closure->plugin_runs = closure_add_learned_plugins(closure, seen);
+    if (closure->plugin_runs == 0) {
+        libs = kp_scan_plugin_dir(exe_path);
+        if (libs) {
+            closure_add_list(closure, seen, libs);
+            kp_free_library_list(libs);
+        }
+    }
+
+    g_hash_table_destroy(seen);
+
+    return closure;
+}
+
+/**
+ * Get up-to-date closure for an executable
+ */
+const kp_closure_t *
+kp_closure_get(const char *exe_path)
+{
+    kp_closure_t *closure;
+    struct stat st;
+
+    g_return_val_if_fail(exe_path, NULL);
+    g_return_val_if_fail(kp_state->closures, NULL);
+
+    if (stat(exe_path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        g_hash_table_remove(kp_state->closures, exe_path);
+        return NULL;
+    }
+
+    closure = g_hash_table_lookup(kp_state->closures, exe_path);
+    if (closure && closure_is_valid(closure, &st)) {
+        g_debug("Closure cache hit: %s (%u libs)", exe_path, closure->libs->len);
+        return closure;
+    }
+
+    if (closure)
+        g_debug("Closure cache stale: %s", exe_path);
+
+    closure = closure_resolve(exe_path, &st);
+    g_hash_table_replace(kp_state->closures, closure->exe_path, closure);
+    kp_state->dirty = TRUE;
+
+    return closure;
+}
+
+/**
+ * Attach a whole-file map to exe, sharing an existing map object
+ */
+static gboolean
+attach_file_map(kp_exe_t *exe, GHashTable *mapped, const char *path,
+                size_t size, double prob)
+{
+    kp_map_t *map, *existing;
+    kp_exemap_t *exemap;
+
+    if (size < (size_t)kp_conf->model.minsize)
+        return FALSE;
+
+    if (g_hash_table_contains(mapped, path))
+        return FALSE;
+
+    map = kp_map_new(path, 0, size);
+    if (!map)
+        return FALSE;
+
+    existing = NULL;
+    if (g_hash_table_lookup_extended(kp_state->maps, map, (gpointer *)&existing, NULL)) {
+        kp_map_free(map);
+        map = existing;
+    }
+
+    exemap = kp_exe_map_new(exe, map);
+    if (!exemap) {
+        if (!existing)
+            kp_map_free(map);
+        return FALSE;
+    }
+
+    exemap->prob = prob;
+    g_hash_table_add(mapped, map->path);
+    return TRUE;
+}
+
+/* Collect paths already mapped by the exe (GFunc for g_set_foreach) */
+static void
+collect_mapped_path(gpointer data, gpointer user_data)
+{
+    kp_exemap_t *exemap = data;
+    g_hash_table_add((GHashTable *)user_data, exemap->map->path);
+}
+
+/**
+ * Attach maps for an exe's binary and closure
+ */
+int
+kp_closure_load_maps(kp_exe_t *exe)
+{
+    const kp_closure_t *closure;
+    GHashTable *mapped;
+    int loaded = 0;
+
+    g_return_val_if_fail(exe, 0);
+    g_return_val_if_fail(exe->path, 0);
+
+    closure = kp_closure_get(exe->path);
+    if (!closure)
+        return 0;
+
+    mapped = g_hash_table_new(g_str_hash, g_str_equal);
+    g_set_foreach(exe->exemaps, collect_mapped_path, mapped);
+
+    if (attach_file_map(exe, mapped, exe->path, closure->size, 1.0))
+        loaded++;
+
+    for (guint i = 0; i < closure->libs->len; i++) {
+        const kp_closure_lib_t *lib = g_ptr_array_index(closure->libs, i);
+        if (attach_file_map(exe, mapped, lib->path, lib->size, lib->prob))
+            loaded++;
+    }
+
+    g_hash_table_destroy(mapped);
+
+    return loaded;
+}
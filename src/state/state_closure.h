@@ -0,0 +1,140 @@
+/* state_closure.h - Persistent dependency-closure cache for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * =============================================================================
+ * MODULE: Dependency Closures
+ * =============================================================================
+ *
+ * A closure is the resolved set of files an executable needs before it can
+ * run: its shared library closure plus plugins found next to it, each with
+ * its size. Closures are keyed by exe path and carry the exe's identity
+ * (dev, ino, mtime, size), and every library carries its own (ino, mtime).
+ *
+ *   kp_state->closures: exe_path → kp_closure_t
+ *                                     ├─ identity of exe
+ *                                     └─ libs: [path, size, ino, mtime]...
+ *
+ * Closures are saved with the state (CLOSURE / LIB lines), so session-boot
+ * preloading and manual-app boosts reuse them after a restart without
+ * resolving ELF dependencies again. An entry is dropped and rebuilt as soon
+ * as the exe or any library changes on disk.
+ *
+ * LEARNED PLUGINS:
+ *   dlopen()ed plugins are not in DT_NEEDED. Instead of preloading every
+ *   .so next to the binary, the spy samples /proc/PID/maps of priority
+ *   apps once per run and counts which shared objects they mapped:
+ *
+ *     kp_state->plugin_history: exe_path → kp_plugin_history_t
+ *                                             ├─ runs (sampled runs)
+ *                                             └─ counts: so_path → runs seen
+ *
+ *   A closure includes objects seen in at least PLUGIN_MIN_FREQ of the runs
+ *   of the exe or its family, with that frequency as the map probability.
+ *   The blind directory scan is only used while no history exists.
+ *
+ * =============================================================================
+ */
+
+#ifndef STATE_CLOSURE_H
+#define STATE_CLOSURE_H
+
+#include "state.h"
+
+/**
+ * kp_closure_lib_t: One file of a closure
+ */
+typedef struct _kp_closure_lib_t
+{
+    char *path;         /* Canonical path */
+    size_t size;        /* File size in bytes when resolved */
+    ino_t ino;          /* Identity when resolved */
+    time_t mtime;
+    double prob;        /* Probability the app maps it (1.0 for DT_NEEDED) */
+} kp_closure_lib_t;
+
+/**
+ * kp_closure_t: Resolved dependency set of an executable
+ */
+typedef struct _kp_closure_t
+{
+    char *exe_path;     /* Executable the closure belongs to */
+    dev_t dev;          /* Exe identity when resolved */
+    ino_t ino;
+    time_t mtime;
+    size_t size;
+    int update_time;    /* kp_state->time when resolved */
+    int plugin_runs;    /* Learned runs the plugin set was derived from */
+    GPtrArray *libs;    /* kp_closure_lib_t*, resolution order */
+} kp_closure_t;
+
+/**
+ * kp_plugin_history_t: Shared objects observed in past runs of an exe
+ */
+typedef struct _kp_plugin_history_t
+{
+    char *exe_path;
+    int runs;               /* Number of sampled process runs */
+    GHashTable *counts;     /* so_path → GINT_TO_POINTER(runs it was mapped in) */
+} kp_plugin_history_t;
+
+/**
+ * Create empty closure (not registered)
+ */
+kp_closure_t *kp_closure_new(const char *exe_path);
+
+/**
+ * Free closure
+ */
+void kp_closure_free(kp_closure_t *closure);
+
+/**
+ * Append a library to a closure
+ */
+void kp_closure_add_lib(kp_closure_t *closure, const char *path,
+                        size_t size, ino_t ino, time_t mtime, double prob);
+
+/**
+ * Get up-to-date closure for an executable
+ *
+ * Returns the cached closure if the exe and all libraries are unchanged,
+ * otherwise resolves it again via kp_scan_libraries() and replaces the
+ * cached entry (marking the state dirty).
+ *
+ * @param exe_path  Executable path
+ * @return          Closure owned by kp_state->closures, or NULL if exe is gone
+ */
+const kp_closure_t *kp_closure_get(const char *exe_path);
+
+/**
+ * Attach maps for an exe's binary and closure
+ *
+ * Creates one whole-file map per file (binary first), skipping files
+ * below model.minsize and files the exe already maps. Existing map
+ * objects are shared.
+ *
+ * @param exe  Executable to populate
+ * @return     Number of maps attached
+ */
+int kp_closure_load_maps(kp_exe_t *exe);
+
+/**
+ * Create empty plugin history (not registered)
+ */
+kp_plugin_history_t *kp_plugin_history_new(const char *exe_path);
+
+/**
+ * Free plugin history
+ */
+void kp_plugin_history_free(kp_plugin_history_t *history);
+
+/**
+ * Record the shared objects one run of an exe mapped
+ *
+ * @param exe_path  Executable path
+ * @param sos       Distinct shared object paths (kp_proc_get_shared_objects)
+ */
+void kp_closure_record_plugins(const char *exe_path, GPtrArray *sos);
+
+#endif /* STATE_CLOSURE_H */
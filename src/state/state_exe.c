@@ -27,6 +27,7 @@
 #include "common.h"
 #include "state.h"
 #include "state_exe.h"
+#include "../config/blacklist.h"
 
 /**
  * Add map size to exe's total size
@@ -70,6 +71,12 @@ kp_exe_new(const char *path, gboolean running, GSet *exemaps)
     exe->weighted_launches = 0.0;
     exe->raw_launches = 0;
     exe->total_duration_sec = 0;
+    exe->launch_rate = 0;
+    exe->uid = KP_UID_UNKNOWN;
+    exe->pool = POOL_OBSERVATION;   /* Callers classify before registering */
+    /* The blacklist may still be loading in parallel with the state file;
+     * main.c refreshes the flag once both are done */
+    exe->blacklisted = kp_state->loading ? FALSE : kp_blacklist_contains(path);
     exe->running_pids = g_hash_table_new_full(
         g_direct_hash, g_direct_equal,
         NULL,                /* pid is stored as GINT_TO_POINTER, no need to free */
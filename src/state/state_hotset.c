@@ -0,0 +1,147 @@
+/* state_hotset.c - Boot hot set for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * =============================================================================
+ * MODULE: Hot Set
+ * =============================================================================
+ *
+ * On a cold boot the whole state file (maps, exes, exemaps, Markov chains,
+ * families, closures, PID revalidation) used to be parsed before the first
+ * prediction could run. The hot set is a copy of what the prophet last
+ * decided to read, stored at the top of the state file, so main.c can read
+ * it in while state_io.c is still parsing the rest on the loader thread.
+ *
+ * The hot set is kept outside kp_state: kp_state_load() wipes kp_state on
+ * another thread while kp_hotset_load() runs. Until the prophet issues its
+ * first batch, the hot set read at startup is what gets saved again.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "state.h"
+#include "state_hotset.h"
+
+static GPtrArray *hotset = NULL;   /* Unregistered kp_map_t copies */
+
+/* kp_map_new() reads kp_state->time, which the loader thread may be writing */
+static kp_map_t *
+hot_map_new(const char *path, size_t offset, size_t length)
+{
+    kp_map_t *map = g_slice_new0(kp_map_t);
+
+    map->path = g_strdup(path);
+    map->offset = offset;
+    map->length = length;
+    map->block = -1;
+    map->extents = -1;
+    map->eta = G_MAXDOUBLE;
+    return map;
+}
+
+static void
+hot_map_free(gpointer data)
+{
+    kp_map_free((kp_map_t *)data);
+}
+
+static void
+hotset_reset(void)
+{
+    if (hotset)
+        g_ptr_array_free(hotset, TRUE);
+    hotset = g_ptr_array_new_with_free_func(hot_map_free);
+}
+
+/**
+ * Remember a readahead batch as the current hot set
+ */
+void
+kp_hotset_record(kp_map_t **maps, int count)
+{
+    hotset_reset();
+
+    for (int i = 0; i < count && i < KP_HOTSET_MAX_MAPS; i++)
+        g_ptr_array_add(hotset, hot_map_new(maps[i]->path, maps[i]->offset,
+                                            maps[i]->length));
+}
+
+/**
+ * Read the hot set section of a state file
+ */
+int
+kp_hotset_load(const char *statefile)
+{
+    char line[FILELEN + 128];
+    char uri[FILELEN];
+    char tag[32];
+    FILE *f;
+    int consumed;
+    int major;
+
+    hotset_reset();
+
+    if (!statefile || !*statefile)
+        return 0;
+
+    f = fopen(statefile, "r");
+    if (!f)
+        return 0;
+
+    /* Same header check as the full parser */
+    if (!fgets(line, sizeof(line), f) ||
+        sscanf(line, "%31s %d.", tag, &major) != 2 ||
+        strcmp(tag, "PRELOAD") || major != (int)strtod(VERSION, NULL)) {
+        fclose(f);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), f) && hotset->len < KP_HOTSET_MAX_MAPS) {
+        unsigned long offset, length;
+        char *path;
+
+        if (sscanf(line, "%31s%n", tag, &consumed) != 1)
+            break;
+        if (!strcmp(tag, "HOTSET"))
+            continue;
+        if (strcmp(tag, "HOT"))
+            break;      /* End of section */
+
+        if (sscanf(line + consumed, "%lu %lu %"FILELENSTR"s",
+                   &offset, &length, uri) != 3)
+            break;
+
+        path = g_filename_from_uri(uri, NULL, NULL);
+        if (!path)
+            continue;
+
+        g_ptr_array_add(hotset, hot_map_new(path, offset, length));
+        g_free(path);
+    }
+
+    fclose(f);
+    return (int)hotset->len;
+}
+
+/**
+ * Current hot set
+ */
+GPtrArray *
+kp_hotset_maps(void)
+{
+    return hotset && hotset->len ? hotset : NULL;
+}
+
+/**
+ * Free the hot set
+ */
+void
+kp_hotset_free(void)
+{
+    if (hotset) {
+        g_ptr_array_free(hotset, TRUE);
+        hotset = NULL;
+    }
+}
@@ -0,0 +1,61 @@
+/* state_hotset.h - Boot hot set for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * =============================================================================
+ * MODULE: Hot Set
+ * =============================================================================
+ *
+ * The last readahead batch the prophet issued (the top-ranked maps that fit
+ * the memory budget) is written as the first section of the state file:
+ *
+ *   PRELOAD  <version> <time>
+ *   HOTSET   <count>
+ *   HOT      <offset> <length> <uri>
+ *   ...
+ *   MAP ...
+ *
+ * At startup kp_hotset_load() reads only the header and this section, so
+ * the first readahead can be issued while the rest of the model is still
+ * being parsed. The full parser skips the section.
+ *
+ * =============================================================================
+ */
+
+#ifndef STATE_HOTSET_H
+#define STATE_HOTSET_H
+
+#include "state.h"
+
+#define KP_HOTSET_MAX_MAPS 1024    /* Entries kept and written */
+
+/**
+ * Remember a readahead batch as the current hot set
+ *
+ * Copies path, offset and length; the maps themselves are not referenced.
+ */
+void kp_hotset_record(kp_map_t **maps, int count);
+
+/**
+ * Read the hot set section of a state file
+ *
+ * Stops at the first line after the section, so the cost does not grow
+ * with the size of the model. Safe to call while another thread runs
+ * kp_state_load(): nothing in kp_state is touched.
+ *
+ * @return  Number of entries read (0 if the file has no hot set)
+ */
+int kp_hotset_load(const char *statefile);
+
+/**
+ * Current hot set, as unregistered maps (NULL if empty)
+ */
+GPtrArray *kp_hotset_maps(void);
+
+/**
+ * Free the hot set
+ */
+void kp_hotset_free(void);
+
+#endif /* STATE_HOTSET_H */
@@ -10,23 +10,29 @@
  * This module handles reading and writing the persistent state file.
  *
  * READ SEQUENCE:
+ *   0. HOTSET/HOT     - Skipped (read early by kp_hotset_load())
  *   1. read_map()     - Memory map regions
  *   2. read_badexe()  - Blacklisted executables (skipped)
  *   3. read_exe()     - Tracked executables
  *   4. read_exemap()  - Exe-to-map associations
  *   5. read_markov()  - Correlation chains
  *   6. read_family()  - Application families
- *   7. read_crc32()   - Integrity verification
+ *   7. read_closure() - Dependency closures (+ LIB subsections)
+ *   8. read_plugins() - Learned plugin history (+ SO subsections)
+ *   9. read_crc32()   - Integrity verification
  *
  * WRITE SEQUENCE:
  *   1. write_header() - Version info
+ *      write_hotset() - Last readahead batch, for the next boot
  *   2. write_map()    - All maps
  *   3. write_badexe() - Blacklisted exes
  *   4. write_exe()    - All exes
  *   5. write_exemap() - All exemaps
  *   6. write_markov() - All Markov chains
  *   7. write_family() - All families
- *   8. write_crc32()  - CRC32 footer
+ *   8. write_closure() - Dependency closures of tracked exes
+ *   9. write_plugins() - Learned plugin history of tracked exes
+ *  10. write_crc32()  - CRC32 footer
  *
  * =============================================================================
  */
@@ -39,6 +45,8 @@
 #include "../daemon/stats.h"
 #include "state.h"
 #include "state_io.h"
+#include "state_closure.h"
+#include "state_hotset.h"
 
 #include <time.h>
 #include <fcntl.h>
@@ -52,6 +60,8 @@
  * ======================================================================== */
 
 #define TAG_PRELOAD     "PRELOAD"
+#define TAG_HOTSET      "HOTSET"     /* Boot hot set (written first) */
+#define TAG_HOT         "HOT"        /* Hot set entry */
 #define TAG_MAP         "MAP"
 #define TAG_BADEXE      "BADEXE"
 #define TAG_EXE         "EXE"
@@ -60,6 +70,10 @@
 #define TAG_EXEMAP      "EXEMAP"
 #define TAG_MARKOV      "MARKOV"
 #define TAG_FAMILY      "FAMILY"
+#define TAG_CLOSURE     "CLOSURE"
+#define TAG_LIB         "LIB"        /* Closure library subsection entry */
+#define TAG_PLUGINS     "PLUGINS"
+#define TAG_SO          "SO"         /* Plugin history subsection entry */
 #define TAG_CRC32       "CRC32"
 #define TAG_PRELOAD_TIMES "PRELOAD_TIMES"  /* Preload timestamps section */
 #define TAG_PRELOAD_TIME  "PRELOAD"        /* Individual preload timestamp */
@@ -84,6 +98,8 @@ typedef struct _read_context_t
     GHashTable *exes;
     kp_exe_t *current_exe;      /* Current exe for reading PIDS subsections */
     int expected_pids;          /* Number of PIDs to read */
+    kp_closure_t *current_closure; /* Current closure for reading LIB entries */
+    kp_plugin_history_t *current_history; /* Current history for reading SO entries */
     gpointer data;
     GError *err;
     char filebuf[FILELEN];
@@ -93,18 +109,13 @@ typedef struct _read_context_t
  * PID VALIDATION HELPERS
  * ======================================================================== */
 
-/* Forward declaration - get_parent_pid() is defined in spy.c */
-extern pid_t get_parent_pid(pid_t pid);
-
 /**
  * Check if PID still exists in /proc
  */
 static gboolean
 is_pid_alive(pid_t pid)
 {
-    char proc_path[64];
-    snprintf(proc_path, sizeof(proc_path), "/proc/%d", pid);
-    return g_file_test(proc_path, G_FILE_TEST_EXISTS);
+    return kp_proc_exists(pid);
 }
 
 /**
@@ -121,28 +132,27 @@ is_pid_alive(pid_t pid)
 static gboolean
 verify_pid_exe_match(pid_t pid, const char *expected_path)
 {
-    char exe_link[64];
-    char actual_path[PATH_MAX];
+    char *actual_path;
     char resolved_expected[PATH_MAX];
-    ssize_t len;
-    
-    snprintf(exe_link, sizeof(exe_link), "/proc/%d/exe", pid);
-    len = readlink(exe_link, actual_path, sizeof(actual_path) - 1);
+    gboolean match;
     
-    if (len < 0) {
+    actual_path = kp_proc_get_exe(pid);
+    if (!actual_path) {
         /* Process exited or we don't have permission */
         return FALSE;
     }
-    actual_path[len] = '\0';
     
     /* Resolve both paths to canonical form (handle symlinks) */
     if (!realpath(expected_path, resolved_expected)) {
         /* Expected path doesn't exist anymore */
+        g_free(actual_path);
         return FALSE;
     }
     
     /* Compare canonical paths */
-    return (strcmp(actual_path, resolved_expected) == 0);
+    match = (strcmp(actual_path, resolved_expected) == 0);
+    g_free(actual_path);
+    return match;
 }
 
 /* ========================================================================
@@ -233,18 +243,26 @@ read_exe(read_context_t *rc)
     kp_exe_t *exe;
     int update_time, time;
     int i, expansion, pool = POOL_OBSERVATION;
+    int uid = -1;
     double weighted_launches = 0.0;
     unsigned long raw_launches = 0, total_duration = 0;
     char *path;
     int fields_read;
 
-    /* Try new 9-field format first (with weighted counting) */
+    /* Try 10-field format first (with launching user) */
     fields_read = sscanf(rc->line,
+                         "%d %d %d %d %d %lf %lu %lu %d %"FILELENSTR"s",
+                         &i, &update_time, &time, &expansion, &pool,
+                         &weighted_launches, &raw_launches, &total_duration,
+                         &uid, rc->filebuf);
+
+    if (fields_read >= 10) {
+        /* Success - current format */
+    } else if ((fields_read = sscanf(rc->line,
                          "%d %d %d %d %d %lf %lu %lu %"FILELENSTR"s",
                          &i, &update_time, &time, &expansion, &pool, 
-                         &weighted_launches, &raw_launches, &total_duration, rc->filebuf);
-    
-    if (fields_read >= 9) {
+                         &weighted_launches, &raw_launches, &total_duration,
+                         rc->filebuf)) >= 9) {
         /* Success - new format */
         g_debug("Read exe in new 9-field format (weighted counting)");
     } else {
@@ -278,6 +296,7 @@ read_exe(read_context_t *rc)
     exe->weighted_launches = weighted_launches;
     exe->raw_launches = raw_launches;
     exe->total_duration_sec = total_duration;
+    exe->uid = uid < 0 ? KP_UID_UNKNOWN : (uid_t)uid;
     exe->change_timestamp = -1;
     g_free(path);
     if (g_hash_table_lookup(rc->exes, GINT_TO_POINTER(i))) {
@@ -470,6 +489,191 @@ read_family(read_context_t *rc)
     g_hash_table_insert(kp_state->app_families, g_strdup(family_id), family);
 }
 
+/* Read dependency closure header from state file
+ *
+ * CLOSURE format: "CLOSURE <update_time> <dev> <ino> <mtime> <size> <plugin_runs> <uri>"
+ *   update_time - Timestamp when the closure was resolved
+ *   dev/ino     - Identity of the executable when resolved
+ *   mtime/size  - Modification time and size of the executable
+ *   plugin_runs - Learned runs the plugin set came from (absent in old files)
+ *   uri         - Executable path as file URI
+ *
+ * Followed by indented "LIB" lines, see read_closure_lib().
+ */
+static void
+read_closure(read_context_t *rc)
+{
+    kp_closure_t *closure;
+    int update_time;
+    unsigned long long dev, ino, size;
+    long long mtime;
+    int plugin_runs = 0;
+    char *path;
+
+    rc->current_closure = NULL;
+
+    if (7 > sscanf(rc->line,
+                   "%d %llu %llu %lld %llu %d %"FILELENSTR"s",
+                   &update_time, &dev, &ino, &mtime, &size, &plugin_runs, rc->filebuf)) {
+        plugin_runs = 0;
+        if (6 > sscanf(rc->line,
+                       "%d %llu %llu %lld %llu %"FILELENSTR"s",
+                       &update_time, &dev, &ino, &mtime, &size, rc->filebuf)) {
+            rc->errmsg = READ_SYNTAX_ERROR;
+            return;
+        }
+    }
+
+    path = g_filename_from_uri(rc->filebuf, NULL, &(rc->err));
+    if (!path)
+        return;
+
+    if (g_hash_table_contains(kp_state->closures, path)) {
+        g_debug("Closure for %s already exists, skipping duplicate", path);
+        g_free(path);
+        return;
+    }
+
+    closure = kp_closure_new(path);
+    g_free(path);
+    closure->update_time = update_time;
+    closure->dev = (dev_t)dev;
+    closure->ino = (ino_t)ino;
+    closure->mtime = (time_t)mtime;
+    closure->size = (size_t)size;
+    closure->plugin_runs = plugin_runs;
+
+    g_hash_table_insert(kp_state->closures, closure->exe_path, closure);
+    rc->current_closure = closure;
+}
+
+/* Read closure library entry from state file
+ *
+ * LIB format: "LIB <size> <ino> <mtime> <prob> <uri>"
+ *   size  - File size in bytes when resolved
+ *   ino   - Inode number when resolved
+ *   mtime - Modification time when resolved
+ *   prob  - Probability the app maps it (absent in old files, 1.0)
+ *   uri   - Library path as file URI
+ */
+static void
+read_closure_lib(read_context_t *rc)
+{
+    unsigned long long size, ino;
+    long long mtime;
+    double prob = 1.0;
+    char *path;
+
+    if (5 > sscanf(rc->line,
+                   "%llu %llu %lld %lf %"FILELENSTR"s",
+                   &size, &ino, &mtime, &prob, rc->filebuf)) {
+        prob = 1.0;
+        if (4 > sscanf(rc->line,
+                       "%llu %llu %lld %"FILELENSTR"s",
+                       &size, &ino, &mtime, rc->filebuf)) {
+            rc->errmsg = READ_SYNTAX_ERROR;
+            return;
+        }
+    }
+
+    if (prob < 0.0 || prob > 1.0) {
+        rc->errmsg = READ_SYNTAX_ERROR;
+        return;
+    }
+
+    if (!rc->current_closure) {
+        /* Parent closure was a skipped duplicate */
+        return;
+    }
+
+    path = g_filename_from_uri(rc->filebuf, NULL, &(rc->err));
+    if (!path)
+        return;
+
+    kp_closure_add_lib(rc->current_closure, path, (size_t)size, (ino_t)ino,
+                       (time_t)mtime, prob);
+    g_free(path);
+}
+
+/* Read learned plugin history header from state file
+ *
+ * PLUGINS format: "PLUGINS <runs> <uri>"
+ *   runs - Number of sampled process runs
+ *   uri  - Executable path as file URI
+ *
+ * Followed by indented "SO" lines, see read_plugin_so().
+ */
+static void
+read_plugins(read_context_t *rc)
+{
+    kp_plugin_history_t *history;
+    int runs;
+    char *path;
+
+    rc->current_history = NULL;
+
+    if (2 > sscanf(rc->line, "%d %"FILELENSTR"s", &runs, rc->filebuf)) {
+        rc->errmsg = READ_SYNTAX_ERROR;
+        return;
+    }
+
+    if (runs <= 0) {
+        rc->errmsg = READ_SYNTAX_ERROR;
+        return;
+    }
+
+    path = g_filename_from_uri(rc->filebuf, NULL, &(rc->err));
+    if (!path)
+        return;
+
+    if (g_hash_table_contains(kp_state->plugin_history, path)) {
+        g_debug("Plugin history for %s already exists, skipping duplicate", path);
+        g_free(path);
+        return;
+    }
+
+    history = kp_plugin_history_new(path);
+    g_free(path);
+    history->runs = runs;
+
+    g_hash_table_insert(kp_state->plugin_history, history->exe_path, history);
+    rc->current_history = history;
+}
+
+/* Read plugin history entry from state file
+ *
+ * SO format: "SO <count> <uri>"
+ *   count - Number of sampled runs that mapped the object
+ *   uri   - Shared object path as file URI
+ */
+static void
+read_plugin_so(read_context_t *rc)
+{
+    int count;
+    char *path;
+
+    if (2 > sscanf(rc->line, "%d %"FILELENSTR"s", &count, rc->filebuf)) {
+        rc->errmsg = READ_SYNTAX_ERROR;
+        return;
+    }
+
+    if (!rc->current_history) {
+        /* Parent history was a skipped duplicate */
+        return;
+    }
+
+    if (count <= 0 || count > rc->current_history->runs) {
+        rc->errmsg = READ_SYNTAX_ERROR;
+        return;
+    }
+
+    path = g_filename_from_uri(rc->filebuf, NULL, &(rc->err));
+    if (!path)
+        return;
+
+    g_hash_table_replace(rc->current_history->counts, path, GINT_TO_POINTER(count));
+}
+
 /* Read PIDS header from state file
  *
  * PIDS format: "PIDS <count>"
@@ -494,11 +698,13 @@ read_pids(read_context_t *rc)
 
 /* Read individual PID from state file
  *
- * PID format: "PID <pid> <start_time> <last_update> <user_init>"
+ * PID format: "PID <pid> <start_time> <last_update> <user_init> <sampled>"
  *   pid         - Process ID (will be validated on load)
  *   start_time  - When process started (Unix timestamp)
  *   last_update - Last weight update time (Unix timestamp)
  *   user_init   - Boolean: 1 if user-initiated, 0 if automated
+ *   sampled     - Boolean: plugins already recorded for this run (absent
+ *                 in old files), so a restart doesn't walk its maps again
  */
 static void
 read_pid(read_context_t *rc)
@@ -506,10 +712,11 @@ read_pid(read_context_t *rc)
     pid_t pid;
     time_t start_time, last_update;
     int user_init;
+    int sampled = 0;
     process_info_t *proc_info;
     
-    if (4 > sscanf(rc->line, "%d %ld %ld %d", 
-                   &pid, &start_time, &last_update, &user_init)) {
+    if (4 > sscanf(rc->line, "%d %ld %ld %d %d", 
+                   &pid, &start_time, &last_update, &user_init, &sampled)) {
         rc->errmsg = READ_SYNTAX_ERROR;
         return;
     }
@@ -535,10 +742,11 @@ read_pid(read_context_t *rc)
     /* Create process_info_t and insert */
     proc_info = g_new0(process_info_t, 1);
     proc_info->pid = pid;
-    proc_info->parent_pid = get_parent_pid(pid);  /* Recalculate parent */
+    proc_info->parent_pid = kp_proc_get_ppid(pid);  /* Recalculate parent */
     proc_info->start_time = start_time;
     proc_info->last_weight_update = last_update;
     proc_info->user_initiated = (gboolean)user_init;
+    proc_info->plugins_sampled = (gboolean)sampled;
     
     g_hash_table_insert(rc->current_exe->running_pids, 
                        GINT_TO_POINTER(pid), proc_info);
@@ -596,6 +804,8 @@ kp_state_read_from_channel(GIOChannel *f)
     rc.err = NULL;
     rc.current_exe = NULL;
     rc.expected_pids = 0;
+    rc.current_closure = NULL;
+    rc.current_history = NULL;
     rc.maps = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)kp_map_unref);
     rc.exes = g_hash_table_new(g_direct_hash, g_direct_equal);
 
@@ -624,12 +834,13 @@ kp_state_read_from_channel(GIOChannel *f)
             break;
         }
 
-        if (!strcmp(tag, TAG_PRELOAD)) {
+        /* TAG_PRELOAD_TIME shares its tag with the header: only line 1 is the header */
+        if (!strcmp(tag, TAG_PRELOAD) && lineno == 1) {
             int major_ver_read, major_ver_run;
             const char *version;
             int time;
 
-            if (lineno != 1 || 2 > sscanf(rc.line,
+            if (2 > sscanf(rc.line,
                                           "%d.%*[^\t]\t%d",
                                           &major_ver_read, &time)) {
                 rc.errmsg = READ_SYNTAX_ERROR;
@@ -649,6 +860,9 @@ kp_state_read_from_channel(GIOChannel *f)
 
             kp_state->last_accounting_timestamp = kp_state->time = time;
         }
+        else if (!strcmp(tag, TAG_HOTSET) || !strcmp(tag, TAG_HOT)) {
+            /* Already read by kp_hotset_load() */
+        }
         else if (!strcmp(tag, TAG_MAP))    read_map(&rc);
         else if (!strcmp(tag, TAG_BADEXE)) read_badexe(&rc);
         else if (!strcmp(tag, TAG_EXE))    { rc.current_exe = NULL; read_exe(&rc); }
@@ -657,6 +871,10 @@ kp_state_read_from_channel(GIOChannel *f)
         else if (!strcmp(tag, TAG_EXEMAP)) read_exemap(&rc);
         else if (!strcmp(tag, TAG_MARKOV)) read_markov(&rc);
         else if (!strcmp(tag, TAG_FAMILY)) read_family(&rc);
+        else if (!strcmp(tag, TAG_CLOSURE)) read_closure(&rc);
+        else if (!strcmp(tag, TAG_LIB))    read_closure_lib(&rc);
+        else if (!strcmp(tag, TAG_PLUGINS)) read_plugins(&rc);
+        else if (!strcmp(tag, TAG_SO))     read_plugin_so(&rc);
         else if (!strcmp(tag, TAG_CRC32))  read_crc32(&rc);
         else if (!strcmp(tag, TAG_PRELOAD_TIMES)) {
             /* Just a header, count is informational */
@@ -705,14 +923,15 @@ kp_state_read_from_channel(GIOChannel *f)
 
 typedef struct _write_context_t
 {
-    GIOChannel *f;
+    GString *out;       /* Serialized state */
     GString *line;
     GError *err;
 } write_context_t;
 
 #define write_it(s) \
-    if (wc->err || G_IO_STATUS_NORMAL != g_io_channel_write_chars(wc->f, s, -1, NULL, &(wc->err))) \
-        return;
+    if (wc->err) \
+        return; \
+    g_string_append(wc->out, s);
 #define write_tag(tag) write_it(tag "\t")
 #define write_string(string) write_it((string)->str)
 #define write_ln() write_it("\n")
@@ -730,6 +949,41 @@ write_header(write_context_t *wc)
     write_ln();
 }
 
+static void
+write_hot(kp_map_t *map, write_context_t *wc)
+{
+    char *uri;
+
+    uri = g_filename_to_uri(map->path, NULL, &(wc->err));
+    if (!uri)
+        return;
+
+    write_tag(TAG_HOT);
+    g_string_printf(wc->line, "%zu\t%zu\t%s", map->offset, map->length, uri);
+    write_string(wc->line);
+    write_ln();
+
+    g_free(uri);
+}
+
+/* Hot set right after the header, so it can be read without the rest */
+static void
+write_hotset(write_context_t *wc)
+{
+    GPtrArray *hot = kp_hotset_maps();
+
+    if (!hot)
+        return;
+
+    write_tag(TAG_HOTSET);
+    g_string_printf(wc->line, "%u", hot->len);
+    write_string(wc->line);
+    write_ln();
+
+    for (guint i = 0; i < hot->len && !wc->err; i++)
+        write_hot(g_ptr_array_index(hot, i), wc);
+}
+
 static void
 write_map(kp_map_t *map, gpointer G_GNUC_UNUSED data, write_context_t *wc)
 {
@@ -786,10 +1040,11 @@ write_exe(gpointer G_GNUC_UNUSED key, kp_exe_t *exe, write_context_t *wc)
 
     write_tag(TAG_EXE);
     g_string_printf(wc->line,
-                    "%d\t%d\t%d\t%d\t%d\t%.6f\t%lu\t%lu\t%s",
+                    "%d\t%d\t%d\t%d\t%d\t%.6f\t%lu\t%lu\t%d\t%s",
                     exe->seq, exe->update_time, exe->time, -1, 
                     (int)exe->pool, exe->weighted_launches, exe->raw_launches,
-                    exe->total_duration_sec, uri);
+                    exe->total_duration_sec,
+                    exe->uid == KP_UID_UNKNOWN ? -1 : (int)exe->uid, uri);
     write_string(wc->line);
     write_ln();
 
@@ -828,11 +1083,12 @@ write_pid_callback(gpointer key, gpointer value, gpointer user_data)
     /* Write "    PID\t..." manually with 4-space indent */
     write_it("    ");  /* 4-space indent */
     write_tag(TAG_PID);
-    g_string_printf(wc->line, "%d\t%ld\t%ld\t%d",
+    g_string_printf(wc->line, "%d\t%ld\t%ld\t%d\t%d",
                     pid,
                     (long)proc_info->start_time,
                     (long)proc_info->last_weight_update,
-                    (int)proc_info->user_initiated);
+                    (int)proc_info->user_initiated,
+                    (int)proc_info->plugins_sampled);
     write_string(wc->line);
     write_ln();
 }
@@ -882,37 +1138,11 @@ write_markov_wrapper(gpointer data, gpointer user_data)
 }
 
 static void
-write_crc32(write_context_t *wc, int fd)
+write_crc32(write_context_t *wc)
 {
     uint32_t crc;
-    off_t file_size;
-    char *content;
-
-    file_size = lseek(fd, 0, SEEK_CUR);
-    if (file_size <= 0)
-        return;
-
-    content = g_malloc(file_size);
-    if (!content) {
-        g_warning("g_malloc failed for CRC calculation (%ld bytes)", (long)file_size);
-        return;
-    }
 
-    if (lseek(fd, 0, SEEK_SET) < 0) {
-        g_free(content);
-        return;
-    }
-
-    if (read(fd, content, file_size) != file_size) {
-        g_free(content);
-        lseek(fd, 0, SEEK_END);
-        return;
-    }
-
-    crc = kp_crc32(content, file_size);
-    g_free(content);
-
-    lseek(fd, 0, SEEK_END);
+    crc = kp_crc32(wc->out->str, wc->out->len);
 
     write_tag(TAG_CRC32);
     g_string_printf(wc->line, "%08X", crc);
@@ -951,31 +1181,122 @@ write_family_wrapper(gpointer key, gpointer value, gpointer user_data)
     write_family(key, (kp_app_family_t *)value, (write_context_t *)user_data);
 }
 
-/* Write state to GIOChannel with CRC32 footer */
+static void
+write_closure(gpointer G_GNUC_UNUSED key, kp_closure_t *closure, write_context_t *wc)
+{
+    char *uri;
+
+    /* Only persist closures of apps the model still tracks */
+    if (!g_hash_table_lookup(kp_state->exes, closure->exe_path))
+        return;
+
+    uri = g_filename_to_uri(closure->exe_path, NULL, &(wc->err));
+    if (!uri)
+        return;
+
+    write_tag(TAG_CLOSURE);
+    g_string_printf(wc->line, "%d\t%llu\t%llu\t%lld\t%llu\t%d\t%s",
+                    closure->update_time,
+                    (unsigned long long)closure->dev,
+                    (unsigned long long)closure->ino,
+                    (long long)closure->mtime,
+                    (unsigned long long)closure->size,
+                    closure->plugin_runs, uri);
+    g_free(uri);
+    write_string(wc->line);
+    write_ln();
+
+    for (guint i = 0; i < closure->libs->len; i++) {
+        kp_closure_lib_t *lib = g_ptr_array_index(closure->libs, i);
+
+        uri = g_filename_to_uri(lib->path, NULL, &(wc->err));
+        if (!uri)
+            return;
+
+        write_it("  ");  /* 2-space indent */
+        write_tag(TAG_LIB);
+        g_string_printf(wc->line, "%llu\t%llu\t%lld\t%lf\t%s",
+                        (unsigned long long)lib->size,
+                        (unsigned long long)lib->ino,
+                        (long long)lib->mtime, lib->prob, uri);
+        g_free(uri);
+        write_string(wc->line);
+        write_ln();
+    }
+}
+
+static void
+write_closure_wrapper(gpointer key, gpointer value, gpointer user_data)
+{
+    write_closure(key, (kp_closure_t *)value, (write_context_t *)user_data);
+}
+
+static void
+write_plugins(gpointer G_GNUC_UNUSED key, kp_plugin_history_t *history, write_context_t *wc)
+{
+    GHashTableIter iter;
+    gpointer so_path, count;
+    char *uri;
+
+    /* Only persist history of apps the model still tracks */
+    if (!g_hash_table_lookup(kp_state->exes, history->exe_path))
+        return;
+
+    uri = g_filename_to_uri(history->exe_path, NULL, &(wc->err));
+    if (!uri)
+        return;
+
+    write_tag(TAG_PLUGINS);
+    g_string_printf(wc->line, "%d\t%s", history->runs, uri);
+    g_free(uri);
+    write_string(wc->line);
+    write_ln();
+
+    g_hash_table_iter_init(&iter, history->counts);
+    while (g_hash_table_iter_next(&iter, &so_path, &count)) {
+        uri = g_filename_to_uri(so_path, NULL, &(wc->err));
+        if (!uri)
+            return;
+
+        write_it("  ");  /* 2-space indent */
+        write_tag(TAG_SO);
+        g_string_printf(wc->line, "%d\t%s", GPOINTER_TO_INT(count), uri);
+        g_free(uri);
+        write_string(wc->line);
+        write_ln();
+    }
+}
+
+static void
+write_plugins_wrapper(gpointer key, gpointer value, gpointer user_data)
+{
+    write_plugins(key, (kp_plugin_history_t *)value, (write_context_t *)user_data);
+}
+
+/* Serialize state into a buffer, with CRC32 footer */
 char *
-kp_state_write_to_channel(GIOChannel *f, int fd)
+kp_state_write_to_string(GString *out)
 {
     write_context_t wc;
 
-    wc.f = f;
+    wc.out = out;
     wc.line = g_string_sized_new(100);
     wc.err = NULL;
 
     write_header(&wc);
+    if (!wc.err) write_hotset(&wc);
     if (!wc.err) g_hash_table_foreach(kp_state->maps, (GHFunc)write_map, &wc);
     if (!wc.err) g_hash_table_foreach(kp_state->bad_exes, write_badexe_wrapper, &wc);
     if (!wc.err) g_hash_table_foreach(kp_state->exes, (GHFunc)write_exe, &wc);
     if (!wc.err) kp_exemap_foreach(write_exemap_wrapper, &wc);
     if (!wc.err) kp_markov_foreach(write_markov_wrapper, &wc);
     if (!wc.err) g_hash_table_foreach(kp_state->app_families, write_family_wrapper, &wc);
-    if (!wc.err) kp_stats_save_preload_times(f);  /* Save preload timestamps */
-
-    if (!wc.err) {
-        g_io_channel_flush(f, &wc.err);
-    }
+    if (!wc.err) g_hash_table_foreach(kp_state->closures, write_closure_wrapper, &wc);
+    if (!wc.err) g_hash_table_foreach(kp_state->plugin_history, write_plugins_wrapper, &wc);
+    if (!wc.err) kp_stats_save_preload_times(out);  /* Save preload timestamps */
 
     if (!wc.err) {
-        write_crc32(&wc, fd);
+        write_crc32(&wc);
     }
 
     g_string_free(wc.line, TRUE);
@@ -994,12 +1315,12 @@ kp_state_handle_corrupt_file(const char *statefile, const char *reason)
 {
     char *broken_path;
     time_t now;
-    struct tm *tm_info;
+    struct tm tm_info;
     char timestamp[32];
 
     now = time(NULL);
-    tm_info = localtime(&now);
-    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", tm_info);
+    localtime_r(&now, &tm_info);   /* May run on the startup loader thread */
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm_info);
 
     broken_path = g_strdup_printf("%s.broken.%s", statefile, timestamp);
 
@@ -12,6 +12,8 @@
  * STATE FILE FORMAT:
  *   Text-based, line-oriented format with tags:
  *   - PRELOAD <version> <time>  - Header with format version
+ *   - HOTSET <count>            - Boot hot set, always right after the header
+ *   - HOT <offset> <length> <uri> - Hot set entry
  *   - MAP <seq> <path> <offset> <length> - Memory map region
  *   - BADEXE <time> <size> <path> - Blacklisted small executable
  *   - EXE <seq> <time> <run_time> <path> - Tracked executable
@@ -30,8 +32,9 @@
 /* Internal read function - called from kp_state_load */
 char *kp_state_read_from_channel(GIOChannel *f);
 
-/* Internal write function - called from kp_state_save */
-char *kp_state_write_to_channel(GIOChannel *f, int fd);
+/* Internal write function - called from kp_state_save
+ * Appends the serialized state to out; returns an error message or NULL */
+char *kp_state_write_to_string(GString *out);
 
 /* Handle corrupt state file */
 gboolean kp_state_handle_corrupt_file(const char *statefile, const char *reason);
@@ -57,6 +57,10 @@ kp_map_new(const char *path, size_t offset, size_t length)
     map->refcount = 0;
     map->update_time = kp_state->time;
     map->block = -1;
+    map->dev = 0;
+    map->extents = -1;
+    map->cost_us = 0;
+    map->eta = G_MAXDOUBLE;
     return map;
 }
 
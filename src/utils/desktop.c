@@ -6,24 +6,90 @@
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Desktop Index
+ * =============================================================================
+ *
+ * Maps executables to the .desktop files that launch them. Every parsed
+ * .desktop file is kept as a record (including hidden or unresolvable
+ * ones, so they are not parsed again); the executable index points at the
+ * winning record for each exe: earlier directory first, then file name.
+ *
+ * STARTUP:
+ *   1. The cache file (binary, CRC-checked) is used if every scanned
+ *      directory still has the mtime it had when the cache was written.
+ *   2. Otherwise the directories are listed and the files are parsed from
+ *      a low-priority idle callback, DESKTOP_BUILD_BATCH per call, so the
+ *      daemon starts without waiting for the parse. Until the build ends
+ *      lookups see a partial index; completion bumps the generation and
+ *      calls the notify hook with NULL so everything is reclassified.
+ *
+ * UPDATES:
+ *   An inotify watch per directory re-parses only the .desktop files that
+ *   were written, created, moved or deleted, bumps the generation and
+ *   calls the notify hook for each executable whose entry changed.
+ *   Without inotify (or for directories created after startup)
+ *   kp_desktop_refresh() re-syncs directories whose mtime moved.
+ *
+ * Directory mtimes don't move when a file is edited in place, so the cache
+ * can miss such an edit made while the daemon was not running; package
+ * managers replace files by rename, which does move them.
+ *
+ * =============================================================================
  */
 
 #include "common.h"
 #include "desktop.h"
 #include "logging.h"
+#include "crc32.h"
+#include "fswatch.h"
 #include <sys/stat.h>
 
+#define DESKTOP_DIR_MAX      4
+#define DESKTOP_BUILD_BATCH  16     /* .desktop files parsed per idle callback */
+#define DESKTOP_CACHE_MAGIC  "PHDESK01"
+#define DESKTOP_CACHE_NAME   "desktop.cache"
+
 /**
- * Desktop application entry
+ * Desktop application entry (one per parsed .desktop file)
  */
 typedef struct {
     char *app_name;        /* Display name (e.g., "Firefox") */
-    char *exec_path;       /* Resolved executable path */
+    char *exec_path;       /* Resolved executable path, NULL if hidden/unresolvable */
     char *desktop_file;    /* Path to .desktop file */
+    gint64 mtime_ns;       /* .desktop file mtime when parsed */
+    int dir;               /* Index of the directory it was found in */
 } desktop_app_t;
 
-/* Global registry: exe_path → desktop_app_t */
-static GHashTable *desktop_apps = NULL;
+/**
+ * Scanned directory
+ */
+typedef struct {
+    char *path;
+    gint64 mtime_ns;       /* mtime when last synced, 0 if missing */
+    int wd;                /* inotify watch descriptor, -1 if none */
+} desktop_dir_t;
+
+static struct {
+    GHashTable *apps;      /* exe_path → desktop_app_t* (borrowed from files) */
+    GHashTable *files;     /* desktop_file → desktop_app_t* */
+    desktop_dir_t dirs[DESKTOP_DIR_MAX];
+    int n_dirs;
+
+    GPtrArray *pending;    /* "dir\t.desktop path" left to parse in background */
+    guint build_id;        /* Idle source of the background build */
+
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_t *watch;   /* NULL when not watching */
+#endif
+
+    char *cache_path;      /* NULL: no cache */
+    gboolean dirty;        /* Index differs from the cache file */
+    kp_desktop_notify_func notify;
+    kp_desktop_ready_func on_ready;     /* One-shot, see kp_desktop_on_ready() */
+    guint generation;      /* See kp_desktop_generation() */
+} desktop;
 
 /**
  * Free desktop app entry
@@ -40,6 +106,18 @@ desktop_app_free(gpointer data)
     }
 }
 
+/* mtime in nanoseconds, 0 if path doesn't exist */
+static gint64
+path_mtime_ns(const char *path, gboolean want_dir)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0 || (want_dir && !S_ISDIR(st.st_mode)))
+        return 0;
+
+    return (gint64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
 /**
  * Try to resolve snap wrapper to actual binary
  *
@@ -112,8 +190,8 @@ resolve_snap_binary(const char *wrapper_path)
  * - Field codes: %u, %U, %f, %F (removed)
  * - Snap wrappers: /snap/bin/firefox → /snap/firefox/current/usr/lib/firefox/firefox
  */
-static char *
-resolve_exec_path(const char *exec_line)
+char *
+kp_desktop_resolve_exec(const char *exec_line)
 {
     char **argv = NULL;
     char *resolved = NULL;
@@ -191,24 +269,35 @@ resolve_exec_path(const char *exec_line)
 
 /**
  * Parse a single .desktop file
+ *
+ * @return Record for the file (exec_path NULL if it names no visible app),
+ *         or NULL if the file can't be read
  */
-static void
-parse_desktop_file(const char *path)
+static desktop_app_t *
+parse_desktop_file(const char *path, int dir)
 {
     GKeyFile *kf;
     GError *error = NULL;
     char *exec = NULL;
-    char *name = NULL;
-    char *resolved_path = NULL;
     desktop_app_t *app;
     gboolean is_hidden;
+    gint64 mtime_ns;
+
+    mtime_ns = path_mtime_ns(path, FALSE);
+    if (!mtime_ns)
+        return NULL;
+
+    app = g_new0(desktop_app_t, 1);
+    app->desktop_file = g_strdup(path);
+    app->mtime_ns = mtime_ns;
+    app->dir = dir;
 
     kf = g_key_file_new();
     if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, &error)) {
         g_debug("Cannot load desktop file %s: %s", path, error->message);
         g_error_free(error);
         g_key_file_free(kf);
-        return;
+        return app;
     }
 
     /* Skip hidden applications (NoDisplay=true or Hidden=true) */
@@ -218,12 +307,12 @@ parse_desktop_file(const char *path)
     }
     if (is_hidden) {
         g_key_file_free(kf);
-        return;
+        return app;
     }
 
     /* Get Exec= and Name= */
     exec = g_key_file_get_string(kf, "Desktop Entry", "Exec", NULL);
-    name = g_key_file_get_string(kf, "Desktop Entry", "Name", NULL);
+    app->app_name = g_key_file_get_string(kf, "Desktop Entry", "Name", NULL);
 
     if (!exec) {
         g_debug("Desktop file %s has no Exec= line", path);
@@ -231,106 +320,709 @@ parse_desktop_file(const char *path)
     }
 
     /* Resolve Exec= to actual binary path */
-    resolved_path = resolve_exec_path(exec);
-    if (!resolved_path) {
+    app->exec_path = kp_desktop_resolve_exec(exec);
+    if (!app->exec_path) {
         g_debug("Cannot resolve Exec=%s from %s", exec, path);
         goto cleanup;
     }
 
-    /* Check if already registered (first .desktop file wins) */
-    if (g_hash_table_contains(desktop_apps, resolved_path)) {
-        g_debug("Already registered: %s (from earlier .desktop)", resolved_path);
-        goto cleanup;
+    if (!app->app_name)
+        app->app_name = g_strdup("Unknown");
+
+cleanup:
+    g_free(exec);
+    g_key_file_free(kf);
+    return app;
+}
+
+/* ========================================================================
+ * INDEX MAINTENANCE
+ * ======================================================================== */
+
+/* Does record a take precedence over record b for the same exe? */
+static gboolean
+app_precedes(const desktop_app_t *a, const desktop_app_t *b)
+{
+    if (a->dir != b->dir)
+        return a->dir < b->dir;
+    return strcmp(a->desktop_file, b->desktop_file) < 0;
+}
+
+/**
+ * Point the exe index at the best remaining record for exe_path
+ */
+static void
+index_elect(const char *exe_path)
+{
+    GHashTableIter iter;
+    gpointer value;
+    desktop_app_t *best = NULL;
+
+    g_hash_table_iter_init(&iter, desktop.files);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        desktop_app_t *app = value;
+        if (app->exec_path && strcmp(app->exec_path, exe_path) == 0 &&
+            (!best || app_precedes(app, best)))
+            best = app;
     }
 
-    /* Create and register app */
-    app = g_new0(desktop_app_t, 1);
-    app->app_name = name ? name : g_strdup("Unknown");
-    app->exec_path = g_strdup(resolved_path);
-    app->desktop_file = g_strdup(path);
+    if (best)
+        g_hash_table_replace(desktop.apps, g_strdup(exe_path), best);
+    else
+        g_hash_table_remove(desktop.apps, exe_path);
+}
 
-    g_hash_table_insert(desktop_apps, g_strdup(resolved_path), app);
-    g_debug("Registered desktop app: %s (%s)", app->app_name, resolved_path);
+/**
+ * Drop the record of a .desktop file
+ *
+ * @return Exe it launched if the exe index changed (caller frees), or NULL
+ */
+static char *
+index_remove(const char *desktop_file)
+{
+    desktop_app_t *app = g_hash_table_lookup(desktop.files, desktop_file);
+    char *exe_path = NULL;
 
-    name = NULL;  /* Ownership transferred to app */
+    if (!app)
+        return NULL;
 
-cleanup:
-    g_free(exec);
-    g_free(name);
-    g_free(resolved_path);
-    g_key_file_free(kf);
+    /* Was it the winning record for its exe? */
+    if (app->exec_path && g_hash_table_lookup(desktop.apps, app->exec_path) == app) {
+        exe_path = g_strdup(app->exec_path);
+        g_hash_table_remove(desktop.apps, exe_path);
+    }
+
+    g_hash_table_remove(desktop.files, desktop_file);   /* Frees app */
+
+    if (exe_path)
+        index_elect(exe_path);
+    return exe_path;
+}
+
+/**
+ * Add a record, replacing any earlier record of the same file
+ *
+ * @return TRUE if the exe index changed
+ */
+static gboolean
+index_add(desktop_app_t *app)
+{
+    desktop_app_t *current;
+
+    g_free(index_remove(app->desktop_file));
+    g_hash_table_insert(desktop.files, app->desktop_file, app);
+
+    if (!app->exec_path)
+        return FALSE;
+
+    current = g_hash_table_lookup(desktop.apps, app->exec_path);
+    if (current && !app_precedes(app, current)) {
+        g_debug("Already registered: %s (from %s)", app->exec_path, current->desktop_file);
+        return FALSE;
+    }
+
+    g_hash_table_replace(desktop.apps, g_strdup(app->exec_path), app);
+    g_debug("Registered desktop app: %s (%s)", app->app_name, app->exec_path);
+    return TRUE;
+}
+
+/* Index changed: new generation, cache stale, tell the listener */
+static void
+index_changed(const char *exe_path)
+{
+    desktop.generation++;
+    desktop.dirty = TRUE;
+    if (desktop.notify)
+        desktop.notify(exe_path);
 }
 
 /**
- * Scan a directory for .desktop files
+ * Bring one .desktop file up to date
  */
 static void
-scan_desktop_dir(const char *dir_path)
+update_file(const char *path, int dir)
 {
-    GDir *dir;
+    desktop_app_t *old = g_hash_table_lookup(desktop.files, path);
+    desktop_app_t *app;
+    gboolean had_old = old != NULL;
+    gboolean added;
+    char *old_exe;
+    gint64 mtime_ns = path_mtime_ns(path, FALSE);
+
+    if (old && old->mtime_ns == mtime_ns && old->dir == dir)
+        return;     /* Unchanged */
+
+    old_exe = index_remove(path);
+    app = mtime_ns ? parse_desktop_file(path, dir) : NULL;
+    added = app && index_add(app);
+
+    /* One notification per exe whose entry changed */
+    if (added)
+        index_changed(app->exec_path);
+    if (old_exe && !(added && strcmp(old_exe, app->exec_path) == 0))
+        index_changed(old_exe);
+    if (!added && !old_exe && (had_old || app))
+        desktop.dirty = TRUE;   /* Record changed, exe index didn't */
+
+    g_debug("Desktop file %s: %s", path, app ? "updated" : "removed");
+    g_free(old_exe);
+}
+
+/**
+ * List the .desktop files of a directory
+ */
+static void
+list_dir(int dir, GPtrArray *out)
+{
+    GDir *d;
     const char *filename;
-    struct stat st;
 
-    /* Check if directory exists */
-    if (stat(dir_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
-        g_debug("Desktop directory not found: %s", dir_path);
+    d = g_dir_open(desktop.dirs[dir].path, 0, NULL);
+    if (!d) {
+        g_debug("Desktop directory not found: %s", desktop.dirs[dir].path);
         return;
     }
 
-    dir = g_dir_open(dir_path, 0, NULL);
-    if (!dir) {
-        g_debug("Cannot open desktop directory: %s", dir_path);
+    while ((filename = g_dir_read_name(d)))
+        if (g_str_has_suffix(filename, ".desktop"))
+            g_ptr_array_add(out, g_build_filename(desktop.dirs[dir].path, filename, NULL));
+
+    g_dir_close(d);
+}
+
+/**
+ * Re-sync a directory: drop records of vanished files, update the rest
+ */
+static void
+sync_dir(int dir)
+{
+    GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+    GHashTable *present = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *gone = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+
+    desktop.dirs[dir].mtime_ns = path_mtime_ns(desktop.dirs[dir].path, TRUE);
+    list_dir(dir, files);
+
+    for (guint i = 0; i < files->len; i++)
+        g_hash_table_insert(present, g_ptr_array_index(files, i), GINT_TO_POINTER(1));
+
+    g_hash_table_iter_init(&iter, desktop.files);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        desktop_app_t *app = value;
+        if (app->dir == dir && !g_hash_table_lookup(present, app->desktop_file))
+            g_ptr_array_add(gone, g_strdup(app->desktop_file));
+    }
+
+    for (guint i = 0; i < gone->len; i++) {
+        update_file(g_ptr_array_index(gone, i), dir);
+        g_free(g_ptr_array_index(gone, i));
+    }
+    for (guint i = 0; i < files->len; i++)
+        update_file(g_ptr_array_index(files, i), dir);
+
+    g_ptr_array_free(gone, TRUE);
+    g_hash_table_destroy(present);
+    g_ptr_array_free(files, TRUE);
+}
+
+/* ========================================================================
+ * CACHE FILE
+ *
+ *   magic[8] u32:ndirs { str:path i64:mtime }* u32:napps
+ *   { i32:dir i64:mtime str:file str:exec str:name }* u32:crc32
+ *
+ * str is u32 length + bytes, with length 0xFFFFFFFF for NULL. Native byte
+ * order: the cache never leaves the machine.
+ * ======================================================================== */
+
+#define CACHE_NULL_STR 0xFFFFFFFFu
+
+static void
+cache_put(GString *buf, const void *data, gsize len)
+{
+    g_string_append_len(buf, data, (gssize)len);
+}
+
+static void
+cache_put_str(GString *buf, const char *str)
+{
+    guint32 len = str ? (guint32)strlen(str) : CACHE_NULL_STR;
+
+    cache_put(buf, &len, sizeof(len));
+    if (str)
+        cache_put(buf, str, len);
+}
+
+/**
+ * Write the index to the cache file (if it changed since the last write)
+ */
+static void
+cache_save(void)
+{
+    GString *buf;
+    GHashTableIter iter;
+    gpointer value;
+    guint32 n, crc;
+    GError *error = NULL;
+
+    if (!desktop.cache_path || !desktop.dirty || desktop.pending)
         return;
+
+    buf = g_string_sized_new(64 * 1024);
+    cache_put(buf, DESKTOP_CACHE_MAGIC, 8);
+
+    n = (guint32)desktop.n_dirs;
+    cache_put(buf, &n, sizeof(n));
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        cache_put_str(buf, desktop.dirs[i].path);
+        cache_put(buf, &desktop.dirs[i].mtime_ns, sizeof(gint64));
+    }
+
+    n = g_hash_table_size(desktop.files);
+    cache_put(buf, &n, sizeof(n));
+    g_hash_table_iter_init(&iter, desktop.files);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        const desktop_app_t *app = value;
+        gint32 dir = app->dir;
+
+        cache_put(buf, &dir, sizeof(dir));
+        cache_put(buf, &app->mtime_ns, sizeof(gint64));
+        cache_put_str(buf, app->desktop_file);
+        cache_put_str(buf, app->exec_path);
+        cache_put_str(buf, app->app_name);
     }
 
-    g_debug("Scanning desktop files in: %s", dir_path);
+    crc = kp_crc32(buf->str, buf->len);
+    cache_put(buf, &crc, sizeof(crc));
 
-    while ((filename = g_dir_read_name(dir))) {
-        if (g_str_has_suffix(filename, ".desktop")) {
-            char *full_path = g_build_filename(dir_path, filename, NULL);
-            parse_desktop_file(full_path);
-            g_free(full_path);
+    if (g_file_set_contents(desktop.cache_path, buf->str, (gssize)buf->len, &error)) {
+        desktop.dirty = FALSE;
+        g_debug("Desktop index cached: %u entries in %s", n, desktop.cache_path);
+    } else {
+        g_debug("Cannot write desktop cache %s: %s", desktop.cache_path, error->message);
+        g_error_free(error);
+    }
+
+    g_string_free(buf, TRUE);
+}
+
+/* Bounds-checked reader over the cache buffer */
+typedef struct {
+    const char *p;
+    const char *end;
+} cache_reader_t;
+
+static gboolean
+cache_get(cache_reader_t *r, void *out, gsize len)
+{
+    if ((gsize)(r->end - r->p) < len)
+        return FALSE;
+    memcpy(out, r->p, len);
+    r->p += len;
+    return TRUE;
+}
+
+static gboolean
+cache_get_str(cache_reader_t *r, char **out)
+{
+    guint32 len;
+
+    *out = NULL;
+    if (!cache_get(r, &len, sizeof(len)))
+        return FALSE;
+    if (len == CACHE_NULL_STR)
+        return TRUE;
+    if ((gsize)(r->end - r->p) < len)
+        return FALSE;
+
+    *out = g_strndup(r->p, len);
+    r->p += len;
+    return TRUE;
+}
+
+/**
+ * Load the index from the cache file if it is still current
+ *
+ * @return TRUE if the index was loaded
+ */
+static gboolean
+cache_load(void)
+{
+    char *data = NULL;
+    gsize len = 0;
+    cache_reader_t r;
+    guint32 n, crc;
+    gboolean ok = FALSE;
+
+    if (!desktop.cache_path ||
+        !g_file_get_contents(desktop.cache_path, &data, &len, NULL))
+        return FALSE;
+
+    if (len < 8 + 3 * sizeof(guint32) || memcmp(data, DESKTOP_CACHE_MAGIC, 8) != 0)
+        goto out;
+
+    memcpy(&crc, data + len - sizeof(crc), sizeof(crc));
+    if (kp_crc32(data, len - sizeof(crc)) != crc) {
+        g_debug("Desktop cache %s is corrupt, rebuilding", desktop.cache_path);
+        goto out;
+    }
+
+    r.p = data + 8;
+    r.end = data + len - sizeof(crc);
+
+    /* Key: same directories with the same mtimes */
+    if (!cache_get(&r, &n, sizeof(n)) || n != (guint32)desktop.n_dirs)
+        goto out;
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        char *path;
+        gint64 mtime_ns;
+        gboolean same;
+
+        if (!cache_get_str(&r, &path) || !cache_get(&r, &mtime_ns, sizeof(mtime_ns))) {
+            g_free(path);
+            goto out;
         }
+        same = g_strcmp0(path, desktop.dirs[i].path) == 0 &&
+               mtime_ns == desktop.dirs[i].mtime_ns;
+        g_free(path);
+        if (!same) {
+            g_debug("Desktop directory %s changed, rebuilding index", desktop.dirs[i].path);
+            goto out;
+        }
+    }
+
+    if (!cache_get(&r, &n, sizeof(n)))
+        goto out;
+    for (guint32 i = 0; i < n; i++) {
+        desktop_app_t *app = g_new0(desktop_app_t, 1);
+        gint32 dir;
+
+        if (!cache_get(&r, &dir, sizeof(dir)) ||
+            !cache_get(&r, &app->mtime_ns, sizeof(gint64)) ||
+            !cache_get_str(&r, &app->desktop_file) ||
+            !cache_get_str(&r, &app->exec_path) ||
+            !cache_get_str(&r, &app->app_name) ||
+            !app->desktop_file || dir < 0 || dir >= desktop.n_dirs) {
+            desktop_app_free(app);
+            g_hash_table_remove_all(desktop.apps);
+            g_hash_table_remove_all(desktop.files);
+            goto out;
+        }
+        app->dir = dir;
+        index_add(app);
+    }
+
+    ok = TRUE;
+
+out:
+    g_free(data);
+    return ok;
+}
+
+/* ========================================================================
+ * BACKGROUND BUILD
+ * ======================================================================== */
+
+/**
+ * Parse up to batch pending files
+ *
+ * @return TRUE while files remain
+ */
+static gboolean
+build_batch(guint batch)
+{
+    while (desktop.pending && desktop.pending->len > 0 && batch-- > 0) {
+        char *entry = g_ptr_array_index(desktop.pending, desktop.pending->len - 1);
+        char *tab = strchr(entry, '\t');
+        desktop_app_t *app;
+
+        g_ptr_array_remove_index(desktop.pending, desktop.pending->len - 1);
+
+        app = parse_desktop_file(tab + 1, atoi(entry));
+        if (app)
+            index_add(app);
+        g_free(entry);
+    }
+
+    return desktop.pending && desktop.pending->len > 0;
+}
+
+/* Background build finished: publish the index */
+static void
+build_done(void)
+{
+    g_ptr_array_free(desktop.pending, TRUE);
+    desktop.pending = NULL;
+
+    g_message("Desktop index built: %u GUI applications from %u files",
+              g_hash_table_size(desktop.apps), g_hash_table_size(desktop.files));
+
+    index_changed(NULL);
+    cache_save();
+
+    if (desktop.on_ready) {
+        kp_desktop_ready_func func = desktop.on_ready;
+        desktop.on_ready = NULL;
+        func();
     }
+}
+
+static gboolean
+build_step(gpointer data)
+{
+    (void)data;
 
-    g_dir_close(dir);
+    if (build_batch(DESKTOP_BUILD_BATCH))
+        return TRUE;
+
+    desktop.build_id = 0;
+    build_done();
+    return FALSE;
+}
+
+/* ========================================================================
+ * INOTIFY
+ * ======================================================================== */
+
+#ifdef HAVE_SYS_INOTIFY_H
+static int
+dir_by_wd(int wd)
+{
+    for (int i = 0; i < desktop.n_dirs; i++)
+        if (desktop.dirs[i].wd == wd)
+            return i;
+    return -1;
+}
+
+/**
+ * inotify event: a .desktop file written, moved or deleted
+ */
+static gboolean
+desktop_inotify_event(const struct inotify_event *ev, gpointer data)
+{
+    int dir;
+
+    (void)data;
+
+    if (ev->mask & IN_Q_OVERFLOW) {
+        for (int i = 0; i < desktop.n_dirs; i++)
+            sync_dir(i);
+        return TRUE;
+    }
+
+    dir = dir_by_wd(ev->wd);
+    if (dir < 0)
+        return TRUE;
+
+    /* Directory itself removed: drop its entries */
+    if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if (ev->mask & IN_MOVE_SELF)
+            kp_fswatch_rm(desktop.watch, ev->wd);
+        desktop.dirs[dir].wd = -1;
+        sync_dir(dir);
+        return TRUE;
+    }
+
+    if (ev->len && g_str_has_suffix(ev->name, ".desktop")) {
+        char *path = g_build_filename(desktop.dirs[dir].path, ev->name, NULL);
+        update_file(path, dir);
+        g_free(path);
+    }
+    desktop.dirs[dir].mtime_ns = path_mtime_ns(desktop.dirs[dir].path, TRUE);
+    return TRUE;
+}
+
+/**
+ * inotify fd failed: the next watch_dirs() starts over
+ */
+static void
+desktop_inotify_done(gboolean active, gpointer data)
+{
+    (void)data;
+
+    if (active)
+        return;
+
+    kp_fswatch_free(desktop.watch);
+    desktop.watch = NULL;
+    for (int i = 0; i < desktop.n_dirs; i++)
+        desktop.dirs[i].wd = -1;
+}
+#endif
+
+/**
+ * Add inotify watches for directories that exist but aren't watched
+ */
+static void
+watch_dirs(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (!desktop.watch) {
+        desktop.watch = kp_fswatch_new(desktop_inotify_event, desktop_inotify_done, NULL);
+        if (!desktop.watch) {
+            g_debug("inotify unavailable (%s), desktop index refreshed on SIGHUP",
+                    strerror(errno));
+            return;
+        }
+    }
+
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        if (desktop.dirs[i].wd >= 0)
+            continue;
+        desktop.dirs[i].wd = kp_fswatch_add(desktop.watch, desktop.dirs[i].path,
+                                            IN_CREATE | IN_CLOSE_WRITE | IN_DELETE |
+                                            IN_MOVED_TO | IN_MOVED_FROM |
+                                            IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+        if (desktop.dirs[i].wd >= 0)
+            g_debug("watching %s for desktop files", desktop.dirs[i].path);
+    }
+#endif
+}
+
+/* ========================================================================
+ * PUBLIC API
+ * ======================================================================== */
+
+static void
+add_dir(const char *path)
+{
+    desktop_dir_t *d;
+
+    if (desktop.n_dirs >= DESKTOP_DIR_MAX)
+        return;
+
+    d = &desktop.dirs[desktop.n_dirs++];
+    d->path = g_strdup(path);
+    d->mtime_ns = path_mtime_ns(path, TRUE);
+    d->wd = -1;
 }
 
 /**
  * Initialize desktop file scanner
  */
 void
-kp_desktop_init(void)
+kp_desktop_init(const char *cache_dir)
 {
     const char *home;
-    char *user_dir;
-    int count;
 
-    if (desktop_apps) {
+    if (desktop.files) {
         g_warning("Desktop scanner already initialized");
         return;
     }
 
-    desktop_apps = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                          g_free, desktop_app_free);
-
-    /* Scan system directories */
-    scan_desktop_dir("/usr/share/applications");
-    scan_desktop_dir("/usr/local/share/applications");
-
-    /* Scan snap desktop files (Ubuntu/snapd) */
-    scan_desktop_dir("/var/lib/snapd/desktop/applications");
+    desktop.apps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    desktop.files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, desktop_app_free);
+    desktop.cache_path = cache_dir ? g_build_filename(cache_dir, DESKTOP_CACHE_NAME, NULL) : NULL;
 
-    /* Scan user directory */
+    /* Directory order is precedence order */
+    add_dir("/usr/share/applications");
+    add_dir("/usr/local/share/applications");
+    add_dir("/var/lib/snapd/desktop/applications");     /* Snap (Ubuntu/snapd) */
     home = g_get_home_dir();
     if (home) {
-        user_dir = g_build_filename(home, ".local/share/applications", NULL);
-        scan_desktop_dir(user_dir);
+        char *user_dir = g_build_filename(home, ".local/share/applications", NULL);
+        add_dir(user_dir);
         g_free(user_dir);
     }
 
-    count = g_hash_table_size(desktop_apps);
-    g_message("Desktop scanner initialized: discovered %d GUI applications", count);
+    /* Watch before listing so no change falls between the two */
+    watch_dirs();
+
+    if (cache_load()) {
+        desktop.generation++;
+        g_message("Desktop index loaded from cache: %u GUI applications",
+                  g_hash_table_size(desktop.apps));
+        return;
+    }
+
+    desktop.pending = g_ptr_array_new();
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+
+        list_dir(i, files);
+        for (guint j = 0; j < files->len; j++)
+            g_ptr_array_add(desktop.pending,
+                            g_strdup_printf("%d\t%s", i, (char *)g_ptr_array_index(files, j)));
+        g_ptr_array_free(files, TRUE);
+    }
+
+    g_message("Desktop index: parsing %u files in the background", desktop.pending->len);
+    desktop.build_id = g_idle_add_full(G_PRIORITY_LOW, build_step, NULL, NULL);
+}
+
+/**
+ * Finish a pending background build now
+ */
+void
+kp_desktop_complete(void)
+{
+    if (!desktop.pending)
+        return;
+
+    if (desktop.build_id) {
+        g_source_remove(desktop.build_id);
+        desktop.build_id = 0;
+    }
+
+    while (build_batch(G_MAXUINT))
+        ;
+    build_done();
+}
+
+/**
+ * Is the index complete?
+ */
+gboolean
+kp_desktop_ready(void)
+{
+    return desktop.pending == NULL;
+}
+
+/**
+ * Run a callback once the background build finishes
+ */
+void
+kp_desktop_on_ready(kp_desktop_ready_func func)
+{
+    desktop.on_ready = func;
+}
+
+/**
+ * Re-sync directories whose mtime moved
+ */
+void
+kp_desktop_refresh(void)
+{
+    if (!desktop.files || desktop.pending)
+        return;
+
+    watch_dirs();
+
+    for (int i = 0; i < desktop.n_dirs; i++)
+        if (path_mtime_ns(desktop.dirs[i].path, TRUE) != desktop.dirs[i].mtime_ns)
+            sync_dir(i);
+
+    cache_save();
+}
+
+/**
+ * Set the index change listener
+ */
+void
+kp_desktop_set_notify(kp_desktop_notify_func func)
+{
+    desktop.notify = func;
+}
+
+/**
+ * Desktop index generation
+ */
+guint
+kp_desktop_generation(void)
+{
+    return desktop.generation;
 }
 
 /**
@@ -339,11 +1031,11 @@ kp_desktop_init(void)
 gboolean
 kp_desktop_has_file(const char *exe_path)
 {
-    if (!desktop_apps || !exe_path) {
+    if (!desktop.apps || !exe_path) {
         return FALSE;
     }
 
-    return g_hash_table_contains(desktop_apps, exe_path);
+    return g_hash_table_contains(desktop.apps, exe_path);
 }
 
 /**
@@ -354,11 +1046,11 @@ kp_desktop_get_name(const char *exe_path)
 {
     desktop_app_t *app;
 
-    if (!desktop_apps || !exe_path) {
+    if (!desktop.apps || !exe_path) {
         return NULL;
     }
 
-    app = g_hash_table_lookup(desktop_apps, exe_path);
+    app = g_hash_table_lookup(desktop.apps, exe_path);
     return app ? app->app_name : NULL;
 }
 
@@ -368,9 +1060,35 @@ kp_desktop_get_name(const char *exe_path)
 void
 kp_desktop_free(void)
 {
-    if (desktop_apps) {
-        g_hash_table_destroy(desktop_apps);
-        desktop_apps = NULL;
-        g_debug("Desktop scanner freed");
-    }
+    if (!desktop.files)
+        return;
+
+    if (desktop.build_id)
+        g_source_remove(desktop.build_id);
+    if (desktop.pending)
+        g_ptr_array_free(desktop.pending, TRUE);
+    desktop.build_id = 0;
+    desktop.pending = NULL;
+    desktop.on_ready = NULL;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    kp_fswatch_free(desktop.watch);
+    desktop.watch = NULL;
+#endif
+
+    cache_save();
+
+    g_hash_table_destroy(desktop.apps);
+    g_hash_table_destroy(desktop.files);
+    desktop.apps = NULL;
+    desktop.files = NULL;
+
+    for (int i = 0; i < desktop.n_dirs; i++)
+        g_free(desktop.dirs[i].path);
+    desktop.n_dirs = 0;
+
+    g_free(desktop.cache_path);
+    desktop.cache_path = NULL;
+    desktop.generation++;
+    g_debug("Desktop scanner freed");
 }
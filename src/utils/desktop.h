@@ -14,9 +14,10 @@
  * Scans for .desktop files in standard XDG directories to auto-discover
  * GUI applications that should be in the priority pool.
  *
- * SCANNED DIRECTORIES:
+ * SCANNED DIRECTORIES (in precedence order):
  * - /usr/share/applications
  * - /usr/local/share/applications
+ * - /var/lib/snapd/desktop/applications
  * - ~/.local/share/applications
  *
  * PURPOSE:
@@ -24,11 +25,11 @@
  * Firefox, VS Code, etc. are automatically recognized and prioritized.
  *
  * USAGE:
- *   kp_desktop_init();  // Call once at startup
+ *   kp_desktop_init(cache_dir);  // Cache hit, or background build starts
  *   if (kp_desktop_has_file("/usr/bin/firefox")) {
  *       // App has .desktop file → priority pool
  *   }
- *   kp_desktop_free();  // Call at shutdown
+ *   kp_desktop_free();  // Call at shutdown (writes the cache)
  *
  * =============================================================================
  */
@@ -38,11 +39,66 @@
 
 #include <glib.h>
 
+/**
+ * Index change listener
+ *
+ * @param exe_path Executable whose entry was added, removed or changed,
+ *                 or NULL when the whole index was (re)built
+ */
+typedef void (*kp_desktop_notify_func)(const char *exe_path);
+
+/**
+ * Called once when a background build finishes
+ */
+typedef void (*kp_desktop_ready_func)(void);
+
 /**
  * Initialize desktop file scanner
- * Scans standard directories and builds app registry
+ *
+ * Loads the index from the cache if no scanned directory changed since it
+ * was written; otherwise schedules a background build from the main loop.
+ * Starts inotify watches on the scanned directories either way.
+ *
+ * @param cache_dir Directory for the index cache, or NULL for no cache
  */
-void kp_desktop_init(void);
+void kp_desktop_init(const char *cache_dir);
+
+/**
+ * Finish a pending background build now
+ *
+ * For callers that need the complete index immediately (seeding stopped
+ * at shutdown).
+ */
+void kp_desktop_complete(void);
+
+/**
+ * Has the background build finished?
+ *
+ * Lets idle work that depends on the index (first-run seeding) wait for
+ * it without forcing a synchronous build.
+ */
+gboolean kp_desktop_ready(void);
+
+/**
+ * Run @func once when the background build finishes
+ *
+ * Only meaningful while kp_desktop_ready() is FALSE. One listener; NULL
+ * cancels it.
+ */
+void kp_desktop_on_ready(kp_desktop_ready_func func);
+
+/**
+ * Re-sync directories whose mtime changed
+ *
+ * Fallback for systems without inotify and for directories that did not
+ * exist at startup. Called on SIGHUP.
+ */
+void kp_desktop_refresh(void);
+
+/**
+ * Set the index change listener (one; NULL to clear)
+ */
+void kp_desktop_set_notify(kp_desktop_notify_func func);
 
 /**
  * Check if an executable has a .desktop file
@@ -52,6 +108,17 @@ void kp_desktop_init(void);
  */
 gboolean kp_desktop_has_file(const char *exe_path);
 
+/**
+ * Resolve an Exec= command line to a canonical executable path
+ *
+ * Handles shell quoting, "env VAR=value" prefixes, PATH lookup and snap
+ * wrappers, like the index itself does for .desktop files.
+ *
+ * @param exec_line  Command line ("firefox %u", "'/opt/app/bin/app' --new")
+ * @return           Newly allocated path, or NULL if it can't be resolved
+ */
+char *kp_desktop_resolve_exec(const char *exec_line);
+
 /**
  * Get application name from .desktop file
  *
@@ -60,6 +127,14 @@ gboolean kp_desktop_has_file(const char *exe_path);
  */
 const char *kp_desktop_get_name(const char *exe_path);
 
+/**
+ * Desktop index generation
+ *
+ * Incremented whenever the index is (re)built, updated or freed, so callers
+ * that cache results derived from it can tell when to drop them.
+ */
+guint kp_desktop_generation(void);
+
 /**
  * Free desktop scanner resources
  */
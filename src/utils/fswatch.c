@@ -0,0 +1,149 @@
+/* fswatch.c - inotify watches on the main loop for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: inotify Watches
+ * =============================================================================
+ *
+ * Live hints (daemon/hints.c), login detection (daemon/session.c) and the
+ * desktop index (utils/desktop.c) each follow a few directories. This is
+ * the plumbing they share:
+ *
+ *   - A non-blocking, close-on-exec inotify fd with a GIOChannel watch.
+ *   - On wakeup, the fd is read until empty and every event goes to the
+ *     owner's handler, then the done handler runs once for the batch.
+ *   - An error on the fd, or a handler reporting the watch lost, closes
+ *     the fd and removes the source. The owner learns it from the done
+ *     handler and decides whether to fall back or start over.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "fswatch.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+struct _kp_fswatch_t
+{
+    int fd;                 /* -1 once lost */
+    guint watch_id;
+    kp_fswatch_func func;
+    kp_fswatch_done_func done;
+    gpointer user_data;
+};
+
+/* Close the fd; the source goes away when the callback returns FALSE */
+static gboolean
+fswatch_lost(kp_fswatch_t *w)
+{
+    close(w->fd);
+    w->fd = -1;
+    w->watch_id = 0;
+
+    /* May free w */
+    if (w->done)
+        w->done(FALSE, w->user_data);
+    return FALSE;
+}
+
+static gboolean
+fswatch_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    kp_fswatch_t *w = data;
+    ssize_t len;
+
+    (void)source;
+
+    if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+        return fswatch_lost(w);
+
+    while ((len = read(w->fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (!w->func(ev, w->user_data))
+                return fswatch_lost(w);
+        }
+    }
+
+    if (w->done)
+        w->done(TRUE, w->user_data);
+    return TRUE;
+}
+
+/**
+ * Create an inotify instance and watch it from the main loop
+ */
+kp_fswatch_t *
+kp_fswatch_new(kp_fswatch_func func, kp_fswatch_done_func done, gpointer user_data)
+{
+    kp_fswatch_t *w;
+    GIOChannel *channel;
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd < 0)
+        return NULL;
+
+    w = g_new0(kp_fswatch_t, 1);
+    w->fd = fd;
+    w->func = func;
+    w->done = done;
+    w->user_data = user_data;
+
+    channel = g_io_channel_unix_new(fd);
+    w->watch_id = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                 fswatch_callback, w);
+    g_io_channel_unref(channel);    /* The watch holds its own reference */
+    return w;
+}
+
+/**
+ * Watch a path
+ */
+int
+kp_fswatch_add(kp_fswatch_t *w, const char *path, uint32_t mask)
+{
+    if (w->fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    return inotify_add_watch(w->fd, path, mask);
+}
+
+/**
+ * Stop watching a watch descriptor
+ */
+void
+kp_fswatch_rm(kp_fswatch_t *w, int wd)
+{
+    if (w->fd >= 0 && wd >= 0)
+        inotify_rm_watch(w->fd, wd);
+}
+
+/**
+ * Remove the main loop watch and close the fd
+ */
+void
+kp_fswatch_free(kp_fswatch_t *w)
+{
+    if (!w)
+        return;
+
+    if (w->watch_id)
+        g_source_remove(w->watch_id);
+    if (w->fd >= 0)
+        close(w->fd);
+    g_free(w);
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
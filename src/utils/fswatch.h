@@ -0,0 +1,70 @@
+/* fswatch.h - inotify watches on the main loop for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef FSWATCH_H
+#define FSWATCH_H
+
+#include <glib.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+
+/**
+ * kp_fswatch_t: One inotify instance read from a GLib source
+ *
+ * Owns the inotify fd and its main loop watch. Events are handed to the
+ * owner one at a time; the owner maps watch descriptors to its own state.
+ */
+typedef struct _kp_fswatch_t kp_fswatch_t;
+
+/**
+ * Event handler
+ *
+ * @return  FALSE if the watch is lost (e.g. a watched root went away);
+ *          the remaining events are dropped
+ */
+typedef gboolean (*kp_fswatch_func)(const struct inotify_event *ev, gpointer user_data);
+
+/**
+ * Called after the events of one wakeup were handled (@active TRUE), or
+ * once when the watch is lost (@active FALSE). By then the fd is closed
+ * and the handler may kp_fswatch_free() the watch.
+ */
+typedef void (*kp_fswatch_done_func)(gboolean active, gpointer user_data);
+
+/**
+ * Create an inotify instance and watch it from the main loop
+ *
+ * @param done  May be NULL
+ * @return  NULL if inotify is unavailable (errno set)
+ */
+kp_fswatch_t *kp_fswatch_new(kp_fswatch_func func, kp_fswatch_done_func done,
+                             gpointer user_data);
+
+/**
+ * Watch a path
+ *
+ * @return  Watch descriptor, -1 on error (errno set) or if the watch is lost
+ */
+int kp_fswatch_add(kp_fswatch_t *w, const char *path, uint32_t mask);
+
+/**
+ * Stop watching a watch descriptor
+ */
+void kp_fswatch_rm(kp_fswatch_t *w, int wd);
+
+/**
+ * Remove the main loop watch and close the fd
+ */
+void kp_fswatch_free(kp_fswatch_t *w);
+
+#endif /* HAVE_SYS_INOTIFY_H */
+
+#endif /* FSWATCH_H */
@@ -7,155 +7,1085 @@
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
  *
+ * =============================================================================
+ * MODULE OVERVIEW: Shared Library Discovery
+ * =============================================================================
+ *
  * Discovers shared libraries via:
- * 1. ldd (ELF-linked dependencies)
+ * 1. In-process ELF dependency resolution (DT_NEEDED closure)
  * 2. Directory scan (for dlopen'd libraries like Firefox's libxul.so)
+ *
+ * The directory scan is blind: it returns every large .so next to the exe.
+ * state_closure.c only falls back to it when no plugin history has been
+ * learned for the app yet.
+ *
+ * ELF RESOLUTION:
+ *   Earlier versions ran "/usr/bin/ldd" through popen() for every exe.
+ *   That forked a shell plus the dynamic loader per app, parsed text, and
+ *   executed the loader against binaries we do not trust. Instead we read
+ *   PT_DYNAMIC ourselves and follow the loader's search order:
+ *
+ *     1. DT_RPATH of the object (and of the exe), unless DT_RUNPATH exists
+ *     2. DT_RUNPATH of the object
+ *     3. /etc/ld.so.cache
+ *     4. Default directories (multiarch, lib64, lib)
+ *
+ *   $ORIGIN and $LIB are expanded; $LIB is the directory the loader's own
+ *   libc.so.6 resolves to (lib/x86_64-linux-gnu, lib64, ...), so it follows
+ *   the distribution's layout. Candidates whose ELF class or machine
+ *   differ from the requesting object are skipped, as the loader does.
+ *   LD_LIBRARY_PATH is ignored - it belongs to the user's session, not to
+ *   the daemon's environment.
+ *
+ * CACHING:
+ *   - Parsed ELF headers are cached by (dev, ino, mtime) of each file,
+ *     so each shared library is parsed once no matter how many apps use it.
+ *   - The closure of each exe is cached with the identity of every member.
+ *     A cached closure is reused only if all members still stat the same
+ *     and /etc/ld.so.cache has not changed.
+ *
+ *   A session-boot batch therefore costs one stat() per member instead of
+ *   one fork+exec per app. Both caches are dropped when the configuration
+ *   is reloaded or once they hold ELF_CACHE_MAX objects, so files replaced
+ *   by upgrades don't accumulate for the life of the daemon.
+ *
+ * =============================================================================
  */
 
+#include "common.h"
+#include "../config/config.h"
 #include "lib_scanner.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+
+#include <elf.h>
 #include <dirent.h>
-#include <sys/stat.h>
-#include <glib.h>
+#include <limits.h>
 
 #define MAX_LIBS 256
-#define LINE_SIZE 1024
 #define MIN_LIB_SIZE (64 * 1024)  /* Only scan libs > 64 KB */
 
+#define LD_SO_CACHE         "/etc/ld.so.cache"
+#define LD_CACHE_MAGIC_OLD  "ld.so-1.7.0"
+#define LD_CACHE_MAGIC_NEW  "glibc-ld.so.cache1.1"
+#define LD_CACHE_FLAG_ELF   0x0001  /* FLAG_ELF / FLAG_ELF_LIBC6 type bits */
+
+/* Sanity limits for untrusted ELF input */
+#define ELF_MAX_PHNUM       256
+#define ELF_MAX_DYNAMIC     (64 * 1024)
+
+#define ELF_CACHE_MAX       4096    /* Parsed objects kept before a flush */
+
+/* Multiarch and legacy default search paths (after ld.so.cache) */
+static const char *default_lib_dirs[] = {
+#if defined(__x86_64__)
+    "/lib/x86_64-linux-gnu",
+    "/usr/lib/x86_64-linux-gnu",
+#elif defined(__aarch64__)
+    "/lib/aarch64-linux-gnu",
+    "/usr/lib/aarch64-linux-gnu",
+#elif defined(__i386__)
+    "/lib/i386-linux-gnu",
+    "/usr/lib/i386-linux-gnu",
+#endif
+    "/lib64",
+    "/usr/lib64",
+    "/lib",
+    "/usr/lib",
+    NULL
+};
+
+/**
+ * File identity used as cache key
+ */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    long mtime_nsec;
+} elf_key_t;
+
+/**
+ * Parsed dynamic section of one ELF object
+ */
+typedef struct {
+    int elf_class;      /* ELFCLASS32/ELFCLASS64, 0 = not a usable ELF */
+    int machine;        /* e_machine */
+    char **needed;      /* DT_NEEDED sonames (NULL-terminated) */
+    char *rpath;        /* DT_RPATH, unexpanded */
+    char *runpath;      /* DT_RUNPATH, unexpanded */
+} elf_info_t;
+
+/**
+ * One resolved library of a closure
+ */
+typedef struct {
+    char *path;         /* Canonical path */
+    elf_key_t key;      /* Identity when resolved */
+} closure_member_t;
+
+/**
+ * Cached dependency closure of an exe
+ */
+typedef struct {
+    guint ld_cache_gen;     /* ld.so.cache generation it was built against */
+    GPtrArray *members;     /* closure_member_t*, loader order */
+} closure_t;
+
+static struct {
+    GHashTable *elf_cache;      /* elf_key_t* → elf_info_t* */
+    GHashTable *closures;       /* elf_key_t* (exe) → closure_t* */
+    GHashTable *ld_cache;       /* soname → GPtrArray of paths */
+    elf_key_t ld_cache_key;     /* Identity of loaded /etc/ld.so.cache */
+    guint ld_cache_gen;         /* Bumped on every ld.so.cache reload */
+    char *dst_lib[2];           /* $LIB for ELFCLASS32, ELFCLASS64 */
+    guint dst_lib_gen;          /* ld_cache_gen dst_lib was derived from */
+    guint conf_gen;             /* Config generation the caches belong to */
+} scanner;
+
+/* ========================================================================
+ * CACHE KEYS
+ * ======================================================================== */
+
+static guint
+elf_key_hash(gconstpointer p)
+{
+    const elf_key_t *k = p;
+    return (guint)(k->ino ^ (k->ino >> 32) ^ k->dev ^ k->mtime ^ k->mtime_nsec);
+}
+
+static gboolean
+elf_key_equal(gconstpointer a, gconstpointer b)
+{
+    const elf_key_t *x = a, *y = b;
+    return x->dev == y->dev && x->ino == y->ino &&
+           x->mtime == y->mtime && x->mtime_nsec == y->mtime_nsec;
+}
+
+/**
+ * Fill identity from stat(); follows symlinks like the loader does
+ */
+static gboolean
+elf_key_from_path(const char *path, elf_key_t *key)
+{
+    struct stat st;
+
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+        return FALSE;
+
+    memset(key, 0, sizeof(*key));
+    key->dev = st.st_dev;
+    key->ino = st.st_ino;
+    key->mtime = st.st_mtim.tv_sec;
+    key->mtime_nsec = st.st_mtim.tv_nsec;
+    return TRUE;
+}
+
+static elf_key_t *
+elf_key_dup(const elf_key_t *key)
+{
+    elf_key_t *copy = g_new(elf_key_t, 1);
+    *copy = *key;
+    return copy;
+}
+
+static void
+elf_info_free(gpointer data)
+{
+    elf_info_t *info = data;
+    if (info) {
+        g_strfreev(info->needed);
+        g_free(info->rpath);
+        g_free(info->runpath);
+        g_free(info);
+    }
+}
+
+static void
+closure_free(gpointer data)
+{
+    closure_t *closure = data;
+    if (closure) {
+        g_ptr_array_free(closure->members, TRUE);
+        g_free(closure);
+    }
+}
+
+static void
+closure_member_free(gpointer data)
+{
+    closure_member_t *member = data;
+    if (member) {
+        g_free(member->path);
+        g_free(member);
+    }
+}
+
+/**
+ * Drop parsed objects and closures (between scans only: lookups hand out
+ * pointers into the cache)
+ */
+static void
+scanner_flush(void)
+{
+    if (scanner.closures) {
+        g_hash_table_destroy(scanner.closures);
+        scanner.closures = NULL;
+    }
+    if (scanner.elf_cache) {
+        g_hash_table_destroy(scanner.elf_cache);
+        scanner.elf_cache = NULL;
+    }
+}
+
+static void
+scanner_ensure_init(void)
+{
+    if (scanner.elf_cache &&
+        (scanner.conf_gen != kp_config_generation() ||
+         g_hash_table_size(scanner.elf_cache) >= ELF_CACHE_MAX)) {
+        g_debug("lib_scanner: flushing %u cached objects",
+                g_hash_table_size(scanner.elf_cache));
+        scanner_flush();
+    }
+
+    scanner.conf_gen = kp_config_generation();
+
+    if (scanner.elf_cache)
+        return;
+
+    scanner.elf_cache = g_hash_table_new_full(elf_key_hash, elf_key_equal,
+                                              g_free, elf_info_free);
+    scanner.closures = g_hash_table_new_full(elf_key_hash, elf_key_equal,
+                                             g_free, closure_free);
+}
+
+/* ========================================================================
+ * ELF PARSING
+ * ======================================================================== */
+
+/**
+ * Read exactly len bytes at offset
+ */
+static gboolean
+read_at(int fd, void *buf, size_t len, off_t offset)
+{
+    ssize_t n = pread(fd, buf, len, offset);
+    return n >= 0 && (size_t)n == len;
+}
+
+/**
+ * Read one NUL-terminated string from the dynamic string table
+ *
+ * @return Copy of the string (caller frees), or NULL if out of range/empty
+ */
+static char *
+read_dynstr(int fd, guint64 strtab_off, guint64 strsz, guint64 idx)
+{
+    char buf[PATH_MAX];
+    size_t want;
+    ssize_t n;
+
+    if (idx >= strsz)
+        return NULL;
+
+    want = MIN((guint64)sizeof(buf) - 1, strsz - idx);
+    n = pread(fd, buf, want, (off_t)(strtab_off + idx));
+    if (n <= 0)
+        return NULL;
+
+    buf[n] = '\0';
+    return buf[0] ? g_strdup(buf) : NULL;
+}
+
+/**
+ * Normalized program header (32/64-bit agnostic)
+ */
+typedef struct {
+    guint32 type;
+    guint64 offset;
+    guint64 vaddr;
+    guint64 filesz;
+} phdr_t;
+
+/**
+ * Translate a virtual address into a file offset via PT_LOAD segments
+ */
+static gboolean
+vaddr_to_offset(const phdr_t *ph, int phnum, guint64 vaddr, guint64 *offset)
+{
+    for (int i = 0; i < phnum; i++) {
+        if (ph[i].type != PT_LOAD)
+            continue;
+        if (vaddr >= ph[i].vaddr && vaddr < ph[i].vaddr + ph[i].filesz) {
+            *offset = ph[i].offset + (vaddr - ph[i].vaddr);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Parse the dynamic section of an ELF file
+ *
+ * Only native byte order is accepted - foreign-endian objects can't be
+ * loaded by this system's loader anyway.
+ *
+ * @param path  File to parse
+ * @return      Parsed info (elf_class == 0 if not a usable ELF object)
+ */
+static elf_info_t *
+elf_parse(const char *path)
+{
+    elf_info_t *info = g_new0(elf_info_t, 1);
+    unsigned char ident[EI_NIDENT];
+    phdr_t ph[ELF_MAX_PHNUM];
+    guint64 phoff, dyn_off = 0, dyn_size = 0;
+    guint64 strtab_addr = 0, strsz = 0, strtab_off;
+    guint64 rpath_idx = G_MAXUINT64, runpath_idx = G_MAXUINT64;
+    GArray *needed_idx;
+    char *dynbuf = NULL;
+    int phnum, phentsize, elf_class, machine;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return info;
+
+    if (!read_at(fd, ident, sizeof(ident), 0) ||
+        memcmp(ident, ELFMAG, SELFMAG) != 0) {
+        close(fd);
+        return info;
+    }
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    if (ident[EI_DATA] != ELFDATA2LSB) {
+#else
+    if (ident[EI_DATA] != ELFDATA2MSB) {
+#endif
+        close(fd);
+        return info;
+    }
+
+    elf_class = ident[EI_CLASS];
+    if (elf_class == ELFCLASS64) {
+        Elf64_Ehdr eh;
+        if (!read_at(fd, &eh, sizeof(eh), 0)) {
+            close(fd);
+            return info;
+        }
+        phoff = eh.e_phoff;
+        phnum = eh.e_phnum;
+        phentsize = eh.e_phentsize;
+        machine = eh.e_machine;
+        if (phentsize != sizeof(Elf64_Phdr))
+            phnum = 0;
+    } else if (elf_class == ELFCLASS32) {
+        Elf32_Ehdr eh;
+        if (!read_at(fd, &eh, sizeof(eh), 0)) {
+            close(fd);
+            return info;
+        }
+        phoff = eh.e_phoff;
+        phnum = eh.e_phnum;
+        phentsize = eh.e_phentsize;
+        machine = eh.e_machine;
+        if (phentsize != sizeof(Elf32_Phdr))
+            phnum = 0;
+    } else {
+        close(fd);
+        return info;
+    }
+
+    if (phnum <= 0 || phnum > ELF_MAX_PHNUM) {
+        close(fd);
+        return info;
+    }
+
+    /* Load and normalize program headers */
+    for (int i = 0; i < phnum; i++) {
+        off_t off = (off_t)(phoff + (guint64)i * phentsize);
+
+        if (elf_class == ELFCLASS64) {
+            Elf64_Phdr p;
+            if (!read_at(fd, &p, sizeof(p), off))
+                goto out;
+            ph[i].type = p.p_type;
+            ph[i].offset = p.p_offset;
+            ph[i].vaddr = p.p_vaddr;
+            ph[i].filesz = p.p_filesz;
+        } else {
+            Elf32_Phdr p;
+            if (!read_at(fd, &p, sizeof(p), off))
+                goto out;
+            ph[i].type = p.p_type;
+            ph[i].offset = p.p_offset;
+            ph[i].vaddr = p.p_vaddr;
+            ph[i].filesz = p.p_filesz;
+        }
+
+        if (ph[i].type == PT_DYNAMIC) {
+            dyn_off = ph[i].offset;
+            dyn_size = ph[i].filesz;
+        }
+    }
+
+    /* The object is a valid ELF even if statically linked */
+    info->elf_class = elf_class;
+    info->machine = machine;
+
+    if (dyn_size == 0 || dyn_size > ELF_MAX_DYNAMIC)
+        goto out;
+
+    dynbuf = g_malloc(dyn_size);
+    if (!read_at(fd, dynbuf, dyn_size, (off_t)dyn_off))
+        goto out;
+
+    /* Walk dynamic entries; string offsets are resolved after DT_STRTAB */
+    needed_idx = g_array_new(FALSE, FALSE, sizeof(guint64));
+    {
+        size_t entsize = (elf_class == ELFCLASS64) ? sizeof(Elf64_Dyn)
+                                                   : sizeof(Elf32_Dyn);
+        size_t count = dyn_size / entsize;
+
+        for (size_t i = 0; i < count; i++) {
+            gint64 tag;
+            guint64 val;
+
+            if (elf_class == ELFCLASS64) {
+                Elf64_Dyn d;
+                memcpy(&d, dynbuf + i * entsize, sizeof(d));
+                tag = d.d_tag;
+                val = d.d_un.d_val;
+            } else {
+                Elf32_Dyn d;
+                memcpy(&d, dynbuf + i * entsize, sizeof(d));
+                tag = d.d_tag;
+                val = d.d_un.d_val;
+            }
+
+            if (tag == DT_NULL)
+                break;
+
+            switch (tag) {
+            case DT_NEEDED:
+                g_array_append_val(needed_idx, val);
+                break;
+            case DT_STRTAB:
+                strtab_addr = val;
+                break;
+            case DT_STRSZ:
+                strsz = val;
+                break;
+            case DT_RPATH:
+                rpath_idx = val;
+                break;
+            case DT_RUNPATH:
+                runpath_idx = val;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    if (strsz == 0 || !vaddr_to_offset(ph, phnum, strtab_addr, &strtab_off)) {
+        g_array_free(needed_idx, TRUE);
+        goto out;
+    }
+
+    /* .dynstr of large C++ libraries runs to megabytes: read only the
+     * strings we need instead of the whole table */
+    info->needed = g_new0(char *, needed_idx->len + 1);
+    for (guint i = 0, n = 0; i < needed_idx->len; i++) {
+        char *name = read_dynstr(fd, strtab_off, strsz,
+                                 g_array_index(needed_idx, guint64, i));
+        if (name)
+            info->needed[n++] = name;
+    }
+    g_array_free(needed_idx, TRUE);
+
+    info->rpath = read_dynstr(fd, strtab_off, strsz, rpath_idx);
+    info->runpath = read_dynstr(fd, strtab_off, strsz, runpath_idx);
+
+out:
+    g_free(dynbuf);
+    close(fd);
+    return info;
+}
+
+/**
+ * Get parsed ELF info for a path, using the (dev, ino, mtime) cache
+ *
+ * @param path  File to look up
+ * @param key   Out: identity of the file (may be NULL)
+ * @return      Cached info, or NULL if the file is missing/not ELF
+ */
+static const elf_info_t *
+elf_lookup(const char *path, elf_key_t *key)
+{
+    elf_key_t k;
+    elf_info_t *info;
+
+    if (!elf_key_from_path(path, &k))
+        return NULL;
+
+    info = g_hash_table_lookup(scanner.elf_cache, &k);
+    if (!info) {
+        info = elf_parse(path);
+        g_hash_table_insert(scanner.elf_cache, elf_key_dup(&k), info);
+    }
+
+    if (key)
+        *key = k;
+
+    return info->elf_class ? info : NULL;
+}
+
+/* ========================================================================
+ * /etc/ld.so.cache
+ * ======================================================================== */
+
+/**
+ * (Re)load /etc/ld.so.cache if it changed since last use
+ *
+ * Supports the "glibc-ld.so.cache1.1" format, standalone or appended to
+ * the legacy "ld.so-1.7.0" table. String offsets in the new format are
+ * relative to the start of the new header.
+ */
+static void
+ld_cache_refresh(void)
+{
+    elf_key_t key;
+    gchar *contents = NULL;
+    gsize len = 0, off = 0;
+    guint32 nlibs;
+
+    if (!elf_key_from_path(LD_SO_CACHE, &key)) {
+        memset(&key, 0, sizeof(key));
+    }
+
+    if (scanner.ld_cache && elf_key_equal(&key, &scanner.ld_cache_key))
+        return;
+
+    if (scanner.ld_cache)
+        g_hash_table_destroy(scanner.ld_cache);
+
+    scanner.ld_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)g_ptr_array_unref);
+    scanner.ld_cache_key = key;
+    scanner.ld_cache_gen++;
+
+    if (!g_file_get_contents(LD_SO_CACHE, &contents, &len, NULL))
+        return;
+
+    /* Skip legacy table if present */
+    if (len >= 16 && memcmp(contents, LD_CACHE_MAGIC_OLD,
+                            strlen(LD_CACHE_MAGIC_OLD)) == 0) {
+        guint32 old_nlibs;
+        memcpy(&old_nlibs, contents + 12, sizeof(old_nlibs));
+        off = 16 + (gsize)old_nlibs * 12;
+        off = (off + 7) & ~(gsize)7;
+    }
+
+    if (off + 48 > len ||
+        memcmp(contents + off, LD_CACHE_MAGIC_NEW, strlen(LD_CACHE_MAGIC_NEW)) != 0) {
+        g_debug("lib_scanner: unrecognized %s format", LD_SO_CACHE);
+        g_free(contents);
+        return;
+    }
+
+    memcpy(&nlibs, contents + off + 20, sizeof(nlibs));
+
+    for (guint32 i = 0; i < nlibs; i++) {
+        gsize ent = off + 48 + (gsize)i * 24;
+        gint32 flags;
+        guint32 k, v;
+        const char *soname, *libpath;
+        GPtrArray *paths;
+
+        if (ent + 24 > len)
+            break;
+
+        memcpy(&flags, contents + ent, sizeof(flags));
+        memcpy(&k, contents + ent + 4, sizeof(k));
+        memcpy(&v, contents + ent + 8, sizeof(v));
+
+        if (!(flags & LD_CACHE_FLAG_ELF))
+            continue;
+        if (off + k >= len || off + v >= len)
+            continue;
+
+        soname = contents + off + k;
+        libpath = contents + off + v;
+        if (!memchr(soname, '\0', len - off - k) ||
+            !memchr(libpath, '\0', len - off - v) || libpath[0] != '/')
+            continue;
+
+        paths = g_hash_table_lookup(scanner.ld_cache, soname);
+        if (!paths) {
+            paths = g_ptr_array_new_with_free_func(g_free);
+            g_hash_table_insert(scanner.ld_cache, g_strdup(soname), paths);
+        }
+        g_ptr_array_add(paths, g_strdup(libpath));
+    }
+
+    g_debug("lib_scanner: loaded %u sonames from %s",
+            g_hash_table_size(scanner.ld_cache), LD_SO_CACHE);
+
+    g_free(contents);
+}
+
+/* ========================================================================
+ * RESOLUTION
+ * ======================================================================== */
+
+/**
+ * Accept candidate only if it is an ELF object matching the requester
+ */
+static gboolean
+candidate_compatible(const char *path, const elf_info_t *requester)
+{
+    const elf_info_t *info = elf_lookup(path, NULL);
+
+    return info && info->elf_class == requester->elf_class &&
+           info->machine == requester->machine;
+}
+
+/**
+ * Value of $LIB for objects like @requester
+ *
+ * glibc sets $LIB to its own library directory, so derive it from where
+ * libc.so.6 of the same class resolves: ld.so.cache first, then the
+ * default directories. Re-derived whenever ld.so.cache changes.
+ */
+static const char *
+dst_lib(const elf_info_t *requester)
+{
+    int slot = requester->elf_class == ELFCLASS64;
+    char *libc = NULL;
+    GPtrArray *cached;
+
+    if (scanner.dst_lib_gen != scanner.ld_cache_gen) {
+        g_free(scanner.dst_lib[0]);
+        g_free(scanner.dst_lib[1]);
+        scanner.dst_lib[0] = scanner.dst_lib[1] = NULL;
+        scanner.dst_lib_gen = scanner.ld_cache_gen;
+    }
+    if (scanner.dst_lib[slot])
+        return scanner.dst_lib[slot];
+
+    cached = scanner.ld_cache ? g_hash_table_lookup(scanner.ld_cache, "libc.so.6") : NULL;
+    for (guint i = 0; cached && i < cached->len && !libc; i++) {
+        if (candidate_compatible(g_ptr_array_index(cached, i), requester))
+            libc = g_strdup(g_ptr_array_index(cached, i));
+    }
+    for (int i = 0; default_lib_dirs[i] && !libc; i++) {
+        char *candidate = g_build_filename(default_lib_dirs[i], "libc.so.6", NULL);
+        if (candidate_compatible(candidate, requester))
+            libc = candidate;
+        else
+            g_free(candidate);
+    }
+
+    if (libc) {
+        /* /usr/lib/x86_64-linux-gnu/libc.so.6 → lib/x86_64-linux-gnu */
+        char *dir = g_path_get_dirname(libc);
+        const char *rel = dir;
+
+        if (g_str_has_prefix(rel, "/usr/"))
+            rel += 4;
+        while (*rel == '/')
+            rel++;
+        scanner.dst_lib[slot] = g_strdup(*rel ? rel : "lib");
+        g_free(dir);
+        g_free(libc);
+    } else {
+        scanner.dst_lib[slot] = g_strdup(slot ? "lib64" : "lib");
+    }
+
+    g_debug("lib_scanner: $LIB for ELFCLASS%d is %s",
+            slot ? 64 : 32, scanner.dst_lib[slot]);
+    return scanner.dst_lib[slot];
+}
+
+/**
+ * Expand $ORIGIN / $LIB dynamic string tokens in one search path entry
+ *
+ * @return Expanded path (caller frees), or NULL if it uses an unsupported token
+ */
+static char *
+expand_dst(const char *dir, const char *origin, const elf_info_t *requester)
+{
+    GString *out = g_string_new(NULL);
+    const char *p = dir;
+
+    while (*p) {
+        if (*p != '$') {
+            g_string_append_c(out, *p++);
+            continue;
+        }
+
+        if (g_str_has_prefix(p, "$ORIGIN") || g_str_has_prefix(p, "${ORIGIN}")) {
+            g_string_append(out, origin);
+            p += (p[1] == '{') ? 9 : 7;
+        } else if (g_str_has_prefix(p, "$LIB") || g_str_has_prefix(p, "${LIB}")) {
+            g_string_append(out, dst_lib(requester));
+            p += (p[1] == '{') ? 6 : 4;
+        } else {
+            /* $PLATFORM and friends: skip entry rather than guess */
+            g_string_free(out, TRUE);
+            return NULL;
+        }
+    }
+
+    return g_string_free(out, FALSE);
+}
+
+/**
+ * Search a colon-separated rpath/runpath list
+ */
+static char *
+search_path_list(const char *list, const char *origin, const char *name,
+                 const elf_info_t *requester)
+{
+    char **dirs;
+    char *found = NULL;
+
+    if (!list)
+        return NULL;
+
+    dirs = g_strsplit(list, ":", -1);
+    for (int i = 0; dirs[i] && !found; i++) {
+        char *dir, *candidate;
+
+        if (!dirs[i][0])
+            continue;
+
+        dir = expand_dst(dirs[i], origin, requester);
+        if (!dir)
+            continue;
+
+        candidate = g_build_filename(dir, name, NULL);
+        if (candidate_compatible(candidate, requester))
+            found = candidate;
+        else
+            g_free(candidate);
+        g_free(dir);
+    }
+    g_strfreev(dirs);
+
+    return found;
+}
+
+/**
+ * Resolve one DT_NEEDED entry following the dynamic loader's order
+ *
+ * @param name       Soname from DT_NEEDED
+ * @param obj        Requesting object
+ * @param obj_dir    Directory of requesting object ($ORIGIN)
+ * @param exe        Main executable (its DT_RPATH is inherited)
+ * @param exe_dir    Directory of main executable
+ * @return           Resolved path (caller frees), or NULL if not found
+ */
+static char *
+resolve_needed(const char *name, const elf_info_t *obj, const char *obj_dir,
+               const elf_info_t *exe, const char *exe_dir)
+{
+    char *found = NULL;
+    GPtrArray *cached;
+
+    /* Names containing a slash are used verbatim */
+    if (strchr(name, '/')) {
+        if (name[0] == '/' && candidate_compatible(name, obj))
+            return g_strdup(name);
+        return NULL;
+    }
+
+    /* DT_RPATH is only honored when the object has no DT_RUNPATH */
+    if (!obj->runpath) {
+        found = search_path_list(obj->rpath, obj_dir, name, obj);
+        if (!found && exe != obj && !exe->runpath)
+            found = search_path_list(exe->rpath, exe_dir, name, obj);
+        if (found)
+            return found;
+    }
+
+    found = search_path_list(obj->runpath, obj_dir, name, obj);
+    if (found)
+        return found;
+
+    cached = g_hash_table_lookup(scanner.ld_cache, name);
+    if (cached) {
+        for (guint i = 0; i < cached->len; i++) {
+            const char *candidate = g_ptr_array_index(cached, i);
+            if (candidate_compatible(candidate, obj))
+                return g_strdup(candidate);
+        }
+    }
+
+    for (int i = 0; default_lib_dirs[i]; i++) {
+        char *candidate = g_build_filename(default_lib_dirs[i], name, NULL);
+        if (candidate_compatible(candidate, obj))
+            return candidate;
+        g_free(candidate);
+    }
+
+    return NULL;
+}
+
+/**
+ * Check that every member of a cached closure is unchanged on disk
+ */
+static gboolean
+closure_is_valid(const closure_t *closure)
+{
+    if (closure->ld_cache_gen != scanner.ld_cache_gen)
+        return FALSE;
+
+    for (guint i = 0; i < closure->members->len; i++) {
+        const closure_member_t *m = g_ptr_array_index(closure->members, i);
+        elf_key_t now;
+
+        if (!elf_key_from_path(m->path, &now) || !elf_key_equal(&now, &m->key))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Compute transitive DT_NEEDED closure of an executable (breadth-first,
+ * i.e. in the order the loader maps them)
+ */
+static closure_t *
+closure_build(const char *exe_path, const elf_info_t *exe)
+{
+    closure_t *closure = g_new0(closure_t, 1);
+    GHashTable *seen_names = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTable *seen_files = g_hash_table_new_full(elf_key_hash, elf_key_equal,
+                                                   g_free, NULL);
+    GPtrArray *queue = g_ptr_array_new();   /* borrowed member paths */
+    char *exe_dir = g_path_get_dirname(exe_path);
+    elf_key_t exe_key;
+
+    closure->ld_cache_gen = scanner.ld_cache_gen;
+    closure->members = g_ptr_array_new_with_free_func(closure_member_free);
+
+    if (elf_key_from_path(exe_path, &exe_key))
+        g_hash_table_add(seen_files, elf_key_dup(&exe_key));
+
+    g_ptr_array_add(queue, (gpointer)exe_path);
+
+    for (guint q = 0; q < queue->len && closure->members->len < MAX_LIBS; q++) {
+        const char *obj_path = g_ptr_array_index(queue, q);
+        const elf_info_t *obj = (q == 0) ? exe : elf_lookup(obj_path, NULL);
+        char *obj_dir;
+
+        if (!obj || !obj->needed)
+            continue;
+
+        obj_dir = g_path_get_dirname(obj_path);
+
+        for (int i = 0; obj->needed[i] && closure->members->len < MAX_LIBS; i++) {
+            const char *name = obj->needed[i];
+            closure_member_t *member;
+            char canonical[PATH_MAX];
+            char *resolved;
+            elf_key_t key;
+
+            /* Loader matches already-loaded objects by soname */
+            if (g_hash_table_contains(seen_names, name))
+                continue;
+            g_hash_table_add(seen_names, (gpointer)name);
+
+            /* The interpreter is mapped by every process anyway */
+            if (g_str_has_prefix(name, "ld-linux"))
+                continue;
+
+            resolved = resolve_needed(name, obj, obj_dir, exe, exe_dir);
+            if (!resolved) {
+                g_debug("lib_scanner: %s: %s not found", exe_path, name);
+                continue;
+            }
+
+            if (!elf_key_from_path(resolved, &key) ||
+                g_hash_table_contains(seen_files, &key)) {
+                g_free(resolved);
+                continue;
+            }
+            g_hash_table_add(seen_files, elf_key_dup(&key));
+
+            /* Store canonical path so it matches /proc/PID/maps entries */
+            member = g_new0(closure_member_t, 1);
+            member->path = realpath(resolved, canonical) ? g_strdup(canonical)
+                                                         : g_strdup(resolved);
+            member->key = key;
+            g_free(resolved);
+
+            g_ptr_array_add(closure->members, member);
+            g_ptr_array_add(queue, member->path);
+        }
+
+        g_free(obj_dir);
+    }
+
+    g_ptr_array_free(queue, TRUE);
+    g_hash_table_destroy(seen_names);
+    g_hash_table_destroy(seen_files);
+    g_free(exe_dir);
+
+    return closure;
+}
+
+/**
+ * Get (cached) dependency closure for an executable
+ */
+static const closure_t *
+closure_get(const char *exe_path)
+{
+    const elf_info_t *exe;
+    closure_t *closure;
+    elf_key_t key;
+
+    exe = elf_lookup(exe_path, &key);
+    if (!exe)
+        return NULL;
+
+    closure = g_hash_table_lookup(scanner.closures, &key);
+    if (closure && closure_is_valid(closure))
+        return closure;
+
+    closure = closure_build(exe_path, exe);
+    g_hash_table_replace(scanner.closures, elf_key_dup(&key), closure);
+
+    return closure;
+}
+
+/* ========================================================================
+ * DIRECTORY SCAN
+ * ======================================================================== */
+
 /**
  * Scan directory for .so files (catches dlopen'd libs like libxul.so)
  */
 static void
-scan_dir_for_libs(const char *dir_path, GPtrArray *libs)
+scan_dir_for_libs(const char *dir_path, GPtrArray *libs, GHashTable *seen)
 {
     DIR *dir;
     struct dirent *entry;
     struct stat st;
     char full_path[PATH_MAX];
-    
+
     dir = opendir(dir_path);
     if (!dir)
         return;
-    
+
     while ((entry = readdir(dir)) != NULL && libs->len < MAX_LIBS) {
         /* Look for .so files */
         const char *name = entry->d_name;
         size_t len = strlen(name);
-        
+
         if (len < 4)
             continue;
-        
+
         /* Check for .so extension or .so.N pattern */
         if (!strstr(name, ".so"))
             continue;
-        
+
         snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, name);
-        
+
         /* Skip if not a regular file or too small */
         if (stat(full_path, &st) < 0 || !S_ISREG(st.st_mode))
             continue;
-        
+
         if (st.st_size < MIN_LIB_SIZE)
             continue;
-        
+
+        if (g_hash_table_contains(seen, full_path))
+            continue;
+
         g_ptr_array_add(libs, g_strdup(full_path));
+        g_hash_table_add(seen, g_ptr_array_index(libs, libs->len - 1));
     }
-    
+
     closedir(dir);
 }
 
+/* ========================================================================
+ * PUBLIC API
+ * ======================================================================== */
+
+/**
+ * Build NULL-terminated list from array (NULL if empty)
+ */
+static char **
+finish_library_list(GPtrArray *libs, const char *what, const char *exe_path)
+{
+    if (libs->len == 0) {
+        g_ptr_array_free(libs, TRUE);
+        return NULL;
+    }
+
+    g_ptr_array_add(libs, NULL);  /* NULL terminator */
+
+    g_debug("lib_scanner: found %u %s for %s", libs->len - 1, what, exe_path);
+
+    return (char **)g_ptr_array_free(libs, FALSE);
+}
+
 /**
  * Scan executable for shared library dependencies
- * Uses ldd for ELF deps + directory scan for dlopen'd libs
+ * Uses in-process ELF resolution of the DT_NEEDED closure
  */
 char **
 kp_scan_libraries(const char *exe_path)
 {
-    char cmd[PATH_MAX + 32];
-    char line[LINE_SIZE];
-    FILE *fp;
+    const closure_t *closure;
     GPtrArray *libs;
-    char *exe_dir;
-    
+
     if (!exe_path)
         return NULL;
-    
+
+    scanner_ensure_init();
+    ld_cache_refresh();
+
     libs = g_ptr_array_new();
-    
-    /* Phase 1: Use ldd for ELF-linked dependencies */
-    /* BUG 1 FIX: Use g_shell_quote to prevent command injection */
-    gchar *quoted_path = g_shell_quote(exe_path);
-    snprintf(cmd, sizeof(cmd), "/usr/bin/ldd %s 2>/dev/null", quoted_path);
-    g_free(quoted_path);
-    
-    fp = popen(cmd, "r");
-    if (fp) {
-        while (fgets(line, sizeof(line), fp) && libs->len < MAX_LIBS) {
-            char *arrow, *path_start, *path_end;
-            char *lib_path = NULL;
-            
-            /* Skip virtual libraries */
-            if (strstr(line, "linux-vdso") || 
-                strstr(line, "linux-gate") ||
-                strstr(line, "not found")) {
-                continue;
-            }
-            
-            /* Parse " => /path" pattern */
-            arrow = strstr(line, " => ");
-            if (arrow) {
-                path_start = arrow + 4;
-                path_end = strchr(path_start, ' ');
-                if (!path_end) path_end = strchr(path_start, '\n');
-                
-                if (path_end && path_end > path_start) {
-                    lib_path = g_strndup(path_start, path_end - path_start);
-                }
-            } else {
-                /* Direct path: "    /lib64/ld-linux.so" */
-                char *start = line;
-                while (*start == ' ' || *start == '\t') start++;
-                
-                if (*start == '/') {
-                    path_end = strchr(start, ' ');
-                    if (!path_end) path_end = strchr(start, '\n');
-                    
-                    if (path_end && path_end > start) {
-                        lib_path = g_strndup(start, path_end - start);
-                    }
-                }
-            }
-            
-            /* Add valid paths, skip ld-linux */
-            if (lib_path && lib_path[0] == '/' && !strstr(lib_path, "ld-linux")) {
-                g_ptr_array_add(libs, lib_path);
-            } else {
-                g_free(lib_path);
-            }
+
+    closure = closure_get(exe_path);
+    if (closure) {
+        for (guint i = 0; i < closure->members->len && libs->len < MAX_LIBS; i++) {
+            const closure_member_t *m = g_ptr_array_index(closure->members, i);
+            g_ptr_array_add(libs, g_strdup(m->path));
         }
-        pclose(fp);
     }
-    
-    /* Phase 2: Scan executable's directory for .so files (dlopen'd libs) */
+
+    return finish_library_list(libs, "libraries", exe_path);
+}
+
+/**
+ * Scan executable's directory for .so files (dlopen'd libs)
+ */
+char **
+kp_scan_plugin_dir(const char *exe_path)
+{
+    GPtrArray *libs;
+    GHashTable *seen;
+    char *exe_dir;
+
+    if (!exe_path)
+        return NULL;
+
+    libs = g_ptr_array_new();
+    seen = g_hash_table_new(g_str_hash, g_str_equal);
+
     exe_dir = g_path_get_dirname(exe_path);
     if (exe_dir && strcmp(exe_dir, ".") != 0 && strcmp(exe_dir, "/usr/bin") != 0) {
         /* Only scan app-specific dirs like /usr/lib/firefox-esr/, not /usr/bin */
-        scan_dir_for_libs(exe_dir, libs);
+        scan_dir_for_libs(exe_dir, libs, seen);
     }
     g_free(exe_dir);
-    
-    if (libs->len == 0) {
-        g_ptr_array_free(libs, TRUE);
-        return NULL;
-    }
-    
-    g_ptr_array_add(libs, NULL);  /* NULL terminator */
-    
-    g_debug("lib_scanner: found %u libraries for %s", libs->len - 1, exe_path);
-    
-    return (char **)g_ptr_array_free(libs, FALSE);
+    g_hash_table_destroy(seen);
+
+    return finish_library_list(libs, "directory plugins", exe_path);
 }
 
 /**
@@ -166,10 +1096,25 @@ kp_free_library_list(char **libs)
 {
     if (!libs)
         return;
-    
+
     for (int i = 0; libs[i]; i++) {
         g_free(libs[i]);
     }
     g_free(libs);
 }
 
+/**
+ * Release resolver caches
+ */
+void
+kp_lib_scanner_free(void)
+{
+    scanner_flush();
+    g_free(scanner.dst_lib[0]);
+    g_free(scanner.dst_lib[1]);
+    scanner.dst_lib[0] = scanner.dst_lib[1] = NULL;
+    if (scanner.ld_cache) {
+        g_hash_table_destroy(scanner.ld_cache);
+        scanner.ld_cache = NULL;
+    }
+}
@@ -9,7 +9,11 @@
 #include <limits.h>
 
 /**
- * Scan executable for shared library dependencies using ldd
+ * Scan executable for shared library dependencies
+ *
+ * Resolves the transitive DT_NEEDED closure in-process (no ldd/fork).
+ * Parsed ELF objects and closures are cached by (dev, ino, mtime).
+ *
  * @param exe_path Path to executable
  * @return NULL-terminated array of library paths, or NULL on error
  *         Caller must free with kp_free_library_list()
@@ -17,8 +21,25 @@
 char **kp_scan_libraries(const char *exe_path);
 
 /**
- * Free library list returned by kp_scan_libraries
+ * Scan executable's own directory for large .so files
+ *
+ * Catches dlopen'd plugins (e.g. Firefox's libxul.so) that are not in
+ * DT_NEEDED. Skipped for /usr/bin and relative paths.
+ *
+ * @param exe_path Path to executable
+ * @return NULL-terminated array of library paths, or NULL if none
+ *         Caller must free with kp_free_library_list()
+ */
+char **kp_scan_plugin_dir(const char *exe_path);
+
+/**
+ * Free library list returned by kp_scan_libraries/kp_scan_plugin_dir
  */
 void kp_free_library_list(char **libs);
 
+/**
+ * Release ELF and ld.so.cache caches (call at shutdown)
+ */
+void kp_lib_scanner_free(void);
+
 #endif /* LIB_SCANNER_H */
@@ -0,0 +1,139 @@
+/* linereader.c - Streaming line reader for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Line Reader
+ * =============================================================================
+ *
+ * Shell history and recently-used.xbel can grow to tens of megabytes. This
+ * reader walks them through one fixed buffer instead of loading them whole:
+ *
+ *   read() → buf[start, len) → memchr('\n') → line
+ *                ↑ compacted when only a partial line is left
+ *
+ * The reader keeps the file offset of every line it hands out, so seeding
+ * can stop mid-file at the end of a time slice, and the live hint watcher
+ * (daemon/hints.c) can reopen at the previous offset and parse only what
+ * was appended.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "linereader.h"
+
+#define LINEREADER_BUF 65536
+
+/**
+ * Open a file for reading from an offset
+ */
+gboolean
+kp_linereader_open(kp_linereader_t *r, const char *path, off_t offset)
+{
+    g_return_val_if_fail(r, FALSE);
+
+    r->fd = open(path, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+    if (r->fd < 0)
+        return FALSE;
+
+    if (offset > 0 && lseek(r->fd, offset, SEEK_SET) != offset) {
+        close(r->fd);
+        r->fd = -1;
+        return FALSE;
+    }
+
+    if (!r->buf)
+        r->buf = g_malloc(LINEREADER_BUF);
+    r->start = r->len = 0;
+    r->base = offset;
+    r->eof = FALSE;
+    r->skipping = FALSE;
+    return TRUE;
+}
+
+/**
+ * Next line, without its newline
+ */
+const char *
+kp_linereader_next(kp_linereader_t *r, size_t *len_out, gboolean partial)
+{
+    if (r->fd < 0)
+        return NULL;
+
+    for (;;) {
+        char *nl = memchr(r->buf + r->start, '\n', r->len - r->start);
+
+        if (nl) {
+            const char *line = r->buf + r->start;
+            size_t len = (size_t)(nl - line);
+            gboolean skip = r->skipping;
+
+            r->start += len + 1;
+            r->skipping = FALSE;
+            if (skip)
+                continue;
+            *len_out = len;
+            return line;
+        }
+
+        if (r->eof) {
+            /* Last line without newline */
+            if (partial && r->start < r->len && !r->skipping) {
+                const char *line = r->buf + r->start;
+                *len_out = r->len - r->start;
+                r->start = r->len;
+                return line;
+            }
+            return NULL;
+        }
+
+        /* Compact, then refill */
+        if (r->start > 0) {
+            memmove(r->buf, r->buf + r->start, r->len - r->start);
+            r->base += (off_t)r->start;
+            r->len -= r->start;
+            r->start = 0;
+        }
+        if (r->len == LINEREADER_BUF) {
+            r->base += (off_t)r->len;   /* Overlong line: drop what we have */
+            r->len = 0;
+            r->skipping = TRUE;
+        }
+
+        {
+            ssize_t n = read(r->fd, r->buf + r->len, LINEREADER_BUF - r->len);
+            if (n <= 0)
+                r->eof = TRUE;
+            else
+                r->len += (size_t)n;
+        }
+    }
+}
+
+/**
+ * File offset just past the last line returned
+ */
+off_t
+kp_linereader_offset(const kp_linereader_t *r)
+{
+    return r->base + (off_t)r->start;
+}
+
+/**
+ * Close the file and free the buffer
+ */
+void
+kp_linereader_close(kp_linereader_t *r)
+{
+    if (r->fd >= 0)
+        close(r->fd);
+    r->fd = -1;
+    g_free(r->buf);
+    r->buf = NULL;
+}
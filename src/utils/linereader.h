@@ -0,0 +1,66 @@
+/* linereader.h - Streaming line reader for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <glib.h>
+#include <sys/types.h>
+
+/**
+ * kp_linereader_t: Reads a file line by line through a fixed buffer
+ *
+ * Resumable: a caller can stop after any line and continue later, and
+ * kp_linereader_offset() tells where to reopen to parse only data
+ * appended since.
+ */
+typedef struct _kp_linereader_t
+{
+    int fd;             /* -1 when closed */
+    char *buf;
+    size_t start, len;  /* Unconsumed bytes are buf[start, len) */
+    off_t base;         /* File offset of buf[0] */
+    gboolean eof;
+    gboolean skipping;  /* Discarding the rest of an overlong line */
+} kp_linereader_t;
+
+#define KP_LINEREADER_INIT { -1, NULL, 0, 0, 0, FALSE, FALSE }
+
+/**
+ * Open a file for reading from an offset
+ *
+ * @return  FALSE if the file cannot be opened (errno set)
+ */
+gboolean kp_linereader_open(kp_linereader_t *r, const char *path, off_t offset);
+
+/**
+ * Next line, without its newline
+ *
+ * The line points into the reader's buffer and is valid until the next
+ * call. Lines longer than the buffer are skipped.
+ *
+ * @param len_out  Line length
+ * @param partial  Also return a last line that has no newline yet;
+ *                 otherwise it is left unconsumed for a later reopen
+ * @return         Line, or NULL at end of file
+ */
+const char *kp_linereader_next(kp_linereader_t *r, size_t *len_out, gboolean partial);
+
+/**
+ * File offset just past the last line returned
+ */
+off_t kp_linereader_offset(const kp_linereader_t *r);
+
+/**
+ * Close the file and free the buffer (safe on a closed reader)
+ */
+void kp_linereader_close(kp_linereader_t *r);
+
+#endif /* LINEREADER_H */
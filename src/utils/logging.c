@@ -80,13 +80,15 @@ kp_log_handler(const char *log_domain,
                gpointer G_GNUC_UNUSED user_data)
 {
     time_t curtime;
-    char *timestr;
+    char timestr[32];   /* ctime_r: startup logs from a worker thread too */
 
     /* Ignore unimportant messages (upstream logic) */
     if (log_level <= G_LOG_LEVEL_ERROR << kp_log_level) {
         curtime = time(NULL);
-        timestr = ctime(&curtime);
-        timestr[strlen(timestr) - 1] = '\0';  /* Remove trailing newline */
+        if (!ctime_r(&curtime, timestr))
+            timestr[0] = '\0';
+        else
+            timestr[strcspn(timestr, "\n")] = '\0';  /* Remove trailing newline */
 
         fprintf(stderr, "[%s] %s%s%s\n",
                 timestr,
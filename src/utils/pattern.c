@@ -27,6 +27,22 @@
  *   - Path-aware: * does NOT match directory separators (/)
  *   - Uses POSIX fnmatch() with FNM_PATHNAME flag
  *
+ * COMPILED MATCHERS:
+ *   Prefix rules become a byte trie stored as a flat node array (first
+ *   child / next sibling), so accepting a maps line is a single walk over
+ *   its path instead of strlen()+strncmp() per rule. Each terminal node
+ *   keeps the index of the earliest rule ending there; the earliest index
+ *   seen along the walk is the rule a linear scan would have hit first.
+ *   Short lists (PREFIX_LINEAR_MAX rules, like the default mapprefix,
+ *   whose first rule takes most lines) are cheaper to scan in order, so
+ *   they keep a strncmp() per rule with the lengths computed up front.
+ *
+ *   Globs are split by their literal prefix (text before the first
+ *   wildcard): globs without wildcards go into a hash table, the others
+ *   hang off a prefix trie, and only globs whose literal prefix matched
+ *   the path reach fnmatch(). Globs starting with a wildcard are always
+ *   tried.
+ *
  * BOUNDARY MATCHING:
  *   Directory prefix matching ensures proper boundaries:
  *   - "/opt" matches "/opt/app" ✓
@@ -148,3 +164,456 @@ kp_path_in_directories(const char *path, char **prefixes, int count)
 
     return FALSE;
 }
+
+/* ========================================================================
+ * BYTE TRIE (shared by prefix and glob sets)
+ * ======================================================================== */
+
+#define TRIE_NONE (-1)
+
+/* Build-time node: children as a singly linked sibling list */
+typedef struct {
+    gint32 first_child;     /* Index of first child node, TRIE_NONE if leaf */
+    gint32 next_sibling;    /* Index of next node with the same parent */
+    gint32 value;           /* Payload of a word ending here, TRIE_NONE if none */
+    guchar byte;            /* Edge label from parent */
+} trie_build_node_t;
+
+/* Frozen node: children are slots [first, first + count) */
+typedef struct {
+    gint32 first;           /* Slot of first child */
+    gint32 value;           /* Payload of a word ending here, TRIE_NONE if none */
+    gint32 below;           /* Smallest payload among descendants, G_MAXINT32 if none */
+    gint32 edge;            /* Offset of the edge bytes into this slot */
+    guint16 edge_len;       /* Length of the edge (>= 1 except at the root) */
+    guint16 count;          /* Number of children */
+} trie_slot_t;
+
+/*
+ * Lookup-time radix trie in breadth-first order. Chains of nodes with a
+ * single child and no payload collapse into one multi-byte edge, so
+ * "/usr/" is one step rather than five. labels[i] is the first byte of
+ * the edge into slot i; a node's child labels are contiguous, so picking
+ * the child is a short scan over adjacent bytes.
+ */
+typedef struct {
+    trie_slot_t *slots;     /* Slot 0 is the root */
+    guchar *labels;         /* First edge byte per slot */
+    guchar *edges;          /* Edge bytes of all slots */
+    guint n_slots;
+} trie_t;
+
+static GArray *
+trie_build_new(void)
+{
+    GArray *nodes = g_array_new(FALSE, FALSE, sizeof(trie_build_node_t));
+    trie_build_node_t root = { TRIE_NONE, TRIE_NONE, TRIE_NONE, 0 };
+
+    g_array_append_val(nodes, root);
+    return nodes;
+}
+
+#define BUILD_NODE(nodes, i) (&g_array_index((nodes), trie_build_node_t, (i)))
+
+/**
+ * Insert the first len bytes of word and return its terminal node
+ */
+static gint32
+trie_build_insert(GArray *nodes, const char *word, size_t len)
+{
+    gint32 node = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        guchar c = (guchar)word[i];
+        gint32 child;
+
+        for (child = BUILD_NODE(nodes, node)->first_child; child != TRIE_NONE;
+             child = BUILD_NODE(nodes, child)->next_sibling)
+            if (BUILD_NODE(nodes, child)->byte == c)
+                break;
+
+        if (child == TRIE_NONE) {
+            trie_build_node_t fresh = { TRIE_NONE, TRIE_NONE, TRIE_NONE, c };
+
+            fresh.next_sibling = BUILD_NODE(nodes, node)->first_child;
+            g_array_append_val(nodes, fresh);
+            child = (gint32)nodes->len - 1;
+            BUILD_NODE(nodes, node)->first_child = child;
+        }
+        node = child;
+    }
+
+    return node;
+}
+
+/**
+ * Convert a build trie to the breadth-first lookup layout (frees nodes)
+ */
+static void
+trie_freeze(trie_t *trie, GArray *nodes)
+{
+    guint n = nodes->len;
+    gint32 *order = g_new(gint32, n);   /* slot → build node at end of edge */
+    gint32 *parent = g_new(gint32, n);  /* slot → parent slot */
+    GString *edges = g_string_new(NULL);
+    guint head = 0, tail = 1;
+
+    trie->slots = g_new0(trie_slot_t, n);
+    trie->labels = g_new0(guchar, n);
+
+    order[0] = 0;
+    parent[0] = 0;
+
+    while (head < tail) {
+        guint slot = head++;
+        const trie_build_node_t *b = BUILD_NODE(nodes, order[slot]);
+        trie_slot_t *s = &trie->slots[slot];
+
+        s->first = (gint32)tail;
+        s->value = b->value;
+        s->below = G_MAXINT32;
+        s->count = 0;
+
+        for (gint32 child = b->first_child; child != TRIE_NONE;
+             child = BUILD_NODE(nodes, child)->next_sibling) {
+            trie_slot_t *c = &trie->slots[tail];
+            gint32 end = child;
+
+            c->edge = (gint32)edges->len;
+            g_string_append_c(edges, (gchar)BUILD_NODE(nodes, end)->byte);
+
+            /* Collapse the chain while it neither branches nor ends a word */
+            while (BUILD_NODE(nodes, end)->value == TRIE_NONE &&
+                   BUILD_NODE(nodes, end)->first_child != TRIE_NONE &&
+                   BUILD_NODE(nodes, BUILD_NODE(nodes, end)->first_child)->next_sibling == TRIE_NONE &&
+                   edges->len - c->edge < G_MAXUINT16) {
+                end = BUILD_NODE(nodes, end)->first_child;
+                g_string_append_c(edges, (gchar)BUILD_NODE(nodes, end)->byte);
+            }
+
+            c->edge_len = (guint16)(edges->len - c->edge);
+            trie->labels[tail] = BUILD_NODE(nodes, child)->byte;
+            parent[tail] = (gint32)slot;
+            order[tail++] = end;
+            s->count++;
+        }
+    }
+
+    trie->n_slots = tail;
+    trie->edges = (guchar *)g_string_free(edges, FALSE);
+
+    /* Children come after their parent, so one reverse pass fills "below" */
+    for (guint slot = tail; slot-- > 1; ) {
+        const trie_slot_t *s = &trie->slots[slot];
+        gint32 min = s->below;
+
+        if (s->value != TRIE_NONE && s->value < min)
+            min = s->value;
+        if (min < trie->slots[parent[slot]].below)
+            trie->slots[parent[slot]].below = min;
+    }
+
+    g_free(parent);
+    g_free(order);
+    g_array_free(nodes, TRUE);
+}
+
+static void
+trie_clear(trie_t *trie)
+{
+    g_free(trie->slots);
+    g_free(trie->labels);
+    g_free(trie->edges);
+    trie->slots = NULL;
+    trie->labels = NULL;
+    trie->edges = NULL;
+    trie->n_slots = 0;
+}
+
+/**
+ * Follow the edge out of slot node that *path starts with
+ *
+ * Advances *path past the edge. Edge bytes are never NUL, so a path
+ * shorter than the edge fails at its terminator.
+ */
+static inline gint32
+trie_step(const trie_t *trie, gint32 node, const char **path)
+{
+    const trie_slot_t *s = &trie->slots[node];
+    const guchar *label = trie->labels + s->first;
+    const guchar *p = (const guchar *)*path;
+
+    for (guint i = 0; i < s->count; i++) {
+        const trie_slot_t *child;
+        const guchar *edge;
+
+        if (label[i] != p[0])
+            continue;
+
+        child = &trie->slots[s->first + i];
+        edge = trie->edges + child->edge;
+        for (guint k = 1; k < child->edge_len; k++)
+            if (p[k] != edge[k])
+                return TRIE_NONE;
+
+        *path += child->edge_len;
+        return s->first + (gint32)i;
+    }
+
+    return TRIE_NONE;
+}
+
+/* ========================================================================
+ * PREFIX SETS
+ * ======================================================================== */
+
+/* Rule count up to which a linear scan beats the trie walk */
+#define PREFIX_LINEAR_MAX 4
+
+typedef struct {
+    char *prefix;           /* Without the leading '!' */
+    size_t len;
+    gboolean accept;
+} prefix_rule_t;
+
+struct _kp_prefix_set_t {
+    trie_t trie;            /* value = index of earliest rule ending here */
+    GArray *accept;         /* gboolean per rule index (trie only) */
+    GArray *linear;         /* prefix_rule_t in order, NULL if the trie is used */
+};
+
+/**
+ * Compile prefix rules
+ */
+kp_prefix_set_t *
+kp_prefix_set_new(char * const *rules)
+{
+    kp_prefix_set_t *set = g_new0(kp_prefix_set_t, 1);
+    GArray *nodes;
+    gint32 index = 0;
+
+    set->accept = g_array_new(FALSE, FALSE, sizeof(gboolean));
+
+    if (!rules || g_strv_length((gchar **)rules) <= PREFIX_LINEAR_MAX) {
+        set->linear = g_array_new(FALSE, FALSE, sizeof(prefix_rule_t));
+
+        for (; rules && *rules; rules++) {
+            const char *p = *rules;
+            prefix_rule_t rule;
+
+            rule.accept = *p != '!';
+            if (!rule.accept)
+                p++;
+            rule.prefix = g_strdup(p);
+            rule.len = strlen(p);
+            g_array_append_val(set->linear, rule);
+        }
+        return set;
+    }
+
+    nodes = trie_build_new();
+
+    for (; rules && *rules; rules++, index++) {
+        const char *p = *rules;
+        gboolean accept = TRUE;
+        gint32 node;
+
+        if (*p == '!') {
+            p++;
+            accept = FALSE;
+        }
+        g_array_append_val(set->accept, accept);
+
+        /* A later duplicate can never be reached by a linear scan */
+        node = trie_build_insert(nodes, p, strlen(p));
+        if (BUILD_NODE(nodes, node)->value == TRIE_NONE)
+            BUILD_NODE(nodes, node)->value = index;
+    }
+
+    trie_freeze(&set->trie, nodes);
+    return set;
+}
+
+/**
+ * Apply prefix rules to a path
+ */
+gboolean
+kp_prefix_set_accept(const kp_prefix_set_t *set, const char *path)
+{
+    const trie_t *trie;
+    gint32 node = 0;
+    gint32 best = G_MAXINT32;
+
+    if (!set || !path)
+        return TRUE;
+
+    if (set->linear) {
+        for (guint i = 0; i < set->linear->len; i++) {
+            const prefix_rule_t *rule = &g_array_index(set->linear, prefix_rule_t, i);
+
+            if (!strncmp(path, rule->prefix, rule->len))
+                return rule->accept;
+        }
+        return TRUE;
+    }
+
+    trie = &set->trie;
+    for (;;) {
+        const trie_slot_t *s = &trie->slots[node];
+
+        if (s->value != TRIE_NONE && s->value < best)
+            best = s->value;
+
+        /* No longer prefix can name an earlier rule */
+        if (best <= s->below || !*path)
+            break;
+
+        node = trie_step(trie, node, &path);
+        if (node == TRIE_NONE)
+            break;
+    }
+
+    return best == G_MAXINT32 ? TRUE : g_array_index(set->accept, gboolean, best);
+}
+
+/**
+ * Free compiled prefix rules
+ */
+void
+kp_prefix_set_free(kp_prefix_set_t *set)
+{
+    if (!set)
+        return;
+
+    if (set->linear) {
+        for (guint i = 0; i < set->linear->len; i++)
+            g_free(g_array_index(set->linear, prefix_rule_t, i).prefix);
+        g_array_free(set->linear, TRUE);
+    }
+    trie_clear(&set->trie);
+    g_array_free(set->accept, TRUE);
+    g_free(set);
+}
+
+/* ========================================================================
+ * GLOB SETS
+ * ======================================================================== */
+
+struct _kp_glob_set_t {
+    GHashTable *literals;   /* Patterns without wildcards (exact paths) */
+    trie_t trie;            /* Literal prefix → index into buckets */
+    GPtrArray *buckets;     /* GPtrArray* of patterns sharing a literal prefix */
+    GPtrArray *anywhere;    /* Patterns starting with a wildcard */
+};
+
+/* Length of the wildcard-free start of a glob */
+static size_t
+glob_literal_len(const char *pattern)
+{
+    return strcspn(pattern, "*?[\\");
+}
+
+/**
+ * Compile glob patterns
+ */
+kp_glob_set_t *
+kp_glob_set_new(char **patterns, int count)
+{
+    kp_glob_set_t *set = g_new0(kp_glob_set_t, 1);
+    GArray *nodes = trie_build_new();
+
+    set->literals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    set->buckets = g_ptr_array_new();
+    set->anywhere = g_ptr_array_new_with_free_func(g_free);
+
+    for (int i = 0; patterns && i < count; i++) {
+        const char *pattern = patterns[i];
+        size_t literal;
+        gint32 node;
+        GPtrArray *bucket;
+
+        if (!pattern || !*pattern)
+            continue;
+
+        literal = glob_literal_len(pattern);
+        if (!pattern[literal]) {
+            g_hash_table_replace(set->literals, g_strdup(pattern), GINT_TO_POINTER(1));
+            continue;
+        }
+        if (literal == 0) {
+            g_ptr_array_add(set->anywhere, g_strdup(pattern));
+            continue;
+        }
+
+        node = trie_build_insert(nodes, pattern, literal);
+        if (BUILD_NODE(nodes, node)->value == TRIE_NONE) {
+            BUILD_NODE(nodes, node)->value = (gint32)set->buckets->len;
+            g_ptr_array_add(set->buckets, g_ptr_array_new_with_free_func(g_free));
+        }
+        bucket = g_ptr_array_index(set->buckets, BUILD_NODE(nodes, node)->value);
+        g_ptr_array_add(bucket, g_strdup(pattern));
+    }
+
+    trie_freeze(&set->trie, nodes);
+    return set;
+}
+
+/* fnmatch() every pattern of a list */
+static gboolean
+glob_list_match(const GPtrArray *list, const char *path)
+{
+    for (guint i = 0; i < list->len; i++)
+        if (fnmatch(g_ptr_array_index(list, i), path, FNM_PATHNAME) == 0)
+            return TRUE;
+    return FALSE;
+}
+
+/**
+ * Check a path against compiled globs
+ */
+gboolean
+kp_glob_set_match(const kp_glob_set_t *set, const char *path)
+{
+    const trie_t *trie;
+    const char *p;
+    gint32 node = 0;
+
+    if (!set || !path)
+        return FALSE;
+
+    if (g_hash_table_size(set->literals) &&
+        g_hash_table_lookup(set->literals, path))
+        return TRUE;
+
+    /* Walk the literal prefixes the path starts with */
+    trie = &set->trie;
+    for (p = path; *p; ) {
+        node = trie_step(trie, node, &p);
+        if (node == TRIE_NONE)
+            break;
+        if (trie->slots[node].value != TRIE_NONE &&
+            glob_list_match(g_ptr_array_index(set->buckets,
+                                              trie->slots[node].value), path))
+            return TRUE;
+    }
+
+    return glob_list_match(set->anywhere, path);
+}
+
+/**
+ * Free compiled globs
+ */
+void
+kp_glob_set_free(kp_glob_set_t *set)
+{
+    if (!set)
+        return;
+
+    g_hash_table_destroy(set->literals);
+    trie_clear(&set->trie);
+    for (guint i = 0; i < set->buckets->len; i++)
+        g_ptr_array_free(g_ptr_array_index(set->buckets, i), TRUE);
+    g_ptr_array_free(set->buckets, TRUE);
+    g_ptr_array_free(set->anywhere, TRUE);
+    g_free(set);
+}
@@ -24,6 +24,17 @@
  *
  * Note: STAR represents * (asterisk wildcard)
  *
+ * COMPILED MATCHERS:
+ *   Rule lists that are checked on hot paths are compiled once at config
+ *   load instead of being re-scanned per call:
+ *   - kp_prefix_set_t: ordered "prefix" / "!prefix" rules (mapprefix,
+ *     exeprefix) as a byte trie; one walk over the path finds the first
+ *     matching rule. Lists of a few rules stay a linear scan, which is
+ *     cheaper when the first rule matches
+ *   - kp_glob_set_t: glob lists (excluded_patterns) as an exact-match hash
+ *     plus a trie over each glob's literal prefix; fnmatch() only runs for
+ *     globs whose literal prefix matched
+ *
  * =============================================================================
  */
 
@@ -64,4 +75,58 @@ gboolean kp_pattern_matches_any(const char *path, char **patterns, int count);
  */
 gboolean kp_path_in_directories(const char *path, char **prefixes, int count);
 
+/* Compiled ordered prefix rules (opaque) */
+typedef struct _kp_prefix_set_t kp_prefix_set_t;
+
+/* Compiled glob list (opaque) */
+typedef struct _kp_glob_set_t kp_glob_set_t;
+
+/**
+ * Compile prefix rules
+ *
+ * @param rules NULL-terminated rules; "!prefix" rejects, "prefix" accepts
+ * @return Compiled set (never NULL; an empty set accepts everything)
+ */
+kp_prefix_set_t *kp_prefix_set_new(char * const *rules);
+
+/**
+ * Apply prefix rules to a path
+ *
+ * Same result as scanning the rules in order and taking the first one
+ * that is a prefix of path: TRUE if it accepts, FALSE if it rejects,
+ * TRUE if none matches. Cost is one trie walk over the path, or one
+ * strncmp() per rule tried for short lists.
+ *
+ * @param set Compiled rules, or NULL (accept everything)
+ */
+gboolean kp_prefix_set_accept(const kp_prefix_set_t *set, const char *path);
+
+/**
+ * Free compiled prefix rules (NULL-safe)
+ */
+void kp_prefix_set_free(kp_prefix_set_t *set);
+
+/**
+ * Compile glob patterns
+ *
+ * @param patterns Patterns (fnmatch syntax, FNM_PATHNAME)
+ * @param count Number of patterns
+ * @return Compiled set (never NULL)
+ */
+kp_glob_set_t *kp_glob_set_new(char **patterns, int count);
+
+/**
+ * Check a path against compiled globs
+ *
+ * Same result as kp_pattern_matches_any() on the source patterns.
+ *
+ * @param set Compiled globs, or NULL (no match)
+ */
+gboolean kp_glob_set_match(const kp_glob_set_t *set, const char *path);
+
+/**
+ * Free compiled globs (NULL-safe)
+ */
+void kp_glob_set_free(kp_glob_set_t *set);
+
 #endif /* PATTERN_H */
@@ -0,0 +1,233 @@
+/* queue.c - Bounded single-producer queue for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Bounded Queue
+ * =============================================================================
+ *
+ * The stages of the worker pipeline (daemon/pipeline.c) hand work to each
+ * other through these queues. Each one is a ring of fixed size guarded by
+ * a mutex, with one condition variable for "not empty" and one for "not
+ * full". Being bounded is the point: a stage that falls behind makes its
+ * producer wait or drop work, instead of letting a backlog grow.
+ *
+ * MAIN LOOP CONSUMERS:
+ *   The main loop cannot block in a pop. kp_queue_watch() opens a pipe,
+ *   each push writes one byte to it, and a GIOChannel watch on the read
+ *   end pops everything available when the loop wakes up.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "queue.h"
+
+#if KP_HAVE_THREADS
+
+struct _kp_queue_t
+{
+    GMutex lock;
+    GCond not_empty;
+    GCond not_full;
+    gpointer *items;
+    guint capacity;
+    guint head;             /* Index of the oldest item */
+    guint len;
+
+    int wake[2];            /* Pipe for kp_queue_watch(), -1 if none */
+    guint watch_id;
+    kp_queue_func func;
+    gpointer user_data;
+};
+
+/**
+ * Create a queue
+ */
+kp_queue_t *
+kp_queue_new(guint capacity)
+{
+    kp_queue_t *q = g_new0(kp_queue_t, 1);
+
+    g_mutex_init(&q->lock);
+    g_cond_init(&q->not_empty);
+    g_cond_init(&q->not_full);
+    q->capacity = MAX(1, capacity);
+    q->items = g_new0(gpointer, q->capacity);
+    q->wake[0] = q->wake[1] = -1;
+    return q;
+}
+
+/* Append with the lock held and room available */
+static void
+queue_put(kp_queue_t *q, gpointer item)
+{
+    q->items[(q->head + q->len) % q->capacity] = item;
+    q->len++;
+    g_cond_signal(&q->not_empty);
+
+    if (q->wake[1] >= 0) {
+        char c = 0;
+        /* Non-blocking; a full pipe already means "wake up" */
+        if (write(q->wake[1], &c, 1) < 0) {
+            /* Nothing to do */
+        }
+    }
+}
+
+/* Remove with the lock held and an item available */
+static gpointer
+queue_take(kp_queue_t *q)
+{
+    gpointer item = q->items[q->head];
+
+    q->items[q->head] = NULL;
+    q->head = (q->head + 1) % q->capacity;
+    q->len--;
+    g_cond_signal(&q->not_full);
+    return item;
+}
+
+/**
+ * Append an item, waiting while the queue is full
+ */
+void
+kp_queue_push(kp_queue_t *q, gpointer item)
+{
+    g_mutex_lock(&q->lock);
+    while (q->len == q->capacity)
+        g_cond_wait(&q->not_full, &q->lock);
+    queue_put(q, item);
+    g_mutex_unlock(&q->lock);
+}
+
+/**
+ * Append an item if there is room
+ */
+gboolean
+kp_queue_try_push(kp_queue_t *q, gpointer item)
+{
+    gboolean queued = FALSE;
+
+    g_mutex_lock(&q->lock);
+    if (q->len < q->capacity) {
+        queue_put(q, item);
+        queued = TRUE;
+    }
+    g_mutex_unlock(&q->lock);
+    return queued;
+}
+
+/**
+ * Remove the oldest item, waiting while the queue is empty
+ */
+gpointer
+kp_queue_pop(kp_queue_t *q)
+{
+    gpointer item;
+
+    g_mutex_lock(&q->lock);
+    while (q->len == 0)
+        g_cond_wait(&q->not_empty, &q->lock);
+    item = queue_take(q);
+    g_mutex_unlock(&q->lock);
+    return item;
+}
+
+/**
+ * Remove the oldest item if there is one
+ */
+gpointer
+kp_queue_try_pop(kp_queue_t *q)
+{
+    gpointer item = NULL;
+
+    g_mutex_lock(&q->lock);
+    if (q->len > 0)
+        item = queue_take(q);
+    g_mutex_unlock(&q->lock);
+    return item;
+}
+
+/* Main loop side of kp_queue_watch() */
+static gboolean
+queue_wake_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    kp_queue_t *q = data;
+    char buf[64];
+    gpointer item;
+
+    (void)source;
+
+    if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+        q->watch_id = 0;
+        return FALSE;
+    }
+
+    while (read(q->wake[0], buf, sizeof(buf)) > 0)
+        ;
+
+    while ((item = kp_queue_try_pop(q)))
+        q->func(item, q->user_data);
+
+    return TRUE;
+}
+
+/**
+ * Deliver items to a handler on the main loop
+ */
+guint
+kp_queue_watch(kp_queue_t *q, kp_queue_func func, gpointer user_data)
+{
+    GIOChannel *channel;
+
+    g_return_val_if_fail(q && func && q->wake[0] < 0, 0);
+
+    if (pipe(q->wake) < 0) {
+        q->wake[0] = q->wake[1] = -1;
+        return 0;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(q->wake[i], F_SETFL, fcntl(q->wake[i], F_GETFL) | O_NONBLOCK);
+        fcntl(q->wake[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    q->func = func;
+    q->user_data = user_data;
+
+    channel = g_io_channel_unix_new(q->wake[0]);
+    q->watch_id = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                 queue_wake_callback, q);
+    g_io_channel_unref(channel);
+
+    return q->watch_id;
+}
+
+/**
+ * Free a queue
+ */
+void
+kp_queue_free(kp_queue_t *q)
+{
+    if (!q)
+        return;
+
+    if (q->watch_id)
+        g_source_remove(q->watch_id);
+    for (int i = 0; i < 2; i++)
+        if (q->wake[i] >= 0)
+            close(q->wake[i]);
+
+    g_cond_clear(&q->not_full);
+    g_cond_clear(&q->not_empty);
+    g_mutex_clear(&q->lock);
+    g_free(q->items);
+    g_free(q);
+}
+
+#endif /* KP_HAVE_THREADS */
@@ -0,0 +1,77 @@
+/* queue.h - Bounded single-producer queue for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <glib.h>
+
+/**
+ * kp_queue_t: Fixed-capacity FIFO between exactly two threads
+ *
+ * One thread pushes, one thread pops. A full queue is the producer's
+ * problem: it can wait (kp_queue_push) or drop the item (kp_queue_try_push).
+ * When the consumer is the main loop, kp_queue_watch() delivers items from
+ * a GLib source instead of a blocking pop.
+ *
+ * Needs GLib >= 2.32 (threads); see KP_HAVE_THREADS.
+ */
+typedef struct _kp_queue_t kp_queue_t;
+
+/* Item handler for kp_queue_watch() */
+typedef void (*kp_queue_func)(gpointer item, gpointer user_data);
+
+#define KP_HAVE_THREADS GLIB_CHECK_VERSION(2, 32, 0)
+
+/**
+ * Create a queue holding at most @capacity items
+ */
+kp_queue_t *kp_queue_new(guint capacity);
+
+/**
+ * Append an item, waiting while the queue is full
+ */
+void kp_queue_push(kp_queue_t *q, gpointer item);
+
+/**
+ * Append an item if there is room
+ *
+ * @return  FALSE if the queue is full (item not queued)
+ */
+gboolean kp_queue_try_push(kp_queue_t *q, gpointer item);
+
+/**
+ * Remove the oldest item, waiting while the queue is empty
+ */
+gpointer kp_queue_pop(kp_queue_t *q);
+
+/**
+ * Remove the oldest item if there is one
+ *
+ * @return  Item, or NULL if the queue is empty
+ */
+gpointer kp_queue_try_pop(kp_queue_t *q);
+
+/**
+ * Deliver items to a handler on the main loop
+ *
+ * The queue then wakes the main loop through a pipe on every push; the
+ * handler runs once per item, in order.
+ *
+ * @return  Source ID
+ */
+guint kp_queue_watch(kp_queue_t *q, kp_queue_func func, gpointer user_data);
+
+/**
+ * Free a queue (and its watch). Items still queued are not freed.
+ */
+void kp_queue_free(kp_queue_t *q);
+
+#endif /* QUEUE_H */
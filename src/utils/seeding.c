@@ -8,6 +8,25 @@
  * - Shell history (bash/zsh)
  *
  * Provides immediate value on first daemon start.
+ *
+ * =============================================================================
+ * EXECUTION MODEL
+ * =============================================================================
+ *
+ * Seeding runs as a low-priority idle task on the main loop, so the first
+ * scan and prediction never wait for it. Each idle call works on the current
+ * source for at most SEED_SLICE_US; the whole task stops collecting after
+ * SEED_BUDGET_US of work and merges what it has.
+ *
+ *   XBEL → DESKTOP_TIMES → HISTORY (bash, zsh) → RESOLVE → BROWSERS
+ *        → SYSTEM → MERGE
+ *
+ * Files are read through the streaming line reader in linereader.c (fixed
+ * buffer, resumable across slices). Results accumulate in a private table keyed by exe path;
+ * kp_state is touched once, in MERGE, which also waits for the desktop
+ * index (shell history only seeds apps that have a .desktop file).
+ *
+ * =============================================================================
  */
 
 #include "common.h"
@@ -22,271 +41,385 @@
 #include <unistd.h>
 #include <dirent.h>
 #include "desktop.h"
+#include "linereader.h"
 
-/* Seed from XDG recently-used files */
-static int
-kp_seed_from_xdg_recent(void)
+#define SEED_SLICE_US   5000        /* Work per idle callback */
+#define SEED_BUDGET_US  2000000     /* Total work before merging early */
+
+typedef enum {
+    SEED_XBEL,
+    SEED_DESKTOP_TIMES,
+    SEED_HISTORY,
+    SEED_RESOLVE,
+    SEED_BROWSERS,
+    SEED_SYSTEM,
+    SEED_MERGE,
+    SEED_SOURCES = SEED_MERGE       /* Number of collecting phases */
+} seed_phase_t;
+
+static const char *const phase_names[] = {
+    "XDG recently-used", "Desktop files", "Shell history", "Shell history",
+    "Browser profiles", "System defaults", "merge"
+};
+
+/* Accumulated seed for one executable */
+typedef struct {
+    double weighted_launches;
+    unsigned long raw_launches;
+    gboolean needs_desktop;     /* Only seed if it has a .desktop file */
+    seed_phase_t source;        /* First source that named it */
+} seed_entry_t;
+
+static struct {
+    guint source_id;
+    gboolean waiting;           /* Merge waits for the desktop index */
+    kp_seed_done_func done;
+    seed_phase_t phase;
+    gint64 started_us;          /* Wall clock at kp_seed_start() */
+    gint64 work_us;             /* Time spent in slices */
+    gboolean over_budget;
+
+    GHashTable *seeds;          /* exe path → seed_entry_t* */
+    GHashTable *executable;     /* path → GINT_TO_POINTER(1 + access(X_OK) == 0) */
+    int by_source[SEED_SOURCES];
+
+    /* Per-phase cursors */
+    kp_linereader_t reader;
+    int file_index;             /* History file / desktop dir index */
+    DIR *dir;
+    char *dir_path;             /* Path of dir */
+    GHashTable *cmd_counts;     /* History: command → count */
+    GHashTableIter cmd_iter;
+    gboolean cmd_iter_valid;
+} seed = { .reader = KP_LINEREADER_INIT };
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+/**
+ * access(X_OK) with a memo, since the same binaries recur across sources
+ */
+static gboolean
+is_executable(const char *path)
 {
-    const char *home = g_get_home_dir();
-    char xbel_path[PATH_MAX];
-    FILE *fp;
-    char line[2048];
-    int seeded = 0;
-    
-    /* XDG recently-used is at ~/.local/share/recently-used.xbel */
-    snprintf(xbel_path, sizeof(xbel_path), "%s/.local/share/recently-used.xbel", home);
-    fp = fopen(xbel_path, "r");
-    if (!fp) {
-        g_debug("XDG recently-used file not found: %s", xbel_path);
-        return 0;
+    gpointer cached = g_hash_table_lookup(seed.executable, path);
+    gboolean ok;
+
+    if (cached)
+        return GPOINTER_TO_INT(cached) == 2;
+
+    ok = access(path, X_OK) == 0;
+    g_hash_table_insert(seed.executable, g_strdup(path), GINT_TO_POINTER(ok ? 2 : 1));
+    return ok;
+}
+
+/**
+ * Find a bare command in /usr/bin or /bin (the historical seeding PATH)
+ */
+static gboolean
+resolve_command(const char *cmd, char *out, size_t size)
+{
+    snprintf(out, size, "/usr/bin/%s", cmd);
+    if (is_executable(out))
+        return TRUE;
+    snprintf(out, size, "/bin/%s", cmd);
+    return is_executable(out);
+}
+
+/**
+ * Record a seed contribution
+ */
+static void
+seed_add(const char *path, double weight, unsigned long launches,
+         seed_phase_t source, gboolean needs_desktop)
+{
+    seed_entry_t *entry = g_hash_table_lookup(seed.seeds, path);
+
+    if (!entry) {
+        entry = g_new0(seed_entry_t, 1);
+        entry->needs_desktop = TRUE;
+        entry->source = source;
+        g_hash_table_insert(seed.seeds, g_strdup(path), entry);
     }
-    
-    /* Simple line-by-line parser looking for application exec lines */
-    while (fgets(line, sizeof(line), fp)) {
-        char *exec_start = strstr(line, "exec=\"");
-        
-        if (exec_start) {
-            exec_start += 6;  /* Skip 'exec="' */
-            char *exec_end = strchr(exec_start, '"');
-            if (!exec_end) continue;
-            
-            char exec_line[PATH_MAX];
-            size_t len = exec_end - exec_start;
-            if (len >= sizeof(exec_line)) continue;
-            
-            strncpy(exec_line, exec_start, len);
-            exec_line[len] = '\0';
-            
-            /* Extract first word (the actual binary) */
-            char *app_path = strtok(exec_line, " ");
-            if (!app_path || app_path[0] != '/') continue;
-            
-            /* Check if file exists */
-            if (access(app_path, X_OK) != 0) continue;
-            
-            /* Calculate score based on recency */
-            double score = 5.0;  /* Base score for being in recently-used */
-            
-            /* Check if exe already exists */
-            kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, app_path);
-            if (!exe) {
-                exe = kp_exe_new(app_path, FALSE, NULL);
-                exe->pool = POOL_PRIORITY;  /* Recently used = priority */
-                kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-            }
-            
-            exe->weighted_launches += score;
-            exe->raw_launches += 1;
-            seeded++;
+
+    entry->weighted_launches += weight;
+    entry->raw_launches += launches;
+    if (!needs_desktop)
+        entry->needs_desktop = FALSE;
+
+    if (!needs_desktop)
+        seed.by_source[source]++;
+}
+
+/* Copy the first space-separated word of [start, end) */
+static gboolean
+first_word(const char *start, const char *end, char *out, size_t size)
+{
+    size_t len;
+
+    while (start < end && (*start == ' ' || *start == '\t'))
+        start++;
+    for (len = 0; start + len < end && start[len] != ' ' && start[len] != '\t' &&
+                  start[len] != '\n'; len++)
+        ;
+
+    if (len == 0 || len >= size)
+        return FALSE;
+
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return TRUE;
+}
+
+/**
+ * Command name of one shell history line
+ */
+gboolean
+kp_seed_history_command(const char *line, size_t len, char *cmd, size_t size)
+{
+    const char *cmd_start = line;
+
+    /* zsh extended history: ": <time>:<duration>;command" */
+    if (len > 2 && line[0] == ':' && line[1] == ' ') {
+        const char *semi = memchr(line, ';', len);
+        if (!semi)
+            return FALSE;
+        cmd_start = semi + 1;
+    }
+
+    if (!first_word(cmd_start, line + len, cmd, size) || cmd[0] == '#' ||
+        strchr(cmd, '/'))
+        return FALSE;
+
+    /* Skip common non-apps */
+    if (strcmp(cmd, "cd") == 0 || strcmp(cmd, "ls") == 0 ||
+        strcmp(cmd, "echo") == 0 || strcmp(cmd, "cat") == 0)
+        return FALSE;
+
+    return TRUE;
+}
+
+/* ========================================================================
+ * SOURCES
+ *
+ * Each step function does a bounded amount of work and returns TRUE once
+ * its source is exhausted.
+ * ======================================================================== */
+
+/* XDG recently-used: exec="..." attributes with an absolute binary */
+static gboolean
+step_xbel(gint64 deadline)
+{
+    const char *line;
+    size_t len;
+
+    if (seed.reader.fd < 0) {
+        char *path = g_build_filename(g_get_home_dir(), ".local/share/recently-used.xbel", NULL);
+        gboolean ok = kp_linereader_open(&seed.reader, path, 0);
+
+        if (!ok)
+            g_debug("XDG recently-used file not found: %s", path);
+        g_free(path);
+        if (!ok)
+            return TRUE;
+    }
+
+    while (g_get_monotonic_time() < deadline) {
+        const char *exec, *end;
+        char app_path[PATH_MAX];
+
+        line = kp_linereader_next(&seed.reader, &len, TRUE);
+        if (!line) {
+            kp_linereader_close(&seed.reader);
+            return TRUE;
         }
+
+        exec = g_strstr_len(line, (gssize)len, "exec=\"");
+        if (!exec)
+            continue;
+        exec += 6;
+        end = memchr(exec, '"', len - (size_t)(exec - line));
+        if (!end || !first_word(exec, end, app_path, sizeof(app_path)))
+            continue;
+        if (app_path[0] != '/' || !is_executable(app_path))
+            continue;
+
+        seed_add(app_path, 5.0, 1, SEED_XBEL, FALSE);  /* Base score for being recent */
     }
-    
-    fclose(fp);
-    g_debug("Seeded %d apps from XDG recently-used", seeded);
-    return seeded;
+
+    return FALSE;
 }
 
-/* Seed from desktop file modification times */
-static int
-kp_seed_from_desktop_times(void)
+/* Score one .desktop file by its mtime */
+static void
+seed_desktop_file(const char *desktop_path, time_t now)
+{
+    struct stat st;
+    char full_path[PATH_MAX];
+    char binary[PATH_MAX];
+    gboolean found = FALSE;
+    kp_linereader_t r = KP_LINEREADER_INIT;
+    const char *line;
+    size_t len;
+    double days_ago;
+
+    if (stat(desktop_path, &st) != 0)
+        return;
+
+    /* Skip very old files (> 180 days) */
+    days_ago = (double)(now - st.st_mtime) / 86400.0;
+    if (days_ago > 180)
+        return;
+
+    if (!kp_linereader_open(&r, desktop_path, 0))
+        return;
+    while ((line = kp_linereader_next(&r, &len, TRUE))) {
+        if (len > 5 && strncmp(line, "Exec=", 5) == 0) {
+            found = first_word(line + 5, line + len, binary, sizeof(binary));
+            break;
+        }
+    }
+    kp_linereader_close(&r);
+
+    if (!found)
+        return;
+
+    if (binary[0] == '/')
+        g_strlcpy(full_path, binary, sizeof(full_path));
+    else if (!resolve_command(binary, full_path, sizeof(full_path)))
+        return;
+
+    /* FILTER: Skip shell wrapper scripts (e.g., kali-menu's exec-in-shell) */
+    if (strstr(full_path, "exec-in-shell") ||
+        strstr(full_path, "/usr/share/kali-menu/") ||
+        strstr(full_path, "/usr/share/legion/"))
+        return;
+
+    /* Score with exponential decay: score = 3.0 * exp(-days/60) */
+    seed_add(full_path, 3.0 * exp(-days_ago / 60.0), 1, SEED_DESKTOP_TIMES, FALSE);
+}
+
+/* Desktop file modification times, one directory entry at a time */
+static gboolean
+step_desktop_times(gint64 deadline)
 {
-    const char *desktop_dirs[] = {
-        "/usr/share/applications",
-        "/usr/local/share/applications",
-        NULL
-    };
-    int seeded = 0;
     time_t now = time(NULL);
-    
-    /* Also check user's local applications */
-    const char *home = g_get_home_dir();
-    char user_apps[PATH_MAX];
-    snprintf(user_apps, sizeof(user_apps), "%s/.local/share/applications", home);
-    
-    for (int d = 0; d < 4; d++) {
-        const char *dir = (d < 2) ? desktop_dirs[d] : (d == 2 ? user_apps : NULL);
-        if (!dir) break;
-        
-        DIR *dp = opendir(dir);
-        if (!dp) continue;
-        
+
+    while (g_get_monotonic_time() < deadline) {
         struct dirent *entry;
-        while ((entry = readdir(dp))) {
-            if (!g_str_has_suffix(entry->d_name, ".desktop")) continue;
-            
-            char desktop_path[PATH_MAX];
-            struct stat st;
-            snprintf(desktop_path, sizeof(desktop_path), "%s/%s", dir, entry->d_name);
-            
-            if (stat(desktop_path, &st) != 0) continue;
-            
-            /* Calculate age in days */
-            double days_ago = (double)(now - st.st_mtime) / 86400.0;
-            
-            /* Skip very old files (> 180 days) */
-            if (days_ago > 180) continue;
-            
-            /* Score with exponential decay: score = 3.0 * exp(-days/60) */
-            double score = 3.0 * exp(-days_ago / 60.0);
-            
-            /* Parse desktop file to extract Exec= line */
-            FILE *desktop_fp = fopen(desktop_path, "r");
-            if (!desktop_fp) continue;
-            
-            char desktop_line[1024];
-            char *exec_value = NULL;
-            while (fgets(desktop_line, sizeof(desktop_line), desktop_fp)) {
-                /* Skip comments and empty lines */
-                if (desktop_line[0] == '#' || desktop_line[0] == '\n') continue;
-                
-                /* Look for Exec= line */
-                if (strncmp(desktop_line, "Exec=", 5) == 0) {
-                    exec_value = desktop_line + 5;
-                    /* Remove newline */
-                    char *newline = strchr(exec_value, '\n');
-                    if (newline) *newline = '\0';
-                    break;
-                }
-            }
-            fclose(desktop_fp);
-            
-            if (!exec_value) continue;
-            
-            /* Extract binary path (first word, handle field codes like %u, %f) */
-            char exec_copy[1024];
-            strncpy(exec_copy, exec_value, sizeof(exec_copy) - 1);
-            exec_copy[sizeof(exec_copy) - 1] = '\0';
-            
-            char *binary = strtok(exec_copy, " ");
-            if (!binary) continue;
-            
-            /* Resolve to full path if needed */
-            char full_path[PATH_MAX];
-            if (binary[0] == '/') {
-                /* Already absolute path */
-                strncpy(full_path, binary, sizeof(full_path) - 1);
-            } else {
-                /* Search in PATH */
-                snprintf(full_path, sizeof(full_path), "/usr/bin/%s", binary);
-                if (access(full_path, X_OK) != 0) {
-                    snprintf(full_path, sizeof(full_path), "/bin/%s", binary);
-                    if (access(full_path, X_OK) != 0) {
-                        continue;  /* Binary not found */
-                    }
-                }
-            }
-            
-            /* FILTER: Skip shell wrapper scripts (e.g., kali-menu's exec-in-shell) */
-            if (strstr(full_path, "exec-in-shell") ||
-                strstr(full_path, "/usr/share/kali-menu/") ||
-                strstr(full_path, "/usr/share/legion/")) {
-                continue;  /* Skip wrapper scripts, we want the actual app */
-            }
-            
-            /* Seed the app */
-            kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, full_path);
-            if (!exe) {
-                exe = kp_exe_new(full_path,FALSE, NULL);
-                exe->pool = POOL_PRIORITY;  /* Desktop apps = priority */
-                kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
+
+        if (!seed.dir) {
+            g_free(seed.dir_path);
+            switch (seed.file_index++) {
+            case 0: seed.dir_path = g_strdup("/usr/share/applications"); break;
+            case 1: seed.dir_path = g_strdup("/usr/local/share/applications"); break;
+            case 2: seed.dir_path = g_build_filename(g_get_home_dir(), ".local/share/applications", NULL); break;
+            default:
+                seed.dir_path = NULL;
+                seed.file_index = 0;
+                return TRUE;
             }
-            
-            exe->weighted_launches += score;
-            exe->raw_launches += 1;
-            seeded++;
+            seed.dir = opendir(seed.dir_path);
+            continue;
+        }
+
+        entry = readdir(seed.dir);
+        if (!entry) {
+            closedir(seed.dir);
+            seed.dir = NULL;
+            continue;
+        }
+
+        if (g_str_has_suffix(entry->d_name, ".desktop")) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", seed.dir_path, entry->d_name);
+            seed_desktop_file(path, now);
         }
-        closedir(dp);
     }
-    
-    g_debug("Seeded %d apps from desktop file times", seeded);
-    return seeded;
+
+    return FALSE;
 }
 
-/* Seed from shell history */
-static int
-kp_seed_from_shell_history(void)
+/* Shell history: count the first word of every command */
+static gboolean
+step_history(gint64 deadline)
 {
-    const char *home = g_get_home_dir();
-    const char *history_files[] = {
-        "/.bash_history",
-        "/.zsh_history",
-        NULL
-    };
-    GHashTable *cmd_counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-    int seeded = 0;
-    
-    for (int i = 0; history_files[i]; i++) {
-        char history_path[PATH_MAX];
-        FILE *fp;
-        char line[1024];
-        
-        snprintf(history_path, sizeof(history_path), "%s%s", home, history_files[i]);
-        fp = fopen(history_path, "r");
-        if (!fp) continue;
-        
-        while (fgets(line, sizeof(line), fp)) {
-            char *cmd = strtok(line, " \t\n");
-            if (!cmd || cmd[0] == '#') continue;
-            
-            /* Skip common non-apps */
-            if (strcmp(cmd, "cd") == 0 || strcmp(cmd, "ls") == 0 ||
-                strcmp(cmd, "echo") == 0 || strcmp(cmd, "cat") == 0)
-                continue;
-            
-            /* Count frequency */
-            gpointer count = g_hash_table_lookup(cmd_counts, cmd);
-            g_hash_table_insert(cmd_counts,  g_strdup(cmd),
-                                GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
+    static const char *const history_files[] = { ".bash_history", ".zsh_history" };
+    const char *line;
+    size_t len;
+
+    while (g_get_monotonic_time() < deadline) {
+        char cmd[256];
+        gpointer count;
+
+        if (seed.reader.fd < 0) {
+            char *path;
+
+            if (seed.file_index >= (int)G_N_ELEMENTS(history_files)) {
+                seed.file_index = 0;
+                return TRUE;
+            }
+            path = g_build_filename(g_get_home_dir(), history_files[seed.file_index++], NULL);
+            kp_linereader_open(&seed.reader, path, 0);
+            g_free(path);
+            continue;
         }
-        fclose(fp);
+
+        line = kp_linereader_next(&seed.reader, &len, TRUE);
+        if (!line) {
+            kp_linereader_close(&seed.reader);
+            continue;
+        }
+
+        if (!kp_seed_history_command(line, len, cmd, sizeof(cmd)))
+            continue;
+
+        /* Count frequency */
+        count = g_hash_table_lookup(seed.cmd_counts, cmd);
+        if (count)
+            g_hash_table_replace(seed.cmd_counts, g_strdup(cmd),
+                                 GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
+        else
+            g_hash_table_insert(seed.cmd_counts, g_strdup(cmd), GINT_TO_POINTER(1));
     }
-    
-    /* Convert counts to state entries */
-    GHashTableIter iter;
+
+    return FALSE;
+}
+
+/* Resolve counted history commands to binaries */
+static gboolean
+step_resolve(gint64 deadline)
+{
     gpointer key, value;
-    g_hash_table_iter_init(&iter, cmd_counts);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        const char *cmd = key;
-        int count = GPOINTER_TO_INT(value);
+
+    if (!seed.cmd_iter_valid) {
+        g_hash_table_iter_init(&seed.cmd_iter, seed.cmd_counts);
+        seed.cmd_iter_valid = TRUE;
+    }
+
+    while (g_get_monotonic_time() < deadline) {
         char full_path[PATH_MAX];
-        kp_exe_t *exe;
-        
-        /* Try to resolve command to full path */
-        snprintf(full_path, sizeof(full_path), "/usr/bin/%s", cmd);
-        if (access(full_path, X_OK) != 0) {
-            snprintf(full_path, sizeof(full_path), "/bin/%s", cmd);
-            if (access(full_path, X_OK) != 0) {
-                continue;  /* Can't find executable */
-            }
-        }
-        
-        /* Check if exe already exists */
-        exe = g_hash_table_lookup(kp_state->exes, full_path);
-        if (!exe) {
-            /* FILTER: Only seed apps with .desktop files (skip CLI tools) */
-            if (!kp_desktop_has_file(full_path)) {
-                continue;  /* Skip CLI tools like grep, ls, exec-in-shell */
-            }
-            exe = kp_exe_new(full_path, FALSE, NULL);
-            exe->pool = POOL_PRIORITY;  /* Desktop apps are us  er-initiated */
-            kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-        }
-        
-        /* Score: sqrt to prevent domination by very frequent commands */
-        /* BUG FIX: Use += to accumulate, not = which clobbers prior seeding */
-        exe->weighted_launches += sqrt((double)count);
-        exe->raw_launches += count;
-        seeded++;
+        int count;
+
+        if (!g_hash_table_iter_next(&seed.cmd_iter, &key, &value))
+            return TRUE;
+
+        count = GPOINTER_TO_INT(value);
+        if (!resolve_command(key, full_path, sizeof(full_path)))
+            continue;  /* Can't find executable */
+
+        /* Score: sqrt to prevent domination by very frequent commands.
+         * FILTER at merge: only apps with .desktop files (skip CLI tools) */
+        seed_add(full_path, sqrt((double)count), (unsigned long)count, SEED_HISTORY, TRUE);
     }
-    
-    g_hash_table_destroy(cmd_counts);
-    g_debug("Seeded %d apps from shell history", seeded);
-    return seeded;
+
+    return FALSE;
 }
 
-/* Seed from browser profile detection */
-static int
-kp_seed_from_browser_profiles(void)
+/* Browser profiles used within the last 30 days */
+static gboolean
+step_browsers(gint64 deadline)
 {
     const char *home = g_get_home_dir();
     struct {
@@ -299,223 +432,294 @@ kp_seed_from_browser_profiles(void)
         {".config/chromium", "/usr/bin/chromium", "Chromium"},
         {".config/microsoft-edge", "/usr/bin/microsoft-edge", "Edge"},
         {".config/BraveSoftware/Brave-Browser", "/usr/bin/brave", "Brave"},
-        {NULL, NULL, NULL}
     };
-    int seeded = 0;
     time_t now = time(NULL);
-    
-    for (int i = 0; browsers[i].profile_path; i++) {
+
+    (void)deadline;     /* Five stat() calls: one slice */
+
+    for (unsigned i = 0; i < G_N_ELEMENTS(browsers); i++) {
         char profile_full[PATH_MAX];
         struct stat st;
-        
+        double days_ago, score;
+
         snprintf(profile_full, sizeof(profile_full), "%s/%s", home, browsers[i].profile_path);
-        
+
         /* Check if profile directory exists and was accessed recently */
-        if (stat(profile_full, &st) == 0 && S_ISDIR(st.st_mode)) {
-            double days_ago = (double)(now - st.st_mtime) / 86400.0;
-            
-            /* Only seed if used within last 30 days */
-            if (days_ago <= 30) {
-                /* Check if browser binary exists */
-                if (access(browsers[i].binary_path, X_OK) == 0) {
-                    kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, browsers[i].binary_path);
-                    if (!exe) {
-                        exe = kp_exe_new(browsers[i].binary_path, FALSE, NULL);
-                        exe->pool = POOL_PRIORITY;
-                        kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                    }
-                    
-                    /* Score based on recency: 10.0 * exp(-days/15) */
-                    double score = 10.0 * exp(-days_ago / 15.0);
-                    exe->weighted_launches += score;
-                    exe->raw_launches += 1;
-                    seeded++;
-                    
-                    g_debug("Seeded browser: %s (profile age: %.1f days, score: %.2f)", 
-                           browsers[i].name, days_ago, score);
-                }
-            }
-        }
+        if (stat(profile_full, &st) != 0 || !S_ISDIR(st.st_mode))
+            continue;
+        days_ago = (double)(now - st.st_mtime) / 86400.0;
+        if (days_ago > 30 || !is_executable(browsers[i].binary_path))
+            continue;
+
+        /* Score based on recency: 10.0 * exp(-days/15) */
+        score = 10.0 * exp(-days_ago / 15.0);
+        seed_add(browsers[i].binary_path, score, 1, SEED_BROWSERS, FALSE);
+
+        g_debug("Seeded browser: %s (profile age: %.1f days, score: %.2f)",
+               browsers[i].name, days_ago, score);
     }
-    
-    g_debug("Seeded %d browsers from profile detection", seeded);
-    return seeded;
+
+    return TRUE;
 }
 
-/* Seed common developer tools
- * NOTE: Currently disabled - most dev tools are CLI without .desktop files */
-static int __attribute__((unused))
-kp_seed_from_dev_tools(void)
+/* Default apps of the running desktop environment */
+static gboolean
+step_system(gint64 deadline)
 {
-    const char *dev_tools[] = {
-        "/usr/bin/vim", "/usr/bin/nvim", "/usr/bin/emacs",
-        "/usr/bin/git", "/usr/bin/make", "/usr/bin/gcc",
-        "/usr/bin/python3", "/usr/bin/node", "/usr/bin/npm",
-        "/usr/bin/docker", "/usr/bin/code", "/usr/bin/code-insiders",
+    static const char *const gnome_apps[] = {
+        "/usr/bin/nautilus",      /* File manager */
+        "/usr/bin/gnome-terminal", /* Terminal */
+        "/usr/bin/gnome-control-center", /* Settings */
         NULL
     };
-    int seeded = 0;
-    struct stat st;
-    time_t now = time(NULL);
-    
-    for (int i = 0; dev_tools[i]; i++) {
-        /* Check if tool exists and was accessed recently */
-        if (stat(dev_tools[i], &st) == 0) {
-            double days_ago = (double)(now - st.st_atime) / 86400.0;
-            
-            /* Only seed if accessed within last 60 days */
-            if (days_ago <= 60) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, dev_tools[i]);
-                if (!exe) {
-                    exe = kp_exe_new(dev_tools[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                
-                /* Fixed score for dev tools */
-                double score = 4.0;
-                exe->weighted_launches += score;
-                exe->raw_launches += 1;
-                seeded++;
-            }
-        }
-    }
-    
-    g_debug("Seeded %d developer tools", seeded);
-    return seeded;
+    static const char *const kde_apps[] = {
+        "/usr/bin/dolphin",       /* File manager */
+        "/usr/bin/konsole",       /* Terminal */
+        "/usr/bin/systemsettings", /* Settings */
+        NULL
+    };
+    static const char *const xfce_apps[] = {
+        "/usr/bin/thunar",        /* File manager */
+        "/usr/bin/xfce4-terminal", /* Terminal */
+        NULL
+    };
+    const char *desktop = g_getenv("XDG_CURRENT_DESKTOP");
+    const char *session = g_getenv("DESKTOP_SESSION");
+    const char *const *sets[3] = { NULL, NULL, NULL };
+
+    /* Detect desktop environment */
+    const char *de = desktop ? desktop : (session ? session : "unknown");
+    g_debug("Detected desktop environment: %s", de);
+
+    (void)deadline;
+
+    if (strstr(de, "GNOME") || strstr(de, "gnome"))
+        sets[0] = gnome_apps;
+    if (strstr(de, "KDE") || strstr(de, "kde") || strstr(de, "plasma"))
+        sets[1] = kde_apps;
+    if (strstr(de, "XFCE") || strstr(de, "xfce"))
+        sets[2] = xfce_apps;
+
+    for (int s = 0; s < 3; s++)
+        for (int i = 0; sets[s] && sets[s][i]; i++)
+            if (is_executable(sets[s][i]))
+                seed_add(sets[s][i], 3.0, 1, SEED_SYSTEM, FALSE);
+
+    return TRUE;
 }
 
+/* ========================================================================
+ * MERGE AND DRIVER
+ * ======================================================================== */
+
 /**
- * Seed initial state from all available sources
+ * Apply all collected seeds to kp_state in one pass
  */
-static int kp_seed_from_system_patterns(void);
-
-void
-kp_seed_from_sources(void)
+static int
+seed_merge(void)
 {
-    int total_seeded = 0;
-    int by_source[6] = {0};
-    
-    g_message("=== Smart First-Run Seeding ===");
-    g_message("Analyzing user data to populate initial state...");
-    
-    by_source[0] = kp_seed_from_xdg_recent();
-    by_source[1] = kp_seed_from_desktop_times();
-    by_source[2] = kp_seed_from_shell_history();
-    by_source[3] = kp_seed_from_browser_profiles();
-    /* Disabled: dev_tools are mostly CLI without .desktop files */
-    by_source[4] = 0;  /* kp_seed_from_dev_tools(); */
-    by_source[5] = kp_seed_from_system_patterns();
-    
-    for (int i = 0; i < 6; i++) {
-        total_seeded += by_source[i];
+    GHashTableIter iter;
+    gpointer key, value;
+    int merged = 0;
+
+    if (!kp_state->exes)
+        return 0;
+
+    g_hash_table_iter_init(&iter, seed.seeds);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const char *path = key;
+        const seed_entry_t *entry = value;
+        kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, path);
+
+        if (!exe) {
+            if (entry->needs_desktop && !kp_desktop_has_file(path))
+                continue;  /* Skip CLI tools like grep, ls, exec-in-shell */
+            exe = kp_exe_new(path, FALSE, NULL);
+            exe->pool = POOL_PRIORITY;  /* Seeded apps are user-initiated */
+            kp_state_register_exe(exe, TRUE);
+        }
+
+        if (entry->needs_desktop)
+            seed.by_source[SEED_HISTORY]++;
+
+        /* Accumulate: a running scan may already have registered the exe */
+        exe->weighted_launches += entry->weighted_launches;
+        exe->raw_launches += entry->raw_launches;
+        merged++;
     }
-    
-    if (total_seeded > 0) {
-        g_message("Successfully seeded %d applications:", total_seeded);
-        g_message("  • XDG recently-used: %d apps", by_source[0]);
-        g_message("  • Desktop files: %d apps", by_source[1]);
-        g_message("  • Shell history: %d apps", by_source[2]);
-        g_message("  • Browser profiles: %d apps", by_source[3]);
-        g_message("  • Developer tools: %d apps", by_source[4]);
-        g_message("  • System defaults: %d apps", by_source[5]);
+
+    if (merged > 0)
+        kp_state->dirty = TRUE;
+
+    return merged;
+}
+
+/* Free per-run resources */
+static void
+seed_cleanup(void)
+{
+    kp_linereader_close(&seed.reader);
+    if (seed.dir)
+        closedir(seed.dir);
+    seed.dir = NULL;
+    g_free(seed.dir_path);
+    seed.dir_path = NULL;
+    if (seed.seeds)
+        g_hash_table_destroy(seed.seeds);
+    if (seed.executable)
+        g_hash_table_destroy(seed.executable);
+    if (seed.cmd_counts)
+        g_hash_table_destroy(seed.cmd_counts);
+    seed.seeds = seed.executable = seed.cmd_counts = NULL;
+    seed.cmd_iter_valid = FALSE;
+}
+
+/* Merge and report */
+static void
+seed_finish(void)
+{
+    int merged = seed_merge();
+    gint64 wall_ms = (g_get_monotonic_time() - seed.started_us) / 1000;
+
+    if (merged > 0 && seed.done)
+        seed.done();
+
+    if (merged > 0) {
+        g_message("Successfully seeded %d applications in %" G_GINT64_FORMAT
+                  " ms (%" G_GINT64_FORMAT " ms of work)%s:",
+                  merged, wall_ms, seed.work_us / 1000,
+                  seed.over_budget ? ", time budget reached" : "");
+        g_message("  • XDG recently-used: %d apps", seed.by_source[SEED_XBEL]);
+        g_message("  • Desktop files: %d apps", seed.by_source[SEED_DESKTOP_TIMES]);
+        g_message("  • Shell history: %d apps", seed.by_source[SEED_HISTORY]);
+        g_message("  • Browser profiles: %d apps", seed.by_source[SEED_BROWSERS]);
+        g_message("  • System defaults: %d apps", seed.by_source[SEED_SYSTEM]);
         g_message("Preheat is now ready with intelligent defaults!");
     } else {
         g_message("No seeding data available - will learn from your usage");
     }
     g_message("===============================");
+
+    seed_cleanup();
 }
 
-/* Seed system-specific default apps based on desktop environment */
-static int
-kp_seed_from_system_patterns(void)
+static gboolean seed_step(gpointer data);
+
+/* Desktop index built: run the merge */
+static void
+seed_resume(void)
 {
-    const char *desktop = g_getenv("XDG_CURRENT_DESKTOP");
-    const char *session = g_getenv("DESKTOP_SESSION");
-    int seeded = 0;
-    
-    /* Detect desktop environment */
-    const char *de = desktop ? desktop : (session ? session : "unknown");
-    g_debug("Detected desktop environment: %s", de);
-    
-    /* GNOME defaults */
-    if (strstr(de, "GNOME") || strstr(de, "gnome")) {
-        const char *gnome_apps[] = {
-            "/usr/bin/nautilus",      /* File manager */
-            "/usr/bin/gnome-terminal", /* Terminal */
-            "/usr/bin/gnome-control-center", /* Settings */
-            NULL
-        };
-        
-        for (int i = 0; gnome_apps[i]; i++) {
-            if (access(gnome_apps[i], X_OK) == 0) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, gnome_apps[i]);
-                if (!exe) {
-                    exe = kp_exe_new(gnome_apps[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                /* BUG FIX: Use += to accumulate, not = which clobbers prior data */
-                exe->weighted_launches += 3.0;
-                exe->raw_launches += 1;
-                seeded++;
-            }
-        }
-    }
-    
-    /* KDE defaults */
-    if (strstr(de, "KDE") || strstr(de, "kde") || strstr(de, "plasma")) {
-        const char *kde_apps[] = {
-            "/usr/bin/dolphin",       /* File manager */
-            "/usr/bin/konsole",       /* Terminal */
-            "/usr/bin/systemsettings", /* Settings */
-            NULL
-        };
-        
-        for (int i = 0; kde_apps[i]; i++) {
-            if (access(kde_apps[i], X_OK) == 0) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, kde_apps[i]);
-                if (!exe) {
-                    exe = kp_exe_new(kde_apps[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                /* BUG FIX: Use += to accumulate */
-                exe->weighted_launches += 3.0;
-                exe->raw_launches += 1;
-                seeded++;
-            }
+    seed.waiting = FALSE;
+    seed.source_id = g_idle_add_full(G_PRIORITY_LOW, seed_step, NULL, NULL);
+}
+
+/**
+ * Idle callback: one time slice of seeding
+ */
+static gboolean
+seed_step(gpointer data)
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 deadline = start + SEED_SLICE_US;
+    gboolean done = FALSE;
+
+    (void)data;
+
+    switch (seed.phase) {
+    case SEED_XBEL:          done = step_xbel(deadline); break;
+    case SEED_DESKTOP_TIMES: done = step_desktop_times(deadline); break;
+    case SEED_HISTORY:       done = step_history(deadline); break;
+    case SEED_RESOLVE:       done = step_resolve(deadline); break;
+    case SEED_BROWSERS:      done = step_browsers(deadline); break;
+    case SEED_SYSTEM:        done = step_system(deadline); break;
+    case SEED_MERGE:
+        /* History seeds are filtered on the desktop index: sleep until
+         * it is built rather than polling every slice */
+        if (!kp_desktop_ready()) {
+            seed.source_id = 0;
+            seed.waiting = TRUE;
+            kp_desktop_on_ready(seed_resume);
+            return FALSE;
         }
+        seed.source_id = 0;
+        seed_finish();
+        return FALSE;
     }
-    
-    /* XFCE defaults */
-    if (strstr(de, "XFCE") || strstr(de, "xfce")) {
-        const char *xfce_apps[] = {
-            "/usr/bin/thunar",        /* File manager */
-            "/usr/bin/xfce4-terminal", /* Terminal */
-            NULL
-        };
-        
-        for (int i = 0; xfce_apps[i]; i++) {
-            if (access(xfce_apps[i], X_OK) == 0) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, xfce_apps[i]);
-                if (!exe) {
-                    exe = kp_exe_new(xfce_apps[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                /* BUG FIX: Use += to accumulate */
-                exe->weighted_launches += 3.0;
-                exe->raw_launches += 1;
-                seeded++;
-            }
-        }
+
+    seed.work_us += g_get_monotonic_time() - start;
+
+    /* Out of budget: stop reading, but still resolve the history counted
+     * so far (one lookup per distinct command) */
+    if (!done && seed.phase != SEED_RESOLVE && seed.work_us >= SEED_BUDGET_US) {
+        g_message("Seeding time budget spent in %s, merging what was found",
+                  phase_names[seed.phase]);
+        seed.over_budget = TRUE;
+        kp_linereader_close(&seed.reader);
+        if (seed.dir)
+            closedir(seed.dir);
+        seed.dir = NULL;
+        seed.phase = seed.phase < SEED_RESOLVE ? SEED_RESOLVE : SEED_MERGE;
+    } else if (done) {
+        seed.phase = seed.over_budget ? SEED_MERGE : seed.phase + 1;
     }
-    
-    g_debug("Seeded %d system-specific apps for %s", seeded, de);
-    return seeded;
+
+    return TRUE;
+}
+
+/**
+ * Start first-run seeding in the background
+ */
+void
+kp_seed_start(void)
+{
+    if (seed.source_id || seed.waiting)
+        return;
+
+    g_message("=== Smart First-Run Seeding ===");
+    g_message("Analyzing user data in the background to populate initial state...");
+
+    memset(seed.by_source, 0, sizeof(seed.by_source));
+    seed.phase = SEED_XBEL;
+    seed.file_index = 0;
+    seed.work_us = 0;
+    seed.over_budget = FALSE;
+    seed.started_us = g_get_monotonic_time();
+    seed.seeds = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    seed.executable = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    seed.cmd_counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    seed.source_id = g_idle_add_full(G_PRIORITY_LOW, seed_step, NULL, NULL);
 }
 
+/**
+ * Stop seeding, merging whatever was collected
+ */
+void
+kp_seed_stop(void)
+{
+    if (!seed.source_id && !seed.waiting)
+        return;
+
+    if (seed.source_id)
+        g_source_remove(seed.source_id);
+    seed.source_id = 0;
+    if (seed.waiting)
+        kp_desktop_on_ready(NULL);
+    seed.waiting = FALSE;
+    kp_desktop_complete();
+    g_message("Seeding interrupted in %s, merging what was found",
+              phase_names[seed.phase]);
+    seed_finish();
+}
+
+/**
+ * Set the callback run after a merge
+ */
+void
+kp_seed_set_done(kp_seed_done_func func)
+{
+    seed.done = func;
+}
 
 /* Calculate confidence score for seeded app (0.0 to 1.0)
  * NOTE: Currently unused but reserved for future filtering/prioritization
@@ -11,10 +11,48 @@
 #ifndef SEEDING_H
 #define SEEDING_H
 
+#include <glib.h>
+
 /**
- * Seed initial state from user data sources
- * Called on first run when state file is missing or empty
+ * Called after seeds were merged into kp_state
+ */
+typedef void (*kp_seed_done_func)(void);
+
+/**
+ * Start seeding initial state from user data sources
+ *
+ * Called on first run when the state file is missing or empty. Sources
+ * are read by a low-priority idle task in short time slices and merged
+ * into kp_state in one batch when done, so the first scan and prediction
+ * cycle run without waiting.
+ */
+void kp_seed_start(void);
+
+/**
+ * Stop a running seed task, merging what it has collected
+ *
+ * Called at shutdown before the final state save. No-op if not running.
+ */
+void kp_seed_stop(void);
+
+/**
+ * Set the callback run after a merge (pool reclassification of the
+ * seeded apps, which used to happen at startup)
+ */
+void kp_seed_set_done(kp_seed_done_func func);
+
+/**
+ * Extract the command name of one shell history line
+ *
+ * Handles zsh extended history (": <time>:<duration>;command"). Comments,
+ * paths and trivial builtins (cd, ls, echo, cat) are rejected.
+ *
+ * @param line  History line (not NUL-terminated)
+ * @param len   Line length
+ * @param cmd   Output buffer for the command name
+ * @param size  Size of cmd
+ * @return      TRUE if cmd was filled
  */
-void kp_seed_from_sources(void);
+gboolean kp_seed_history_command(const char *line, size_t len, char *cmd, size_t size);
 
 #endif /* SEEDING_H */
@@ -0,0 +1,671 @@
+/* ctl_cmd_bench.c - Cold-start launch benchmark
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Commands: bench
+ *
+ * Measures what preheat saves for one application on this machine:
+ *
+ *   1. The app's file set is collected from the state file (its maps and
+ *      resolved library closure) and from an untimed discovery run that
+ *      samples /proc/PID/maps of the app and its children.
+ *   2. Each iteration launches the app twice: cold, after dropping the
+ *      set from the page cache with posix_fadvise(DONTNEED), and warm,
+ *      after dropping it and reading it back with readahead() as the
+ *      daemon does.
+ *   3. A launch ends at the ready probe: the app exiting, or with
+ *      --timeout for GUI apps that stay open, the last major fault of
+ *      the main process within the window (the app is then terminated).
+ *      Major faults and block input come from wait4() rusage.
+ *
+ * Median and p95 of both series are reported with the speedup. The
+ * daemon is paused for the run (and resumed after) so it does not warm
+ * the cold launches itself.
+ */
+
+#define _GNU_SOURCE  /* For readahead() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <glib.h>
+
+#include "ctl_commands.h"
+#include "ctl_daemon.h"
+#include "ctl_state.h"
+
+/* File paths */
+#define STATEFILE "/usr/local/var/lib/preheat/preheat.state"
+#define STATEFILE_ALT "/var/lib/preheat/preheat.state"
+#define PAUSEFILE "/run/preheat.pause"
+
+#define SAMPLE_US       10000   /* Maps and fault sampling interval */
+#define KILL_GRACE_US   2000000 /* SIGTERM to SIGKILL */
+
+/* One file of the set; no regions means the whole file */
+typedef struct {
+    char *path;
+    GArray *regions;        /* region_t */
+} bench_file_t;
+
+typedef struct {
+    guint64 offset;
+    guint64 length;
+} region_t;
+
+/* One measured launch */
+typedef struct {
+    double wall_ms;
+    long majflt;
+    long inblock_kb;
+} launch_t;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void
+on_interrupt(int sig)
+{
+    (void)sig;
+    interrupted = 1;
+}
+
+static double
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void
+file_free(bench_file_t *f)
+{
+    g_free(f->path);
+    g_array_free(f->regions, TRUE);
+    g_free(f);
+}
+
+/**
+ * Add a file (and optionally a region of it) to the set
+ */
+static void
+set_add(GHashTable *set, const char *path, guint64 offset, guint64 length)
+{
+    bench_file_t *f = g_hash_table_lookup(set, path);
+
+    if (!f) {
+        f = g_new0(bench_file_t, 1);
+        f->path = g_strdup(path);
+        f->regions = g_array_new(FALSE, FALSE, sizeof(region_t));
+        g_hash_table_insert(set, f->path, f);
+    }
+
+    if (length) {
+        region_t r = { offset, length };
+        for (guint i = 0; i < f->regions->len; i++) {
+            region_t *o = &g_array_index(f->regions, region_t, i);
+            if (o->offset == offset && o->length == length)
+                return;
+        }
+        g_array_append_val(f->regions, r);
+    }
+}
+
+/* ========================================================================
+ * FILE SET
+ * ======================================================================== */
+
+/**
+ * Add the app's maps and library closure from the daemon's state file
+ *
+ * @return Files added, or -1 if the state file can't be read
+ */
+static int
+set_from_state(GHashTable *set, const char *app_path)
+{
+    FILE *f;
+    GHashTable *maps;       /* seq → "offset\tlength\tpath" line fields */
+    GPtrArray *exemaps;     /* map seqs of the app, as strings */
+    char line[4096];
+    char *exe_seq = NULL;
+    gboolean in_closure = FALSE;
+    guint before = g_hash_table_size(set);
+
+    f = fopen(STATEFILE, "r");
+    if (!f)
+        f = fopen(STATEFILE_ALT, "r");
+    if (!f)
+        return -1;
+
+    maps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_strfreev);
+    exemaps = g_ptr_array_new_with_free_func(g_free);
+
+    while (fgets(line, sizeof(line), f)) {
+        char **fields;
+        guint n;
+
+        line[strcspn(line, "\n")] = '\0';
+        fields = g_strsplit(line[0] == ' ' ? g_strchug(line) : line, "\t", -1);
+        n = g_strv_length(fields);
+
+        if (!strcmp(fields[0], "MAP") && n >= 7) {
+            g_hash_table_insert(maps, g_strdup(fields[1]), fields);
+            continue;
+        } else if (!strcmp(fields[0], "EXE") && n >= 3 && !exe_seq) {
+            char *path = g_filename_from_uri(fields[n - 1], NULL, NULL);
+            if (path && !strcmp(path, app_path))
+                exe_seq = g_strdup(fields[1]);
+            g_free(path);
+        } else if (!strcmp(fields[0], "EXEMAP") && n >= 3 && exe_seq &&
+                   !strcmp(fields[1], exe_seq)) {
+            g_ptr_array_add(exemaps, g_strdup(fields[2]));
+        } else if (!strcmp(fields[0], "CLOSURE") && n >= 2) {
+            char *path = g_filename_from_uri(fields[n - 1], NULL, NULL);
+            in_closure = path && !strcmp(path, app_path);
+            g_free(path);
+        } else if (!strcmp(fields[0], "LIB") && n >= 2 && in_closure) {
+            char *path = g_filename_from_uri(fields[n - 1], NULL, NULL);
+            if (path)
+                set_add(set, path, 0, 0);
+            g_free(path);
+        } else if (strcmp(fields[0], "LIB")) {
+            in_closure = FALSE;
+        }
+
+        g_strfreev(fields);
+    }
+    fclose(f);
+
+    for (guint i = 0; i < exemaps->len; i++) {
+        char **map = g_hash_table_lookup(maps, g_ptr_array_index(exemaps, i));
+        char *path;
+
+        if (!map)
+            continue;
+        path = g_filename_from_uri(map[6], NULL, NULL);
+        if (path)
+            set_add(set, path, g_ascii_strtoull(map[3], NULL, 10),
+                    g_ascii_strtoull(map[4], NULL, 10));
+        g_free(path);
+    }
+
+    g_free(exe_seq);
+    g_ptr_array_free(exemaps, TRUE);
+    g_hash_table_destroy(maps);
+    return (int)(g_hash_table_size(set) - before);
+}
+
+/* Add the file-backed mappings of one process */
+static void
+set_from_maps(GHashTable *set, pid_t pid)
+{
+    char name[64];
+    char line[PATH_MAX + 128];
+    FILE *f;
+
+    snprintf(name, sizeof(name), "/proc/%d/maps", pid);
+    f = fopen(name, "r");
+    if (!f)
+        return;
+
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long start, end, offset;
+        char path[PATH_MAX];
+
+        path[0] = '\0';
+        if (sscanf(line, "%llx-%llx %*s %llx %*s %*s %4095[^\n]",
+                   &start, &end, &offset, path) == 4 &&
+            path[0] == '/' && !strstr(path, " (deleted)") && end > start)
+            set_add(set, path, offset, end - start);
+    }
+    fclose(f);
+}
+
+/* Collect pid and its descendants (needs /proc/PID/task/PID/children) */
+static void
+collect_tree(pid_t pid, GArray *pids, int depth)
+{
+    char name[96];
+    FILE *f;
+    int child;
+
+    g_array_append_val(pids, pid);
+    if (depth > 8)
+        return;
+
+    snprintf(name, sizeof(name), "/proc/%d/task/%d/children", pid, pid);
+    f = fopen(name, "r");
+    if (!f)
+        return;
+    while (fscanf(f, "%d", &child) == 1)
+        collect_tree(child, pids, depth + 1);
+    fclose(f);
+}
+
+/* Major faults of a running process so far (field 12 of /proc/PID/stat) */
+static long
+read_majflt(pid_t pid)
+{
+    char name[64];
+    char buf[1024];
+    FILE *f;
+    long majflt = -1;
+    char *p;
+
+    snprintf(name, sizeof(name), "/proc/%d/stat", pid);
+    f = fopen(name, "r");
+    if (!f)
+        return -1;
+
+    if (fgets(buf, sizeof(buf), f) && (p = strrchr(buf, ')')) &&
+        sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %ld", &majflt) != 1)
+        majflt = -1;
+    fclose(f);
+    return majflt;
+}
+
+/* ========================================================================
+ * PAGE CACHE
+ * ======================================================================== */
+
+/* Resident and total bytes of a file (mincore over a read-only map) */
+static void
+residency(const char *path, guint64 *resident, guint64 *total)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    struct stat st;
+    unsigned char *vec;
+    void *addr;
+    size_t pages;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return;
+
+    pages = ((size_t)st.st_size + page - 1) / page;
+    vec = g_malloc(pages);
+    if (mincore(addr, (size_t)st.st_size, vec) == 0) {
+        for (size_t i = 0; i < pages; i++)
+            if (vec[i] & 1)
+                *resident += (guint64)page;
+    }
+    *total += (guint64)st.st_size;
+    g_free(vec);
+    munmap(addr, (size_t)st.st_size);
+}
+
+/* Drop every file of the set from the page cache */
+static void
+evict(GPtrArray *files)
+{
+    for (guint i = 0; i < files->len; i++) {
+        bench_file_t *f = g_ptr_array_index(files, i);
+        int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/* Read the set back the way the daemon does: readahead() of each region */
+static void
+warm(GPtrArray *files)
+{
+    for (guint i = 0; i < files->len; i++) {
+        bench_file_t *f = g_ptr_array_index(files, i);
+        int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+
+        if (fd < 0)
+            continue;
+
+        if (f->regions->len == 0) {
+            if (fstat(fd, &st) == 0)
+                readahead(fd, 0, (size_t)st.st_size);
+        } else {
+            for (guint j = 0; j < f->regions->len; j++) {
+                region_t *r = &g_array_index(f->regions, region_t, j);
+                readahead(fd, (off64_t)r->offset, (size_t)r->length);
+            }
+        }
+        close(fd);
+    }
+}
+
+/* ========================================================================
+ * LAUNCH
+ * ======================================================================== */
+
+/**
+ * Run the app once up to the ready probe
+ *
+ * @param timeout_ms  0: wait for exit; otherwise stop it after this long
+ * @param set         If set, sample its maps into it while it runs
+ * @return TRUE if it ran (the result is in @out)
+ */
+static gboolean
+launch(char **argv, int timeout_ms, int verbose, GHashTable *set, launch_t *out)
+{
+    struct rusage ru;
+    double t0, ready;
+    long last_majflt = -1;
+    int status;
+    pid_t pid, r;
+
+    t0 = now_ms();
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Error: fork failed: %s\n", strerror(errno));
+        return FALSE;
+    }
+
+    if (pid == 0) {
+        setpgid(0, 0);
+        if (!verbose) {
+            int null = open("/dev/null", O_RDWR);
+            if (null >= 0) {
+                dup2(null, STDIN_FILENO);
+                dup2(null, STDOUT_FILENO);
+                dup2(null, STDERR_FILENO);
+                close(null);
+            }
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    setpgid(pid, pid);
+
+    ready = t0;
+    for (;;) {
+        double now;
+
+        r = wait4(pid, &status, WNOHANG, &ru);
+        if (r == pid || (r < 0 && errno != EINTR))
+            break;
+
+        now = now_ms();
+        if (set) {
+            GArray *pids = g_array_new(FALSE, FALSE, sizeof(pid_t));
+            collect_tree(pid, pids, 0);
+            for (guint i = 0; i < pids->len; i++)
+                set_from_maps(set, g_array_index(pids, pid_t, i));
+            g_array_free(pids, TRUE);
+        }
+        if (timeout_ms > 0) {
+            long majflt = read_majflt(pid);
+            if (majflt > last_majflt) {
+                last_majflt = majflt;
+                ready = now;
+            }
+            if (now - t0 >= timeout_ms || interrupted)
+                break;
+        } else if (interrupted) {
+            break;
+        }
+
+        usleep(SAMPLE_US);
+    }
+
+    if (r != pid) {
+        /* Window over (or interrupted): stop the whole process group */
+        double deadline = now_ms() + KILL_GRACE_US / 1000.0;
+
+        kill(-pid, SIGTERM);
+        while ((r = wait4(pid, &status, WNOHANG, &ru)) == 0 && now_ms() < deadline)
+            usleep(SAMPLE_US);
+        if (r != pid) {
+            kill(-pid, SIGKILL);
+            while ((r = wait4(pid, &status, 0, &ru)) < 0 && errno == EINTR)
+                ;
+        }
+    } else {
+        ready = now_ms();
+        kill(-pid, SIGTERM);    /* Leftover children of an exited app */
+        if (timeout_ms == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+            fprintf(stderr, "Error: cannot run %s\n", argv[0]);
+            return FALSE;
+        }
+    }
+
+    if (r != pid)
+        return FALSE;
+
+    out->wall_ms = ready - t0;
+    out->majflt = ru.ru_majflt;
+    out->inblock_kb = ru.ru_inblock / 2;   /* 512-byte units */
+    return TRUE;
+}
+
+/* ========================================================================
+ * REPORT
+ * ======================================================================== */
+
+static int
+compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile of n values (sorts them) */
+static double
+percentile(double *v, int n, int pct)
+{
+    int rank;
+
+    qsort(v, (size_t)n, sizeof(double), compare_double);
+    rank = (pct * n + 99) / 100;
+    return v[CLAMP(rank, 1, n) - 1];
+}
+
+static void
+report_metric(const char *name, const char *unit, GArray *cold, GArray *warm_runs,
+              size_t field)
+{
+    int n = (int)cold->len;
+    double *c = g_new(double, n), *w = g_new(double, n);
+    double c50, c95, w50, w95;
+
+    for (int i = 0; i < n; i++) {
+        launch_t *a = &g_array_index(cold, launch_t, i);
+        launch_t *b = &g_array_index(warm_runs, launch_t, i);
+        c[i] = field == 0 ? a->wall_ms : field == 1 ? a->majflt : a->inblock_kb;
+        w[i] = field == 0 ? b->wall_ms : field == 1 ? b->majflt : b->inblock_kb;
+    }
+
+    c50 = percentile(c, n, 50);
+    c95 = percentile(c, n, 95);
+    w50 = percentile(w, n, 50);
+    w95 = percentile(w, n, 95);
+
+    printf("  %-14s %10.1f %10.1f %10.1f %10.1f  %s\n", name, c50, w50, c95, w95, unit);
+    if (field == 0)
+        printf("  %-14s %10s %9.2fx %10s %9.2fx\n", "speedup", "",
+               w50 > 0 ? c50 / w50 : 0.0, "", w95 > 0 ? c95 / w95 : 0.0);
+
+    g_free(c);
+    g_free(w);
+}
+
+/* ========================================================================
+ * COMMAND
+ * ======================================================================== */
+
+/* Pause the daemon for the run; returns TRUE if we must resume it */
+static gboolean
+pause_daemon(int iterations, int timeout_ms)
+{
+    FILE *f;
+    long budget;
+
+    if (get_daemon_pid(0) < 0 || access(PAUSEFILE, F_OK) == 0)
+        return FALSE;
+
+    /* Generous expiry so a killed bench doesn't leave it paused for good */
+    budget = 600 + (long)iterations * 2 * (timeout_ms > 0 ? timeout_ms / 1000 + 5 : 120);
+    f = fopen(PAUSEFILE, "w");
+    if (!f) {
+        fprintf(stderr, "Warning: cannot pause the daemon (%s); it may warm the cold runs\n",
+                strerror(errno));
+        return FALSE;
+    }
+    fprintf(f, "%ld\n", (long)time(NULL) + budget);
+    fclose(f);
+    return TRUE;
+}
+
+/**
+ * Command: bench - Cold versus preheated launches of an app
+ */
+int
+cmd_bench(char **argv, int iterations, int timeout_sec, int verbose)
+{
+    GHashTable *set;
+    GPtrArray *files;
+    GArray *cold, *warmed;
+    char resolved[PATH_MAX];
+    const char *app_path;
+    guint64 resident = 0, total = 0;
+    double warm_ms = 0;
+    int timeout_ms = timeout_sec * 1000;
+    int from_state;
+    gboolean paused;
+    launch_t run;
+    struct sigaction sa;
+
+    if (!argv || !argv[0]) {
+        fprintf(stderr, "Error: Missing application\n");
+        fprintf(stderr, "Usage: preheat-ctl bench [-n N] [--timeout SEC] APP [ARGS...]\n");
+        fprintf(stderr, "Example: preheat-ctl bench -n 10 --timeout 8 gimp\n");
+        return 1;
+    }
+    if (iterations < 1 || timeout_sec < 0) {
+        fprintf(stderr, "Error: Invalid iteration count or timeout\n");
+        return 1;
+    }
+
+    app_path = resolve_app_name(argv[0], resolved, sizeof(resolved));
+    if (app_path[0] != '/') {
+        char *found = g_find_program_in_path(argv[0]);
+        if (found && realpath(found, resolved))
+            app_path = resolved;
+        g_free(found);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_interrupt;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    set = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)file_free);
+    if (app_path[0] == '/')
+        set_add(set, app_path, 0, 0);
+    from_state = set_from_state(set, app_path);
+
+    paused = pause_daemon(iterations, timeout_ms);
+
+    /* Untimed run: learn the maps, and let the app create its caches */
+    printf("Discovering files of %s...\n", app_path);
+    if (!launch(argv, timeout_ms, verbose, set, &run)) {
+        if (paused)
+            unlink(PAUSEFILE);
+        g_hash_table_destroy(set);
+        return 1;
+    }
+
+    files = g_ptr_array_new();
+    {
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, set);
+        while (g_hash_table_iter_next(&iter, NULL, &value))
+            g_ptr_array_add(files, value);
+    }
+
+    evict(files);
+    for (guint i = 0; i < files->len; i++)
+        residency(((bench_file_t *)g_ptr_array_index(files, i))->path, &resident, &total);
+
+    printf("File set: %u files, %.1f MB (%d from the state file)\n",
+           files->len, total / 1048576.0, from_state < 0 ? 0 : from_state);
+    if (from_state < 0)
+        printf("  State file not readable: using discovered maps only\n");
+    if (resident > total / 20)
+        printf("  %.1f MB stays resident after eviction (mapped by running processes)\n",
+               resident / 1048576.0);
+    printf("Ready probe: %s\n\n", timeout_ms ? "last major fault within the timeout" : "exit");
+
+    cold = g_array_new(FALSE, FALSE, sizeof(launch_t));
+    warmed = g_array_new(FALSE, FALSE, sizeof(launch_t));
+
+    for (int i = 0; i < iterations && !interrupted; i++) {
+        launch_t c, w;
+        double t0;
+
+        evict(files);
+        if (!launch(argv, timeout_ms, verbose, NULL, &c))
+            break;
+
+        evict(files);
+        t0 = now_ms();
+        warm(files);
+        warm_ms += now_ms() - t0;
+        if (!launch(argv, timeout_ms, verbose, NULL, &w))
+            break;
+
+        g_array_append_val(cold, c);
+        g_array_append_val(warmed, w);
+        printf("  run %2d: cold %8.1f ms %6ld majflt %8ld KB   warm %8.1f ms %6ld majflt %8ld KB\n",
+               i + 1, c.wall_ms, c.majflt, c.inblock_kb, w.wall_ms, w.majflt, w.inblock_kb);
+        fflush(stdout);
+    }
+
+    evict(files);
+    if (paused)
+        unlink(PAUSEFILE);
+
+    if (cold->len == 0) {
+        fprintf(stderr, "Error: no complete iteration\n");
+        g_array_free(cold, TRUE);
+        g_array_free(warmed, TRUE);
+        g_ptr_array_free(files, TRUE);
+        g_hash_table_destroy(set);
+        return 1;
+    }
+
+    printf("\n  %-14s %10s %10s %10s %10s\n", "", "cold p50", "warm p50", "cold p95", "warm p95");
+    report_metric("launch", "ms", cold, warmed, 0);
+    report_metric("major faults", "", cold, warmed, 1);
+    report_metric("block input", "KB", cold, warmed, 2);
+    printf("\n  warm-up read: %.1f ms per launch (%u iterations)\n",
+           warm_ms / cold->len, cold->len);
+
+    g_array_free(cold, TRUE);
+    g_array_free(warmed, TRUE);
+    g_ptr_array_free(files, TRUE);
+    g_hash_table_destroy(set);
+    return interrupted ? 130 : 0;
+}
@@ -150,6 +150,8 @@ cmd_stats_verbose(void)
     int uptime = 0, apps = 0, priority_pool = 0, observation_pool = 0;
     size_t total_mb = 0;
     double hit_rate = 0;
+    unsigned long ra_batches = 0;
+    double ra_meta_ms = 0, ra_sort_ms = 0, ra_data_ms = 0;
     
     struct {
         char name[128];
@@ -174,6 +176,10 @@ cmd_stats_verbose(void)
         sscanf(line, "observation_pool=%d", &observation_pool);
         sscanf(line, "total_preloaded_mb=%zu", &total_mb);
         sscanf(line, "memory_pressure_events=%lu", &mem_pressure);
+        sscanf(line, "readahead_batches=%lu", &ra_batches);
+        sscanf(line, "readahead_meta_ms_total=%lf", &ra_meta_ms);
+        sscanf(line, "readahead_sort_ms_total=%lf", &ra_sort_ms);
+        sscanf(line, "readahead_data_ms_total=%lf", &ra_data_ms);
         
         /* Parse top apps */
         if (strncmp(line, "top_app_", 8) == 0 && num_top_apps < 20) {
@@ -273,6 +279,13 @@ cmd_stats_verbose(void)
     if (mem_pressure > 0) printf(" (skipped due to low memory)\n\n");
     else printf("\n\n");
 
+    if (ra_batches > 0) {
+        printf("  Readahead (avg per batch, %lu batches):\n", ra_batches);
+        printf("    Metadata:     %.1f ms\n", ra_meta_ms / ra_batches);
+        printf("    Sort:         %.1f ms\n", ra_sort_ms / ra_batches);
+        printf("    Data:         %.1f ms\n\n", ra_data_ms / ra_batches);
+    }
+
     printf("  Pool Breakdown:\n");
     printf("    Priority:     %d apps (actively preloaded)\n", priority_pool);
     printf("    Observation:  %d apps (tracked only)\n\n", observation_pool);
@@ -0,0 +1,357 @@
+/* ctl_cmd_trace.c - Trace decoder command
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Commands: trace
+ *
+ * Reads the ring file written by the daemon with "trace = true" (layout
+ * in include/trace_format.h) from its oldest record to its newest, and
+ * prints it either for people or as a preheat-sim workload.
+ */
+
+#define _DEFAULT_SOURCE  /* For localtime_r() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <glib.h>
+
+#include "ctl_commands.h"
+#include "trace_format.h"
+
+/* File paths */
+#define TRACEFILE PKGLOCALSTATEDIR "/preheat.trace"
+
+/* Bounds-checked reader over one record's payload */
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    int ok;
+} cursor_t;
+
+static void
+get(cursor_t *c, void *v, size_t n)
+{
+    if (!c->ok || (size_t)(c->end - c->p) < n) {
+        c->ok = 0;
+        memset(v, 0, n);
+        return;
+    }
+    memcpy(v, c->p, n);
+    c->p += n;
+}
+
+static int32_t  get_i32(cursor_t *c) { int32_t v;  get(c, &v, sizeof(v)); return v; }
+static uint32_t get_u32(cursor_t *c) { uint32_t v; get(c, &v, sizeof(v)); return v; }
+static int64_t  get_i64(cursor_t *c) { int64_t v;  get(c, &v, sizeof(v)); return v; }
+static uint64_t get_u64(cursor_t *c) { uint64_t v; get(c, &v, sizeof(v)); return v; }
+static double   get_f64(cursor_t *c) { double v;   get(c, &v, sizeof(v)); return v; }
+
+static const char *
+get_str(cursor_t *c)
+{
+    const unsigned char *nul;
+
+    if (!c->ok || !(nul = memchr(c->p, '\0', (size_t)(c->end - c->p)))) {
+        c->ok = 0;
+        return "";
+    }
+    const char *s = (const char *)c->p;
+    c->p = nul + 1;
+    return s;
+}
+
+/* One mapped region of a MAPSET */
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+    char *path;
+} region_t;
+
+static void
+region_array_free(gpointer data)
+{
+    GArray *regions = data;
+
+    for (guint i = 0; i < regions->len; i++)
+        g_free(g_array_index(regions, region_t, i).path);
+    g_array_free(regions, TRUE);
+}
+
+typedef struct {
+    int sim;
+    int verbose;
+    int64_t first_us;       /* Time of the oldest record */
+    double last_t;          /* --sim: keep times non-decreasing */
+    GHashTable *mapsets;    /* --sim: exe → GArray of region_t */
+    unsigned long counts[KP_TRACE_READAHEAD + 1];
+} decode_t;
+
+static void
+print_time(int64_t time_us)
+{
+    time_t sec = (time_t)(time_us / 1000000);
+    struct tm tm;
+    char buf[32];
+
+    localtime_r(&sec, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%s.%03d  ", buf, (int)(time_us % 1000000 / 1000));
+}
+
+/* (offset, length, path) list of MAPSET and READAHEAD */
+static void
+print_regions(cursor_t *c, uint32_t count, int verbose)
+{
+    for (uint32_t i = 0; i < count && c->ok; i++) {
+        uint64_t offset = get_u64(c);
+        uint64_t length = get_u64(c);
+        const char *path = get_str(c);
+
+        if (verbose && c->ok)
+            printf("      %12llu +%-10llu %s\n",
+                   (unsigned long long)offset, (unsigned long long)length, path);
+    }
+}
+
+static void
+decode_human(decode_t *d, const kp_trace_record_t *rec, cursor_t *c)
+{
+    const char *kind[] = { "PAD", "EXEC", "EXIT", "MAPSET", "CYCLE", "READAHEAD" };
+
+    print_time(rec->time_us);
+    printf("%-9s ", kind[rec->type]);
+
+    switch (rec->type) {
+    case KP_TRACE_EXEC: {
+        int32_t pid = get_i32(c);
+        int32_t ppid = get_i32(c);
+        const char *exe = get_str(c);
+        printf("pid=%d ppid=%d %s%s\n", pid, ppid,
+               (rec->flags & KP_TRACE_F_USER) ? "user " : "", exe);
+        break;
+    }
+    case KP_TRACE_EXIT:
+        printf("pid=%d\n", get_i32(c));
+        break;
+    case KP_TRACE_MAPSET: {
+        uint32_t count = get_u32(c);
+        const char *exe = get_str(c);
+        printf("%s: %u maps%s\n", exe, count,
+               (rec->flags & KP_TRACE_F_TRUNCATED) ? " (truncated)" : "");
+        print_regions(c, count, d->verbose);
+        break;
+    }
+    case KP_TRACE_CYCLE: {
+        int32_t model_time = get_i32(c);
+        int32_t cycle = get_i32(c);
+        int64_t budget_kb = get_i64(c);
+        int64_t used_kb = get_i64(c);
+        uint32_t ranked = get_u32(c);
+        uint32_t selected = get_u32(c);
+        uint32_t count = get_u32(c);
+
+        printf("time=%d cycle=%ds budget=%lldkB used=%lldkB maps=%u/%u%s%s%s\n",
+               model_time, cycle, (long long)budget_kb, (long long)used_kb,
+               selected, ranked,
+               (rec->flags & KP_TRACE_F_URGENT) ? " urgent" : "",
+               (rec->flags & KP_TRACE_F_REWARM) ? " rewarm" : "",
+               (rec->flags & KP_TRACE_F_COALESCED) ? " coalesced" : "");
+        for (uint32_t i = 0; i < count && c->ok; i++) {
+            double lnprob = get_f64(c);
+            const char *exe = get_str(c);
+            if (c->ok)
+                printf("      %5.1f%% %s\n", 100.0 * (1.0 - exp(lnprob)), exe);
+        }
+        break;
+    }
+    case KP_TRACE_READAHEAD: {
+        uint32_t files = get_u32(c);
+        uint64_t bytes = get_u64(c);
+        uint32_t count = get_u32(c);
+
+        printf("%u files, %.1f MB%s%s%s%s\n", files, bytes / (1024.0 * 1024.0),
+               (rec->flags & KP_TRACE_F_HOTSET) ? " hotset" : "",
+               (rec->flags & KP_TRACE_F_REWARM) ? " rewarm" : "",
+               (rec->flags & KP_TRACE_F_REPEAT) ? " (same as before)" : "",
+               (rec->flags & KP_TRACE_F_TRUNCATED) ? " (truncated)" : "");
+        print_regions(c, count, d->verbose);
+        break;
+    }
+    }
+}
+
+/* Emit the preheat-sim workload format (see src/sim/sim.c) */
+static void
+decode_sim(decode_t *d, const kp_trace_record_t *rec, cursor_t *c)
+{
+    double t = (rec->time_us - d->first_us) / 1e6;
+
+    if (t < d->last_t)
+        t = d->last_t;      /* Wall clock stepped back */
+    d->last_t = t;
+
+    switch (rec->type) {
+    case KP_TRACE_EXEC: {
+        int32_t pid = get_i32(c);
+        int32_t ppid = get_i32(c);
+        const char *exe = get_str(c);
+        GArray *regions;
+
+        if (!c->ok)
+            break;
+        printf("%.3f EXEC %d %d %d %s\n", t, pid, ppid,
+               (rec->flags & KP_TRACE_F_USER) ? 1 : 0, exe);
+
+        regions = g_hash_table_lookup(d->mapsets, exe);
+        for (guint i = 0; regions && i < regions->len; i++) {
+            region_t *r = &g_array_index(regions, region_t, i);
+            printf("%.3f MAP %d %llu %llu %s\n", t, pid,
+                   (unsigned long long)r->offset, (unsigned long long)r->length, r->path);
+        }
+        break;
+    }
+    case KP_TRACE_EXIT: {
+        int32_t pid = get_i32(c);
+        if (c->ok)
+            printf("%.3f EXIT %d\n", t, pid);
+        break;
+    }
+    case KP_TRACE_MAPSET: {
+        uint32_t count = get_u32(c);
+        const char *exe = get_str(c);
+        GArray *regions = g_array_new(FALSE, FALSE, sizeof(region_t));
+
+        for (uint32_t i = 0; i < count && c->ok; i++) {
+            region_t r;
+            r.offset = get_u64(c);
+            r.length = get_u64(c);
+            r.path = (char *)get_str(c);
+            if (!c->ok)
+                break;
+            r.path = g_strdup(r.path);
+            g_array_append_val(regions, r);
+        }
+        g_hash_table_replace(d->mapsets, g_strdup(exe), regions);
+        break;
+    }
+    default:
+        break;      /* The simulator makes its own predictions */
+    }
+}
+
+/**
+ * Command: trace - Decode the trace ring file
+ */
+int
+cmd_trace(const char *filepath, int sim, int verbose)
+{
+    const char *path = filepath ? filepath : TRACEFILE;
+    gchar *contents;
+    gsize length;
+    GError *err = NULL;
+    kp_trace_header_t hdr;
+    const unsigned char *data;
+    uint64_t pos, left;
+    unsigned long records = 0, damaged = 0;
+    decode_t d;
+
+    if (!g_file_get_contents(path, &contents, &length, &err)) {
+        fprintf(stderr, "Error: Cannot read trace file %s: %s\n", path, err->message);
+        if (err->code == G_FILE_ERROR_ACCES || err->code == G_FILE_ERROR_PERM)
+            fprintf(stderr, "Hint: Try with sudo\n");
+        else if (err->code == G_FILE_ERROR_NOENT)
+            fprintf(stderr, "Hint: Set 'trace = true' in the [system] section and reload\n");
+        g_error_free(err);
+        return 1;
+    }
+
+    if (length < KP_TRACE_HEADER_SIZE) {
+        fprintf(stderr, "Error: %s is not a preheat trace\n", path);
+        g_free(contents);
+        return 1;
+    }
+    memcpy(&hdr, contents, sizeof(hdr));
+    if (memcmp(hdr.magic, KP_TRACE_MAGIC, sizeof(hdr.magic)) ||
+        hdr.header_size != KP_TRACE_HEADER_SIZE ||
+        hdr.capacity > length - KP_TRACE_HEADER_SIZE ||
+        hdr.head >= hdr.capacity || hdr.tail >= hdr.capacity || hdr.used > hdr.capacity) {
+        fprintf(stderr, "Error: %s is not a preheat trace\n", path);
+        g_free(contents);
+        return 1;
+    }
+    if (hdr.version != KP_TRACE_VERSION) {
+        fprintf(stderr, "Error: %s has trace format version %u, this preheat-ctl reads %d\n",
+                path, hdr.version, KP_TRACE_VERSION);
+        g_free(contents);
+        return 1;
+    }
+
+    memset(&d, 0, sizeof(d));
+    d.sim = sim;
+    d.verbose = verbose;
+    d.mapsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, region_array_free);
+
+    data = (const unsigned char *)contents + KP_TRACE_HEADER_SIZE;
+
+    if (sim)
+        printf("# preheat-sim workload from %s\n", path);
+
+    /* Walk from the oldest record, following lengths around the ring */
+    for (pos = hdr.tail, left = hdr.used; left > 0; ) {
+        kp_trace_record_t rec;
+        cursor_t c;
+
+        memcpy(&rec, data + pos, sizeof(rec));
+        if (rec.len < sizeof(rec) || rec.len % KP_TRACE_ALIGN ||
+            rec.len > left || pos + rec.len > hdr.capacity) {
+            damaged = 1;
+            break;
+        }
+
+        if (rec.type != KP_TRACE_PAD && rec.type <= KP_TRACE_READAHEAD) {
+            if (!records)
+                d.first_us = rec.time_us;
+            records++;
+            d.counts[rec.type]++;
+
+            c.p = data + pos + sizeof(rec);
+            c.end = data + pos + rec.len;
+            c.ok = 1;
+            if (sim)
+                decode_sim(&d, &rec, &c);
+            else
+                decode_human(&d, &rec, &c);
+        }
+
+        pos += rec.len;
+        left -= rec.len;
+        if (pos == hdr.capacity)
+            pos = 0;
+    }
+
+    if (!sim) {
+        time_t started = (time_t)(hdr.started_us / 1000000);
+
+        printf("\nTrace %s: %llu KB ring, started %s", path,
+               (unsigned long long)(hdr.capacity / 1024), ctime(&started));
+        printf("  %lu records (%lu exec, %lu exit, %lu mapset, %lu cycle, %lu readahead)\n",
+               records, d.counts[KP_TRACE_EXEC], d.counts[KP_TRACE_EXIT],
+               d.counts[KP_TRACE_MAPSET], d.counts[KP_TRACE_CYCLE],
+               d.counts[KP_TRACE_READAHEAD]);
+        printf("  %llu older records overwritten, %llu dropped\n",
+               (unsigned long long)(hdr.records - records),
+               (unsigned long long)hdr.dropped);
+    }
+    if (damaged)
+        fprintf(stderr, "Warning: trace damaged at offset %llu, stopped there\n",
+                (unsigned long long)pos);
+
+    g_hash_table_destroy(d.mapsets);
+    g_free(contents);
+    return damaged ? 1 : 0;
+}
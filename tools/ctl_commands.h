@@ -8,6 +8,8 @@
  *   - ctl_cmd_stats.c  - Statistics & monitoring (stats, health, mem)
  *   - ctl_cmd_apps.c   - App management (explain, predict, promote, etc.)
  *   - ctl_cmd_io.c     - Import/export (export, import)
+ *   - ctl_cmd_trace.c  - Trace decoder (trace)
+ *   - ctl_cmd_bench.c  - Launch benchmark (bench)
  */
 
 #ifndef CTL_COMMANDS_H
@@ -81,4 +83,15 @@ int cmd_export(const char *filepath);
 /* Validate JSON import file */
 int cmd_import(const char *filepath);
 
+
+/* === Trace commands (ctl_cmd_trace.c) === */
+
+/* Decode the trace ring file, or convert it to a preheat-sim workload */
+int cmd_trace(const char *filepath, int sim, int verbose);
+
+/* === Benchmark commands (ctl_cmd_bench.c) === */
+
+/* Time cold against preheated launches of a command line */
+int cmd_bench(char **argv, int iterations, int timeout_sec, int verbose);
+
 #endif /* CTL_COMMANDS_H */
@@ -21,6 +21,7 @@
 #define _DEFAULT_SOURCE  /* For realpath() */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <limits.h>
@@ -18,12 +18,15 @@
  *   - Pause file (/run/preheat.pause) for pause state
  *   - Stats file (/run/preheat.stats) for statistics
  *   - State file (preheat.state) for reading learned patterns
+ *   - Trace file (preheat.trace) for recorded workloads
  *
  * COMMAND MODULES:
  *   - ctl_cmd_basic.c  - Daemon lifecycle (status, pause, resume, etc.)
  *   - ctl_cmd_stats.c  - Statistics & monitoring (stats, health, mem)
  *   - ctl_cmd_apps.c   - App management (explain, predict, promote, etc.)
  *   - ctl_cmd_io.c     - Import/export (export, import)
+ *   - ctl_cmd_trace.c  - Trace decoder (trace)
+ *   - ctl_cmd_bench.c  - Launch benchmark (bench)
  *
  * UTILITY MODULES:
  *   - ctl_daemon.c     - PID file reading, signal sending
@@ -73,6 +76,8 @@ print_usage(const char *prog)
     printf("  reset       Remove manual override for an app\n");
     printf("  explain     Explain why an app is/isn't preloaded\n");
     printf("  health      Quick system health check (exit codes: 0/1/2)\n");
+    printf("  trace       Decode the recorded trace (trace = true)\n");
+    printf("  bench       Time cold vs preheated launches of an app\n");
     printf("  help        Show this help message\n");
     printf("\nOptions for stats:\n");
     printf("  --verbose   Show detailed statistics with top 20 apps\n");
@@ -85,6 +90,15 @@ print_usage(const char *prog)
     printf("  FILE        Path to JSON file (default: %s)\n", DEFAULT_EXPORT);
     printf("\nOptions for promote/demote/reset/explain:\n");
     printf("  APP         Application name or path (e.g., firefox, /usr/bin/code)\n");
+    printf("\nOptions for trace:\n");
+    printf("  --sim       Print a workload for preheat-sim instead\n");
+    printf("  -v          List the files of map sets and readahead batches\n");
+    printf("  FILE        Trace file (default: the daemon's)\n");
+    printf("\nOptions for bench:\n");
+    printf("  -n N        Cold/warm launch pairs (default: 5)\n");
+    printf("  --timeout S Stop the app after S seconds (GUI apps; default: wait for exit)\n");
+    printf("  -v          Show the app's output\n");
+    printf("  APP [ARGS]  Command line to launch (after -- if it starts with -)\n");
     printf("\n");
 }
 
@@ -189,6 +203,37 @@ main(int argc, char **argv)
         return cmd_explain(app_name);
     } else if (strcmp(cmd, "health") == 0) {
         return cmd_health();
+    } else if (strcmp(cmd, "trace") == 0) {
+        const char *filepath = NULL;
+        int sim = 0, verbose = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--sim") == 0) {
+                sim = 1;
+            } else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+                verbose = 1;
+            } else {
+                filepath = argv[i];
+            }
+        }
+        return cmd_trace(filepath, sim, verbose);
+    } else if (strcmp(cmd, "bench") == 0) {
+        int iterations = 5, timeout_sec = 0, verbose = 0;
+        int i = 2;
+        for (; i < argc; i++) {
+            if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+                iterations = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+                timeout_sec = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+                verbose = 1;
+            } else if (strcmp(argv[i], "--") == 0) {
+                i++;
+                break;
+            } else {
+                break;
+            }
+        }
+        return cmd_bench(i < argc ? &argv[i] : NULL, iterations, timeout_sec, verbose);
     } else if (strcmp(cmd, "help") == 0 || strcmp(cmd, "--help") == 0 || strcmp(cmd, "-h") == 0) {
         print_usage(argv[0]);
         return 0;